@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_err.h"
+
+#include "sdi12_bus.h"
+#include "sdi12_dev.h"
+#include "sdi12_sched.h"
+#include "sdi12_sim.h"
+
+#define SIM_SENSORS    (3)
+#define SIM_HORIZON_US (24LL * 3600 * 1000000) // One virtual day
+#define SIM_PERIOD_MS  (3600 * 1000)
+#define SIM_SLOT_MS    (1000 * 1000) // Covers 999 s ttt
+
+static const char *TAG = "SDI12-SIM";
+
+static SemaphoreHandle_t done_sem;
+static uint32_t samples;
+static uint32_t errors;
+
+/**
+ * @brief Slow measurements: 999 s announced, service request some minutes earlier. Values follow virtual time, so runs are repeatable.
+ */
+static esp_err_t on_measure(char address, const char *cmd, sdi12_sensor_measurement_t *measurement, void *user_ctx)
+{
+    sdi12_clock_t *clock = (sdi12_clock_t *)user_ctx;
+    double hours = clock->now_us(clock) / 3600e6;
+
+    measurement->ttt_s = 999;
+    measurement->ready_ms = (600 + 60 * (address - '0')) * 1000;
+
+    snprintf(measurement->values, measurement->values_length, "%+.2f%+.1f", 15.0 + (address - '0') + 8.0 * sin(hours * M_PI / 12), 1013.0 - hours / 10);
+
+    return ESP_OK;
+}
+
+static void on_data(size_t plan_index, const sdi12_sched_sample_t *sample, void *ctx)
+{
+    int64_t seconds = sample->started_us / 1000000;
+
+    ++samples;
+    errors += sample->ret != ESP_OK;
+
+    ESP_LOGI(TAG, "%02d:%02d:%02d plan %u: %s %s", (int)(seconds / 3600), (int)(seconds / 60 % 60), (int)(seconds % 60), (unsigned)plan_index,
+        sample->ret == ESP_OK ? sample->values : "", esp_err_to_name(sample->ret));
+
+    if (sample->scheduled_us >= SIM_HORIZON_US)
+    {
+        xSemaphoreGive(done_sem);
+    }
+}
+
+void app_main(void)
+{
+    sdi12_clock_t *clock;
+    sdi12_clock_t *system_clock = sdi12_clock_get_system();
+
+    done_sem = xSemaphoreCreateBinary();
+    ESP_ERROR_CHECK(sdi12_new_sim_clock(0, &clock));
+
+    sdi12_sensor_device_config_t devices[SIM_SENSORS];
+
+    for (size_t i = 0; i < SIM_SENSORS; i++)
+    {
+        devices[i] = (sdi12_sensor_device_config_t) {
+            .address = '0' + i,
+            .on_measure = on_measure,
+            .user_ctx = clock,
+        };
+    }
+
+    sdi12_sim_config_t sim = {
+        .devices = devices,
+        .devices_count = SIM_SENSORS,
+    };
+
+    sdi12_bus_config_t bus_config = {
+        .transport = SDI12_BUS_TRANSPORT_SIM,
+        .sim = &sim,
+        .clock = clock,
+    };
+
+    sdi12_bus_handle_t bus;
+    ESP_ERROR_CHECK(sdi12_new_bus(&bus_config, &bus));
+
+    sdi12_sched_plan_t plans[SIM_SENSORS];
+
+    for (size_t i = 0; i < SIM_SENSORS; i++)
+    {
+        sdi12_dev_handle_t dev;
+        ESP_ERROR_CHECK(sdi12_new_dev(bus, '0' + i, &dev));
+
+        plans[i] = (sdi12_sched_plan_t) {
+            .dev = dev,
+            .type = SDI12_SCHED_MEASUREMENT_M,
+            .period_ms = SIM_PERIOD_MS,
+            .phase_ms = i * (SIM_PERIOD_MS / SIM_SENSORS),
+            .slot_ms = SIM_SLOT_MS,
+            .on_data = on_data,
+        };
+    }
+
+    sdi12_sched_config_t sched_config = {
+        .plans = plans,
+        .plans_length = SIM_SENSORS,
+        .clock = clock,
+        .task_priority = 1, // Same as main task: simulated waits only yield, they never block
+    };
+
+    int64_t real_start_us = system_clock->now_us(system_clock);
+    sdi12_sched_handle_t sched;
+
+    ESP_ERROR_CHECK(sdi12_new_sched(&sched_config, &sched));
+    xSemaphoreTake(done_sem, portMAX_DELAY);
+    sdi12_del_sched(sched);
+
+    int64_t real_us = system_clock->now_us(system_clock) - real_start_us;
+    sdi12_bus_health_t health;
+    sdi12_bus_get_health(bus, '\0', &health);
+
+    ESP_LOGI(TAG, "Virtual day done in %" PRId64 " ms. Samples: %" PRIu32 " Errors: %" PRIu32 " Cmds: %" PRIu32 " Timeouts: %" PRIu32, real_us / 1000,
+        samples, errors, health.commands, health.timeouts);
+}
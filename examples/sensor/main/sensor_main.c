@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+
+#include "sdi12_sensor.h"
+
+#define SDI12_DATA_GPIO CONFIG_EXAMPLE_SDI12_BUS_GPIO
+#define SDI12_SENSORS   CONFIG_EXAMPLE_SDI12_SENSORS
+
+static const char *TAG = "SDI12-SENSOR";
+
+/**
+ * @brief Synthetic weather station: temperature, pressure and humidity following a slow sine, offset by sensor address.
+ */
+static esp_err_t on_measure(char address, const char *cmd, sdi12_sensor_measurement_t *measurement, void *user_ctx)
+{
+    double phase = esp_timer_get_time() / 60e6;
+    double offset = address - '0';
+
+    measurement->ttt_s = cmd[0] == 'R' ? 0 : CONFIG_EXAMPLE_SDI12_TTT;
+    measurement->ready_ms = measurement->ttt_s * 800; // Service request comes before announced time, like most real sensors
+
+    snprintf(measurement->values, measurement->values_length, "%+.2f%+.1f%+.1f", 20.0 + offset + 5.0 * sin(phase), 1013.0 + 2.0 * cos(phase),
+        50.0 + 10.0 * sin(phase / 2));
+
+    return ESP_OK;
+}
+
+void app_main(void)
+{
+    sdi12_sensor_device_config_t devices[SDI12_SENSORS];
+
+    for (size_t i = 0; i < SDI12_SENSORS; i++)
+    {
+        devices[i] = (sdi12_sensor_device_config_t) {
+            .address = '0' + i,
+            .on_measure = on_measure,
+        };
+    }
+
+    sdi12_sensor_config_t config = {
+        .gpio_num = SDI12_DATA_GPIO,
+        .devices = devices,
+        .devices_count = SDI12_SENSORS,
+        .response_delay_us = CONFIG_EXAMPLE_SDI12_RESPONSE_DELAY_US,
+    };
+
+    sdi12_sensor_handle_t sensor;
+
+    ESP_ERROR_CHECK(sdi12_new_sensor(&config, &sensor));
+
+    ESP_LOGI(TAG, "Answering as sensors 0 to %d", SDI12_SENSORS - 1);
+
+    while (true)
+    {
+        vTaskDelay(pdMS_TO_TICKS(10000));
+
+        sdi12_sensor_stats_t stats;
+        sdi12_sensor_get_stats(sensor, &stats);
+
+        ESP_LOGI(TAG, "Cmds: %" PRIu32 " Responses: %" PRIu32 " Service requests: %" PRIu32 " Aborted: %" PRIu32 " RX errors: %" PRIu32
+                      " Late: %" PRIu32 " Max delay: %" PRIu32 " us",
+            stats.cmds, stats.responses, stats.service_requests, stats.aborted, stats.rx_errors, stats.late_responses, stats.max_response_delay_us);
+    }
+}
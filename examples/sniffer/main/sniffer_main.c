@@ -0,0 +1,51 @@
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_err.h"
+
+#include "sdi12_sniffer.h"
+
+#define SDI12_DATA_GPIO CONFIG_EXAMPLE_SDI12_BUS_GPIO
+
+static const char *TAG = "SDI12-SNIFFER";
+static uint8_t capture_ring[4096];
+
+void app_main(void)
+{
+    sdi12_sniffer_config_t config = {
+        .gpio_num = SDI12_DATA_GPIO,
+        .ring = capture_ring,
+        .ring_size = sizeof(capture_ring),
+    };
+
+    sdi12_sniffer_handle_t sniffer;
+
+    ESP_ERROR_CHECK(sdi12_new_sniffer(&config, &sniffer));
+
+    ESP_LOGI(TAG, "Listening...");
+
+    int64_t last_us = 0;
+
+    while (true)
+    {
+        sdi12_sniffer_frame_t frame;
+
+        if (sdi12_sniffer_read(sniffer, &frame, 10000) != ESP_OK)
+        {
+            sdi12_sniffer_stats_t stats;
+            sdi12_sniffer_get_stats(sniffer, &stats);
+            ESP_LOGI(TAG, "Idle. Frames: %" PRIu32 " Dropped: %" PRIu32 " Errors: %" PRIu32, stats.frames, stats.dropped, stats.errors);
+            continue;
+        }
+
+        // Frame data points into capture ring, so it is printed before release
+        printf("%10.3f ms %+9.3f ms %s %s%.*s%s\n", frame.timestamp_us / 1000.0, (frame.timestamp_us - last_us) / 1000.0,
+            (frame.flags & SDI12_SNIFFER_FRAME_CMD) ? "CMD" : "RSP", (frame.flags & SDI12_SNIFFER_FRAME_BREAK) ? "[BRK] " : "", frame.length, frame.data,
+            (frame.flags & SDI12_SNIFFER_FRAME_ERROR) ? " [ERR]" : "");
+
+        last_us = frame.timestamp_us;
+        sdi12_sniffer_release(sniffer);
+    }
+}
@@ -0,0 +1,495 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_err.h"
+
+#include "sdi12_bus.h"
+#include "sdi12_dev.h"
+#include "sdi12_sim.h"
+#include "sdi12_sensor.h"
+
+#define BENCH_WINDOW_US     ((int64_t)CONFIG_EXAMPLE_BENCH_WINDOW_S * 1000000)
+#define BENCH_MAX_SENSORS   (8)
+#define BENCH_VALUES_CHARS  (256)
+#define BENCH_LATENCY_BINS  (464) // 16 bins per power of 2 up to 2^32 ms, ~3% resolution
+
+static const char *TAG = "SDI12-THROUGHPUT";
+
+typedef enum
+{
+    BENCH_STRATEGY_M = 0, // aM! and aDn! reads, one sensor after another
+    BENCH_STRATEGY_C,     // aC! on every sensor, then aDn! reads as values get ready
+    BENCH_STRATEGY_R,     // aR0!, one sensor after another
+    BENCH_STRATEGY_MAX,
+} bench_strategy_t;
+
+static const char *strategy_names[BENCH_STRATEGY_MAX] = { "M", "C", "R" };
+
+/**
+ * @brief Virtual sensor model
+ */
+typedef struct
+{
+    uint16_t ttt_s;
+    uint8_t n_values;
+    bool crc;
+    uint16_t fault_permille; // Cmds answered wrong: no response, bad CRC or service request later than ttt
+} bench_profile_t;
+
+typedef struct
+{
+    const char *name;
+    const bench_profile_t *profiles; // One per sensor, at addresses 0 to count - 1
+    size_t count;
+} bench_fleet_t;
+
+static const bench_profile_t fast_profiles[] = {
+    { .ttt_s = 1, .n_values = 3 },
+    { .ttt_s = 1, .n_values = 3 },
+    { .ttt_s = 2, .n_values = 4 },
+    { .ttt_s = 2, .n_values = 4 },
+};
+
+static const bench_profile_t mixed_profiles[] = {
+    { .ttt_s = 0, .n_values = 2 },
+    { .ttt_s = 1, .n_values = 4, .crc = true },
+    { .ttt_s = 5, .n_values = 9, .fault_permille = 10 },
+    { .ttt_s = 15, .n_values = 6, .crc = true, .fault_permille = 10 },
+    { .ttt_s = 30, .n_values = 12 },
+    { .ttt_s = 60, .n_values = 20, .crc = true },
+};
+
+static const bench_profile_t slow_noisy_profiles[] = {
+    { .ttt_s = 120, .n_values = 9, .crc = true, .fault_permille = 50 },
+    { .ttt_s = 120, .n_values = 9, .crc = true, .fault_permille = 50 },
+    { .ttt_s = 180, .n_values = 5, .fault_permille = 50 },
+    { .ttt_s = 300, .n_values = 9, .fault_permille = 50 },
+};
+
+static const bench_fleet_t fleets[] = {
+    { "fast", fast_profiles, sizeof(fast_profiles) / sizeof(fast_profiles[0]) },
+    { "mixed", mixed_profiles, sizeof(mixed_profiles) / sizeof(mixed_profiles[0]) },
+    { "slow-noisy", slow_noisy_profiles, sizeof(slow_noisy_profiles) / sizeof(slow_noisy_profiles[0]) },
+};
+
+typedef struct
+{
+    const bench_profile_t *profile;
+    uint32_t rng;   // Fault injection state. Seeded per run, so runs are repeatable
+    bool late_next; // Next measurement sends its service request after ttt
+} bench_sensor_t;
+
+typedef struct
+{
+    sdi12_clock_t *clock;
+    sdi12_bus_handle_t bus;
+    sdi12_dev_handle_t devs[BENCH_MAX_SENSORS];
+    size_t count;
+    uint32_t readings;
+    uint32_t failed;
+    uint32_t latency_ms[BENCH_LATENCY_BINS];
+    char buffer[BENCH_VALUES_CHARS];
+} bench_run_t;
+
+static bench_sensor_t sensors[BENCH_MAX_SENSORS];
+static bool faults_enabled;
+
+/**
+ * @brief Values a sensor returns: aM! can announce up to 9 and an aR0! response holds 75 chars
+ */
+static uint8_t values_for(const bench_profile_t *profile, char cmd)
+{
+    switch (cmd)
+    {
+        case 'M':
+            return profile->n_values < 9 ? profile->n_values : 9;
+        case 'R':
+            return profile->n_values < 10 ? profile->n_values : 10;
+        default:
+            return profile->n_values;
+    }
+}
+
+static uint32_t xorshift32(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static esp_err_t on_cmd(char address, const char *cmd, char *out_response, size_t out_response_length, void *user_ctx)
+{
+    bench_sensor_t *sensor = (bench_sensor_t *)user_ctx;
+
+    if (!faults_enabled || xorshift32(&sensor->rng) % 1000 >= sensor->profile->fault_permille)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    switch (xorshift32(&sensor->rng) % 3)
+    {
+        case 0:
+            if (sensor->profile->crc && (cmd[1] == 'D' || cmd[1] == 'R'))
+            {
+                snprintf(out_response, out_response_length, "%c+0.00@@@", address);
+                return ESP_OK;
+            }
+            return ESP_FAIL;
+
+        case 1:
+            sensor->late_next = true;
+            return ESP_ERR_NOT_SUPPORTED;
+
+        default:
+            return ESP_FAIL; // Sensor stays silent
+    }
+}
+
+static esp_err_t on_measure(char address, const char *cmd, sdi12_sensor_measurement_t *measurement, void *user_ctx)
+{
+    bench_sensor_t *sensor = (bench_sensor_t *)user_ctx;
+    size_t offset = 0;
+    uint8_t n_values = values_for(sensor->profile, cmd[0]);
+
+    for (uint8_t i = 0; i < n_values && offset < measurement->values_length; i++)
+    {
+        offset += snprintf(measurement->values + offset, measurement->values_length - offset, "%+.2f", (address - '0') * 10.0 + i * 0.25);
+    }
+
+    measurement->ttt_s = cmd[0] == 'R' ? 0 : sensor->profile->ttt_s;
+    measurement->ready_ms = sensor->late_next ? measurement->ttt_s * 1000 + 2000 : measurement->ttt_s * 750;
+    sensor->late_next = false;
+
+    return ESP_OK;
+}
+
+static uint32_t latency_bin(uint32_t value)
+{
+    if (value < 16)
+    {
+        return value;
+    }
+
+    uint32_t msb = 31 - __builtin_clz(value);
+    return (msb - 3) * 16 + ((value >> (msb - 4)) - 16);
+}
+
+static uint32_t latency_bin_value(uint32_t bin)
+{
+    if (bin < 16)
+    {
+        return bin;
+    }
+
+    uint32_t msb = bin / 16 + 3;
+    return (bin % 16 + 16) << (msb - 4);
+}
+
+/**
+ * @brief Latency percentile, in ms. Lower bound of its bin
+ */
+static uint32_t latency_percentile(const bench_run_t *run, uint32_t permille)
+{
+    uint32_t target = ((uint64_t)run->readings * permille + 999) / 1000;
+    uint32_t seen = 0;
+
+    for (uint32_t bin = 0; bin < BENCH_LATENCY_BINS; bin++)
+    {
+        seen += run->latency_ms[bin];
+
+        if (seen >= target && seen > 0)
+        {
+            return latency_bin_value(bin);
+        }
+    }
+
+    return 0;
+}
+
+static void account_reading(bench_run_t *run, esp_err_t ret, int64_t start_us)
+{
+    if (ret != ESP_OK)
+    {
+        ++run->failed;
+        return;
+    }
+
+    uint32_t latency_ms = (run->clock->now_us(run->clock) - start_us) / 1000;
+
+    ++run->readings;
+    ++run->latency_ms[latency_bin(latency_ms)];
+}
+
+static size_t count_values(const char *values)
+{
+    size_t count = 0;
+
+    for (; *values != '\0'; values++)
+    {
+        count += *values == '+' || *values == '-';
+    }
+
+    return count;
+}
+
+/**
+ * @brief Read aDn! pages until n_values are collected
+ */
+static esp_err_t read_values(bench_run_t *run, size_t sensor, uint8_t n_values)
+{
+    size_t collected = 0;
+
+    for (uint8_t page = 0; page <= 9 && collected < n_values; page++)
+    {
+        esp_err_t ret = sdi12_dev_read_data(run->devs[sensor], page, sensors[sensor].profile->crc, run->buffer, sizeof(run->buffer), 0);
+
+        if (ret != ESP_OK)
+        {
+            return ret;
+        }
+
+        size_t page_values = count_values(run->buffer + 1);
+
+        if (page_values == 0)
+        {
+            break; // Values aren't ready
+        }
+
+        collected += page_values;
+    }
+
+    return collected == n_values ? ESP_OK : ESP_ERR_INVALID_RESPONSE;
+}
+
+static void run_m_cycle(bench_run_t *run)
+{
+    for (size_t i = 0; i < run->count; i++)
+    {
+        int64_t start_us = run->clock->now_us(run->clock);
+        uint8_t n_values = 0;
+        esp_err_t ret = sdi12_dev_start_measurement(run->devs[i], 0, sensors[i].profile->crc, &n_values, 0);
+
+        if (ret == ESP_OK)
+        {
+            ret = read_values(run, i, n_values);
+        }
+
+        account_reading(run, ret, start_us);
+    }
+}
+
+static void run_c_cycle(bench_run_t *run)
+{
+    int64_t start_us[BENCH_MAX_SENSORS];
+    int64_t ready_us[BENCH_MAX_SENSORS];
+    uint8_t n_values[BENCH_MAX_SENSORS];
+    bool started[BENCH_MAX_SENSORS];
+
+    for (size_t i = 0; i < run->count; i++)
+    {
+        start_us[i] = run->clock->now_us(run->clock);
+        started[i] = sdi12_dev_start_concurrent_measurement(run->devs[i], 0, sensors[i].profile->crc, &n_values[i], 0) == ESP_OK;
+        ready_us[i] = run->clock->now_us(run->clock) + (int64_t)sensors[i].profile->ttt_s * 1000000;
+
+        if (!started[i])
+        {
+            account_reading(run, ESP_FAIL, start_us[i]);
+        }
+    }
+
+    // Values are read in ready order, waiting for each one's ttt
+    for (size_t done = 0; done < run->count; done++)
+    {
+        size_t next = SIZE_MAX;
+
+        for (size_t i = 0; i < run->count; i++)
+        {
+            if (started[i] && (next == SIZE_MAX || ready_us[i] < ready_us[next]))
+            {
+                next = i;
+            }
+        }
+
+        if (next == SIZE_MAX)
+        {
+            break;
+        }
+
+        while (run->clock->now_us(run->clock) < ready_us[next])
+        {
+            run->clock->sleep_until(run->clock, ready_us[next]);
+        }
+
+        started[next] = false;
+        account_reading(run, read_values(run, next, n_values[next]), start_us[next]);
+    }
+}
+
+static void run_r_cycle(bench_run_t *run)
+{
+    for (size_t i = 0; i < run->count; i++)
+    {
+        int64_t start_us = run->clock->now_us(run->clock);
+        esp_err_t ret = sdi12_dev_read_continuos_measurement(run->devs[i], 0, sensors[i].profile->crc, run->buffer, sizeof(run->buffer), 0);
+
+        if (ret == ESP_OK && count_values(run->buffer + 1) != values_for(sensors[i].profile, 'R'))
+        {
+            ret = ESP_ERR_INVALID_RESPONSE;
+        }
+
+        account_reading(run, ret, start_us);
+    }
+}
+
+static void run_strategy(bench_run_t *run, const bench_fleet_t *fleet, bench_strategy_t strategy)
+{
+    run->readings = 0;
+    run->failed = 0;
+    memset(run->latency_ms, 0, sizeof(run->latency_ms));
+
+    for (size_t i = 0; i < fleet->count; i++)
+    {
+        sensors[i].rng = 0x9e3779b9 ^ (strategy << 8) ^ i;
+        sensors[i].late_next = false;
+    }
+
+    sdi12_bus_reset_health(run->bus);
+    faults_enabled = true;
+
+    int64_t start_us = run->clock->now_us(run->clock);
+
+    // Cycles run back to back: throughput is bounded by bus and sensors only
+    while (run->clock->now_us(run->clock) - start_us < BENCH_WINDOW_US)
+    {
+        switch (strategy)
+        {
+            case BENCH_STRATEGY_M:
+                run_m_cycle(run);
+                break;
+            case BENCH_STRATEGY_C:
+                run_c_cycle(run);
+                break;
+            default:
+                run_r_cycle(run);
+                break;
+        }
+    }
+
+    faults_enabled = false;
+
+    int64_t elapsed_us = run->clock->now_us(run->clock) - start_us;
+    sdi12_bus_health_t health;
+    sdi12_bus_get_health(run->bus, '\0', &health);
+
+    uint32_t readings_per_min_x10 = (uint64_t)run->readings * 600000000 / elapsed_us;
+    uint32_t bus_permille = health.wire_time.busy_us * 1000 / elapsed_us;
+    uint32_t p50_ms = latency_percentile(run, 500);
+    uint32_t p95_ms = latency_percentile(run, 950);
+    uint32_t p99_ms = latency_percentile(run, 990);
+
+    ESP_LOGI(TAG, "[%s/%s] %" PRIu32 ".%" PRIu32 " readings/min | failed %" PRIu32 " | bus %" PRIu32 ".%" PRIu32 "%% | p50 %" PRIu32 " ms | p95 %" PRIu32
+                  " ms | p99 %" PRIu32 " ms",
+        fleet->name, strategy_names[strategy], readings_per_min_x10 / 10, readings_per_min_x10 % 10, run->failed, bus_permille / 10, bus_permille % 10,
+        p50_ms, p95_ms, p99_ms);
+
+    // Machine readable line, compared against baseline by tools/sdi12_bench_compare.py
+    printf("BENCH,%s,%s,%" PRIu32 ".%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 "\n", fleet->name, strategy_names[strategy],
+        readings_per_min_x10 / 10, readings_per_min_x10 % 10, run->failed, bus_permille, p50_ms, p95_ms, p99_ms);
+}
+
+static esp_err_t run_fleet(bench_run_t *run, const bench_fleet_t *fleet)
+{
+    sdi12_sensor_device_config_t devices[BENCH_MAX_SENSORS];
+
+    for (size_t i = 0; i < fleet->count; i++)
+    {
+        sensors[i].profile = &fleet->profiles[i];
+        devices[i] = (sdi12_sensor_device_config_t) {
+            .address = '0' + i,
+            .on_measure = on_measure,
+            .on_cmd = on_cmd,
+            .user_ctx = &sensors[i],
+        };
+    }
+
+#if CONFIG_EXAMPLE_BENCH_LOOPBACK
+    sdi12_sensor_config_t sensor_config = {
+        .gpio_num = CONFIG_EXAMPLE_BENCH_SENSOR_GPIO,
+        .devices = devices,
+        .devices_count = fleet->count,
+    };
+
+    sdi12_sensor_handle_t sensor;
+    ESP_RETURN_ON_ERROR(sdi12_new_sensor(&sensor_config, &sensor), TAG, "can't create sensors");
+
+    sdi12_bus_config_t bus_config = {
+        .gpio_num = CONFIG_EXAMPLE_BENCH_BUS_GPIO,
+    };
+
+    run->clock = sdi12_clock_get_system();
+#else
+    sdi12_sim_config_t sim = {
+        .devices = devices,
+        .devices_count = fleet->count,
+    };
+
+    sdi12_bus_config_t bus_config = {
+        .transport = SDI12_BUS_TRANSPORT_SIM,
+        .sim = &sim,
+    };
+
+    ESP_ERROR_CHECK(sdi12_new_sim_clock(0, &run->clock));
+    bus_config.clock = run->clock;
+#endif
+
+    ESP_ERROR_CHECK(sdi12_new_bus(&bus_config, &run->bus));
+    run->count = fleet->count;
+
+    for (size_t i = 0; i < fleet->count; i++)
+    {
+        ESP_ERROR_CHECK(sdi12_new_dev(run->bus, '0' + i, &run->devs[i]));
+    }
+
+    for (bench_strategy_t strategy = 0; strategy < BENCH_STRATEGY_MAX; strategy++)
+    {
+        run_strategy(run, fleet, strategy);
+    }
+
+    for (size_t i = 0; i < fleet->count; i++)
+    {
+        sdi12_del_dev(run->devs[i]);
+    }
+
+    sdi12_del_bus(run->bus);
+
+#if CONFIG_EXAMPLE_BENCH_LOOPBACK
+    sdi12_del_sensor(sensor);
+#else
+    sdi12_del_sim_clock(run->clock);
+#endif
+
+    return ESP_OK;
+}
+
+void app_main(void)
+{
+    static bench_run_t run;
+
+    ESP_LOGI(TAG, "%u fleets, %u s per strategy", (unsigned)(sizeof(fleets) / sizeof(fleets[0])), (unsigned)CONFIG_EXAMPLE_BENCH_WINDOW_S);
+
+    for (size_t i = 0; i < sizeof(fleets) / sizeof(fleets[0]); i++)
+    {
+        ESP_ERROR_CHECK(run_fleet(&run, &fleets[i]));
+    }
+
+    ESP_LOGI(TAG, "Done");
+}
@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+
+#include "sdi12_bus.h"
+#include "sdi12_trace.h"
+
+#include "sdkconfig.h"
+
+#define BENCH_TX_GPIO      CONFIG_EXAMPLE_SDI12_TX_GPIO
+#define BENCH_RX_GPIO      CONFIG_EXAMPLE_SDI12_RX_GPIO
+#define BENCH_DIR_GPIO     CONFIG_EXAMPLE_SDI12_DIR_GPIO
+#define BENCH_DIR_TX_LEVEL CONFIG_EXAMPLE_SDI12_DIR_TX_LEVEL
+#define BENCH_UART_PORT    CONFIG_EXAMPLE_UART_PORT_NUM
+#define BENCH_ADDRESS      (CONFIG_EXAMPLE_SENSOR_ADDRESS[0])
+#define BENCH_ITERATIONS   CONFIG_EXAMPLE_ITERATIONS
+
+#define BENCH_CALIBRATION_MS (2000)
+#define BENCH_TRACE_EVENTS   (10000)
+
+static const char *TAG = "SDI12-BENCH";
+static char response[85] = { 0 };
+
+static volatile uint32_t probe_counter = 0;
+static double probe_idle_rate = 0; // Probe loops per us with no bus activity
+
+/**
+ * Busy loop running at idle priority. Every CPU cycle used by bus code (tasks and ISRs) on this core is a cycle the probe doesn't count.
+ */
+static void cpu_probe_task(void *arg)
+{
+    while (1)
+    {
+        ++probe_counter;
+    }
+}
+
+static void calibrate_probe(void)
+{
+    uint32_t start_count = probe_counter;
+    int64_t start = esp_timer_get_time();
+    vTaskDelay(pdMS_TO_TICKS(BENCH_CALIBRATION_MS));
+    probe_idle_rate = (double)(probe_counter - start_count) / (double)(esp_timer_get_time() - start);
+}
+
+static void bench_cmd(sdi12_bus_handle_t bus, const char *transport_name, const char *cmd)
+{
+    int64_t min_us = INT64_MAX;
+    int64_t max_us = 0;
+    int64_t total_us = 0;
+    uint16_t errors = 0;
+
+    uint32_t start_count = probe_counter;
+    int64_t bench_start = esp_timer_get_time();
+
+    for (uint16_t i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        int64_t start = esp_timer_get_time();
+        esp_err_t ret = sdi12_bus_send_cmd(bus, cmd, false, response, sizeof(response), 0);
+        int64_t elapsed = esp_timer_get_time() - start;
+
+        if (ret != ESP_OK)
+        {
+            ++errors;
+            continue;
+        }
+
+        total_us += elapsed;
+        min_us = elapsed < min_us ? elapsed : min_us;
+        max_us = elapsed > max_us ? elapsed : max_us;
+    }
+
+    double busy_rate = (double)(probe_counter - start_count) / (double)(esp_timer_get_time() - bench_start);
+    double cpu_load = probe_idle_rate > 0 ? 100.0 * (1.0 - busy_rate / probe_idle_rate) : 0;
+
+    if (errors == BENCH_ITERATIONS)
+    {
+        ESP_LOGE(TAG, "[%s] %s: no valid response", transport_name, cmd);
+        return;
+    }
+
+    ESP_LOGI(TAG, "[%s] %s: min %.1f ms | avg %.1f ms | max %.1f ms | cpu %.1f %% | errors %u", transport_name, cmd, min_us / 1000.0,
+        total_us / 1000.0 / (BENCH_ITERATIONS - errors), max_us / 1000.0, cpu_load, errors);
+}
+
+static void bench_transport(sdi12_bus_transport_t transport, const char *transport_name)
+{
+    sdi12_bus_config_t config = {
+        .dual_pin = {
+            .tx_gpio_num = BENCH_TX_GPIO,
+            .rx_gpio_num = BENCH_RX_GPIO,
+            .dir_gpio_num = BENCH_DIR_GPIO,
+        },
+        .transport = transport,
+        .uart_port = BENCH_UART_PORT,
+        .flags = {
+            .dual_pin = true,
+            .dir_tx_level = BENCH_DIR_TX_LEVEL,
+        },
+    };
+
+    sdi12_bus_handle_t bus;
+    ESP_ERROR_CHECK(sdi12_new_bus(&config, &bus));
+
+    char cmd_ack[] = "_!";
+    char cmd_id[] = "_I!";
+    cmd_ack[0] = BENCH_ADDRESS;
+    cmd_id[0] = BENCH_ADDRESS;
+
+    bench_cmd(bus, transport_name, cmd_ack);
+    bench_cmd(bus, transport_name, cmd_id);
+
+    sdi12_del_bus(bus);
+}
+
+#if CONFIG_SDI12_TRACE
+/**
+ * Cost of recording a trace event from task context. Bus latency and CPU load with tracing enabled and disabled show its impact on transactions.
+ */
+static void bench_trace(void)
+{
+    int64_t start = esp_timer_get_time();
+
+    for (uint16_t i = 0; i < BENCH_TRACE_EVENTS; i++)
+    {
+        sdi12_trace_record(SDI12_TRACE_USER, BENCH_ADDRESS, i);
+    }
+
+    int64_t elapsed = esp_timer_get_time() - start;
+
+    ESP_LOGI(TAG, "[trace] %.3f us per event", (double)elapsed / BENCH_TRACE_EVENTS);
+    sdi12_trace_clear();
+}
+#endif
+
+void app_main(void)
+{
+    // Probe must share core with bus code to see its load.
+    xTaskCreatePinnedToCore(cpu_probe_task, "cpu_probe", 1024, NULL, tskIDLE_PRIORITY, NULL, xPortGetCoreID());
+
+    ESP_LOGI(TAG, "Calibrating CPU probe...");
+    calibrate_probe();
+
+#if CONFIG_SDI12_TRACE
+    bench_trace();
+#endif
+
+    bench_transport(SDI12_BUS_TRANSPORT_RMT, "rmt");
+    bench_transport(SDI12_BUS_TRANSPORT_UART, "uart");
+
+#if CONFIG_SDI12_TRACE
+    sdi12_trace_print();
+#endif
+
+    ESP_LOGI(TAG, "Benchmark done");
+}
@@ -66,8 +66,14 @@ static void uart_terminal_task(void *arg)
             data[len] = '\0';
             ESP_LOGI(TAG, "Got data (%d bytes): %s", len, data);
 
-            ret = sdi12_bus_send_cmd(sdi12_bus, (const char *)data, crc, response, sizeof(response), SDI12_DEFAULT_RESPONSE_TIMEOUT);
-            uart_write_bytes(TERMINAL_UART_PORT_NUM, (const char *)response, strlen(response));
+            sdi12_bus_result_t result;
+
+            ret = sdi12_bus_transact(sdi12_bus, NULL, (const char *)data, crc, response, sizeof(response), SDI12_DEFAULT_RESPONSE_TIMEOUT, &result);
+
+            if (result.response)
+            {
+                uart_write_bytes(TERMINAL_UART_PORT_NUM, result.response, result.length);
+            }
 
             if (ret != ESP_OK)
             {
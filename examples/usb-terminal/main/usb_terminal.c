@@ -38,7 +38,6 @@ void tinyusb_cdc_rx_callback(int itf, cdcacm_event_t *event)
     /* initialization */
     size_t rx_size = 0;
 
-    memset(response, '\0', sizeof(response));
     /* read */
     esp_err_t ret = tinyusb_cdcacm_read(itf, buf, CONFIG_TINYUSB_CDC_RX_BUFSIZE, &rx_size);
     if (ret == ESP_OK)
@@ -51,10 +50,15 @@ void tinyusb_cdc_rx_callback(int itf, cdcacm_event_t *event)
         ESP_LOGE(TAG, "Read error");
     }
 
-    ret = sdi12_bus_send_cmd(sdi12_bus, (const char *)buf, crc, response, sizeof(response), 0);
+    sdi12_bus_result_t result;
 
-    tinyusb_cdcacm_write_queue(itf, (const uint8_t *)response, strlen(response));
-    tinyusb_cdcacm_write_flush(itf, 50);
+    ret = sdi12_bus_transact(sdi12_bus, NULL, (const char *)buf, crc, response, sizeof(response), 0, &result);
+
+    if (result.response)
+    {
+        tinyusb_cdcacm_write_queue(itf, (const uint8_t *)result.response, result.length);
+        tinyusb_cdcacm_write_flush(itf, 50);
+    }
 
     if (ret != ESP_OK)
     {
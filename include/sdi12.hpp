@@ -0,0 +1,428 @@
+#pragma once
+
+/**
+ * C++17 layer over bus and device API. Header only: every call is inlined into the C call it wraps, nothing is allocated and cmds are
+ * built and checked at compile time.
+ *
+ *  sdi12::Bus bus;
+ *  sdi12::Device dev;
+ *  char buffer[85];
+ *
+ *  sdi12::Bus::create(config, bus);
+ *  sdi12::Device::create(bus, '0', dev);
+ *
+ *  dev.send(sdi12::cmd::measure<'1', true>, buffer);
+ *  sdi12::Result result = dev.send(sdi12::cmd::data<'0', true>, buffer);
+ *
+ *  if (result)
+ *  {
+ *      use(result.response); // std::string_view into buffer
+ *  }
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+#include "esp_err.h"
+
+#include "sdi12_bus.h"
+#include "sdi12_dev.h"
+
+namespace sdi12
+{
+
+namespace cmd
+{
+
+/**
+ * @brief Cmd built at compile time. Address is a placeholder set on send, so one frame serves every device.
+ */
+template <size_t Length>
+struct Frame
+{
+    static constexpr size_t length = Length; // Chars on the wire, address and '!' included
+
+    char text[Length + 1]; // Placeholder address, body, '!' and '\0'
+    bool crc;              // Check response CRC. Only aDx! and aRx! responses carry it
+};
+
+namespace detail
+{
+
+constexpr bool is_index(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// SDI-12 chars are printable ASCII. '!' ends cmd, so it can't be inside
+constexpr bool is_body_char(char c)
+{
+    return c > ' ' && c <= '~' && c != '!';
+}
+
+template <char... Body>
+constexpr auto make(bool crc)
+{
+    static_assert((is_body_char(Body) && ...), "cmd chars must be printable ASCII, '!' excluded");
+
+    Frame<sizeof...(Body) + 2> frame{};
+    size_t i = 0;
+
+    frame.text[i++] = '?';
+    ((frame.text[i++] = Body), ...);
+    frame.text[i++] = '!';
+    frame.text[i] = '\0';
+    frame.crc = crc;
+
+    return frame;
+}
+
+/**
+ * @brief Build aM!, aMC1!, aD0!, aRC2! like frames
+ *
+ * @tparam CrcLetter    add 'C' after Letter, which asks sensor for CRC
+ * @tparam Index        '0'-'9', or '\0' for none
+ * @tparam CheckCrc     check CRC of this cmd response
+ */
+template <char Letter, bool CrcLetter, char Index, bool CheckCrc>
+constexpr auto indexed()
+{
+    static_assert(Index == '\0' || is_index(Index), "cmd index must be '0'-'9'");
+
+    if constexpr (CrcLetter && Index != '\0')
+    {
+        return make<Letter, 'C', Index>(CheckCrc);
+    }
+    else if constexpr (CrcLetter)
+    {
+        return make<Letter, 'C'>(CheckCrc);
+    }
+    else if constexpr (Index != '\0')
+    {
+        return make<Letter, Index>(CheckCrc);
+    }
+    else
+    {
+        return make<Letter>(CheckCrc);
+    }
+}
+
+} // namespace detail
+
+inline constexpr auto acknowledge = detail::make<>(false);       // a!
+inline constexpr auto identification = detail::make<'I'>(false); // aI!
+inline constexpr auto verify = detail::make<'V'>(false);         // aV!
+
+/**
+ * @brief aM!, aMx!, aMC! or aMCx!. Crc asks sensor to add CRC to aDx! responses of measurement
+ */
+template <char Index = '\0', bool Crc = false>
+inline constexpr auto measure = detail::indexed<'M', Crc, Index, false>();
+
+/**
+ * @brief aC!, aCx!, aCC! or aCCx!. Crc asks sensor to add CRC to aDx! responses of measurement
+ */
+template <char Index = '\0', bool Crc = false>
+inline constexpr auto concurrent = detail::indexed<'C', Crc, Index, false>();
+
+/**
+ * @brief aDx!. Set Crc if measurement was started with CRC
+ */
+template <char Index, bool Crc = false>
+inline constexpr auto data = detail::indexed<'D', false, Index, Crc>();
+
+/**
+ * @brief aRx! or aRCx!
+ */
+template <char Index, bool Crc = false>
+inline constexpr auto continuous = detail::indexed<'R', Crc, Index, Crc>();
+
+/**
+ * @brief Any cmd body. i.e. extended<'X', 'R', 'S', 'T'> sends aXRST!
+ */
+template <char First, char... Body>
+inline constexpr auto extended = detail::make<First, Body...>(false);
+
+} // namespace cmd
+
+/**
+ * @brief Transaction outcome. Response is a view into caller buffer: it is valid while buffer isn't reused.
+ */
+struct Result
+{
+    esp_err_t error = ESP_ERR_INVALID_STATE;
+    std::string_view response;                              // Response without <CR><LF>, CRC excluded if valid. Empty if no response
+    char address = '\0';                                    // Response address. '\0' if no response
+    sdi12_bus_crc_status_t crc = SDI12_BUS_CRC_NOT_CHECKED; // CRC check result
+    sdi12_bus_timestamps_t timestamps = {};                 // Transaction timestamps
+
+    Result() = default;
+
+    Result(esp_err_t err, const sdi12_bus_result_t &result)
+        : error(err), response(result.response ? std::string_view(result.response, result.length) : std::string_view()), address(result.address),
+          crc(result.crc), timestamps(result.timestamps)
+    {
+    }
+
+    explicit operator bool() const
+    {
+        return error == ESP_OK;
+    }
+};
+
+/**
+ * @brief Bus owner. Move-only, bus is deleted with it. Devices on it must be destroyed first.
+ */
+class Bus
+{
+public:
+    Bus() = default;
+
+    /**
+     * @brief Take ownership of a bus created by C API
+     */
+    explicit Bus(sdi12_bus_handle_t handle) : handle_(handle)
+    {
+    }
+
+    ~Bus()
+    {
+        reset();
+    }
+
+    Bus(const Bus &) = delete;
+    Bus &operator=(const Bus &) = delete;
+
+    Bus(Bus &&other) noexcept : handle_(other.release())
+    {
+    }
+
+    Bus &operator=(Bus &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            handle_ = other.release();
+        }
+
+        return *this;
+    }
+
+    /**
+     * @brief Create bus. See sdi12_new_bus()
+     *
+     * @param[in] config    bus config
+     * @param[out] out_bus  created bus. Left untouched on error
+     * @return esp_err_t
+     */
+    static esp_err_t create(sdi12_bus_config_t &config, Bus &out_bus)
+    {
+        sdi12_bus_handle_t handle = nullptr;
+        esp_err_t err = sdi12_new_bus(&config, &handle);
+
+        if (err == ESP_OK)
+        {
+            out_bus = Bus(handle);
+        }
+
+        return err;
+    }
+
+    /**
+     * @brief Send a compile time cmd to address. See sdi12_bus_transact()
+     */
+    template <size_t Length>
+    Result send(const cmd::Frame<Length> &frame, char address, char *buffer, size_t buffer_length, uint32_t timeout = 0,
+        const sdi12_bus_access_t *access = nullptr) const
+    {
+        char text[Length + 1];
+        std::memcpy(text, frame.text, sizeof(text));
+        text[0] = address;
+
+        sdi12_bus_result_t result{};
+        esp_err_t err = sdi12_bus_transact(handle_, access, text, frame.crc, buffer, buffer_length, timeout, &result);
+
+        return Result(err, result);
+    }
+
+    template <size_t Length, size_t BufferLength>
+    Result send(const cmd::Frame<Length> &frame, char address, char (&buffer)[BufferLength], uint32_t timeout = 0,
+        const sdi12_bus_access_t *access = nullptr) const
+    {
+        return send(frame, address, buffer, BufferLength, timeout, access);
+    }
+
+    /**
+     * @brief C handle, for calls not wrapped here. Ownership is kept
+     */
+    sdi12_bus_handle_t get() const
+    {
+        return handle_;
+    }
+
+    /**
+     * @brief Give up ownership. Caller must delete bus
+     */
+    sdi12_bus_handle_t release()
+    {
+        sdi12_bus_handle_t handle = handle_;
+        handle_ = nullptr;
+        return handle;
+    }
+
+    void reset()
+    {
+        if (handle_)
+        {
+            sdi12_del_bus(handle_);
+            handle_ = nullptr;
+        }
+    }
+
+    explicit operator bool() const
+    {
+        return handle_ != nullptr;
+    }
+
+private:
+    sdi12_bus_handle_t handle_ = nullptr;
+};
+
+/**
+ * @brief Device owner. Move-only, device is deleted with it.
+ */
+class Device
+{
+public:
+    Device() = default;
+
+    ~Device()
+    {
+        reset();
+    }
+
+    Device(const Device &) = delete;
+    Device &operator=(const Device &) = delete;
+
+    Device(Device &&other) noexcept : handle_(other.handle_), address_(other.address_)
+    {
+        other.handle_ = nullptr;
+    }
+
+    Device &operator=(Device &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            handle_ = other.handle_;
+            address_ = other.address_;
+            other.handle_ = nullptr;
+        }
+
+        return *this;
+    }
+
+    /**
+     * @brief Create device. See sdi12_new_dev()
+     *
+     * @param[in] bus           bus the device is on. Must outlive device
+     * @param[in] address       device address, or '?' to query it. address() returns the one found
+     * @param[out] out_device   created device. Left untouched on error
+     * @return esp_err_t
+     */
+    static esp_err_t create(const Bus &bus, char address, Device &out_device)
+    {
+        sdi12_dev_handle_t handle = nullptr;
+        char found = '\0';
+        esp_err_t err = sdi12_new_dev(bus.get(), address, &handle);
+
+        if (err == ESP_OK)
+        {
+            // With '?' device holds address answered by sensor
+            err = sdi12_dev_get_address(handle, &found);
+
+            if (err != ESP_OK)
+            {
+                sdi12_del_dev(handle);
+                return err;
+            }
+
+            out_device.reset();
+            out_device.handle_ = handle;
+            out_device.address_ = found;
+        }
+
+        return err;
+    }
+
+    /**
+     * @brief Send a compile time cmd. Only device address is set per call. See sdi12_dev_transact()
+     */
+    template <size_t Length>
+    Result send(const cmd::Frame<Length> &frame, char *buffer, size_t buffer_length, uint32_t timeout = 0) const
+    {
+        char text[Length + 1];
+        std::memcpy(text, frame.text, sizeof(text));
+        text[0] = address_;
+
+        sdi12_bus_result_t result{};
+        esp_err_t err = sdi12_dev_transact(handle_, text, frame.crc, buffer, buffer_length, timeout, &result);
+
+        return Result(err, result);
+    }
+
+    template <size_t Length, size_t BufferLength>
+    Result send(const cmd::Frame<Length> &frame, char (&buffer)[BufferLength], uint32_t timeout = 0) const
+    {
+        return send(frame, buffer, BufferLength, timeout);
+    }
+
+    /**
+     * @brief Change device address. See sdi12_dev_change_address()
+     */
+    esp_err_t change_address(char new_address, uint32_t timeout = 0)
+    {
+        esp_err_t err = sdi12_dev_change_address(handle_, new_address, timeout);
+
+        if (err == ESP_OK)
+        {
+            address_ = new_address;
+        }
+
+        return err;
+    }
+
+    char address() const
+    {
+        return address_;
+    }
+
+    /**
+     * @brief C handle, for calls not wrapped here. Ownership is kept
+     */
+    sdi12_dev_handle_t get() const
+    {
+        return handle_;
+    }
+
+    void reset()
+    {
+        if (handle_)
+        {
+            sdi12_del_dev(handle_);
+            handle_ = nullptr;
+        }
+    }
+
+    explicit operator bool() const
+    {
+        return handle_ != nullptr;
+    }
+
+private:
+    sdi12_dev_handle_t handle_ = nullptr;
+    char address_ = '\0';
+};
+
+} // namespace sdi12
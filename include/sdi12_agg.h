@@ -0,0 +1,145 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define SDI12_AGG_MAX_CHANNELS (32) // Values per reading
+
+    /**
+     * @brief Change filter of a channel. A reading is reported as change when it moves away from last reported value by more than
+     * deadband and more than cov_percent of last reported value.
+     */
+    typedef struct
+    {
+        float deadband;    // Absolute threshold, in value units. 0 reports any change
+        float cov_percent; // Relative threshold, in % of last reported value. 0 disables it
+    } sdi12_agg_filter_t;
+
+    /**
+     * @brief Window statistics of a channel
+     */
+    typedef struct
+    {
+        uint32_t count;  // Readings in window
+        float min;      // Lowest value
+        float max;      // Highest value
+        float mean;     // Mean value
+        float variance; // Sample variance. 0 on windows of one reading
+    } sdi12_agg_channel_stats_t;
+
+    /**
+     * @brief Closed window, as given to window callback
+     */
+    typedef struct
+    {
+        int64_t start_us;                       // Window start: multiple of window_us, or previous window end if it was closed early. First reading otherwise
+        int64_t end_us;                         // Window end: next multiple of window_us, or last reading time if it's closed early or by readings
+        uint8_t channels;                       // Number of stats
+        const sdi12_agg_channel_stats_t *stats; // channels items
+    } sdi12_agg_window_t;
+
+    /**
+     * @brief Called when a window closes. Windows without readings aren't reported.
+     */
+    typedef void (*sdi12_agg_window_cb_t)(const sdi12_agg_window_t *window, void *ctx);
+
+    /**
+     * @brief Called when a channel value passes its change filter
+     *
+     * @param channel       channel index
+     * @param timestamp_us  reading time
+     * @param value         new value, now last reported one
+     * @param previous      last reported value before it
+     */
+    typedef void (*sdi12_agg_change_cb_t)(uint8_t channel, int64_t timestamp_us, float value, float previous, void *ctx);
+
+    typedef struct
+    {
+        uint8_t channels;                  // Values per reading
+        uint32_t window_us;                // Time window length. 0 disables time windows
+        uint32_t window_readings;          // Readings per window. 0 disables it. If both are set, window closes on first one reached
+        const sdi12_agg_filter_t *filters; // Optional. channels items: change filter of each channel. NULL reports no changes
+        sdi12_agg_window_cb_t on_window;   // Optional. Closed windows
+        sdi12_agg_change_cb_t on_change;   // Optional. Changes which pass filters
+        void *ctx;                         // Callbacks context
+    } sdi12_agg_config_t;
+
+    typedef struct
+    {
+        uint32_t readings;   // Readings pushed
+        uint32_t windows;    // Windows reported
+        uint32_t changes;    // Changes reported
+        uint32_t suppressed; // Channel values filtered out as no change
+    } sdi12_agg_stats_t;
+
+    typedef struct sdi12_agg *sdi12_agg_handle_t;
+
+    /**
+     * @brief Add a reading given as SDI-12 values string.
+     *
+     * @details Accepts values as returned by device API without address, i.e. sdi12_dev_read_data() response + 1, or scheduler and stream
+     * sample values. Callbacks are called from it, so feed an aggregator from a single task.
+     *
+     * @param[in] agg           aggregator object
+     * @param[in] timestamp_us  reading time. Not older than last reading
+     * @param[in] values        null terminated values. i.e. "+1.23-4.5+1013"
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG invalid args, malformed value or reading older than last one
+     *      - ESP_ERR_INVALID_SIZE number of values isn't aggregator channels
+     */
+    esp_err_t sdi12_agg_push(sdi12_agg_handle_t agg, int64_t timestamp_us, const char *values);
+
+    /**
+     * @brief Add a reading of already parsed values.
+     *
+     * @param[in] agg           aggregator object
+     * @param[in] timestamp_us  reading time. Not older than last reading
+     * @param[in] values        channels values
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG invalid args or reading older than last one
+     */
+    esp_err_t sdi12_agg_push_values(sdi12_agg_handle_t agg, int64_t timestamp_us, const float *values);
+
+    /**
+     * @brief Close current window now, reporting it if it has readings. i.e. before going to sleep.
+     */
+    esp_err_t sdi12_agg_flush(sdi12_agg_handle_t agg);
+
+    esp_err_t sdi12_agg_get_stats(sdi12_agg_handle_t agg, sdi12_agg_stats_t *out_stats);
+
+    /**
+     * @brief Free aggregator resources. Open window is dropped, flush it before if needed.
+     *
+     * @param[in] agg   aggregator object
+     * @return esp_err_t
+     */
+    esp_err_t sdi12_del_agg(sdi12_agg_handle_t agg);
+
+    /**
+     * @brief Create an aggregator.
+     *
+     * @details Window statistics are computed on the fly (Welford's algorithm), so memory per channel is constant whatever readings rate and
+     * window length are.
+     *
+     * @param[in] config    aggregator config
+     * @param[out] ret_agg  created aggregator
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG invalid config
+     *      - ESP_ERR_NO_MEM
+     */
+    esp_err_t sdi12_new_agg(const sdi12_agg_config_t *config, sdi12_agg_handle_t *ret_agg);
+
+#ifdef __cplusplus
+}
+#endif
@@ -3,6 +3,8 @@
 #include <stdbool.h>
 #include "esp_err.h"
 
+#include "sdi12_clock.h"
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -17,19 +19,177 @@ extern "C"
         uint16_t post_break_marking_us;
     } sdi12_bus_timing_t;
 
+    /**
+     * @brief Peripheral used to code and decode SDI-12 frames
+     */
+    typedef enum
+    {
+        SDI12_BUS_TRANSPORT_RMT = 0, // Default. Works on single and dual pin modes
+        SDI12_BUS_TRANSPORT_UART,    // UART peripheral. Dual pin mode only (external line driver is needed)
+        SDI12_BUS_TRANSPORT_SIM,     // No hardware: virtual sensors answer in software, timed by bus clock. See sdi12_sim.h
+    } sdi12_bus_transport_t;
+
+    typedef struct sdi12_sim_config sdi12_sim_config_t;
+
+    /**
+     * @brief Pins used when bus is attached to an external SDI-12 line driver (dual pin mode)
+     */
+    typedef struct
+    {
+        uint8_t tx_gpio_num; // Transceiver data input (MCU -> line)
+        uint8_t rx_gpio_num; // Transceiver data output (line -> MCU)
+        int8_t dir_gpio_num; // Transceiver direction/driver enable pin. Set -1 if transceiver handles direction itself
+    } sdi12_bus_dual_pin_t;
+
     typedef struct
     {
-        uint8_t gpio_num;
+        uint8_t gpio_num;              // Bus pin on single pin mode. Ignored on dual pin mode.
         sdi12_bus_timing_t bus_timing;
+        sdi12_bus_dual_pin_t dual_pin; // Only used if flags.dual_pin is set
+        sdi12_bus_transport_t transport;
+        uint8_t uart_port;             // UART port. Only used with SDI12_BUS_TRANSPORT_UART
+        const sdi12_sim_config_t *sim; // Virtual sensors. Only used with SDI12_BUS_TRANSPORT_SIM
+        sdi12_clock_t *clock;          // Optional. Time source of timestamps and waits. NULL uses sdi12_clock_get_system(). RMT and UART transports
+                                       // stamp frames from ISRs with esp_timer, so other clocks only make sense with SDI12_BUS_TRANSPORT_SIM
+        struct
+        {
+            uint32_t dual_pin : 1;       // Use separated TX/RX (and optional direction) pins. RX channel is kept always armed.
+            uint32_t invert_tx : 1;      // Dual pin mode only. Invert TX pin logic level
+            uint32_t invert_rx : 1;      // Dual pin mode only. Invert RX pin logic level
+            uint32_t dir_tx_level : 1;   // Dual pin mode only. Direction pin level to enable line driver (transmission)
+            uint32_t preempt_measurements : 1; // Abort a pending service request wait when a higher priority request arrives. Cmd is sent again after it.
+        } flags;
     } sdi12_bus_config_t;
 
+    /**
+     * @brief Bus access options. Requests waiting for the bus are served by priority and, on equal priority, in arrival order.
+     *
+     * @details Access priority only orders waiters. As with a mutex, bus owner task is raised to the RTOS priority of the highest
+     * priority task waiting for the bus, until it gives the bus up.
+     */
+    typedef struct
+    {
+        uint8_t priority;     // Higher value is served first. sdi12_bus_send_cmd() and sdi12_bus_send_batch() use 0
+        uint32_t deadline_ms; // Max time waiting for bus access, in ms. 0 waits forever
+    } sdi12_bus_access_t;
+
+    typedef struct
+    {
+        uint32_t depth;         // Requests waiting for the bus right now
+        uint32_t max_depth;     // Max requests waiting at once since bus creation
+        uint32_t granted;       // Requests granted
+        uint32_t expired;       // Requests whose deadline expired before bus was granted
+        uint64_t total_wait_us; // Sum of wait time of granted requests
+        uint32_t max_wait_us;   // Longest wait of a granted request
+    } sdi12_bus_queue_stats_t;
+
+    /**
+     * @brief Cost of measurements preempted by higher priority requests. Only updated if flags.preempt_measurements is set.
+     */
+    typedef struct
+    {
+        uint32_t preemptions;    // Measurements aborted and restarted
+        uint64_t total_lost_us;  // Sum of measurement time thrown away
+        uint64_t total_delay_us; // Sum of time between abort and measurement restart (urgent requests bus time)
+        uint32_t last_lost_us;   // Measurement time thrown away on last preemption
+        uint32_t last_delay_us;  // Time between abort and measurement restart on last preemption
+    } sdi12_bus_preempt_stats_t;
+
+    /**
+     * @brief Bus clock time (esp_timer time, us since boot, by default) of transaction events on the wire. Events which didn't happen are 0.
+     *
+     * @details RMT transport takes them from its TX/RX done ISRs and exact frame lengths. UART transport takes them from task, right after
+     * driver events, so they carry some task latency.
+     */
+    typedef struct
+    {
+        int64_t break_start_us;     // Break start. Marking start if break was skipped
+        int64_t cmd_end_us;         // Cmd last stop bit end
+        int64_t response_start_us;  // First response edge
+        int64_t response_end_us;    // Response last char end
+        int64_t service_request_us; // Service request first edge. Only on aM!, aV!, aH! like cmds with ttt > 0
+    } sdi12_bus_timestamps_t;
+
+#define SDI12_BUS_HISTOGRAM_BUCKETS (16)
+
+    /**
+     * @brief Log2 bucketed histogram. buckets[0] counts 0 values, buckets[i] counts values in [2^(i-1), 2^i). Last bucket also counts any larger value.
+     */
+    typedef struct
+    {
+        uint32_t buckets[SDI12_BUS_HISTOGRAM_BUCKETS];
+        uint32_t count; // Accounted values
+        uint64_t sum;   // Sum of accounted values. sum / count is mean
+        uint32_t max;   // Largest accounted value
+    } sdi12_bus_histogram_t;
+
+    /**
+     * @brief Bus time split by category, in us
+     */
+    typedef struct
+    {
+        uint64_t busy_us;        // Bus held by transactions. Sum of categories below
+        uint64_t break_us;       // Break and post break marking
+        uint64_t cmd_us;         // Cmd chars
+        uint64_t turnaround_us;  // From cmd end to response start. Up to read end if sensor didn't answer
+        uint64_t response_us;    // Response chars
+        uint64_t idle_detect_us; // From response end until transport detects it (line idle time on RMT)
+        uint64_t ttt_wait_us;    // Service request waits, service request itself included
+        uint64_t other_us;       // Anything else: measurements thrown away by preemption, CRC checks, driver overhead
+    } sdi12_bus_wire_time_t;
+
+    /**
+     * @brief Share of time bus has been held by transactions over sliding windows, in per mille
+     */
+    typedef struct
+    {
+        uint16_t last_10s_permille;
+        uint16_t last_minute_permille;
+        uint16_t last_hour_permille;
+    } sdi12_bus_utilization_t;
+
+    /**
+     * @brief Transaction counters and histograms, for whole bus or a single sensor address. Counters are cumulative since bus creation or
+     * last sdi12_bus_reset_health() call.
+     */
+    typedef struct
+    {
+        uint32_t commands;             // Commands sent (preemption restarts aren't counted again)
+        uint32_t successes;            // Commands which returned ESP_OK
+        uint32_t timeouts;             // No response in time
+        uint32_t no_service_requests;  // Measurement accepted, but no service request in ttt
+        uint32_t parity_errors;        // Responses with a parity error
+        uint32_t stop_bit_errors;      // Responses with a framing (stop bit) error
+        uint32_t buffer_too_small;     // Responses longer than out buffer
+        uint32_t crc_errors;           // Responses with a wrong CRC
+        uint32_t invalid_responses;    // Responses from another address
+        uint32_t write_errors;         // Transport couldn't send cmd
+        uint32_t other_errors;         // Any other error
+        uint32_t retries;              // Cmds sent again, i.e. measurement restarts after preemption
+        uint64_t tx_bytes;             // Cmd chars sent
+        uint64_t rx_bytes;             // Response chars received, service requests included
+        sdi12_bus_histogram_t response_latency_us; // From cmd end to first response edge, in us
+        sdi12_bus_histogram_t ttt_slack_ms;        // Announced ttt minus actual service request delay, in ms. Large values mean ttt is too pessimistic
+        sdi12_bus_wire_time_t wire_time;           // Bus time used, by category
+    } sdi12_bus_health_t;
+
+    /**
+     * @brief Command to estimate wire time for
+     */
+    typedef struct
+    {
+        const char *cmd;
+        uint16_t response_chars; // Expected response length, <CR><LF> and CRC included. i.e. 7 for "0+1.23" + <CR><LF>
+        uint32_t ttt_ms;         // Announced measurement time, for aM!, aV! or aH! like cmds. 0 if none
+    } sdi12_bus_wire_step_t;
+
     /**
      * @brief Send command over the bus and waits ONLY for first response line (first <LF><CR> found).
      *
      * @details AM!, AMx!, aMC!, aMCx!, aV! commands require a service request.
      * When service request command is issued, timeout param is used for wait 'atttn', 'atttnn' or 'atttnnn' response line.
      * Function automatically calculates elapsed time and waits for it.
-     *
+     * Use sdi12_bus_send_cmd_lines() for cmds whose response takes several lines.
      *
      * @param[in] bus                   bus object
      * @param[in] cmd                   cmd to send
@@ -49,6 +209,298 @@ extern "C"
      */
     esp_err_t sdi12_bus_send_cmd(sdi12_bus_handle_t bus, const char *cmd, bool crc, char *out_buffer, size_t out_buffer_length, uint32_t timeout);
 
+    /**
+     * @brief Same as sdi12_bus_send_cmd() but waits for bus access with given priority and deadline.
+     *
+     * @param[in] bus                   bus object
+     * @param[in] access                priority and deadline. NULL to use priority 0 and no deadline
+     * @param[in] cmd                   cmd to send
+     * @param[in] crc                   true if crc check is needed. false otherwise
+     * @param[out] out_buffer           buffer to save response
+     * @param[out] out_buffer_length    response buffer length
+     * @param[in] timeout               time to wait for response
+     *
+     * @return esp_err_t
+     *      ESP_ERR_TIMEOUT bus access deadline expires (cmd isn't sent) or cmd timeout expires
+     *      See sdi12_bus_send_cmd() for other values
+     */
+    esp_err_t sdi12_bus_send_cmd_prio(sdi12_bus_handle_t bus, const sdi12_bus_access_t *access, const char *cmd, bool crc, char *out_buffer,
+        size_t out_buffer_length, uint32_t timeout);
+
+    /**
+     * @brief Same as sdi12_bus_send_cmd_prio() but also returns transaction timestamps.
+     *
+     * @details If a long measurement is preempted and restarted, cmd timestamps are the ones of restarted cmd.
+     *
+     * @param[in] bus                   bus object
+     * @param[in] access                priority and deadline. NULL to use priority 0 and no deadline
+     * @param[in] cmd                   cmd to send
+     * @param[in] crc                   true if crc check is needed. false otherwise
+     * @param[out] out_buffer           buffer to save response
+     * @param[out] out_buffer_length    response buffer length
+     * @param[in] timeout               time to wait for response
+     * @param[out] out_timestamps       Optional. Transaction timestamps. Set even on error, with events reached so far
+     *
+     * @return esp_err_t
+     *      See sdi12_bus_send_cmd_prio()
+     */
+    esp_err_t sdi12_bus_send_cmd_timestamped(sdi12_bus_handle_t bus, const sdi12_bus_access_t *access, const char *cmd, bool crc, char *out_buffer,
+        size_t out_buffer_length, uint32_t timeout, sdi12_bus_timestamps_t *out_timestamps);
+
+    /**
+     * @brief Response CRC status
+     */
+    typedef enum
+    {
+        SDI12_BUS_CRC_NOT_CHECKED = 0, // CRC wasn't requested, cmd doesn't carry it (only aDx! and aRx! do) or no response
+        SDI12_BUS_CRC_VALID,           // CRC matched and was removed from response
+        SDI12_BUS_CRC_INVALID,         // CRC missing or wrong. Response is left as received
+    } sdi12_bus_crc_status_t;
+
+    /**
+     * @brief Transaction result. Response isn't copied: it is the slice of caller buffer where it was decoded.
+     */
+    typedef struct
+    {
+        char *response;                    // Response line in caller buffer, without <CR><LF>. NULL if no response was read
+        size_t length;                     // Response length, CRC excluded if valid. Response may hold '\0' chars, so rely on it instead of strlen()
+        char address;                      // Response address, its first char. '\0' if no response
+        sdi12_bus_crc_status_t crc;        // CRC check result
+        sdi12_bus_timestamps_t timestamps; // Transaction timestamps. Events which didn't happen are left as 0
+    } sdi12_bus_result_t;
+
+    /**
+     * @brief Send command and get its response as a slice of buffer, with its length, address, CRC status and timestamps.
+     *
+     * @details Response is decoded straight into buffer, which is neither cleared before nor scanned after, and length is the one counted by
+     * transport while decoding. So no strlen() is needed by caller and payloads holding '\0' are kept whole. Service requests are handled as in
+     * sdi12_bus_send_cmd(). Result is set even on error, with what was received so far.
+     *
+     * @param[in] bus               bus object
+     * @param[in] access            priority and deadline. NULL to use priority 0 and no deadline
+     * @param[in] cmd               cmd to send
+     * @param[in] crc               true if crc check is needed. false otherwise
+     * @param[in] buffer            buffer where response is decoded. Response is null terminated too
+     * @param[in] buffer_length     buffer length. <CR><LF> needs room while decoding
+     * @param[in] timeout           time to wait for response
+     * @param[out] out_result       response slice and transaction details
+     *
+     * @return esp_err_t
+     *      ESP_ERR_INVALID_CRC CRC is missing or wrong. out_result->response holds response as received
+     *      See sdi12_bus_send_cmd_prio() for other values
+     */
+    esp_err_t sdi12_bus_transact(sdi12_bus_handle_t bus, const sdi12_bus_access_t *access, const char *cmd, bool crc, char *buffer, size_t buffer_length,
+        uint32_t timeout, sdi12_bus_result_t *out_result);
+
+    /**
+     * @brief Multi-line response options
+     */
+    typedef struct
+    {
+        uint8_t max_lines;        // Stop after this many lines. 0 reads until no line arrives within line_timeout_ms
+        uint32_t line_timeout_ms; // Time to wait for each line after first one. 0 uses cmd timeout
+        bool crc;                 // Every line has its own CRC. It is checked and removed from each line
+        bool service_request;     // First line is 'atttn' and a service request follows, as on aM!. Only first line is read
+    } sdi12_bus_lines_config_t;
+
+    /**
+     * @brief Send a cmd whose response can take several lines, i.e. vendor extended cmds.
+     *
+     * @details Cmd has no length limit. First line is awaited up to timeout, next ones up to line_timeout_ms each. Reading stops on
+     * max_lines or when a line doesn't arrive in time, which isn't an error. Receiver is kept armed between lines, so a line following
+     * right after previous one is never missed and costs no reception setup. Lines are stored in out_buffer separated by '\n', without
+     * <CR><LF>.
+     *
+     * @param[in] bus                   bus object
+     * @param[in] access                priority and deadline. NULL to use priority 0 and no deadline
+     * @param[in] cmd                   cmd to send
+     * @param[in] config                lines to read and how
+     * @param[out] out_buffer           buffer to save response lines
+     * @param[in] out_buffer_length     response buffer length
+     * @param[in] timeout               time to wait for first line
+     * @param[out] out_lines            Optional. Lines in out_buffer. Set even on error, with lines read so far
+     * @param[out] out_timestamps       Optional. Transaction timestamps. Response end is last line one
+     *
+     * @return esp_err_t
+     *      ESP_OK on success
+     *      ESP_ERR_TIMEOUT bus access deadline expires (cmd isn't sent) or first line doesn't arrive
+     *      ESP_ERR_INVALID_SIZE a line doesn't fit in out_buffer. Previous lines are kept
+     *      ESP_ERR_INVALID_CRC a line CRC doesn't match. Previous lines are kept
+     *      See sdi12_bus_send_cmd() for other values
+     */
+    esp_err_t sdi12_bus_send_cmd_lines(sdi12_bus_handle_t bus, const sdi12_bus_access_t *access, const char *cmd,
+        const sdi12_bus_lines_config_t *config, char *out_buffer, size_t out_buffer_length, uint32_t timeout, uint8_t *out_lines,
+        sdi12_bus_timestamps_t *out_timestamps);
+
+    /**
+     * @brief Get bus access queue metrics
+     *
+     * @param[in] bus           bus object
+     * @param[out] out_stats    queue metrics
+     * @return esp_err_t
+     *      ESP_OK
+     *      ESP_ERR_INVALID_ARG
+     */
+    esp_err_t sdi12_bus_get_queue_stats(sdi12_bus_handle_t bus, sdi12_bus_queue_stats_t *out_stats);
+
+    /**
+     * @brief Get measurement preemption metrics
+     *
+     * @param[in] bus           bus object
+     * @param[out] out_stats    preemption metrics
+     * @return esp_err_t
+     *      ESP_OK
+     *      ESP_ERR_INVALID_ARG
+     */
+    esp_err_t sdi12_bus_get_preempt_stats(sdi12_bus_handle_t bus, sdi12_bus_preempt_stats_t *out_stats);
+
+    /**
+     * @brief Get health counters and histograms snapshot
+     *
+     * @details Counters are always on. They are updated once per transaction, so snapshot is consistent: it never holds half a transaction.
+     *
+     * @param[in] bus           bus object
+     * @param[in] address       sensor address. '\0' for whole bus
+     * @param[out] out_health   counters and histograms
+     * @return esp_err_t
+     *      ESP_OK
+     *      ESP_ERR_INVALID_ARG
+     *      ESP_ERR_NOT_FOUND no cmd has been sent to address yet
+     */
+    esp_err_t sdi12_bus_get_health(sdi12_bus_handle_t bus, char address, sdi12_bus_health_t *out_health);
+
+    /**
+     * @brief Clear health counters and histograms of whole bus and every address
+     *
+     * @param[in] bus           bus object
+     * @return esp_err_t
+     *      ESP_OK
+     *      ESP_ERR_INVALID_ARG
+     */
+    esp_err_t sdi12_bus_reset_health(sdi12_bus_handle_t bus);
+
+    /**
+     * @brief Get share of time bus has been held by transactions over last 10 seconds, minute and hour.
+     *
+     * @details Transactions are accounted when they end, so a long measurement wait shows up once its service request arrives.
+     * Windows are shortened to bus age while bus is younger than them.
+     *
+     * @param[in] bus               bus object
+     * @param[out] out_utilization  utilization
+     * @return esp_err_t
+     *      ESP_OK
+     *      ESP_ERR_INVALID_ARG
+     */
+    esp_err_t sdi12_bus_get_utilization(sdi12_bus_handle_t bus, sdi12_bus_utilization_t *out_utilization);
+
+    /**
+     * @brief Set break and marking of cmds to a sensor address, instead of bus timing.
+     *
+     * @details A sensor which needs longer timing doesn't slow down cmds to the others, and sensors which accept shorter timing save wire time
+     * on every cmd. See sdi12_dev_tune_timing() to find it. '?' cmds always use bus timing.
+     *
+     * @param[in] bus       bus object
+     * @param[in] address   sensor address
+     * @param[in] timing    address timing. 0 fields, or NULL, use bus timing
+     * @return esp_err_t
+     *      ESP_OK
+     *      ESP_ERR_INVALID_ARG
+     */
+    esp_err_t sdi12_bus_set_address_timing(sdi12_bus_handle_t bus, char address, const sdi12_bus_timing_t *timing);
+
+    /**
+     * @brief Get break and marking applied to cmds to a sensor address: its own timing or bus timing.
+     *
+     * @param[in] bus           bus object
+     * @param[in] address       sensor address
+     * @param[out] out_timing   applied timing
+     * @return esp_err_t
+     *      ESP_OK
+     *      ESP_ERR_INVALID_ARG
+     */
+    esp_err_t sdi12_bus_get_address_timing(sdi12_bus_handle_t bus, char address, sdi12_bus_timing_t *out_timing);
+
+    /**
+     * @brief Predict wire time of a cmd sequence, i.e. a batch or a scheduler plan sample.
+     *
+     * @details Break, marking, cmd and response times come from address timing and char time. Sensor turnaround, idle detection and ttt slack are
+     * the averages measured on that address (or whole bus if address has no data yet), so estimate gets closer to reality as bus runs. Without
+     * measurements, SDI-12 worst case turnaround is used and full ttt is awaited. Break is skipped on steps addressing same sensor as
+     * previous one, as batches do.
+     *
+     * @param[in] bus               bus object
+     * @param[in] steps             cmds to estimate
+     * @param[in] steps_length      number of steps
+     * @param[out] out_wire_time    predicted wire time, by category
+     * @return esp_err_t
+     *      ESP_OK
+     *      ESP_ERR_INVALID_ARG
+     */
+    esp_err_t sdi12_bus_estimate_wire_time(sdi12_bus_handle_t bus, const sdi12_bus_wire_step_t *steps, size_t steps_length,
+        sdi12_bus_wire_time_t *out_wire_time);
+
+    /**
+     * @brief Batch step stop conditions. Can be combined.
+     */
+    typedef enum
+    {
+        SDI12_BUS_BATCH_STOP_ON_ERROR = (1 << 0),       // Stop batch if step fails
+        SDI12_BUS_BATCH_STOP_ON_EMPTY = (1 << 1),       // Stop batch if response only has address. i.e. aDx! with no more values
+        SDI12_BUS_BATCH_STOP_ON_ZERO_VALUES = (1 << 2), // Stop batch if 'atttn' response has n = 0. i.e. aM! with nothing to collect
+    } sdi12_bus_batch_stop_t;
+
+    typedef struct
+    {
+        const char *cmd;    // cmd to send
+        bool crc;           // true if crc check is needed
+        char address;       // Expected response address. '\0' to use cmd address
+        uint8_t stop_flags; // See sdi12_bus_batch_stop_t
+    } sdi12_bus_batch_step_t;
+
+    typedef struct
+    {
+        esp_err_t ret;  // Step result. ESP_ERR_INVALID_STATE if step wasn't executed
+        char *response; // Step response, slice of batch buffer. NULL if step failed or wasn't executed
+        size_t length;  // Response length, without '\0'
+        sdi12_bus_timestamps_t timestamps; // Step transaction timestamps
+    } sdi12_bus_batch_result_t;
+
+    /**
+     * @brief Send a sequence of commands as one bus transaction.
+     *
+     * @details Bus is locked once for whole sequence, so no other task can use the bus between steps. Every cmd is checked before sending first one.
+     * Responses are stored one after another in buffer, each one null terminated, and results[i] points to its slice. Break is skipped if step
+     * addresses same sensor than last successful transaction on the bus (previous step or a previous batch) and it is still awake, so inter
+     * command gap is only post break marking.
+     * Service requests are handled as in sdi12_bus_send_cmd().
+     *
+     * @param[in] bus               bus object
+     * @param[in] steps             commands to send
+     * @param[in] steps_length      number of steps
+     * @param[out] buffer           buffer shared by all responses
+     * @param[in] buffer_length     buffer length
+     * @param[out] results          array of steps_length results
+     * @param[out] executed         Optional. Number of executed steps
+     * @param[in] timeout           time to wait for each response
+     *
+     * @return esp_err_t
+     *      ESP_OK all executed steps succeed. Batch could be stopped by a stop condition.
+     *      ESP_ERR_INVALID_ARG any invalid argument or any invalid cmd. No cmd is sent.
+     *      Otherwise, first step error. See sdi12_bus_send_cmd()
+     */
+    esp_err_t sdi12_bus_send_batch(sdi12_bus_handle_t bus, const sdi12_bus_batch_step_t *steps, size_t steps_length, char *buffer, size_t buffer_length,
+        sdi12_bus_batch_result_t *results, size_t *executed, uint32_t timeout);
+
+    /**
+     * @brief Same as sdi12_bus_send_batch() but waits for bus access with given priority and deadline. Whole batch is one bus access.
+     *
+     * @param[in] access    priority and deadline. NULL to use priority 0 and no deadline
+     *
+     * See sdi12_bus_send_batch() for other params. ESP_ERR_TIMEOUT is returned, and no step is executed, if access deadline expires.
+     */
+    esp_err_t sdi12_bus_send_batch_prio(sdi12_bus_handle_t bus, const sdi12_bus_access_t *access, const sdi12_bus_batch_step_t *steps,
+        size_t steps_length, char *buffer, size_t buffer_length, sdi12_bus_batch_result_t *results, size_t *executed, uint32_t timeout);
+
     /**
      * @brief Deallocate and free bus resources
      *
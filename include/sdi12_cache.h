@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#include "sdi12_clock.h"
+#include "sdi12_dev.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define SDI12_CACHE_CMD_CHARS (5) // Longest measurement cmd without address nor '!' ("MC9", "CC9" or "HA") plus '\0'
+
+    typedef struct
+    {
+        size_t entries;       // Measurements kept at once. Least recently used one is dropped to make room
+        size_t values_size;   // Values buffer of each entry, '\0' included. 0 uses 256
+        uint32_t ttl_ms;      // Results younger than it are served from memory. 0 only shares in-flight measurements
+        sdi12_clock_t *clock; // Optional. Age of results and aCx! waits. NULL uses sdi12_clock_get_system(). Use same clock as bus
+    } sdi12_cache_config_t;
+
+    typedef enum
+    {
+        SDI12_CACHE_MEASURED = 0, // Caller ran measurement
+        SDI12_CACHE_SHARED,       // Caller joined a measurement already running for same key
+        SDI12_CACHE_HIT,          // Served from memory, no bus transaction
+    } sdi12_cache_source_t;
+
+    /**
+     * @brief How results were got
+     */
+    typedef struct
+    {
+        uint16_t n_values;           // Values in values string
+        int64_t measured_us;         // Cache clock time when values were read
+        sdi12_cache_source_t source; // Measured, shared or hit
+    } sdi12_cache_info_t;
+
+    typedef struct
+    {
+        uint32_t hits;       // Requests served from memory
+        uint32_t shared;     // Requests which joined an in-flight measurement
+        uint32_t measured;   // Measurements run on bus
+        uint32_t errors;     // Measurements which failed. Errors are shared with joined requests, never cached
+        uint32_t evictions;  // Entries dropped to make room
+        uint32_t full_waits; // Requests which waited for an entry to be free, every entry was in flight
+    } sdi12_cache_stats_t;
+
+    typedef struct sdi12_cache *sdi12_cache_handle_t;
+
+    /**
+     * @brief Get measurement values, running measurement only if needed.
+     *
+     * @details Key is device and cmd. Use one device handle per sensor, cache tells sensors apart by handle. If key has results younger than ttl_ms they are returned right away. If its measurement is
+     * running, caller waits for it and gets same results. Otherwise cmd is sent (aM!, aV! and aH.! hold bus until service request, aC! waits ttt
+     * with bus free) and values are read with aDx! until n values are collected. Measurements of different keys of same sensor are serialized,
+     * so aDx! never returns values of another measurement.
+     *
+     * @param[in] cache                 cache object
+     * @param[in] dev                   device
+     * @param[in] cmd                   measurement cmd without address nor '!'. i.e. "M", "MC1", "C", "V" or "HA". CRC is checked on "MC" and "CC"
+     * @param[out] out_values           null terminated values, without address nor CRC. i.e. "+1.23-4.5"
+     * @param[in] out_values_length     out_values size
+     * @param[out] out_info             Optional. Number of values, measurement time and source
+     * @param[in] timeout               Time to wait for each response. 0 uses SDI12_DEFAULT_RESPONSE_TIMEOUT
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG invalid args or cmd
+     *      - ESP_ERR_INVALID_SIZE values don't fit out_values or entry values buffer
+     *      - any error of measurement cmd or aDx! reads
+     */
+    esp_err_t sdi12_cache_measure(sdi12_cache_handle_t cache, sdi12_dev_handle_t dev, const char *cmd, char *out_values, size_t out_values_length,
+        sdi12_cache_info_t *out_info, uint32_t timeout);
+
+    /**
+     * @brief Drop cached results of a device, so next request runs measurement. Running measurements aren't affected.
+     *
+     * @details Call it before deleting a device: entries are keyed by handle, and a new device could get same one.
+     *
+     * @param[in] cache     cache object
+     * @param[in] dev       device
+     * @param[in] cmd       cmd to drop. NULL drops every cmd of device
+     * @return esp_err_t
+     */
+    esp_err_t sdi12_cache_invalidate(sdi12_cache_handle_t cache, sdi12_dev_handle_t dev, const char *cmd);
+
+    esp_err_t sdi12_cache_get_stats(sdi12_cache_handle_t cache, sdi12_cache_stats_t *out_stats);
+
+    /**
+     * @brief Free cache resources. No request can be running.
+     *
+     * @param[in] cache     cache object
+     * @return esp_err_t
+     */
+    esp_err_t sdi12_del_cache(sdi12_cache_handle_t cache);
+
+    /**
+     * @brief Create measurement cache
+     *
+     * @param[in] config        cache config
+     * @param[out] ret_cache    created cache
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG
+     *      - ESP_ERR_NO_MEM
+     */
+    esp_err_t sdi12_new_cache(const sdi12_cache_config_t *config, sdi12_cache_handle_t *ret_cache);
+
+#ifdef __cplusplus
+}
+#endif
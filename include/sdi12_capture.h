@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * Capture stream format, little endian:
+ *
+ * File header, 8 bytes:
+ *      char     magic[4]       "S12C"
+ *      uint8_t  version        SDI12_CAPTURE_VERSION
+ *      uint8_t  reserved
+ *      uint16_t bit_width_us   bit time symbols were captured with
+ *
+ * Then one record per RMT reception:
+ *      uint16_t num_symbols
+ *      int16_t  ret            decode result on device (esp_err_t)
+ *      uint32_t done_us        reception done time, esp_timer low 32 bits
+ *      uint16_t buffer_length  response buffer length given to decoder
+ *      uint8_t  cmd_length
+ *      uint8_t  rx_error       sdi12 transport rx error (0 none, 1 parity, 2 stop bit)
+ *      char     cmd[cmd_length]                  cmd that triggered the response, not null terminated
+ *      uint32_t symbols[num_symbols]             raw rmt_symbol_word_t values
+ *
+ * tools/sdi12_replay replays captures through the same decoder and CRC code on host.
+ */
+#define SDI12_CAPTURE_VERSION (1)
+
+    /**
+     * @brief Capture sink, i.e. fwrite() to a file on SD card or SPIFFS. Called from bus task, after reception, with bus held.
+     *
+     * @param data      bytes to write
+     * @param length    number of bytes
+     * @param ctx       user context
+     * @return ESP_OK. Any error stops capture
+     */
+    typedef esp_err_t (*sdi12_capture_write_t)(const void *data, size_t length, void *ctx);
+
+    /**
+     * @brief Start capturing raw RMT receptions of every bus. File header is written right away.
+     *
+     * @param[in] write     capture sink
+     * @param[in] ctx       sink context
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG
+     *      - ESP_ERR_INVALID_STATE capture already running
+     *      - ESP_ERR_NOT_SUPPORTED CONFIG_SDI12_CAPTURE is disabled
+     *      - Sink error writing file header
+     */
+    esp_err_t sdi12_capture_start(sdi12_capture_write_t write, void *ctx);
+
+    /**
+     * @brief Stop capture. Sink isn't called after this returns.
+     *
+     * @param[out] out_records  Optional. Records written since start
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_STATE capture isn't running
+     *      - ESP_ERR_NOT_SUPPORTED CONFIG_SDI12_CAPTURE is disabled
+     *      - ESP_FAIL capture had already stopped by a sink error
+     */
+    esp_err_t sdi12_capture_stop(size_t *out_records);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef struct sdi12_clock_t sdi12_clock_t;
+
+    /**
+     * @brief Time source of bus, transports and scheduler. Every timestamp and idle wait of the component goes through it.
+     */
+    struct sdi12_clock_t
+    {
+        /**
+         * @brief Monotonic time, in us
+         *
+         * @param[in] clock     clock object
+         * @return current time
+         */
+        int64_t (*now_us)(sdi12_clock_t *clock);
+
+        /**
+         * @brief Block calling task until clock reaches wake_us. Returns at once if it has already passed.
+         *
+         * @details Sleep can be cut short by wake(), so callers must check time again. Task notifications of caller aren't used.
+         *
+         * @param[in] clock     clock object
+         * @param[in] wake_us   time to wake up at
+         */
+        void (*sleep_until)(sdi12_clock_t *clock, int64_t wake_us);
+
+        /**
+         * @brief Wake task up if it is sleeping on clock. Optional: NULL if sleeps can't be cut short.
+         *
+         * @param[in] clock     clock object
+         * @param[in] task      sleeping task, as TaskHandle_t. Opaque here so header has no RTOS dependency
+         */
+        void (*wake)(sdi12_clock_t *clock, void *task);
+    };
+
+    /**
+     * @brief Get system clock: esp_timer time, us since boot. Used by bus and scheduler when no clock is configured.
+     *
+     * @return system clock. Never NULL, it can't be deleted
+     */
+    sdi12_clock_t *sdi12_clock_get_system(void);
+
+    /**
+     * @brief Create a simulated clock. Time only moves when a task sleeps on it, and it jumps straight to wake time, so idle periods (i.e.
+     * 999 s measurements) take no real time.
+     *
+     * @details Meant for a simulated bus (SDI12_BUS_TRANSPORT_SIM) on host (linux target) builds. Runs are repeatable when a single task
+     * drives the bus, i.e. a scheduler: wakes happen in the same order on every run. With several sleeping tasks, first one to sleep moves
+     * time for all of them.
+     *
+     * @param[in] start_us      initial time
+     * @param[out] ret_clock    created clock
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG
+     *      - ESP_ERR_NO_MEM
+     */
+    esp_err_t sdi12_new_sim_clock(int64_t start_us, sdi12_clock_t **ret_clock);
+
+    /**
+     * @brief Free simulated clock. Objects using it must be deleted first.
+     *
+     * @param[in] clock     clock created by sdi12_new_sim_clock()
+     * @return esp_err_t
+     */
+    esp_err_t sdi12_del_sim_clock(sdi12_clock_t *clock);
+
+#ifdef __cplusplus
+}
+#endif
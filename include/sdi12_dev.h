@@ -23,8 +23,44 @@ extern "C"
         char *optional;
     } sdi12_dev_info_t;
 
+#define SDI12_DEV_JOURNAL_CMD_CHARS (8) // Longest journaled cmd plus '\0'
+
+    /**
+     * @brief Measurement kept on journal (CONFIG_SDI12_JOURNAL)
+     */
+    typedef struct
+    {
+        char cmd[SDI12_DEV_JOURNAL_CMD_CHARS]; // Measurement cmd. i.e. "0MC!"
+        uint16_t n_values;                     // n on measurement response
+        uint16_t n_read;                       // Values read with aDx! since measurement was started or resumed
+        int64_t ready_us;                      // Wall time (gettimeofday) when results are ready
+        bool previous_boot;                    // Started before last reset and not resumed yet
+    } sdi12_dev_journal_entry_t;
+
     typedef struct sdi12_dev *sdi12_dev_handle_t;
 
+    /**
+     * @brief Parameter metadata (SDI-12 1.4 aI<cmd>_nnn! response). Strings are kept by device catalog.
+     */
+    typedef struct
+    {
+        const char *name;        // Parameter identifier, i.e. SHEF code "RP"
+        const char *units;       // i.e. "kPa". "" if sensor didn't send it
+        const char *description; // Any further fields, commas included. "" if sensor didn't send them
+    } sdi12_dev_param_meta_t;
+
+    /**
+     * @brief Timing auto-tune config. 0 fields use defaults.
+     */
+    typedef struct
+    {
+        uint16_t min_break_us;   // Shortest break tried. 0 uses 1000
+        uint16_t min_marking_us; // Shortest marking tried. 0 uses 1000
+        uint16_t resolution_us;  // Search stops when shortest accepted value is known within it. 0 uses 250
+        uint8_t attempts;        // Consecutive acknowledges a timing must get to be accepted. 0 uses 5
+        uint8_t margin_percent;  // Added to shortest accepted values. 0 uses 25
+    } sdi12_dev_tune_config_t;
+
     /**
      * @brief Get device info struct
      *
@@ -55,6 +91,19 @@ extern "C"
      */
     esp_err_t sdi12_dev_get_info(sdi12_dev_handle_t dev, sdi12_dev_info_t *out_info);
 
+    /**
+     * @brief Get timestamps of last transaction sent by device API.
+     *
+     * @note No bus interaction. Call it from the task which sent the cmd, right after it, i.e. to timestamp aDx! values with aM! service request.
+     *
+     * @param[in] dev               Device object
+     * @param[out] out_timestamps   Last transaction timestamps. See sdi12_bus_timestamps_t
+     * @return
+     *      - ESP_OK if no error
+     *      - ESP_ERR_INVALID_ARG if invalid dev
+     */
+    esp_err_t sdi12_dev_get_last_timestamps(sdi12_dev_handle_t dev, sdi12_bus_timestamps_t *out_timestamps);
+
     /**
      * @brief Send a! command.
      *
@@ -230,7 +279,8 @@ extern "C"
     /**
      * @brief Send any command not provided in this api.
      *
-     * @details Take in mind that device address and '!' is append automatically to cmd. i.e. To send aHB!, set cmd as HB
+     * @details Take in mind that device address and '!' is append automatically to cmd. i.e. To send aHB!, set cmd as HB. Cmd can have any
+     * length. Only first response line is read, use sdi12_dev_extended_cmd_lines() for multi-line responses.
      *
      * @param[in] dev                   Device object
      * @param[in] cmd                   Cmd to send
@@ -242,10 +292,172 @@ extern "C"
      *      - ESP_OK if no error
      *      - ESP_ERR_TIMEOUT if timeout expires
      *      - ESP_ERR_INVALID_ARG if invalid dev
+     *      - ESP_ERR_NO_MEM if cmd can't be allocated. It is built on heap, cmds have no length limit
      *      - ESP_ERR_FAIL any other error
      */
     esp_err_t sdi12_dev_extended_cmd(sdi12_dev_handle_t dev, const char *cmd, bool crc, char *out_buffer, size_t out_buffer_length, uint32_t timeout);
 
+    /**
+     * @brief Send a complete cmd, address and '!' included, and get its response as a slice of buffer. See sdi12_bus_transact().
+     *
+     * @details Cmd goes through device API as any other device cmd: journaled measurements are resumed and its timestamps become last device
+     * transaction ones. Meant for cmds built ahead, i.e. at compile time by C++ wrapper (sdi12.hpp), so nothing is formatted per call.
+     *
+     * @param[in] dev               Device object
+     * @param[in] cmd               Cmd to send. i.e. "0MC1!". Address must be device one
+     * @param[in] crc               Set to true if response needs to check CRC. False otherwise
+     * @param[in] buffer            Buffer where response is decoded
+     * @param[in] buffer_length     Buffer length
+     * @param[in] timeout           Time to wait for response
+     * @param[out] out_result       Response slice, length, address, CRC status and timestamps
+     * @return esp_err_t
+     *      - ESP_OK if no error
+     *      - ESP_ERR_INVALID_ARG if invalid args or cmd isn't for device address
+     *      - ESP_ERR_INVALID_RESPONSE if response isn't from device address
+     *      - See sdi12_bus_transact() for other values
+     */
+    esp_err_t sdi12_dev_transact(sdi12_dev_handle_t dev, const char *cmd, bool crc, char *buffer, size_t buffer_length, uint32_t timeout,
+        sdi12_bus_result_t *out_result);
+
+    /**
+     * @brief Send any command whose response can take several lines. Address and '!' are appended to cmd, as on sdi12_dev_extended_cmd().
+     *
+     * @details Lines are collected into out_buffer, separated by '\n', up to config->max_lines or until no line arrives within
+     * config->line_timeout_ms. See sdi12_bus_send_cmd_lines().
+     *
+     * @param[in] dev                   Device object
+     * @param[in] cmd                   Cmd to send, any length. i.e. "XDUMP" to send aXDUMP!
+     * @param[in] config                Lines to read and how
+     * @param[out] out_buffer           Buffer to store response lines
+     * @param[in] out_buffer_length     Response buffer length
+     * @param[out] out_lines            Optional. Lines in out_buffer
+     * @param[in] timeout               Time to wait for first line
+     * @return esp_err_t
+     *      - ESP_OK if no error
+     *      - ESP_ERR_TIMEOUT if first line doesn't arrive
+     *      - ESP_ERR_INVALID_ARG if invalid dev, cmd or config
+     *      - ESP_ERR_INVALID_RESPONSE if first line isn't from device address
+     *      - ESP_ERR_NO_MEM if cmd can't be allocated
+     *      - See sdi12_bus_send_cmd_lines() for other values
+     */
+    esp_err_t sdi12_dev_extended_cmd_lines(sdi12_dev_handle_t dev, const char *cmd, const sdi12_bus_lines_config_t *config, char *out_buffer,
+        size_t out_buffer_length, uint8_t *out_lines, uint32_t timeout);
+
+    /**
+     * @brief Set break and marking of cmds to device, instead of bus timing. Applied by bus to every cmd to device address, device API or not.
+     *
+     * @param[in] dev       Device object
+     * @param[in] timing    Device timing. 0 fields, or NULL, use bus timing
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG
+     */
+    esp_err_t sdi12_dev_set_timing(sdi12_dev_handle_t dev, const sdi12_bus_timing_t *timing);
+
+    /**
+     * @brief Get break and marking applied to cmds to device
+     *
+     * @param[in] dev           Device object
+     * @param[out] out_timing   Applied timing
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG
+     */
+    esp_err_t sdi12_dev_get_timing(sdi12_dev_handle_t dev, sdi12_bus_timing_t *out_timing);
+
+    /**
+     * @brief Find shortest break and marking device reliably accepts, and set them plus a safety margin as device timing.
+     *
+     * @details Break and then marking are binary searched between config minimum and bus timing. A value is accepted if every one of
+     * config attempts acknowledges gets an answer. Probes are spaced so sensor is asleep on each one and needs the break. Result never exceeds
+     * bus timing and is checked again with margin before it's set. Takes a few seconds and failed probes are accounted as errors on bus health.
+     * Run it with no other traffic to device.
+     *
+     * @param[in] dev           Device object
+     * @param[in] config        Optional. Search config. NULL uses defaults
+     * @param[out] out_timing   Optional. Tuned timing
+     * @return esp_err_t
+     *      - ESP_OK device timing is set
+     *      - ESP_ERR_INVALID_ARG
+     *      - ESP_ERR_NOT_FOUND device doesn't answer with bus timing
+     *      - ESP_ERR_INVALID_RESPONSE tuned timing failed final check. Previous timing is kept
+     */
+    esp_err_t sdi12_dev_tune_timing(sdi12_dev_handle_t dev, const sdi12_dev_tune_config_t *config, sdi12_bus_timing_t *out_timing);
+
+    /**
+     * @brief Get measurement of device kept on journal.
+     *
+     * @details With CONFIG_SDI12_JOURNAL, every measurement accepted by sensor (aM!, aC!, aV!, aH.! and their CRC and index variants) is kept
+     * on RTC memory until its values are read. After a reset, sending same measurement cmd again resumes it: cmd isn't sent, call waits only
+     * remaining time and n is taken from journal. Use it to know if there's something to resume.
+     *
+     * @param[in] dev           Device object
+     * @param[out] out_entry    Journaled measurement
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG
+     *      - ESP_ERR_NOT_FOUND no measurement of device on journal
+     *      - ESP_ERR_NOT_SUPPORTED CONFIG_SDI12_JOURNAL is disabled
+     */
+    esp_err_t sdi12_dev_get_journal(sdi12_dev_handle_t dev, sdi12_dev_journal_entry_t *out_entry);
+
+    /**
+     * @brief Drop measurement of device from journal, so next measurement cmd is sent even if one was running before last reset.
+     *
+     * @param[in] dev   Device object
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG
+     */
+    esp_err_t sdi12_dev_clear_journal(sdi12_dev_handle_t dev);
+
+    /**
+     * @brief Get number of parameters of a measurement cmd from metadata (aIM!, aIC!, aIV!, aIHA!...). Sent only once, result is kept on
+     * device metadata catalog.
+     *
+     * @param[in] dev           Device object
+     * @param[in] cmd           Measurement cmd without address nor '!'. i.e. "M", "MC1", "C2", "V" or "HA"
+     * @param[out] out_n_params n on aI<cmd>! response
+     * @param[in] timeout       Time to wait for response
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG invalid dev or cmd. aRx! cmds have no count
+     *      - any error of aI! or aI<cmd>! transaction
+     */
+    esp_err_t sdi12_dev_get_param_count(sdi12_dev_handle_t dev, const char *cmd, uint16_t *out_n_params, uint32_t timeout);
+
+    /**
+     * @brief Get metadata of a measurement parameter: name, units and description.
+     *
+     * @details Device keeps a metadata catalog. Each descriptor is fetched with aI<cmd>_nnn! on first request only, and kept as its 3
+     * null terminated fields, so later requests (i.e. dashboards labelling values) don't touch the bus. Catalog belongs to device identity:
+     * aI! is read first if it's unknown, and catalog is dropped whenever an aI! response differs (other sensor, firmware or config).
+     *
+     * @param[in] dev           Device object
+     * @param[in] cmd           Measurement cmd without address nor '!'. i.e. "M", "MC1", "C2", "V", "HA" or "R0"
+     * @param[in] param         Parameter number, from 1
+     * @param[out] out_meta     Parameter metadata. Strings are valid until catalog is dropped or device deleted
+     * @param[in] timeout       Time to wait for each response
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG invalid dev, cmd or param
+     *      - ESP_ERR_NOT_FOUND param is over cmd parameter count
+     *      - ESP_ERR_INVALID_RESPONSE malformed metadata
+     *      - any error of aI! or aI<cmd>_nnn! transaction
+     */
+    esp_err_t sdi12_dev_get_param_meta(sdi12_dev_handle_t dev, const char *cmd, uint16_t param, sdi12_dev_param_meta_t *out_meta, uint32_t timeout);
+
+    /**
+     * @brief Fetch parameter count and every parameter metadata of a measurement cmd not fetched yet. i.e. on startup, so later requests
+     * never touch the bus.
+     */
+    esp_err_t sdi12_dev_fetch_meta(sdi12_dev_handle_t dev, const char *cmd, uint32_t timeout);
+
+    /**
+     * @brief Drop device metadata catalog, so it's fetched again.
+     */
+    esp_err_t sdi12_dev_clear_meta(sdi12_dev_handle_t dev);
+
     /**
      * @brief Free device memory resources
      *
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#include "sdi12_dev.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef enum
+    {
+        SDI12_SCHED_MEASUREMENT_M = 0, // aMx! (or aMCx!). Bus is held until service request, then aDx! reads
+        SDI12_SCHED_MEASUREMENT_C,     // aCx! (or aCCx!). Bus is free while sensor measures, aDx! reads are issued after ttt
+        SDI12_SCHED_MEASUREMENT_R,     // aRx!. Single exchange
+        SDI12_SCHED_MEASUREMENT_H,     // aHA!. High volume ASCII, bus is held until service request, then aDx! reads
+    } sdi12_sched_measurement_t;
+
+    typedef struct
+    {
+        int64_t scheduled_us; // Time sample was planned for, in us. Wall clock (Unix time) if flags.wall_clock is set, scheduler time otherwise
+        int64_t started_us;   // Time first cmd was issued. Same clock as scheduled_us
+        esp_err_t ret;        // Acquisition result. values are only valid on ESP_OK. ESP_ERR_INVALID_RESPONSE if fewer values than announced were read
+        const char *values;   // Null terminated values, without address nor CRC. i.e. "+1.23-4.5"
+        uint16_t n_values;    // Number of values in values string
+        sdi12_bus_timestamps_t timestamps; // Measurement cmd (aM!, aC!, aR! or aHA!) timestamps. Bus clock
+    } sdi12_sched_sample_t;
+
+    /**
+     * @brief Called from scheduler task with every acquired sample. Keep it short, next run waits for it.
+     *
+     * @param plan_index    index of plan in sdi12_sched_config_t plans
+     * @param sample        acquired sample. Only valid during call
+     * @param ctx           user context set in plan
+     */
+    typedef void (*sdi12_sched_data_cb_t)(size_t plan_index, const sdi12_sched_sample_t *sample, void *ctx);
+
+    /**
+     * @brief Sampling plan of one device
+     */
+    typedef struct
+    {
+        sdi12_dev_handle_t dev;
+        sdi12_sched_measurement_t type;
+        uint8_t index;           // x on aMx!, aCx! or aRx!. Ignored for H
+        bool crc;                // Use CRC cmd version (aMC, aCC) and check CRC on data reads
+        uint32_t period_ms;      // Time between samples
+        uint32_t phase_ms;       // Requested sample time inside period. i.e. period 60000 and phase 0 samples on every whole minute
+        uint32_t max_shift_ms;   // Max delay from phase_ms allowed to avoid collisions with other plans. Search stops at period_ms - 1 anyway
+        uint32_t slot_ms;        // Bus time reserved per sample. Required for M and H (it must cover ttt). 0 estimates it for C and R
+        sdi12_sched_data_cb_t on_data;
+        void *ctx;
+    } sdi12_sched_plan_t;
+
+    typedef struct
+    {
+        const sdi12_sched_plan_t *plans; // Plans are copied on scheduler creation
+        size_t plans_length;
+        uint32_t max_jitter_ms; // Samples starting later than this are accounted as late. 0 uses 10 ms
+        uint32_t task_stack_size; // 0 uses 4096
+        uint8_t task_priority;    // 0 uses 5
+        sdi12_clock_t *clock;     // Optional. Waits and scheduler time. NULL uses sdi12_clock_get_system(). Use same clock as plans bus
+        struct
+        {
+            uint32_t wall_clock : 1; // Align phases to wall clock (Unix time, i.e. set by SNTP). Otherwise they are relative to scheduler creation
+        } flags;
+    } sdi12_sched_config_t;
+
+    /**
+     * @brief Bus timeline computed from plans
+     */
+    typedef struct
+    {
+        uint16_t utilization_permille; // Reserved bus time over total time, in per mille. Above 1000 plans can't fit
+        bool fits;                     // Every plan got a collision free phase within its max_shift_ms
+        size_t unplaced;               // Plans which couldn't get a collision free phase
+    } sdi12_sched_timeline_t;
+
+    typedef struct
+    {
+        uint32_t shift_ms;        // Delay applied to phase_ms to avoid collisions. UINT32_MAX if plan couldn't be placed
+        uint32_t slot_ms;         // Bus time reserved per sample
+        uint32_t runs;            // Samples acquired (or tried)
+        uint32_t errors;          // Samples whose acquisition failed
+        uint32_t missed;          // Samples skipped because previous runs took too long
+        uint32_t late;            // Samples started later than max_jitter_ms
+        uint32_t overruns;        // Samples which used the bus longer than slot_ms
+        uint32_t max_jitter_us;   // Max delay between planned and actual start
+        uint64_t total_jitter_us; // Sum of delays between planned and actual start
+        uint32_t max_bus_us;      // Longest bus time used by a sample. Useful to tune slot_ms
+    } sdi12_sched_plan_stats_t;
+
+    typedef struct sdi12_sched *sdi12_sched_handle_t;
+
+    /**
+     * @brief Compute bus timeline for plans without creating a scheduler.
+     *
+     * @details Plans are placed shortest period first. Each one gets the smallest shift from its phase that doesn't overlap any already placed
+     * plan at any time, so timeline is collision free forever, not only on first periods.
+     *
+     * @param[in] plans             plans to check
+     * @param[in] plans_length      number of plans
+     * @param[out] out_timeline     timeline summary
+     * @param[out] out_shifts_ms    Optional. Array of plans_length items with shift applied to every plan. UINT32_MAX if plan can't be placed
+     * @return esp_err_t
+     *      - ESP_OK timeline computed, check out_timeline->fits
+     *      - ESP_ERR_INVALID_ARG invalid plan
+     *      - ESP_ERR_NO_MEM
+     */
+    esp_err_t sdi12_sched_check_plans(const sdi12_sched_plan_t *plans, size_t plans_length, sdi12_sched_timeline_t *out_timeline, uint32_t *out_shifts_ms);
+
+    /**
+     * @brief Get scheduler timeline summary
+     *
+     * @param[in] sched         scheduler object
+     * @param[out] out_timeline timeline summary
+     * @return esp_err_t
+     */
+    esp_err_t sdi12_sched_get_timeline(sdi12_sched_handle_t sched, sdi12_sched_timeline_t *out_timeline);
+
+    /**
+     * @brief Get plan runtime metrics
+     *
+     * @param[in] sched         scheduler object
+     * @param[in] plan_index    index of plan in config plans
+     * @param[out] out_stats    plan metrics
+     * @return esp_err_t
+     */
+    esp_err_t sdi12_sched_get_plan_stats(sdi12_sched_handle_t sched, size_t plan_index, sdi12_sched_plan_stats_t *out_stats);
+
+    /**
+     * @brief Stop scheduler and free its resources. Waits for running sample, if any.
+     *
+     * @param[in] sched     scheduler object
+     * @return esp_err_t
+     */
+    esp_err_t sdi12_del_sched(sdi12_sched_handle_t sched);
+
+    /**
+     * @brief Create scheduler and start sampling.
+     *
+     * @param[in] config    scheduler config
+     * @param[out] ret_sched created scheduler
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG invalid config or plan
+     *      - ESP_ERR_INVALID_SIZE plans don't fit the bus. Check them with sdi12_sched_check_plans()
+     *      - ESP_ERR_NO_MEM
+     */
+    esp_err_t sdi12_new_sched(const sdi12_sched_config_t *config, sdi12_sched_handle_t *ret_sched);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#include "sdi12_bus.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define SDI12_SENSOR_RESPONSE_LENGTH       (96)   // Longest response line, <CR><LF> excluded
+#define SDI12_SENSOR_VALUES_LENGTH         (256)  // Longest values string of a measurement, split in aD0!..aD9! pages
+#define SDI12_SENSOR_MIN_RESPONSE_DELAY_US (9900) // Earliest response start after cmd stop bit: cmd end detection, TX setup and lead marking
+
+    /**
+     * @brief Measurement requested to a virtual sensor
+     */
+    typedef struct
+    {
+        uint16_t ttt_s;       // Announced time until values are ready, in seconds. 0 means values are ready right away
+        uint32_t ready_ms;    // Time values actually take. Service request (aM!, aV!) is sent then. 0 uses ttt_s
+        char *values;         // Null terminated values, i.e. "+22.5-0.25+1013". Every value starts with its sign
+        size_t values_length; // values buffer length
+    } sdi12_sensor_measurement_t;
+
+    /**
+     * @brief Measurement callback, called from sensor task.
+     *
+     * @param address           virtual sensor address
+     * @param cmd               measurement cmd without address and '!': "M", "M1", "MC", "C", "CC3", "V", "R0", "RC2"...
+     * @param measurement       measurement to fill. Values are ready at once for aR!
+     * @param user_ctx          device user_ctx
+     * @return ESP_OK to answer, any error leaves cmd unanswered
+     */
+    typedef esp_err_t (*sdi12_sensor_measure_cb_t)(char address, const char *cmd, sdi12_sensor_measurement_t *measurement, void *user_ctx);
+
+    /**
+     * @brief Raw cmd callback, called from sensor task before built-in cmd handling. Extended commands and fault injection.
+     *
+     * @param address               virtual sensor address
+     * @param cmd                   null terminated cmd, address and '!' included
+     * @param out_response          response line, without <CR><LF>. CRC isn't added
+     * @param out_response_length   out_response length
+     * @param user_ctx              device user_ctx
+     * @return
+     *      - ESP_OK send out_response
+     *      - ESP_ERR_NOT_SUPPORTED use built-in handling
+     *      - any other error leaves cmd unanswered
+     */
+    typedef esp_err_t (*sdi12_sensor_cmd_cb_t)(char address, const char *cmd, char *out_response, size_t out_response_length, void *user_ctx);
+
+    /**
+     * @brief Virtual sensor hosted on sensor pin
+     */
+    typedef struct
+    {
+        char address;                     // Initial address. aAb! changes it
+        const char *identification;       // aI! response after address. NULL uses "14ESP-IDF SDI12E100"
+        sdi12_sensor_measure_cb_t on_measure; // Optional. Without it measurements return no values
+        sdi12_sensor_cmd_cb_t on_cmd;     // Optional
+        void *user_ctx;
+    } sdi12_sensor_device_config_t;
+
+    typedef struct
+    {
+        uint8_t gpio_num;              // Bus pin on single pin mode. Ignored on dual pin mode.
+        sdi12_bus_dual_pin_t dual_pin; // Only used if flags.dual_pin is set
+        const sdi12_sensor_device_config_t *devices; // Virtual sensors. Copied
+        size_t devices_count;
+        uint16_t response_delay_us; // From cmd stop bit end to response start bit. 0 answers as soon as possible. Otherwise 9900..15000
+        uint32_t task_stack_size;   // 0 uses 4096
+        uint8_t task_priority;      // 0 uses 20. Responses have a few ms budget, keep it high
+        struct
+        {
+            uint32_t dual_pin : 1;     // Use separated TX/RX (and optional direction) pins
+            uint32_t invert_tx : 1;    // Dual pin mode only. Invert TX pin logic level
+            uint32_t invert_rx : 1;    // Dual pin mode only. Invert RX pin logic level
+            uint32_t dir_tx_level : 1; // Dual pin mode only. Direction pin level to enable line driver (transmission)
+        } flags;
+    } sdi12_sensor_config_t;
+
+    typedef struct
+    {
+        uint32_t cmds;                  // Cmds addressed to hosted sensors
+        uint32_t responses;             // Response lines sent. Service requests excluded
+        uint32_t service_requests;
+        uint32_t aborted;               // aM!/aV! measurements aborted by a break or a new cmd before service request
+        uint32_t rx_errors;             // Receptions with parity or stop bit errors
+        uint32_t late_responses;        // Responses started more than 15 ms after cmd end
+        uint32_t max_response_delay_us; // Longest time from cmd stop bit end to response start bit
+    } sdi12_sensor_stats_t;
+
+    typedef struct sdi12_sensor *sdi12_sensor_handle_t;
+
+    esp_err_t sdi12_sensor_get_stats(sdi12_sensor_handle_t sensor, sdi12_sensor_stats_t *out_stats);
+
+    /**
+     * @brief Stop answering and free sensor resources. Line is released.
+     *
+     * @param[in] sensor        sensor object
+     * @return esp_err_t
+     */
+    esp_err_t sdi12_del_sensor(sdi12_sensor_handle_t sensor);
+
+    /**
+     * @brief Create a sensor role object and start answering cmds addressed to its virtual sensors.
+     *
+     * @details Built-in cmds: a!, ?! (only with a single device), aI!, aAb!, aM!, aMC!, aMn!, aMCn!, aC!, aCC!, aCn!, aCCn!, aV!, aDn!, aRn! and
+     * aRCn!. Responses carry CRC when the measurement cmd asked for it, and aM!/aV! send a service request once values are ready. A break, or a
+     * new cmd to the same sensor, aborts a pending aM!/aV!. Unknown cmds are left unanswered, like real sensors do.
+     *
+     * Frames are encoded and decoded with the same RMT code the bus uses. Cmd end is only known after 10 bits without edges, so responses can't
+     * start earlier than SDI12_SENSOR_MIN_RESPONSE_DELAY_US after it (SDI-12 allows 8.33 ms). They start then, or at response_delay_us.
+     *
+     * @param[in] config        sensor config
+     * @param[out] ret_sensor   created sensor
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG invalid pins, addresses or response delay
+     *      - ESP_ERR_NO_MEM
+     */
+    esp_err_t sdi12_new_sensor(const sdi12_sensor_config_t *config, sdi12_sensor_handle_t *ret_sensor);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "sdi12_sensor.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @brief Virtual sensors of a simulated bus (SDI12_BUS_TRANSPORT_SIM).
+     *
+     * @details Sensors are the same ones sensor role hosts (sdi12_sensor.h), with same built-in cmds and callbacks, but no hardware is used:
+     * every frame just takes its wire time on bus clock. Callbacks are called from the task using the bus.
+     *
+     * With a simulated clock (sdi12_new_sim_clock()) idle periods are skipped, so a schedule of 999 s measurements runs a whole day in seconds,
+     * with same cmd order and timestamps on every run.
+     */
+    struct sdi12_sim_config
+    {
+        const sdi12_sensor_device_config_t *devices; // Virtual sensors. Copied
+        size_t devices_count;
+        uint16_t response_delay_us; // From cmd end to response start bit. 0 uses 8330. Values over 15000 make sensors late
+    };
+
+#ifdef __cplusplus
+}
+#endif
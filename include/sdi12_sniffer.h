@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define SDI12_SNIFFER_FRAME_BREAK     (1 << 0) // Frame was preceded by a break
+#define SDI12_SNIFFER_FRAME_CMD       (1 << 1) // Frame ends with '!', so it was sent by a master. Otherwise it is a sensor response
+#define SDI12_SNIFFER_FRAME_ERROR     (1 << 2) // At least one char had a parity or stop bit error
+#define SDI12_SNIFFER_FRAME_TRUNCATED (1 << 3) // Frame was longer than max_frame_chars (or than RMT buffer), extra chars are lost
+
+    typedef struct
+    {
+        int64_t timestamp_us; // First start bit, esp_timer clock
+        uint16_t flags;       // SDI12_SNIFFER_FRAME_* flags
+        uint16_t length;      // Chars in data. Response <CR><LF> is removed
+        const char *data;     // Frame chars, not null terminated. Points into capture ring, valid until sdi12_sniffer_release()
+    } sdi12_sniffer_frame_t;
+
+    typedef struct
+    {
+        int gpio_num;             // SDI-12 data line (or transceiver RX pin). Only used as input
+        uint8_t *ring;            // Capture ring, supplied by caller. Frames are decoded straight into it
+        size_t ring_size;         // Capture ring size, in bytes
+        uint16_t max_frame_chars; // Longest frame stored. 0 uses 128
+        size_t rx_symbols;        // RMT symbols per reception buffer (two are used). Longest burst without idle line must fit. 0 uses 1024
+        uint32_t task_stack_size; // 0 uses 3072
+        uint8_t task_priority;    // 0 uses 10
+        struct
+        {
+            uint32_t invert_rx : 1; // Invert input, i.e. transceiver with non inverting RX output
+        } flags;
+    } sdi12_sniffer_config_t;
+
+    typedef struct
+    {
+        uint32_t frames;    // Frames stored in ring
+        uint32_t dropped;   // Frames lost because ring was full
+        uint32_t errors;    // Frames with parity or stop bit errors
+        uint32_t overflows; // Receptions longer than RMT buffer
+    } sdi12_sniffer_stats_t;
+
+    typedef struct sdi12_sniffer *sdi12_sniffer_handle_t;
+
+    /**
+     * @brief Get oldest captured frame, waiting for one if ring is empty.
+     *
+     * @details Frame data isn't copied, it points into capture ring. Same frame is returned until it is released with sdi12_sniffer_release().
+     * Only one task can read frames.
+     *
+     * @param[in] sniffer       sniffer object
+     * @param[out] out_frame    captured frame
+     * @param[in] timeout_ms    max time waiting for a frame. 0 returns right away
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG
+     *      - ESP_ERR_TIMEOUT no frame captured in time
+     */
+    esp_err_t sdi12_sniffer_read(sdi12_sniffer_handle_t sniffer, sdi12_sniffer_frame_t *out_frame, uint32_t timeout_ms);
+
+    /**
+     * @brief Release frame got from sdi12_sniffer_read(), so its ring space can be reused.
+     *
+     * @param[in] sniffer       sniffer object
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG
+     *      - ESP_ERR_INVALID_STATE ring is empty
+     */
+    esp_err_t sdi12_sniffer_release(sdi12_sniffer_handle_t sniffer);
+
+    esp_err_t sdi12_sniffer_get_stats(sdi12_sniffer_handle_t sniffer, sdi12_sniffer_stats_t *out_stats);
+
+    /**
+     * @brief Stop capture and free sniffer resources. Capture ring is owned by caller.
+     *
+     * @param[in] sniffer       sniffer object
+     * @return esp_err_t
+     */
+    esp_err_t sdi12_del_sniffer(sdi12_sniffer_handle_t sniffer);
+
+    /**
+     * @brief Create sniffer and start capturing. Line is never driven: only a RMT RX channel is installed on gpio_num.
+     *
+     * @details Breaks and long marking gaps split traffic into frames. Frames ending with '!' are master commands, the rest are sensor
+     * responses. Two reception buffers are used, so one is armed while the other is decoded.
+     *
+     * @param[in] config        sniffer config
+     * @param[out] ret_sniffer  created sniffer
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG
+     *      - ESP_ERR_NO_MEM
+     */
+    esp_err_t sdi12_new_sniffer(const sdi12_sniffer_config_t *config, sdi12_sniffer_handle_t *ret_sniffer);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define SDI12_STORE_MAX_CHANNELS (32) // Values per reading
+
+    typedef struct
+    {
+        uint8_t *arena;              // Store memory, supplied by caller. Split in fixed size blocks
+        size_t arena_size;           // Arena size, in bytes
+        size_t block_size;           // Bytes per block. Oldest block is dropped when arena is full. 0 uses 256
+        uint8_t channels;            // Values per reading
+        const uint8_t *decimals;     // Optional. channels items: decimals kept on each channel. NULL keeps 3 on every channel
+        uint32_t time_resolution_us; // Timestamps are kept as multiples of it. 0 uses 1000 (ms)
+    } sdi12_store_config_t;
+
+    /**
+     * @brief Stored reading, as given to query callbacks
+     */
+    typedef struct
+    {
+        int64_t timestamp_us;    // Reading time, rounded down to time resolution
+        const int64_t *values;   // channels scaled values: value * 10^decimals. i.e. "+1.23" is 1230 with 3 decimals
+        const uint8_t *decimals; // channels decimals of values
+        uint8_t channels;        // Number of values
+    } sdi12_store_reading_t;
+
+    typedef struct
+    {
+        uint32_t readings;   // Readings in store
+        uint32_t appended;   // Readings appended since creation
+        uint32_t evicted;    // Readings dropped with oldest blocks to make room
+        size_t blocks_used;  // Blocks holding readings
+        size_t blocks_total; // Blocks in arena
+        size_t bytes_used;   // Bytes of used blocks, headers included
+        int64_t first_us;    // Oldest reading time. 0 if store is empty
+        int64_t last_us;     // Newest reading time. 0 if store is empty
+    } sdi12_store_stats_t;
+
+    /**
+     * @brief Called with each reading of a query, in time order. Store is locked meanwhile, so don't call store functions from it.
+     *
+     * @return true to go on, false to stop query
+     */
+    typedef bool (*sdi12_store_reading_cb_t)(const sdi12_store_reading_t *reading, void *ctx);
+
+    /**
+     * @brief Called with export output chunks
+     *
+     * @return ESP_OK to go on. Any other error stops export and is returned by it
+     */
+    typedef esp_err_t (*sdi12_store_write_cb_t)(const char *data, size_t length, void *ctx);
+
+    typedef struct sdi12_store *sdi12_store_handle_t;
+
+    /**
+     * @brief Append a reading given as SDI-12 values string.
+     *
+     * @details Values are parsed and scaled to channel decimals, extra decimals are rounded. Accepts values as returned by device API without
+     * address, i.e. sdi12_dev_read_data() response + 1, or scheduler and stream sample values.
+     *
+     * @param[in] store         store object
+     * @param[in] timestamp_us  reading time. Not older than last reading
+     * @param[in] values        null terminated values. i.e. "+1.23-4.5+1013"
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG invalid args, malformed value or reading older than last one
+     *      - ESP_ERR_INVALID_SIZE number of values isn't store channels
+     */
+    esp_err_t sdi12_store_append(sdi12_store_handle_t store, int64_t timestamp_us, const char *values);
+
+    /**
+     * @brief Append a reading of already scaled values.
+     *
+     * @param[in] store         store object
+     * @param[in] timestamp_us  reading time. Not older than last reading
+     * @param[in] values        channels scaled values: value * 10^decimals
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG invalid args or reading older than last one
+     */
+    esp_err_t sdi12_store_append_scaled(sdi12_store_handle_t store, int64_t timestamp_us, const int64_t *values);
+
+    /**
+     * @brief Get readings between from_us and to_us, both included.
+     *
+     * @details Blocks keep their time span, so blocks out of range are found by binary search and never decoded.
+     *
+     * @param[in] store         store object
+     * @param[in] from_us       range start
+     * @param[in] to_us         range end
+     * @param[in] on_reading    called with every reading in range
+     * @param[in] ctx           on_reading context
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG
+     */
+    esp_err_t sdi12_store_query(sdi12_store_handle_t store, int64_t from_us, int64_t to_us, sdi12_store_reading_cb_t on_reading, void *ctx);
+
+    /**
+     * @brief Export readings between from_us and to_us as CSV lines: "timestamp_us,value,value...". Output is given in chunks, i.e. to write
+     * it on a file or a HTTP response, so no buffer for whole export is needed.
+     *
+     * @param[in] store         store object
+     * @param[in] from_us       range start
+     * @param[in] to_us         range end
+     * @param[in] write         called with every output chunk
+     * @param[in] ctx           write context
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG
+     *      - any error returned by write
+     */
+    esp_err_t sdi12_store_export_csv(sdi12_store_handle_t store, int64_t from_us, int64_t to_us, sdi12_store_write_cb_t write, void *ctx);
+
+    esp_err_t sdi12_store_get_stats(sdi12_store_handle_t store, sdi12_store_stats_t *out_stats);
+
+    /**
+     * @brief Drop every reading
+     */
+    esp_err_t sdi12_store_clear(sdi12_store_handle_t store);
+
+    /**
+     * @brief Free store resources. Arena is owned by caller.
+     *
+     * @param[in] store     store object
+     * @return esp_err_t
+     */
+    esp_err_t sdi12_del_store(sdi12_store_handle_t store);
+
+    /**
+     * @brief Create a time series store on caller arena.
+     *
+     * @details Each block starts with its time span and a full reading. Following readings keep only differences: timestamp delta of delta and
+     * value deltas, as zigzag varints. Periodic readings of slow changing values take a few bytes each.
+     *
+     * @param[in] config        store config
+     * @param[out] ret_store    created store
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG invalid config, or block too small for a reading of channels values
+     *      - ESP_ERR_NO_MEM
+     */
+    esp_err_t sdi12_new_store(const sdi12_store_config_t *config, sdi12_store_handle_t *ret_store);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#include "sdi12_bus.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define SDI12_STREAM_VALUES_CHARS (76) // aRx! values field is 75 chars at most, plus '\0'
+
+    /**
+     * @brief Continuous measurement polled by a stream
+     */
+    typedef struct
+    {
+        char address;  // Sensor address
+        uint8_t index; // x on aRx!
+        bool crc;      // Send aRCx! and check response CRC
+    } sdi12_stream_source_t;
+
+    /**
+     * @brief Stream output slot. Caller supplies them, stream task stores parsed responses in them.
+     */
+    typedef struct
+    {
+        uint32_t seq;                           // Sample number. Dropped samples take a number too, so gaps show losses
+        uint16_t source;                        // Index of source in config sources
+        uint16_t n_values;                      // Number of values in values string
+        esp_err_t ret;                          // Poll result. values are only valid on ESP_OK
+        char values[SDI12_STREAM_VALUES_CHARS]; // Null terminated values, without address nor CRC. i.e. "+1.23-4.5"
+        sdi12_bus_timestamps_t timestamps;      // aRx! transaction timestamps. Bus clock
+    } sdi12_stream_sample_t;
+
+    typedef struct
+    {
+        sdi12_bus_handle_t bus;
+        const sdi12_stream_source_t *sources; // Polled in order once per cycle. Copied
+        size_t sources_length;
+        uint32_t period_us;             // Target time between cycle starts. 0 polls back to back, at max bus rate
+        sdi12_stream_sample_t *samples; // Output ring, supplied by caller
+        size_t samples_length;          // Slots in output ring
+        uint32_t response_timeout_ms;   // Max wait for each response. 0 uses SDI12_DEFAULT_RESPONSE_TIMEOUT
+        sdi12_bus_access_t access;      // Bus access of every cycle. Other bus users get the bus between cycles
+        sdi12_clock_t *clock;           // Optional. Cycle timing. NULL uses sdi12_clock_get_system(). Use same clock as bus
+        uint32_t task_stack_size;       // 0 uses 3072
+        uint8_t task_priority;          // 0 uses 5
+    } sdi12_stream_config_t;
+
+    typedef struct
+    {
+        uint32_t cycles;   // Cycles run, every source polled once
+        uint32_t samples;  // Samples stored in output ring
+        uint32_t errors;   // Polls which failed (timeout, CRC, bad address...). Stored too, with their error
+        uint32_t dropped;  // Samples lost because output ring was full
+        uint32_t overruns; // Cycles which took longer than period_us
+    } sdi12_stream_stats_t;
+
+    typedef struct sdi12_stream *sdi12_stream_handle_t;
+
+    /**
+     * @brief Get oldest sample, waiting for one if output ring is empty.
+     *
+     * @details Sample isn't copied, it points into output ring. Same sample is returned until it is released with sdi12_stream_release().
+     * Only one task can read samples. Stream task never waits for reader: if ring is full, new samples are dropped.
+     *
+     * @param[in] stream        stream object
+     * @param[out] out_sample   oldest sample
+     * @param[in] timeout_ms    max time waiting for a sample. 0 returns right away
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG
+     *      - ESP_ERR_TIMEOUT no sample in time
+     */
+    esp_err_t sdi12_stream_read(sdi12_stream_handle_t stream, const sdi12_stream_sample_t **out_sample, uint32_t timeout_ms);
+
+    /**
+     * @brief Release sample got from sdi12_stream_read(), so its slot can be reused.
+     *
+     * @param[in] stream        stream object
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG
+     *      - ESP_ERR_INVALID_STATE ring is empty
+     */
+    esp_err_t sdi12_stream_release(sdi12_stream_handle_t stream);
+
+    esp_err_t sdi12_stream_get_stats(sdi12_stream_handle_t stream, sdi12_stream_stats_t *out_stats);
+
+    /**
+     * @brief Stop polling and free stream resources. Waits for running cycle. Output ring is owned by caller.
+     *
+     * @param[in] stream        stream object
+     * @return esp_err_t
+     */
+    esp_err_t sdi12_del_stream(sdi12_stream_handle_t stream);
+
+    /**
+     * @brief Create stream and start polling.
+     *
+     * @details Each cycle polls every source as one bus batch, so bus is locked once per cycle. Break is skipped whenever polled sensor is
+     * still awake: on consecutive sources of same sensor, and between cycles if period is short. Responses are parsed and stored in output
+     * ring by stream task.
+     *
+     * @param[in] config        stream config
+     * @param[out] ret_stream   created stream
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_INVALID_ARG invalid config or source
+     *      - ESP_ERR_NO_MEM
+     */
+    esp_err_t sdi12_new_stream(const sdi12_stream_config_t *config, sdi12_stream_handle_t *ret_stream);
+
+#ifdef __cplusplus
+}
+#endif
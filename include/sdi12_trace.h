@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef enum
+    {
+        SDI12_TRACE_TX_FRAME = 1, // Cmd sent. arg: cmd length, bit 15 set if break was sent
+        SDI12_TRACE_RX_FRAME,     // Response line received. arg: line length
+        SDI12_TRACE_PARITY_ERROR, // arg: chars received before error
+        SDI12_TRACE_STOP_ERROR,   // arg: chars received before error
+        SDI12_TRACE_CRC_ERROR,    // arg: response length
+        SDI12_TRACE_TIMEOUT,      // No response or service request. arg: time waited, in ms (saturated)
+        SDI12_TRACE_RETRY,        // Cmd sent again, i.e. preempted measurement restart. arg: attempt number
+        SDI12_TRACE_USER,         // Recorded by application with sdi12_trace_record()
+    } sdi12_trace_event_t;
+
+    /**
+     * @brief Trace record, as dumped by sdi12_trace_dump()
+     */
+    typedef struct
+    {
+        uint32_t seq;          // Record number since boot. Gaps mean overwritten records
+        uint32_t timestamp_us; // esp_timer time, low 32 bits. Wraps every ~71 minutes
+        uint8_t type;          // See sdi12_trace_event_t
+        char address;          // Sensor address. '\0' if unknown
+        uint16_t arg;          // Event argument. See sdi12_trace_event_t
+    } sdi12_trace_record_t;
+
+    /**
+     * @brief Record an event. Lock free, it can be called from tasks and ISRs. No-op if CONFIG_SDI12_TRACE is disabled.
+     *
+     * @param type      event type
+     * @param address   sensor address, '\0' if unknown
+     * @param arg       event argument
+     */
+    void sdi12_trace_record(sdi12_trace_event_t type, char address, uint16_t arg);
+
+    /**
+     * @brief Copy recorded events, oldest first. Events being written while dumping are skipped.
+     *
+     * @param[out] out_records      records buffer
+     * @param[in] max_records       records buffer length
+     * @return number of records copied. 0 if CONFIG_SDI12_TRACE is disabled
+     */
+    size_t sdi12_trace_dump(sdi12_trace_record_t *out_records, size_t max_records);
+
+    /**
+     * @brief Print recorded events to console, one line per event, for tools/sdi12_trace_decode.py.
+     *
+     * @return esp_err_t
+     *      - ESP_OK
+     *      - ESP_ERR_NOT_SUPPORTED CONFIG_SDI12_TRACE is disabled
+     *      - ESP_ERR_NO_MEM
+     */
+    esp_err_t sdi12_trace_print(void);
+
+    /**
+     * @brief Drop recorded events
+     */
+    void sdi12_trace_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "esp_err.h"
+
+#include "sdi12_bus.h"
+#include "sdi12_transport.h"
+
+/**
+ * Valid sensor addresses: '0'-'9', 'a'-'z' and 'A'-'Z'
+ */
+#define SDI12_HEALTH_ADDRESSES (62)
+
+/**
+ * Usage ring buckets. Seconds ring covers last minute, minutes ring last hour.
+ */
+#define SDI12_HEALTH_USAGE_BUCKETS (60)
+
+/**
+ * @brief Outcome of a single transaction, filled by bus code while it runs and accounted once it is over.
+ */
+typedef struct
+{
+    esp_err_t ret;
+    sdi12_transport_rx_error_t rx_error; // Cause of ESP_FAIL on response reads
+    bool write_error;
+    uint8_t retries;
+    uint16_t tx_bytes;
+    uint16_t rx_bytes;
+    uint16_t cmd_chars; // Last sent cmd length
+    bool responded;         // Last sent cmd got its response line
+    size_t response_length; // Last cmd response line length
+    uint32_t ttt_ms;   // Announced measurement time. Only used if service request timestamp is set
+    uint32_t yielded_us; // Time bus was handed to preempting requests
+    int64_t start_us;     // First cmd break start
+    int64_t line_done_us; // Last response line read end
+    int64_t end_us;       // Transaction end
+    sdi12_bus_timestamps_t timestamps;
+} sdi12_bus_txn_t;
+
+/**
+ * @brief Bus busy time per time bucket. Bucket slot is reused when index doesn't match.
+ */
+typedef struct
+{
+    int64_t index[SDI12_HEALTH_USAGE_BUCKETS]; // Bucket number since boot
+    uint32_t busy_us[SDI12_HEALTH_USAGE_BUCKETS];
+} sdi12_bus_usage_ring_t;
+
+/**
+ * @brief Health counters of a bus. Per address records are allocated on first cmd to that address.
+ */
+typedef struct
+{
+    portMUX_TYPE lock;
+    sdi12_bus_health_t total;
+    sdi12_bus_health_t *addresses[SDI12_HEALTH_ADDRESSES];
+    sdi12_clock_t *clock;
+    int64_t created_us;
+    sdi12_bus_usage_ring_t seconds;
+    sdi12_bus_usage_ring_t minutes;
+} sdi12_bus_health_store_t;
+
+void sdi12_bus_health_init(sdi12_bus_health_store_t *store, sdi12_clock_t *clock);
+
+/**
+ * @brief Free per address records
+ */
+void sdi12_bus_health_deinit(sdi12_bus_health_store_t *store);
+
+/**
+ * @brief Account finished transaction on bus and address records. Only called by bus owner.
+ *
+ * @param store     health store
+ * @param address   cmd address
+ * @param txn       transaction outcome
+ */
+void sdi12_bus_health_account(sdi12_bus_health_store_t *store, char address, const sdi12_bus_txn_t *txn);
+
+/**
+ * @brief Copy bus ('\0') or address record
+ *
+ * @return esp_err_t
+ *      - ESP_OK
+ *      - ESP_ERR_INVALID_ARG invalid address
+ *      - ESP_ERR_NOT_FOUND no cmd sent to address yet
+ */
+esp_err_t sdi12_bus_health_get(sdi12_bus_health_store_t *store, char address, sdi12_bus_health_t *out_health);
+
+void sdi12_bus_health_reset(sdi12_bus_health_store_t *store);
+
+/**
+ * @brief Compute bus utilization over sliding windows
+ */
+void sdi12_bus_health_get_utilization(sdi12_bus_health_store_t *store, sdi12_bus_utilization_t *out_utilization);
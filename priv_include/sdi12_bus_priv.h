@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "sdi12_bus.h"
+
+/**
+ * @brief Called when a sensor accepts a measurement cmd (aM!, aMC!, aV!, aC!, aCC!, aHA!...), with its 'atttn' response, before service
+ * request is awaited. Also called on every restart of a preempted measurement. Called from task using the bus, with bus locked.
+ *
+ * @param cmd       measurement cmd, address and '!' included
+ * @param response  'atttn', 'atttnn' or 'atttnnn' response
+ * @param ctx       context set with callback
+ */
+typedef void (*sdi12_bus_measurement_cb_t)(const char *cmd, const char *response, void *ctx);
+
+/**
+ * @brief Set bus measurement callback. Used by device API measurement journal. NULL removes it.
+ */
+esp_err_t sdi12_bus_set_measurement_callback(sdi12_bus_handle_t bus, sdi12_bus_measurement_cb_t cb, void *ctx);
+
+/**
+ * @brief Keep bus locked for duration_ms, waiting on bus clock. Used to wait a measurement without a pending cmd, as bus does while it waits
+ * a service request, so no other cmd or break aborts it.
+ */
+esp_err_t sdi12_bus_hold(sdi12_bus_handle_t bus, uint32_t duration_ms);
+
+/**
+ * @brief Bus identity, same on every boot with same config: RX pin (single pin mode pin, or dual pin RX pin). Used to tell apart sensors
+ * sharing an address on different buses.
+ */
+uint16_t sdi12_bus_get_id(sdi12_bus_handle_t bus);
+
+/**
+ * @brief Index of a SDI-12 address: '0'-'9' are 0-9, 'a'-'z' are 10-35 and 'A'-'Z' are 36-61.
+ *
+ * @return index, -1 if address is invalid
+ */
+int sdi12_bus_address_index(char address);
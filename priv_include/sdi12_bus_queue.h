@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "esp_err.h"
+
+#include "sdi12_bus.h"
+
+typedef struct sdi12_bus_waiter sdi12_bus_waiter_t;
+
+/**
+ * @brief Bus access request waiting on queue. Lives on requester stack while it waits.
+ */
+struct sdi12_bus_waiter
+{
+    SemaphoreHandle_t granted_sem;
+    StaticSemaphore_t granted_sem_buffer;
+    uint8_t priority;
+    TaskHandle_t task;
+    UBaseType_t task_priority; // RTOS priority of task when it asked for the bus
+    uint32_t seq;              // Arrival order. Same priority waiters are served FIFO, so tasks sharing a priority take turns.
+    int64_t enqueue_us;
+    volatile bool granted;
+    sdi12_bus_waiter_t *next;
+};
+
+/**
+ * @brief Bus arbiter. Replaces plain mutex: bus is granted to highest priority waiter and, on equal priority, to oldest one.
+ *
+ * @details Waiters block on their own semaphore, so owner doesn't inherit their RTOS priority as it would with a mutex. Queue does it:
+ * while a waiter task has a higher RTOS priority than owner task, owner is raised to it. Owner gets its own priority back when it hands
+ * the bus over. A boost isn't lowered if its waiter gives up (deadline), it is kept until bus changes hands.
+ */
+typedef struct
+{
+    portMUX_TYPE spinlock;
+    bool busy;
+    uint8_t owner_priority;
+    TaskHandle_t owner_task;
+    UBaseType_t owner_task_priority; // Owner RTOS priority when bus was granted. Restored on hand over
+    UBaseType_t owner_boost;         // RTOS priority owner has been raised to. 0 if not raised
+    SemaphoreHandle_t boost_lock;    // Serializes owner priority changes, so a waiter can't raise a task which has just left the bus
+    StaticSemaphore_t boost_lock_buffer;
+    uint32_t next_seq;
+    sdi12_bus_waiter_t *waiters; // Sorted by priority (desc) and seq (asc)
+    sdi12_bus_queue_stats_t stats;
+    bool preemptible;                // Owner is in a wait that can be aborted
+    volatile bool preempt_requested; // A higher priority waiter arrived while owner was preemptible
+    void (*on_preempt)(void *ctx);   // Called, out of critical section, when preemption is requested
+    void *on_preempt_ctx;
+    sdi12_clock_t *clock; // Wait time stats. Deadlines are RTOS ticks, they only matter while other tasks hold the bus
+} sdi12_bus_queue_t;
+
+/**
+ * @brief Init queue
+ *
+ * @param queue         bus queue
+ * @param clock         bus clock
+ * @param on_preempt    called when a higher priority request arrives while owner is preemptible. Can be NULL
+ * @param ctx           on_preempt context
+ */
+void sdi12_bus_queue_init(sdi12_bus_queue_t *queue, sdi12_clock_t *clock, void (*on_preempt)(void *ctx), void *ctx);
+
+/**
+ * @brief Wait for bus access
+ *
+ * @param queue         bus queue
+ * @param priority      request priority. Higher served first
+ * @param deadline_ms   max time waiting for access. 0 waits forever
+ * @return esp_err_t
+ *      - ESP_OK bus granted
+ *      - ESP_ERR_TIMEOUT deadline expired before bus was granted
+ */
+esp_err_t sdi12_bus_queue_acquire(sdi12_bus_queue_t *queue, uint8_t priority, uint32_t deadline_ms);
+
+/**
+ * @brief Release bus access. Bus is handed to next waiter, if any.
+ *
+ * @param queue         bus queue
+ */
+void sdi12_bus_queue_release(sdi12_bus_queue_t *queue);
+
+/**
+ * @brief Mark owner wait as preemptible (or not). Only called by bus owner.
+ *
+ * @details When preemptible is set and a higher priority request is already waiting, preempt_requested is set right away.
+ * preempt_requested is cleared when preemptible is set.
+ *
+ * @param queue         bus queue
+ * @param preemptible   true when entering preemptible wait, false when leaving it
+ */
+void sdi12_bus_queue_set_preemptible(sdi12_bus_queue_t *queue, bool preemptible);
+
+/**
+ * @brief Hand bus to a waiting higher priority request and wait to get it back. Only called by bus owner.
+ *
+ * @param queue     bus queue
+ * @return true if bus was handed over. false if no higher priority request is waiting (bus is kept)
+ */
+bool sdi12_bus_queue_yield(sdi12_bus_queue_t *queue);
+
+void sdi12_bus_queue_get_stats(sdi12_bus_queue_t *queue, sdi12_bus_queue_stats_t *out_stats);
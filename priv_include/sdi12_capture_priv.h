@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "sdkconfig.h"
+
+#include "esp_err.h"
+#include "driver/rmt_types.h"
+
+#include "sdi12_capture.h"
+
+/**
+ * @brief Write a reception record if capture is running. Task context only.
+ *
+ * @param cmd               cmd that triggered reception. NULL if unknown
+ * @param symbols           received symbols
+ * @param num_symbols       received symbols length
+ * @param buffer_length     response buffer length given to decoder
+ * @param ret               decoder result
+ * @param rx_error          decoder rx error
+ * @param done_us           reception done time
+ */
+void sdi12_capture_reception(const char *cmd, const rmt_symbol_word_t *symbols, size_t num_symbols, size_t buffer_length, esp_err_t ret,
+    uint8_t rx_error, int64_t done_us);
+
+/**
+ * RMT transport records receptions through this macro, so capture has no cost at all if CONFIG_SDI12_CAPTURE is disabled.
+ */
+#if CONFIG_SDI12_CAPTURE
+#define SDI12_CAPTURE(cmd, symbols, num_symbols, buffer_length, ret, rx_error, done_us)                                                           \
+    sdi12_capture_reception((cmd), (symbols), (num_symbols), (buffer_length), (ret), (rx_error), (done_us))
+#else
+#define SDI12_CAPTURE(cmd, symbols, num_symbols, buffer_length, ret, rx_error, done_us) ((void)0)
+#endif
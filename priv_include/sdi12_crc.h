@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "esp_err.h"
+
+/**
+ * @brief Compute SDI-12 CRC (CRC-16/ARC) of data, encoded as 3 ASCII chars
+ *
+ * @param data          data to protect, i.e. response without CRC and <CR><LF>
+ * @param length        data length
+ * @param out_crc       3 ASCII chars, not null terminated
+ */
+void sdi12_crc_ascii(const char *data, size_t length, char out_crc[3]);
+
+/**
+ * @brief Check CRC of a response line
+ *
+ * @param response  response, without <CR><LF>. Last 3 chars are CRC. No terminator is needed
+ * @param length    response length, CRC included
+ * @return esp_err_t
+ *      - ESP_OK CRC matches
+ *      - ESP_ERR_INVALID_ARG response is too short to hold a CRC
+ *      - ESP_ERR_INVALID_CRC CRC doesn't match
+ */
+esp_err_t sdi12_crc_check(const char *response, size_t length);
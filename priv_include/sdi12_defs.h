@@ -3,6 +3,17 @@
 #define SDI12_BREAK_US              (12200)
 #define SDI12_POST_BREAK_MARKING_US (8333)
 #define SDI12_BIT_WIDTH_US          (833)
+#define SDI12_CHAR_US               (10 * SDI12_BIT_WIDTH_US) // 7E1: start + 7 data + parity + stop bits
+#define SDI12_RESPONSE_START_MAX_US (15000) // Sensor must start its response within this time after cmd stop bit
+#define SDI12_RX_IDLE_US            (SDI12_BREAK_US + 500) // RMT reception ends when line is idle this long. The longest SDI12 signal is break
+#define SDI12_BREAK_SKIP_US         (87000) // Recorder doesn't need to break if addressed sensor was active less than this time ago
+#define SDI12_TX_SLACK_MS           (100) // Added to frame wire time when waiting for TX done
+
+// Time a frame takes on the wire: break, marking and chars
+#define SDI12_FRAME_US(chars, break_us, marking_us) ((int64_t)(break_us) + (marking_us) + (int64_t)(chars) * SDI12_CHAR_US)
+
+// TX done timeout of a frame, in ms
+#define SDI12_TX_WAIT_MS(chars, break_us, marking_us) ((uint32_t)((SDI12_FRAME_US(chars, break_us, marking_us) + 999) / 1000) + SDI12_TX_SLACK_MS)
 
 #define SDI12_MARKING (0)
 #define SDI12_SPACING (1)
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sdkconfig.h"
+
+#include "sdi12_bus.h"
+#include "sdi12_dev.h"
+
+/**
+ * Measurement journal. Device API keeps accepted measurements (cmd, n and ready time) on RTC memory, so they survive resets and are resumed
+ * on next boot instead of being started again. Entries are keyed by bus identity (sdi12_bus_get_id()) and address, so same address on two
+ * buses are two sensors. Functions are stubs if CONFIG_SDI12_JOURNAL is disabled.
+ */
+
+/**
+ * @brief Record measurements accepted on bus. Safe to call for every device of bus.
+ */
+void sdi12_dev_journal_attach(sdi12_bus_handle_t bus);
+
+/**
+ * @brief Take measurement started with same cmd before last reset, if results are still kept.
+ *
+ * @param bus               bus cmd is sent on
+ * @param cmd               measurement cmd about to be sent
+ * @param out_remaining_ms  time until results are ready. 0 if they are
+ * @param out_n_values      n on measurement response
+ * @return true if measurement is resumed, so cmd mustn't be sent
+ */
+bool sdi12_dev_journal_resume(sdi12_bus_handle_t bus, const char *cmd, uint32_t *out_remaining_ms, uint16_t *out_n_values);
+
+/**
+ * @brief Check whether a measurement started before last reset is still running on sensor. Any cmd to it would abort it.
+ */
+bool sdi12_dev_journal_running(sdi12_bus_handle_t bus, char address);
+
+/**
+ * @brief Account values read with aDx!. Entry is dropped once every value is read, or if sensor has no more values.
+ *
+ * @param bus       bus response was read on
+ * @param response  aDx! response, address included
+ */
+void sdi12_dev_journal_data(sdi12_bus_handle_t bus, const char *response);
+
+esp_err_t sdi12_dev_journal_get(sdi12_bus_handle_t bus, char address, sdi12_dev_journal_entry_t *out_entry);
+
+void sdi12_dev_journal_clear(sdi12_bus_handle_t bus, char address);
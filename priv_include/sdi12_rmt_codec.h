@@ -0,0 +1,127 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "driver/rmt_types.h"
+
+#include "sdi12_transport.h"
+
+/**
+ * RMT symbols <-> SDI-12 chars (1200 baud, 7E1, inverse logic). No driver calls, so it is shared by bus transport, capture replay and host
+ * tools.
+ */
+
+/**
+ * @brief Decode RMT symbols into a response line. Stop when SDI12 response end (\r\n) is found. Only decoded chars are written.
+ *
+ * @param raw_symbols           received rmt symbols
+ * @param symbols_length        received rmt symbols length
+ * @param out_buffer            decoded line, without <CR><LF>. Null terminated
+ * @param out_buffer_length     out buffer length
+ * @param out_length            Optional. Decoded line length, without <CR><LF>. Only set on success
+ * @param out_rx_error          set to error cause when ESP_FAIL is returned
+ * @return esp_err_t
+ *      - ESP_OK SDI12 end is found and parse ok
+ *      - ESP_FAIL parity or stop bit error
+ *      - ESP_ERR_INVALID_SIZE out buffer too small
+ *      - ESP_ERR_NOT_FOUND SDI12 end isn't found
+ */
+esp_err_t sdi12_rmt_decode_line(const rmt_symbol_word_t *raw_symbols, size_t symbols_length, char *out_buffer, size_t out_buffer_length,
+    size_t *out_length, sdi12_transport_rx_error_t *out_rx_error);
+
+typedef void (*sdi12_rmt_stream_char_cb_t)(void *ctx, char c, sdi12_transport_rx_error_t error, int64_t start_us);
+typedef void (*sdi12_rmt_stream_frame_end_cb_t)(void *ctx, bool brk);
+
+/**
+ * @brief Streaming 7E1 decoder, fed one RMT level at a time. Chars, frame gaps and breaks are reported through callbacks, so cmd decoding
+ * and sniffer share same framing, parity and break rules.
+ */
+typedef struct
+{
+    sdi12_rmt_stream_char_cb_t on_char;           // Char decoded. Chars with errors are reported too
+    sdi12_rmt_stream_frame_end_cb_t on_frame_end; // Marking gap after a char (brk false) or break (brk true, even if no char came before)
+    void *ctx;
+    uint8_t gap_bits; // Marking bits after a char which end a frame
+    uint8_t bit_counter;
+    uint8_t idle_bits;
+    bool in_frame; // A char has been decoded since last frame end
+    char c;
+    bool parity;
+    sdi12_transport_rx_error_t error;
+    int64_t char_start_us;
+} sdi12_rmt_stream_t;
+
+/**
+ * @brief Init streaming decoder
+ *
+ * @param stream        decoder
+ * @param gap_bits      marking bits after a char which end a frame
+ * @param on_char       char callback
+ * @param on_frame_end  frame end callback
+ * @param ctx           callbacks context
+ */
+void sdi12_rmt_stream_init(sdi12_rmt_stream_t *stream, uint8_t gap_bits, sdi12_rmt_stream_char_cb_t on_char, sdi12_rmt_stream_frame_end_cb_t on_frame_end,
+    void *ctx);
+
+/**
+ * @brief Drop char being decoded and frame state. Call before a new reception.
+ */
+void sdi12_rmt_stream_reset(sdi12_rmt_stream_t *stream);
+
+/**
+ * @brief Feed a level. Inverse logic: level 1 is spacing (0), level 0 is marking (1).
+ *
+ * @param stream        decoder
+ * @param level         line level
+ * @param duration_us   level duration
+ * @param start_us      level start time, passed to on_char as char start. Any base can be used
+ */
+void sdi12_rmt_stream_level(sdi12_rmt_stream_t *stream, uint8_t level, uint32_t duration_us, int64_t start_us);
+
+/**
+ * @brief End of reception. A char waiting for its stop bit is reported: last stop bit is idle line, so it isn't on symbols.
+ */
+void sdi12_rmt_stream_flush(sdi12_rmt_stream_t *stream);
+
+/**
+ * @brief Decode last cmd of a reception, as seen by a sensor. Breaks and marking gaps split reception into frames and only last frame is
+ * returned, so a reception holding other sensors traffic followed by a cmd still yields the cmd.
+ *
+ * @param raw_symbols           received rmt symbols
+ * @param symbols_length        received rmt symbols length
+ * @param out_buffer            decoded cmd, '!' included. Null terminated
+ * @param out_buffer_length     out buffer length
+ * @param out_break             Optional. Set if last frame was preceded by a break
+ * @param out_rx_error          set to error cause when ESP_FAIL is returned
+ * @return esp_err_t
+ *      - ESP_OK last frame ends with '!'
+ *      - ESP_FAIL parity or stop bit error on last frame
+ *      - ESP_ERR_INVALID_SIZE out buffer too small
+ *      - ESP_ERR_NOT_FOUND last frame isn't a cmd
+ */
+esp_err_t sdi12_rmt_decode_cmd(const rmt_symbol_word_t *raw_symbols, size_t symbols_length, char *out_buffer, size_t out_buffer_length,
+    bool *out_break, sdi12_transport_rx_error_t *out_rx_error);
+
+/**
+ * Symbols needed to encode a frame of chars: break/marking symbol, plus 10 bits (5 symbols) per char
+ */
+#define SDI12_RMT_FRAME_SYMBOLS(chars) (1 + (chars) * 5)
+
+/**
+ * @brief Encode break (or marking only) and chars into RMT symbols
+ *
+ * @param data              chars to send
+ * @param length            chars to send length
+ * @param break_us          break length. 0 sends only marking
+ * @param marking_us        marking before first char. Up to 2 * 32767 us without break
+ * @param out_symbols       SDI12_RMT_FRAME_SYMBOLS(length) symbols
+ */
+void sdi12_rmt_encode_frame(const char *data, size_t length, uint16_t break_us, uint32_t marking_us, rmt_symbol_word_t *out_symbols);
+
+/**
+ * @brief Sum of symbol durations, in us (1 tick = 1 us). Zero duration is end marker.
+ */
+int64_t sdi12_rmt_symbols_duration_us(const rmt_symbol_word_t *symbols, size_t symbols_length);
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#include "sdi12_sensor.h"
+
+#define SDI12_SENSOR_PROTO_MAX_DEVICES (62) // Valid addresses: '0'-'9', 'a'-'z' and 'A'-'Z'
+
+/**
+ * @brief Virtual sensor and its last measurement
+ */
+typedef struct
+{
+    sdi12_sensor_device_config_t config;
+    char address;
+    char values[SDI12_SENSOR_VALUES_LENGTH];
+    uint8_t page_chars;   // Values chars per aDn! page
+    bool crc;             // Last measurement asked for CRC
+    bool service_request; // aM!/aV! waiting for its service request
+    int64_t ready_us;     // Values ready time
+} sdi12_sensor_proto_device_t;
+
+/**
+ * @brief Sensor side of SDI-12 protocol, without any driver. Shared by sensor role (RMT) and simulated bus transport, which give it cmds and
+ * time and send its responses. Not thread safe: owner serializes calls.
+ */
+typedef struct
+{
+    sdi12_sensor_proto_device_t *devices;
+    size_t devices_count;
+} sdi12_sensor_proto_t;
+
+/**
+ * @brief Check device configs and allocate devices
+ *
+ * @param proto             protocol object
+ * @param devices           virtual sensors. Copied
+ * @param devices_count     number of devices
+ * @return esp_err_t
+ *      - ESP_OK
+ *      - ESP_ERR_INVALID_ARG invalid or duplicated addresses
+ *      - ESP_ERR_NO_MEM
+ */
+esp_err_t sdi12_sensor_proto_init(sdi12_sensor_proto_t *proto, const sdi12_sensor_device_config_t *devices, size_t devices_count);
+
+void sdi12_sensor_proto_deinit(sdi12_sensor_proto_t *proto);
+
+/**
+ * @brief Handle a received cmd. A pending aM!/aV! of addressed device is aborted.
+ *
+ * @param proto                 protocol object
+ * @param cmd                   null terminated cmd, address and '!' included
+ * @param cmd_end_us            cmd stop bit end. Measurements are timed from it
+ * @param now_us                current time
+ * @param out_response          response line, without <CR><LF>
+ * @param out_response_length   out_response length
+ * @param out_aborted           measurements aborted by cmd
+ * @return esp_err_t
+ *      - ESP_OK response is ready
+ *      - ESP_ERR_NOT_FOUND cmd isn't addressed to a hosted device
+ *      - any other error leaves cmd unanswered
+ */
+esp_err_t sdi12_sensor_proto_handle_cmd(sdi12_sensor_proto_t *proto, const char *cmd, int64_t cmd_end_us, int64_t now_us, char *out_response,
+    size_t out_response_length, uint32_t *out_aborted);
+
+/**
+ * @brief Abort pending aM!/aV! measurements of every device, as a break does
+ *
+ * @return number of aborted measurements
+ */
+uint32_t sdi12_sensor_proto_abort(sdi12_sensor_proto_t *proto);
+
+/**
+ * @brief Get time of next service request
+ *
+ * @return ready time of earliest pending aM!/aV!. INT64_MAX if there is none
+ */
+int64_t sdi12_sensor_proto_next_service_request(const sdi12_sensor_proto_t *proto);
+
+/**
+ * @brief Take a due service request. Call it until it returns '\0'.
+ *
+ * @param proto     protocol object
+ * @param now_us    current time
+ * @return address of a device whose values are ready. '\0' if there is none
+ */
+char sdi12_sensor_proto_pop_service_request(sdi12_sensor_proto_t *proto, int64_t now_us);
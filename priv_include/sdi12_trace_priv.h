@@ -0,0 +1,14 @@
+#pragma once
+
+#include "sdkconfig.h"
+
+#include "sdi12_trace.h"
+
+/**
+ * Bus code records events through this macro, so tracing has no cost at all if CONFIG_SDI12_TRACE is disabled.
+ */
+#if CONFIG_SDI12_TRACE
+#define SDI12_TRACE(type, address, arg) sdi12_trace_record((type), (address), (arg))
+#else
+#define SDI12_TRACE(type, address, arg) ((void)0)
+#endif
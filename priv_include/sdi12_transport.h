@@ -0,0 +1,118 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#include "sdi12_bus.h"
+
+typedef struct sdi12_transport_t sdi12_transport_t;
+
+/**
+ * @brief Bus clock time of a frame on the wire
+ */
+typedef struct
+{
+    int64_t start_us; // First edge. Break start on commands
+    int64_t end_us;   // Last char stop bit end
+} sdi12_transport_stamp_t;
+
+/**
+ * @brief Cause of a read_line() ESP_FAIL
+ */
+typedef enum
+{
+    SDI12_TRANSPORT_RX_ERROR_NONE = 0,
+    SDI12_TRANSPORT_RX_ERROR_PARITY,
+    SDI12_TRANSPORT_RX_ERROR_STOP_BIT,
+} sdi12_transport_rx_error_t;
+
+/**
+ * @brief Physical layer used by bus object. Bus handles locking, command validation, CRC and service requests,
+ * transport only moves frames over the wire.
+ */
+struct sdi12_transport_t
+{
+    /**
+     * @brief Send break, post break marking and cmd. Returns when last cmd stop bit is sent and line is released.
+     *
+     * @param[in] transport     transport object
+     * @param[in] cmd           null terminated cmd to send
+     * @param[in] timing        break and marking to apply. break_us 0 means no break, only marking
+     * @param[out] out_stamp    Optional. Frame time on the wire
+     * @return esp_err_t
+     */
+    esp_err_t (*write_cmd)(sdi12_transport_t *transport, const char *cmd, const sdi12_bus_timing_t *timing, sdi12_transport_stamp_t *out_stamp);
+
+    /**
+     * @brief Wait for a response line (ended by <CR><LF>). <CR><LF> is removed from out buffer and string is null terminated.
+     *
+     * @details If rx_keep is set and line is read, receiver is armed again before returning, so next line of a multi-line response is caught
+     * without any setup. Any other outcome, or next write_cmd(), releases receiver.
+     *
+     * @param[in] transport             transport object
+     * @param[out] out_buffer           buffer to save response
+     * @param[in] out_buffer_length     response buffer length
+     * @param[in] timeout               time to wait for response, in ms. 0 to use SDI12_DEFAULT_RESPONSE_TIMEOUT
+     * @param[in] abort                 Optional. Checked before waiting and on every wake() call. If it is true, wait is aborted.
+     * @param[out] out_stamp            Optional. Response line time on the wire. Only set on success
+     * @return esp_err_t
+     *      - ESP_OK on success. Line length is in rx_length
+     *      - ESP_ERR_TIMEOUT no response
+     *      - ESP_ERR_INVALID_SIZE out buffer too small
+     *      - ESP_ERR_INVALID_STATE wait aborted
+     *      - ESP_FAIL parity or framing error
+     */
+    esp_err_t (*read_line)(sdi12_transport_t *transport, char *out_buffer, size_t out_buffer_length, uint32_t timeout, const volatile bool *abort,
+        sdi12_transport_stamp_t *out_stamp);
+
+    /**
+     * @brief Wake up a pending read_line() so it checks its abort flag. Spurious wake ups are ignored by reader.
+     *
+     * @param[in] transport     transport object
+     */
+    void (*wake)(sdi12_transport_t *transport);
+
+    /**
+     * @brief Free transport resources
+     *
+     * @param[in] transport     transport object
+     * @return esp_err_t
+     */
+    esp_err_t (*del)(sdi12_transport_t *transport);
+
+    sdi12_transport_rx_error_t rx_error; // Set by transport when read_line() returns ESP_FAIL
+    size_t rx_length;                    // Set by transport when read_line() returns ESP_OK. Line length, without <CR><LF>. Line can hold '\0'
+    uint32_t rx_idle_us;                 // Time from response end until read_line() detects it. Used by wire time estimates
+    bool rx_keep;                        // Set by bus while more lines of same response are expected. Ignored by transports which always listen
+};
+
+/**
+ * @brief Create RMT based transport. Supports single pin and dual pin modes.
+ *
+ * @param[in] config            bus config
+ * @param[out] ret_transport    created transport
+ * @return esp_err_t
+ */
+esp_err_t sdi12_new_rmt_transport(const sdi12_bus_config_t *config, sdi12_transport_t **ret_transport);
+
+/**
+ * @brief Create UART peripheral based transport. Only dual pin mode is supported.
+ *
+ * @param[in] config            bus config
+ * @param[out] ret_transport    created transport
+ * @return esp_err_t
+ */
+esp_err_t sdi12_new_uart_transport(const sdi12_bus_config_t *config, sdi12_transport_t **ret_transport);
+
+/**
+ * @brief Create simulated transport. Virtual sensors answer in software and every frame takes its wire time on bus clock, so with a simulated
+ * clock a whole measurement schedule runs in a fraction of real time.
+ *
+ * @param[in] config            bus config. config->sim must be set
+ * @param[in] clock             bus clock
+ * @param[out] ret_transport    created transport
+ * @return esp_err_t
+ */
+esp_err_t sdi12_new_sim_transport(const sdi12_bus_config_t *config, sdi12_clock_t *clock, sdi12_transport_t **ret_transport);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * SDI-12 <values> field helpers, shared by every module reading aDx! or aRx! responses.
+ */
+
+#define SDI12_VALUES_MAX_DECIMALS (9) // Most decimals a value can be scaled to
+
+extern const int64_t sdi12_values_pow10[SDI12_VALUES_MAX_DECIMALS + 1];
+
+/**
+ * @brief Count values of a <values> field. Every value starts with its sign.
+ *
+ * @param values    null terminated values, without address nor CRC. i.e. "+1.23-4.5"
+ * @return number of values
+ */
+uint16_t sdi12_values_count(const char *values);
+
+/**
+ * @brief Parse one SDI-12 value ("+1.23", "-4", "+0.5") and scale it to decimals. Extra decimals are rounded half away from zero.
+ *
+ * @param values        value to parse, sign included
+ * @param decimals      decimals kept. Up to SDI12_VALUES_MAX_DECIMALS
+ * @param out_value     value * 10^decimals
+ * @return pointer to next value. NULL if value is malformed
+ */
+const char *sdi12_values_parse(const char *values, uint8_t decimals, int64_t *out_value);
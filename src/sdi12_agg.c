@@ -0,0 +1,302 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "esp_check.h"
+#include "esp_log.h"
+
+#include "sdi12_agg.h"
+#include "sdi12_values.h"
+
+/**
+ * @brief Channel state. Running stats of open window plus change filter state, so its size doesn't depend on readings.
+ */
+typedef struct
+{
+    uint32_t count;
+    float min;
+    float max;
+    float mean;
+    float m2; // Sum of squared differences from mean
+    float reported;
+    bool has_reported;
+} sdi12_agg_channel_t;
+
+typedef struct sdi12_agg
+{
+    uint8_t channels;
+    int64_t window_us;
+    uint32_t window_readings;
+    sdi12_agg_filter_t *filters;
+    sdi12_agg_window_cb_t on_window;
+    sdi12_agg_change_cb_t on_change;
+    void *ctx;
+
+    sdi12_agg_channel_t *state;
+    sdi12_agg_channel_stats_t *window_stats; // Filled on window close
+    bool window_open;
+    int64_t window_start_us;
+    uint32_t window_count;
+    bool has_readings;
+    int64_t last_us;
+
+    portMUX_TYPE lock; // Protects stats
+    sdi12_agg_stats_t stats;
+} sdi12_agg_t;
+
+static const char *TAG = "sdi12 agg";
+
+static void close_window(sdi12_agg_t *agg, int64_t end_us)
+{
+    for (uint8_t i = 0; i < agg->channels; i++)
+    {
+        sdi12_agg_channel_t *channel = &agg->state[i];
+        sdi12_agg_channel_stats_t *stats = &agg->window_stats[i];
+
+        stats->count = channel->count;
+        stats->min = channel->min;
+        stats->max = channel->max;
+        stats->mean = channel->mean;
+        stats->variance = channel->count > 1 ? channel->m2 / (channel->count - 1) : 0;
+
+        channel->count = 0;
+        channel->mean = 0;
+        channel->m2 = 0;
+    }
+
+    sdi12_agg_window_t window = {
+        .start_us = agg->window_start_us,
+        .end_us = end_us,
+        .channels = agg->channels,
+        .stats = agg->window_stats,
+    };
+
+    agg->window_open = false;
+    agg->window_count = 0;
+
+    portENTER_CRITICAL(&agg->lock);
+    ++agg->stats.windows;
+    portEXIT_CRITICAL(&agg->lock);
+
+    if (agg->on_window)
+    {
+        agg->on_window(&window, agg->ctx);
+    }
+}
+
+/**
+ * @brief Report value if it passes channel change filter
+ */
+static bool filter_change(sdi12_agg_t *agg, uint8_t index, int64_t timestamp_us, float value)
+{
+    const sdi12_agg_filter_t *filter = &agg->filters[index];
+    sdi12_agg_channel_t *channel = &agg->state[index];
+
+    if (channel->has_reported)
+    {
+        float threshold = fmaxf(filter->deadband, fabsf(channel->reported) * filter->cov_percent / 100.0f);
+
+        if (fabsf(value - channel->reported) <= threshold)
+        {
+            return false;
+        }
+    }
+
+    float previous = channel->has_reported ? channel->reported : NAN;
+
+    channel->reported = value;
+    channel->has_reported = true;
+
+    if (agg->on_change)
+    {
+        agg->on_change(index, timestamp_us, value, previous, agg->ctx);
+    }
+
+    return true;
+}
+
+esp_err_t sdi12_agg_push_values(sdi12_agg_handle_t agg, int64_t timestamp_us, const float *values)
+{
+    ESP_RETURN_ON_FALSE(agg && values, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+    ESP_RETURN_ON_FALSE(!agg->has_readings || timestamp_us >= agg->last_us, ESP_ERR_INVALID_ARG, TAG, "reading older than last one");
+
+    if (agg->window_open && agg->window_us != 0)
+    {
+        // Window may have started after an early close, so its end is taken from its period
+        int64_t end_us = agg->window_start_us - agg->window_start_us % agg->window_us + agg->window_us;
+
+        if (timestamp_us >= end_us)
+        {
+            close_window(agg, end_us);
+        }
+    }
+
+    if (!agg->window_open)
+    {
+        agg->window_open = true;
+
+        if (agg->window_us == 0)
+        {
+            agg->window_start_us = timestamp_us;
+        }
+        else if (agg->has_readings && agg->last_us - agg->last_us % agg->window_us == timestamp_us - timestamp_us % agg->window_us)
+        {
+            // Previous window of same period was closed early, by window_readings or flush
+            agg->window_start_us = agg->last_us;
+        }
+        else
+        {
+            agg->window_start_us = timestamp_us - timestamp_us % agg->window_us;
+        }
+    }
+
+    uint32_t changes = 0;
+    uint32_t suppressed = 0;
+
+    for (uint8_t i = 0; i < agg->channels; i++)
+    {
+        sdi12_agg_channel_t *channel = &agg->state[i];
+        float value = values[i];
+
+        // Welford's running mean and variance
+        ++channel->count;
+        float delta = value - channel->mean;
+        channel->mean += delta / channel->count;
+        channel->m2 += delta * (value - channel->mean);
+        channel->min = channel->count == 1 ? value : fminf(channel->min, value);
+        channel->max = channel->count == 1 ? value : fmaxf(channel->max, value);
+
+        if (agg->filters)
+        {
+            if (filter_change(agg, i, timestamp_us, value))
+            {
+                ++changes;
+            }
+            else
+            {
+                ++suppressed;
+            }
+        }
+    }
+
+    agg->has_readings = true;
+    agg->last_us = timestamp_us;
+
+    portENTER_CRITICAL(&agg->lock);
+    ++agg->stats.readings;
+    agg->stats.changes += changes;
+    agg->stats.suppressed += suppressed;
+    portEXIT_CRITICAL(&agg->lock);
+
+    if (agg->window_readings != 0 && ++agg->window_count >= agg->window_readings)
+    {
+        close_window(agg, timestamp_us);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_agg_push(sdi12_agg_handle_t agg, int64_t timestamp_us, const char *values)
+{
+    ESP_RETURN_ON_FALSE(agg && values, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    float parsed[SDI12_AGG_MAX_CHANNELS];
+    uint8_t count = 0;
+
+    while (*values != '\0')
+    {
+        ESP_RETURN_ON_FALSE(count < agg->channels, ESP_ERR_INVALID_SIZE, TAG, "more values than channels");
+
+        int64_t scaled;
+
+        values = sdi12_values_parse(values, SDI12_VALUES_MAX_DECIMALS, &scaled);
+        ESP_RETURN_ON_FALSE(values, ESP_ERR_INVALID_ARG, TAG, "malformed value %u", count);
+        parsed[count++] = (float)scaled / sdi12_values_pow10[SDI12_VALUES_MAX_DECIMALS];
+    }
+
+    ESP_RETURN_ON_FALSE(count == agg->channels, ESP_ERR_INVALID_SIZE, TAG, "%u values, %u channels", count, agg->channels);
+
+    return sdi12_agg_push_values(agg, timestamp_us, parsed);
+}
+
+esp_err_t sdi12_agg_flush(sdi12_agg_handle_t agg)
+{
+    ESP_RETURN_ON_FALSE(agg, ESP_ERR_INVALID_ARG, TAG, "agg is NULL");
+
+    if (agg->window_open)
+    {
+        close_window(agg, agg->last_us);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_agg_get_stats(sdi12_agg_handle_t agg, sdi12_agg_stats_t *out_stats)
+{
+    ESP_RETURN_ON_FALSE(agg && out_stats, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    portENTER_CRITICAL(&agg->lock);
+    *out_stats = agg->stats;
+    portEXIT_CRITICAL(&agg->lock);
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_del_agg(sdi12_agg_handle_t agg)
+{
+    ESP_RETURN_ON_FALSE(agg, ESP_ERR_INVALID_ARG, TAG, "agg is NULL");
+
+    free(agg->filters);
+    free(agg->state);
+    free(agg->window_stats);
+    free(agg);
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_new_agg(const sdi12_agg_config_t *config, sdi12_agg_handle_t *ret_agg)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(config && ret_agg, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+    ESP_RETURN_ON_FALSE(config->channels > 0 && config->channels <= SDI12_AGG_MAX_CHANNELS, ESP_ERR_INVALID_ARG, TAG, "invalid channels");
+
+    if (config->filters)
+    {
+        for (uint8_t i = 0; i < config->channels; i++)
+        {
+            ESP_RETURN_ON_FALSE(config->filters[i].deadband >= 0 && config->filters[i].cov_percent >= 0, ESP_ERR_INVALID_ARG, TAG,
+                "channel %u: negative filter threshold", i);
+        }
+    }
+
+    sdi12_agg_t *agg = calloc(1, sizeof(sdi12_agg_t));
+    ESP_RETURN_ON_FALSE(agg, ESP_ERR_NO_MEM, TAG, "can't allocate aggregator");
+
+    portMUX_INITIALIZE(&agg->lock);
+    agg->channels = config->channels;
+    agg->window_us = config->window_us;
+    agg->window_readings = config->window_readings;
+    agg->on_window = config->on_window;
+    agg->on_change = config->on_change;
+    agg->ctx = config->ctx;
+    agg->state = calloc(config->channels, sizeof(sdi12_agg_channel_t));
+    agg->window_stats = calloc(config->channels, sizeof(sdi12_agg_channel_stats_t));
+    ESP_GOTO_ON_FALSE(agg->state && agg->window_stats, ESP_ERR_NO_MEM, err, TAG, "can't allocate channels");
+
+    if (config->filters)
+    {
+        agg->filters = malloc(config->channels * sizeof(sdi12_agg_filter_t));
+        ESP_GOTO_ON_FALSE(agg->filters, ESP_ERR_NO_MEM, err, TAG, "can't allocate filters");
+        memcpy(agg->filters, config->filters, config->channels * sizeof(sdi12_agg_filter_t));
+    }
+
+    *ret_agg = agg;
+    return ESP_OK;
+
+err:
+    sdi12_del_agg(agg);
+    return ret;
+}
@@ -1,43 +1,48 @@
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <sys/param.h>
+#include <inttypes.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
-#include "freertos/queue.h"
 
 #include "esp_check.h"
 
-#include "driver/rmt_tx.h"
-#include "driver/rmt_rx.h"
-#include "driver/rmt_encoder.h"
-
-#include "driver/gpio.h"
-
 #include "esp_log.h"
 
 #include "sdi12_defs.h"
 #include "sdi12_bus.h"
+#include "sdi12_bus_priv.h"
+#include "sdi12_transport.h"
+#include "sdi12_crc.h"
+#include "sdi12_bus_queue.h"
+#include "sdi12_bus_health.h"
+#include "sdi12_trace_priv.h"
 
 typedef struct sdi12_bus
 {
-    uint8_t gpio_num;
     sdi12_bus_timing_t timing;
-    rmt_channel_handle_t rmt_tx_channel;
-    rmt_channel_handle_t rmt_rx_channel;
-    rmt_encoder_t *copy_encoder;
-    QueueHandle_t receive_queue;
-    SemaphoreHandle_t mutex;
+    sdi12_bus_timing_t address_timing[SDI12_HEALTH_ADDRESSES]; // Per address overrides. 0 fields use bus timing
+    sdi12_clock_t *clock;
+    sdi12_transport_t *transport;
+    sdi12_bus_queue_t queue;
+    uint16_t id;              // See sdi12_bus_get_id()
+    char last_address;        // Address of last sent cmd
+    int64_t last_activity_us; // Last response end on the wire. Used to know if last sensor is still awake
+    bool preempt_measurements;
+    portMUX_TYPE preempt_lock;
+    sdi12_bus_preempt_stats_t preempt_stats;
+    sdi12_bus_health_store_t health;
+    sdi12_bus_measurement_cb_t on_measurement;
+    void *on_measurement_ctx;
 } sdi12_bus_t;
 
-#define SDI12_BUS_LOCK(b)                                                                                                                                      \
-    if (b->mutex)                                                                                                                                              \
-    xSemaphoreTake(b->mutex, portMAX_DELAY)
+#define SDI12_BUS_LOCK(b, access)                                                                                                                              \
+    sdi12_bus_queue_acquire(&(b)->queue, (access) ? (access)->priority : 0, (access) ? (access)->deadline_ms : 0)
 
-#define SDI12_BUS_UNLOCK(b)                                                                                                                                    \
-    if (b->mutex)                                                                                                                                              \
-    xSemaphoreGive(b->mutex)
+#define SDI12_BUS_UNLOCK(b) sdi12_bus_queue_release(&(b)->queue)
 
 /**
  * Largest response, excluding response to extended commands, are receive from aDx! or aRx! commands
@@ -47,568 +52,880 @@ typedef struct sdi12_bus
  */
 #define SDI12_MAX_RESPONSE_CHARS (82)
 
-#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
-#define SDI12_RMT_CLK_SRC RMT_CLK_SRC_REF_TICK
-#else
-#define SDI12_RMT_CLK_SRC RMT_CLK_SRC_DEFAULT
-#endif
+/**
+ * Max times a single measurement can be preempted. After that, its service request wait can't be aborted, so a stream of urgent
+ * requests can't starve it.
+ */
+#define SDI12_MAX_PREEMPTIONS (3)
 
 static const char *TAG = "sdi12 bus";
 
+static esp_err_t check_cmd(const char *cmd)
+{
+    ESP_RETURN_ON_FALSE(cmd && cmd[0] != '\0', ESP_ERR_INVALID_ARG, TAG, "invalid command");
+
+    size_t cmd_len = strlen(cmd);
+
+    ESP_RETURN_ON_FALSE(((cmd[0] >= '0' && cmd[0] <= '9') || (cmd[0] >= 'a' && cmd[0] <= 'z') || (cmd[0] >= 'A' && cmd[0] <= 'Z') || cmd[0] == '?'),
+        ESP_ERR_INVALID_ARG, TAG, "Invalidad sensor address");
+
+    ESP_RETURN_ON_FALSE(cmd[cmd_len - 1] == '!', ESP_ERR_INVALID_ARG, TAG, "Invalid CMD terminator");
+
+    return ESP_OK;
+}
+
 /**
- * @brief Configure RMT channel as transmisor
+ * @brief Get measurement time from 'atttn', 'atttnn' or 'atttnnn' response
  *
- * @param bus         bus object
- * @return esp_err_t
- *      - ESP_FAIL RMT config install error
- *      - ESP_OK  configuration and installation OK
+ * @param response  response to aM!, aV! or aH! like cmds
+ * @return seconds to wait for service request
  */
-static esp_err_t config_rmt_as_tx(sdi12_bus_t *bus)
+static uint16_t service_request_seconds(const char *response)
 {
-    rmt_tx_channel_config_t tx_channel_config = {
-        .gpio_num = bus->gpio_num,        // GPIO number
-        .clk_src = SDI12_RMT_CLK_SRC,   // select source clock
-        .resolution_hz = 1 * 1000 * 1000, // 1MHz tick resolution, i.e. 1 tick = 1us
-        .mem_block_symbols = 64,          // memory block size, 64 * 4 = 256Bytes
-        .trans_queue_depth = 6,
-        .flags  = {
-            .io_loop_back = false,
-            .invert_out = false, // don't invert input signal
-            .with_dma = false,  // don't need DMA backend
-        }, 
-    };
+    uint16_t seconds = 0;
+    uint8_t factor = 100;
 
-    ESP_RETURN_ON_ERROR(rmt_new_tx_channel(&tx_channel_config, &bus->rmt_tx_channel), TAG, "create rmt tx channel error");
+    for (uint8_t i = 1; i < 4 && response[i] != '\0'; i++)
+    {
+        seconds += (response[i] - '0') * factor;
+        factor /= 10;
+    }
 
-    ESP_RETURN_ON_ERROR(rmt_enable(bus->rmt_tx_channel), TAG, "rmt tx enable error");
+    return seconds;
+}
 
-    return ESP_OK;
+int sdi12_bus_address_index(char address)
+{
+    if (address >= '0' && address <= '9')
+    {
+        return address - '0';
+    }
+
+    if (address >= 'a' && address <= 'z')
+    {
+        return 10 + address - 'a';
+    }
+
+    if (address >= 'A' && address <= 'Z')
+    {
+        return 36 + address - 'A';
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Break and marking of cmds to address
+ */
+static sdi12_bus_timing_t address_timing(const sdi12_bus_t *bus, char address)
+{
+    sdi12_bus_timing_t timing = bus->timing;
+    int index = sdi12_bus_address_index(address);
+
+    if (index >= 0)
+    {
+        const sdi12_bus_timing_t *custom = &bus->address_timing[index];
+
+        timing.break_us = custom->break_us != 0 ? custom->break_us : timing.break_us;
+        timing.post_break_marking_us = custom->post_break_marking_us != 0 ? custom->post_break_marking_us : timing.post_break_marking_us;
+    }
+
+    return timing;
 }
 
-static bool sdi12_rmt_receive_done_callback(rmt_channel_handle_t channel, const rmt_rx_done_event_data_t *data, void *user_data)
+/**
+ * @brief Tell measurement callback a sensor has accepted cmd
+ */
+static void notify_measurement(sdi12_bus_t *bus, const char *cmd, const char *response, size_t length)
 {
-    BaseType_t high_task_wakeup = pdFALSE;
-    QueueHandle_t receive_queue = (QueueHandle_t)user_data;
-    xQueueSendFromISR(receive_queue, data, &high_task_wakeup);
-    return high_task_wakeup == pdTRUE;
+    if (bus->on_measurement && response[0] == cmd[0] && length >= 5)
+    {
+        bus->on_measurement(cmd, response, bus->on_measurement_ctx);
+    }
 }
 
 /**
- * @brief Configure RMT channel as Receptor
+ * @brief Check response CRC and remove it
  *
- * @param bus         bus object
- * @return esp_err_t
- *      - ESP_FAIL RMT config install error
- *      - ESP_OK  configuration and installation OK
+ * @param length    response length. CRC is taken out of it on success
  */
-static esp_err_t config_rmt_as_rx(sdi12_bus_t *bus)
-{
-    rmt_rx_channel_config_t rx_channel_config = {
-        .gpio_num = bus->gpio_num,
-        .clk_src = SDI12_RMT_CLK_SRC,
-        .mem_block_symbols = 128,
-        .resolution_hz = 1 * 1000 * 1000, // 1MHz tick resolution, i.e. 1 tick = 1us
-        .flags = {
-            .io_loop_back = false,
-            .invert_in = false,
-            .with_dma = false,
-        },
-    };
-
-    // Workaround to enable PULLDOWN on pin. rmt_new_rx_channel enable by default pull up
-    // and there is no way to change it.
-    gpio_hold_en(bus->gpio_num);
-    ESP_RETURN_ON_ERROR(rmt_new_rx_channel(&rx_channel_config, &bus->rmt_rx_channel), TAG, "create rmt rx channel failed");
-    gpio_hold_dis(bus->gpio_num);
-    gpio_set_pull_mode(bus->gpio_num, GPIO_PULLDOWN_ONLY);
-
-    rmt_rx_event_callbacks_t cbs = {
-        .on_recv_done = sdi12_rmt_receive_done_callback,
-    };
-
-    ESP_RETURN_ON_ERROR(rmt_rx_register_event_callbacks(bus->rmt_rx_channel, &cbs, bus->receive_queue), TAG, "error registering rx callback");
-    ESP_RETURN_ON_ERROR(rmt_enable(bus->rmt_rx_channel), TAG, "error enabling rx channel");
+static esp_err_t strip_crc(const char *cmd, char *response, size_t *length)
+{
+    esp_err_t ret = sdi12_crc_check(response, *length);
 
-    return ESP_OK;
+    if (ret == ESP_ERR_INVALID_CRC)
+    {
+        SDI12_TRACE(SDI12_TRACE_CRC_ERROR, cmd[0], *length);
+    }
+
+    if (ret == ESP_OK)
+    {
+        *length -= 3;
+        response[*length] = '\0'; // Clear CRC string
+    }
+
+    return ret;
 }
 
-static esp_err_t set_idle_bus(sdi12_bus_t *bus)
+/**
+ * @brief Account finished transaction on health counters and remember which sensor is awake
+ */
+static void close_txn(sdi12_bus_t *bus, const char *cmd, esp_err_t ret, sdi12_bus_txn_t *txn)
 {
-    gpio_config_t gpio_conf = {
-        .intr_type = GPIO_INTR_DISABLE,
-        // also enable the input path is `io_loop_back` is on, this is useful for debug
-        .mode = GPIO_MODE_OUTPUT,
-        .pull_down_en = false,
-        .pull_up_en = false,
-        .pin_bit_mask = 1ULL << bus->gpio_num,
-    };
+    txn->ret = ret;
+    txn->end_us = bus->clock->now_us(bus->clock);
+    sdi12_bus_health_account(&bus->health, cmd[0], txn);
+
+    // Only a sensor which has answered is known to be awake. Its marking starts when its last char ends on the wire, not when line read
+    // returns: RMT one only does after SDI12_RX_IDLE_US of silence.
+    bus->last_address = ret == ESP_OK ? cmd[0] : '\0';
+    bus->last_activity_us = MAX(txn->timestamps.response_end_us, txn->timestamps.service_request_us);
+}
+
+/**
+ * @brief Send cmd and read first response line. Bus must be locked by caller.
+ *
+ * @param txn   cmd and response timestamps, bytes and errors are updated
+ */
+static esp_err_t send_and_read(sdi12_bus_t *bus, const char *cmd, bool send_break, char *out_buffer, size_t out_buffer_length, uint32_t timeout,
+    sdi12_bus_txn_t *txn)
+{
+    ESP_LOGD(TAG, "TX: %s", cmd);
+
+    sdi12_bus_timing_t timing = address_timing(bus, cmd[0]);
+
+    if (!send_break)
+    {
+        timing.break_us = 0;
+    }
+
+    sdi12_transport_stamp_t stamp;
+    esp_err_t ret = bus->transport->write_cmd(bus->transport, cmd, &timing, &stamp);
+
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "write error");
+        txn->write_error = true;
+        return ret;
+    }
+
+    txn->cmd_chars = strlen(cmd);
+    txn->tx_bytes += txn->cmd_chars;
+    txn->start_us = txn->start_us != 0 ? txn->start_us : stamp.start_us;
+    txn->timestamps.break_start_us = stamp.start_us;
+    txn->timestamps.cmd_end_us = stamp.end_us;
+    txn->timestamps.response_start_us = 0;
+    txn->timestamps.response_end_us = 0;
+    txn->responded = false;
+
+    ret = bus->transport->read_line(bus->transport, out_buffer, out_buffer_length, timeout, NULL, &stamp);
+    txn->line_done_us = bus->clock->now_us(bus->clock);
 
-    gpio_hold_dis(bus->gpio_num);
+    if (ret == ESP_OK)
+    {
+        txn->responded = true;
+        txn->response_length = bus->transport->rx_length;
+        txn->rx_bytes += txn->response_length + 2; // <CR><LF> included
+        txn->timestamps.response_start_us = stamp.start_us;
+        txn->timestamps.response_end_us = stamp.end_us;
+    }
+    else if (ret == ESP_ERR_TIMEOUT)
+    {
+        SDI12_TRACE(SDI12_TRACE_TIMEOUT, cmd[0], MIN(timeout != 0 ? timeout : SDI12_DEFAULT_RESPONSE_TIMEOUT, UINT16_MAX));
+    }
+    else if (ret == ESP_FAIL)
+    {
+        txn->rx_error = bus->transport->rx_error;
+    }
 
-    ESP_RETURN_ON_ERROR(gpio_config(&gpio_conf), TAG, "set idle bus error");
+    return ret;
+}
 
-    return gpio_set_level(bus->gpio_num, 0);
+static void account_preemption(sdi12_bus_t *bus, const char *cmd, uint32_t lost_us, uint32_t delay_us)
+{
+    portENTER_CRITICAL(&bus->preempt_lock);
+    ++bus->preempt_stats.preemptions;
+    bus->preempt_stats.total_lost_us += lost_us;
+    bus->preempt_stats.total_delay_us += delay_us;
+    bus->preempt_stats.last_lost_us = lost_us;
+    bus->preempt_stats.last_delay_us = delay_us;
+    portEXIT_CRITICAL(&bus->preempt_lock);
+
+    ESP_LOGW(TAG, "%s preempted: %" PRIu32 " us of measurement lost, result delayed %" PRIu32 " us", cmd, lost_us, delay_us);
 }
 
 /**
- * @brief Parse RMT symbols into char buffer. Stop when SDI12 response end (\r\n) is found
+ * @brief Wait for service request of an already accepted measurement. Bus must be locked by caller.
+ *
+ * @details If preemption is enabled, wait is aborted when a higher priority request arrives. Bus is handed to it and, as its break aborts
+ * the measurement, cmd is sent again once bus is given back. If urgent request is gone (i.e. its deadline expired) when bus is about to be
+ * handed over, nothing has been sent yet, so wait is resumed.
  *
- * @param bus         bus object
- * @param raw_symbols         received rmt symbols
- * @param symbols_length  received rmt symbols length
+ * @param bus                   bus object
+ * @param cmd                   measurement cmd
+ * @param out_buffer            buffer with 'atttn' response. Updated if cmd is restarted
+ * @param out_buffer_length     response buffer length
+ * @param timeout               time to wait for response on cmd restart
+ * @param txn                   service request timestamp and ttt are set. Cmd ones are updated if cmd is restarted
  * @return esp_err_t
- *      - ESP_ERR_INVALID_ARG bus or symbol are NULL or symbol_length <= 0
- *      - ESP_ERR_NOT_FOUND SDI12 end isn't found
- *      - ESP_OK SDI12 end is found and parse ok
  */
-static esp_err_t parse_response(sdi12_bus_t *bus, rmt_symbol_word_t *raw_symbols, size_t symbols_length, char *out_buffer, size_t out_buffer_length)
+static esp_err_t wait_service_request(sdi12_bus_t *bus, const char *cmd, char *out_buffer, size_t out_buffer_length, uint32_t timeout,
+    sdi12_bus_txn_t *txn)
 {
-    memset(out_buffer, '\0', out_buffer_length);
+    esp_err_t ret = ESP_OK;
+    uint8_t preemptions = 0;
+    int64_t measurement_start = bus->clock->now_us(bus->clock);
+    uint32_t wait_ms = service_request_seconds(out_buffer) * 1000;
 
-    size_t char_index = 0;
-    size_t symbol_index = 0;
-    bool level0 = 0; // False if level0, duration0 needed. True when level1, duration1
-    uint8_t bit_counter = 0;
-    uint8_t level;
-    uint8_t number_of_bits;
-    char c = 0;
-    bool parity = false;
+    txn->ttt_ms = wait_ms;
 
-    while (symbol_index < symbols_length)
+    // Only necessary if seconds is equal or greather than 1
+    while (wait_ms > 0)
     {
-        if (!level0)
+        char temp_buf[4] = { 0 };
+        bool preemptible = bus->preempt_measurements && preemptions < SDI12_MAX_PREEMPTIONS;
+
+        if (preemptible)
         {
-            level = raw_symbols[symbol_index].level0;
-            // (raw_symbols[index].duration0 + SDI12_BIT_WIDTH_US / 2) / SDI12_BIT_WIDTH_US -> Solve integer division round.
-            number_of_bits = (raw_symbols[symbol_index].duration0 + SDI12_BIT_WIDTH_US / 2) / SDI12_BIT_WIDTH_US;
+            sdi12_bus_queue_set_preemptible(&bus->queue, true);
         }
-        else
+
+        int64_t wait_start = bus->clock->now_us(bus->clock);
+        sdi12_transport_stamp_t stamp;
+        ret = bus->transport->read_line(bus->transport, temp_buf, sizeof(temp_buf), wait_ms, preemptible ? &bus->queue.preempt_requested : NULL, &stamp);
+
+        if (preemptible)
         {
-            level = raw_symbols[symbol_index].level1;
-            number_of_bits = (raw_symbols[symbol_index].duration1 + SDI12_BIT_WIDTH_US / 2) / SDI12_BIT_WIDTH_US;
-            ++symbol_index;
+            sdi12_bus_queue_set_preemptible(&bus->queue, false);
         }
 
-        level0 = !level0;
-
-        while (number_of_bits > 0 && number_of_bits < 10)
+        if (ret != ESP_ERR_INVALID_STATE)
         {
-            switch (bit_counter)
+            if (ret == ESP_OK && bus->transport->rx_length > 0)
+            {
+                ret = temp_buf[0] == cmd[0] ? ESP_OK : ESP_ERR_INVALID_RESPONSE;
+                txn->rx_bytes += bus->transport->rx_length + 2;
+                txn->timestamps.service_request_us = stamp.start_us;
+            }
+            else if (ret == ESP_ERR_TIMEOUT)
+            {
+                SDI12_TRACE(SDI12_TRACE_TIMEOUT, cmd[0], MIN(wait_ms, UINT16_MAX));
+                ret = ESP_ERR_NOT_FINISHED;
+            }
+            else if (ret == ESP_FAIL)
             {
-                // start bit
-                case 0:
-                    // We need to found start bit.
-                    if (level == 1)
-                    {
-                        ++bit_counter;
-                        parity = false;
-                        c = 0;
-                    }
-
-                    break;
-
-                // parity bit
-                case 8:
-                    if (parity != level)
-                    {
-                        ESP_LOGE(TAG, "Reception parity error");
-                        return ESP_FAIL;
-                    }
-
-                    if (char_index < out_buffer_length)
-                    {
-                        out_buffer[char_index] = c;
-
-                        if (out_buffer[char_index] == '\n' && out_buffer[char_index - 1] == '\r')
-                        {
-                            out_buffer[char_index - 1] = '\0'; // Delete \r\n from response buffer
-                            ESP_LOGD(TAG, "RX: %s", out_buffer);
-                            return ESP_OK;
-                        }
-
-                        ++char_index;
-                    }
-                    else
-                    {
-                        out_buffer[out_buffer_length - 1] = '\0';
-                        ESP_LOGE(TAG, "Out buffer too small");
-                        return ESP_ERR_INVALID_SIZE;
-                    }
-
-                    ++bit_counter;
-                    break;
-
-                // stop bit
-                case 9:
-                    if (level != 0)
-                    {
-                        ESP_LOGE(TAG, "Reception Stop bit error");
-                        return ESP_FAIL;
-                    }
-
-                    bit_counter = 0;
-                    break;
-
-                // data bits. Remember inverse logic
-                default:
-                    if (level == 0)
-                    {
-                        c |= (1 << (bit_counter - 1));
-                    }
-                    else
-                    {
-                        parity = !parity;
-                    }
-
-                    ++bit_counter;
-                    break;
+                txn->rx_error = bus->transport->rx_error;
             }
 
-            --number_of_bits;
+            return ret;
         }
+
+        int64_t preempt_start = bus->clock->now_us(bus->clock);
+
+        if (!sdi12_bus_queue_yield(&bus->queue))
+        {
+            uint32_t waited_ms = (preempt_start - wait_start) / 1000;
+            wait_ms = waited_ms < wait_ms ? wait_ms - waited_ms : 0;
+            ret = ESP_ERR_NOT_FINISHED; // In case remaining time is already over
+            continue;
+        }
+
+        txn->yielded_us += bus->clock->now_us(bus->clock) - preempt_start;
+        ++preemptions;
+        ++txn->retries;
+        SDI12_TRACE(SDI12_TRACE_RETRY, cmd[0], preemptions);
+
+        ret = send_and_read(bus, cmd, true, out_buffer, out_buffer_length, timeout, txn);
+
+        int64_t restart_us = bus->clock->now_us(bus->clock);
+        account_preemption(bus, cmd, preempt_start - measurement_start, restart_us - preempt_start);
+
+        if (ret != ESP_OK)
+        {
+            return ret;
+        }
+
+        notify_measurement(bus, cmd, out_buffer, txn->response_length);
+        measurement_start = restart_us;
+        wait_ms = service_request_seconds(out_buffer) * 1000;
+        txn->ttt_ms = wait_ms;
     }
 
-    return ESP_ERR_NOT_FOUND;
+    return ret;
 }
 
-static esp_err_t read_response_line(sdi12_bus_t *bus, char *out_buffer, size_t out_buffer_length, uint32_t timeout)
+/**
+ * @brief Send cmd and wait for response (and service request if needed). Bus must be locked by caller. Transaction is accounted on health
+ * counters.
+ *
+ * @param bus                   bus object
+ * @param cmd                   already checked cmd
+ * @param crc                   true to check (and remove) response CRC
+ * @param send_break            false to skip break. Only valid if addressed sensor is still awake.
+ * @param out_buffer            buffer to save response
+ * @param out_buffer_length     response buffer length
+ * @param timeout               time to wait for response
+ * @param out_result            response slice, CRC status and transaction timestamps. Events which didn't happen are left as 0
+ * @return esp_err_t
+ */
+static esp_err_t send_cmd_locked(sdi12_bus_t *bus, const char *cmd, bool crc, bool send_break, char *out_buffer, size_t out_buffer_length,
+    uint32_t timeout, sdi12_bus_result_t *out_result)
 {
-    ESP_RETURN_ON_FALSE(bus, ESP_ERR_INVALID_ARG, TAG, "bus is NULL");
+    sdi12_bus_txn_t txn = { 0 };
+    sdi12_bus_crc_status_t crc_status = SDI12_BUS_CRC_NOT_CHECKED;
 
-    esp_err_t ret;
+    esp_err_t ret = send_and_read(bus, cmd, send_break, out_buffer, out_buffer_length, timeout, &txn);
 
-    ret = config_rmt_as_rx(bus);
-    // ret = rmt_enable(bus->rmt_rx_channel);
-
-    if (ret != ESP_OK)
+    if (ret == ESP_OK)
     {
-        return ret;
+        if ((cmd[1] == 'D' || cmd[1] == 'R') && crc)
+        {
+            ret = strip_crc(cmd, out_buffer, &txn.response_length);
+            crc_status = ret == ESP_OK ? SDI12_BUS_CRC_VALID : SDI12_BUS_CRC_INVALID;
+        }
+        else if (cmd[1] == 'M' || cmd[1] == 'V' || cmd[1] == 'H')
+        {
+            // Command aM..! and aV..! require service request
+            // Response should be "atttn", "atttnn" or "atttnnn"
+            notify_measurement(bus, cmd, out_buffer, txn.response_length);
+            ret = wait_service_request(bus, cmd, out_buffer, out_buffer_length, timeout, &txn);
+        }
+        else if (cmd[1] == 'C')
+        {
+            notify_measurement(bus, cmd, out_buffer, txn.response_length);
+        }
     }
 
-    rmt_symbol_word_t raw_symbols[128];
-    rmt_rx_done_event_data_t rx_data;
-    uint32_t aux_timeout = timeout != 0 ? timeout : SDI12_DEFAULT_RESPONSE_TIMEOUT;
+    close_txn(bus, cmd, ret, &txn);
 
-    rmt_receive_config_t receive_config = {
-    
-    // Check @link https://github.com/espressif/esp-idf/issues/11262.
-    // Max range_min_ns value use rmt group resolution and must be a value allocatable in a 8-bit width reg.
-    // Group resolution is the same as RMT source clock
-// #if SDI12_RMT_CLK_SRC == RMT_CLK_SRC_REF_TICK
-//         // Group resolution = 1Mhz
-//         .signal_range_min_ns = 255 * 1000,
-// #else
-        // Group resolution = 80Mhz
-        .signal_range_min_ns = 3186,
-// #endif
-        .signal_range_max_ns = (SDI12_BREAK_US + 500) * 1000, // the longest duration for SDI12 signal is break signal
-    };
+    // A preempted measurement resent without response leaves no valid line in buffer
+    out_result->response = txn.responded ? out_buffer : NULL;
+    out_result->length = txn.responded ? txn.response_length : 0;
+    out_result->address = txn.responded && txn.response_length > 0 ? out_buffer[0] : '\0';
+    out_result->crc = crc_status;
+    out_result->timestamps = txn.timestamps;
 
-    ret = rmt_receive(bus->rmt_rx_channel, raw_symbols, sizeof(raw_symbols), &receive_config);
+    return ret;
+}
 
-    if (ret == ESP_OK)
+/**
+ * @brief Read lines following first one of a multi-line response. Each line is appended to out buffer after a '\n'. Bus must be locked by
+ * caller.
+ *
+ * @param lines     lines already in out buffer. Updated with appended ones
+ * @param txn       response end, bytes and errors are updated
+ */
+static esp_err_t read_more_lines(sdi12_bus_t *bus, const char *cmd, const sdi12_bus_lines_config_t *config, char *out_buffer,
+    size_t out_buffer_length, uint32_t timeout, uint8_t *lines, sdi12_bus_txn_t *txn)
+{
+    esp_err_t ret = ESP_OK;
+    uint32_t line_timeout = config->line_timeout_ms != 0 ? config->line_timeout_ms : timeout;
+    size_t length = txn->response_length;
+
+    while (config->max_lines == 0 || *lines < config->max_lines)
     {
-        if (xQueueReceive(bus->receive_queue, &rx_data, pdMS_TO_TICKS(aux_timeout)) == pdPASS)
+        // Receiver is kept armed while another line can follow this one
+        bus->transport->rx_keep = config->max_lines == 0 || *lines + 1 < config->max_lines;
+
+        // A full buffer still lets silence end the response. Only a line which doesn't fit is an error.
+        char spare;
+        bool full = length + 1 >= out_buffer_length;
+        char *line = full ? &spare : out_buffer + length + 1;
+        sdi12_transport_stamp_t stamp;
+
+        ret = bus->transport->read_line(bus->transport, line, full ? 1 : out_buffer_length - length - 1, line_timeout, NULL, &stamp);
+        txn->line_done_us = bus->clock->now_us(bus->clock);
+
+        if (ret == ESP_ERR_TIMEOUT)
         {
-            if (rx_data.num_symbols > 0)
-            {
-                // for (size_t i = 0; i < rx_data.num_symbols; i++)
-                // {
-                //     printf("Level: %d | Duration: %d \n", rx_data.received_symbols[i].level0, rx_data.received_symbols[i].duration0);
-                //     printf("Level: %d | Duration: %d \n", rx_data.received_symbols[i].level1, rx_data.received_symbols[i].duration1);
-                // }
+            // No more lines
+            ret = ESP_OK;
+            break;
+        }
 
-                ret = parse_response(bus, rx_data.received_symbols, rx_data.num_symbols, out_buffer, out_buffer_length);
-            }
+        if (ret == ESP_FAIL)
+        {
+            txn->rx_error = bus->transport->rx_error;
+        }
+
+        ret = ret == ESP_OK && full ? ESP_ERR_INVALID_SIZE : ret;
+
+        if (ret != ESP_OK)
+        {
+            break;
         }
-        else
+
+        size_t line_length = bus->transport->rx_length;
+
+        txn->rx_bytes += line_length + 2;
+        txn->timestamps.response_end_us = stamp.end_us;
+
+        if (config->crc)
         {
-            ESP_LOGD(TAG, "no rmt symbols received");
+            ret = strip_crc(cmd, line, &line_length);
 
-            ret = ESP_ERR_TIMEOUT;
+            if (ret != ESP_OK)
+            {
+                break;
+            }
         }
-    }
 
-    // Skip gpio reset on disable rmt_disable()
-    gpio_hold_en(bus->gpio_num);
-    rmt_disable(bus->rmt_rx_channel);
-    rmt_del_channel(bus->rmt_rx_channel);
-    set_idle_bus(bus);
+        out_buffer[length] = '\n';
+        length += 1 + line_length;
+        ++*lines;
+    }
 
     return ret;
 }
 
-static void encode_cmd(sdi12_bus_timing_t *timing, const char *cmd, rmt_symbol_word_t *rmt_symbols_out, size_t rmt_symbols_len)
+/**
+ * @brief Send cmd and collect its response lines (or wait its service request). Bus must be locked by caller. Transaction is accounted on
+ * health counters as a single one.
+ */
+static esp_err_t send_lines_locked(sdi12_bus_t *bus, const char *cmd, const sdi12_bus_lines_config_t *config, char *out_buffer,
+    size_t out_buffer_length, uint32_t timeout, uint8_t *out_lines, sdi12_bus_timestamps_t *timestamps)
 {
-    size_t rmt_symbol_index = 0;
-    // Break + marking
-    rmt_symbols_out[rmt_symbol_index].level0 = 1;
-    rmt_symbols_out[rmt_symbol_index].duration0 = timing->break_us;
-    rmt_symbols_out[rmt_symbol_index].level1 = SDI12_MARKING;
-    rmt_symbols_out[rmt_symbol_index].duration1 = timing->post_break_marking_us;
-    ++rmt_symbol_index;
+    sdi12_bus_txn_t txn = { 0 };
+    uint8_t lines = 0;
 
-    uint8_t char_index = 0;
-    size_t encode_len = rmt_symbols_len - 1; // Remove break + marking symbol
+    bus->transport->rx_keep = !config->service_request && config->max_lines != 1;
+    esp_err_t ret = send_and_read(bus, cmd, true, out_buffer, out_buffer_length, timeout, &txn);
 
-    while (encode_len > 0)
+    if (ret == ESP_OK && config->service_request)
+    {
+        ret = wait_service_request(bus, cmd, out_buffer, out_buffer_length, timeout, &txn);
+        lines = ret == ESP_OK ? 1 : 0;
+    }
+    else if (ret == ESP_OK)
     {
-        // start from last time truncated encoding
-        char cur_byte = cmd[char_index];
-        uint8_t bit_index = 0;
-        uint8_t level_to_write;
-        bool parity_bit = false;
+        ret = config->crc ? strip_crc(cmd, out_buffer, &txn.response_length) : ESP_OK;
 
-        while ((encode_len > 0) && (bit_index < 10))
+        if (ret == ESP_OK)
         {
-            switch (bit_index)
-            {
-                case 0: // start bit
-                    rmt_symbols_out[rmt_symbol_index].level0 = SDI12_SPACING;
-                    rmt_symbols_out[rmt_symbol_index].duration0 = SDI12_BIT_WIDTH_US;
-                    break;
-
-                case 8: // parity bit
-                    rmt_symbols_out[rmt_symbol_index].level0 = parity_bit;
-                    rmt_symbols_out[rmt_symbol_index].duration0 = SDI12_BIT_WIDTH_US;
-
-                    break;
-
-                case 9: // stop bit
-                    rmt_symbols_out[rmt_symbol_index].level1 = SDI12_MARKING;
-                    rmt_symbols_out[rmt_symbol_index].duration1 = SDI12_BIT_WIDTH_US;
-                    break;
-
-                default:                 // case 1 to 7, char bits
-
-                    if (cur_byte & 0x01) // bit == 1; Inverse -> 0 to write
-                    {
-                        level_to_write = SDI12_MARKING;
-                    }
-                    else // bit == 1; Inverse -> 1 to write
-                    {
-                        level_to_write = SDI12_SPACING;
-                        parity_bit = !parity_bit;
-                    }
-
-                    if (bit_index % 2 == 0)
-                    {
-                        rmt_symbols_out[rmt_symbol_index].level0 = level_to_write;
-                        rmt_symbols_out[rmt_symbol_index].duration0 = SDI12_BIT_WIDTH_US;
-                    }
-                    else
-                    {
-                        rmt_symbols_out[rmt_symbol_index].level1 = level_to_write;
-                        rmt_symbols_out[rmt_symbol_index].duration1 = SDI12_BIT_WIDTH_US;
-                    }
-
-                    cur_byte >>= 1;
-
-                    break;
-            }
-
-            ++bit_index;
-            if (bit_index % 2 == 0)
-            {
-                ++rmt_symbol_index;
-                --encode_len;
-            }
+            lines = 1;
+            ret = read_more_lines(bus, cmd, config, out_buffer, out_buffer_length, timeout, &lines, &txn);
         }
+    }
+
+    // Any receiver left armed is released by next write
+    bus->transport->rx_keep = false;
+
+    close_txn(bus, cmd, ret, &txn);
+    *timestamps = txn.timestamps;
 
-        ++char_index;
+    if (out_lines)
+    {
+        *out_lines = lines;
     }
+
+    return ret;
 }
 
-static esp_err_t write_cmd(sdi12_bus_t *bus, const char *cmd)
+esp_err_t sdi12_bus_transact(sdi12_bus_handle_t bus, const sdi12_bus_access_t *access, const char *cmd, bool crc, char *buffer, size_t buffer_length,
+    uint32_t timeout, sdi12_bus_result_t *out_result)
 {
-    ESP_RETURN_ON_ERROR(config_rmt_as_tx(bus), TAG, "error on tx config");
+    ESP_RETURN_ON_FALSE(out_result, ESP_ERR_INVALID_ARG, TAG, "no result");
 
-    // Initial Break & marking + chars. Every char need 10 bits transfers so it needs 5 rmt_symbol_word
-    size_t rmt_symbols_len = 1 + strlen(cmd) * 5;
-    rmt_symbol_word_t rmt_symbols[rmt_symbols_len];
+    memset(out_result, 0, sizeof(sdi12_bus_result_t));
 
-    encode_cmd(&bus->timing, cmd, rmt_symbols, rmt_symbols_len);
+    ESP_RETURN_ON_FALSE(bus, ESP_ERR_INVALID_ARG, TAG, "bus is NULL");
+    ESP_RETURN_ON_ERROR(check_cmd(cmd), TAG, "invalid command");
+    ESP_RETURN_ON_FALSE(buffer, ESP_ERR_INVALID_ARG, TAG, "no out buffer");
+    ESP_RETURN_ON_FALSE(buffer_length > 0, ESP_ERR_INVALID_ARG, TAG, "out buffer length error");
 
-    rmt_transmit_config_t tx_config = {
-        .loop_count = 0,
-        .flags.eot_level = 0,
-    };
+    ESP_RETURN_ON_ERROR(SDI12_BUS_LOCK(bus, access), TAG, "bus access deadline expired");
 
-    esp_err_t ret = rmt_transmit(bus->rmt_tx_channel, bus->copy_encoder, rmt_symbols, sizeof(rmt_symbol_word_t) * rmt_symbols_len, &tx_config);
+    esp_err_t ret = send_cmd_locked(bus, cmd, crc, true, buffer, buffer_length, timeout, out_result);
 
-    if (ret == ESP_OK)
+    // Bus is always master and must be in low state while no transmissions, so keep it as TX.
+    // config_rmt_as_tx(bus);
+    // ret = set_idle_bus(bus);
+    SDI12_BUS_UNLOCK(bus);
+
+    return ret;
+}
+
+esp_err_t sdi12_bus_send_cmd_timestamped(sdi12_bus_handle_t bus, const sdi12_bus_access_t *access, const char *cmd, bool crc, char *out_buffer,
+    size_t out_buffer_length, uint32_t timeout, sdi12_bus_timestamps_t *out_timestamps)
+{
+    sdi12_bus_result_t result;
+    esp_err_t ret = sdi12_bus_transact(bus, access, cmd, crc, out_buffer, out_buffer_length, timeout, &result);
+
+    if (out_timestamps)
     {
-        ret = rmt_tx_wait_all_done(bus->rmt_tx_channel, 1000);
+        *out_timestamps = result.timestamps;
+    }
+
+    return ret;
+}
 
-        gpio_hold_en(bus->gpio_num);
-        rmt_disable(bus->rmt_tx_channel);
-        rmt_del_channel(bus->rmt_tx_channel);
+esp_err_t sdi12_bus_send_cmd_lines(sdi12_bus_handle_t bus, const sdi12_bus_access_t *access, const char *cmd, const sdi12_bus_lines_config_t *config,
+    char *out_buffer, size_t out_buffer_length, uint32_t timeout, uint8_t *out_lines, sdi12_bus_timestamps_t *out_timestamps)
+{
+    ESP_RETURN_ON_FALSE(bus && config, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+    ESP_RETURN_ON_ERROR(check_cmd(cmd), TAG, "invalid command");
+    ESP_RETURN_ON_FALSE(out_buffer, ESP_ERR_INVALID_ARG, TAG, "no out buffer");
+    ESP_RETURN_ON_FALSE(out_buffer_length > 0, ESP_ERR_INVALID_ARG, TAG, "out buffer length error");
 
-        set_idle_bus(bus);
+    ESP_RETURN_ON_ERROR(SDI12_BUS_LOCK(bus, access), TAG, "bus access deadline expired");
+
+    sdi12_bus_timestamps_t timestamps;
+    esp_err_t ret = send_lines_locked(bus, cmd, config, out_buffer, out_buffer_length, timeout, out_lines, &timestamps);
+
+    SDI12_BUS_UNLOCK(bus);
 
-        // gpio_set_level(bus->gpio_num, 0);
+    if (out_timestamps)
+    {
+        *out_timestamps = timestamps;
     }
 
     return ret;
 }
 
-static esp_err_t sdi12_check_crc(const char *response)
+esp_err_t sdi12_bus_send_cmd_prio(sdi12_bus_handle_t bus, const sdi12_bus_access_t *access, const char *cmd, bool crc, char *out_buffer,
+    size_t out_buffer_length, uint32_t timeout)
+{
+    return sdi12_bus_send_cmd_timestamped(bus, access, cmd, crc, out_buffer, out_buffer_length, timeout, NULL);
+}
+
+esp_err_t sdi12_bus_send_cmd(sdi12_bus_handle_t bus, const char *cmd, bool crc, char *out_buffer, size_t out_buffer_length, uint32_t timeout)
 {
-    const uint8_t response_len = strlen(response);
+    return sdi12_bus_send_cmd_prio(bus, NULL, cmd, crc, out_buffer, out_buffer_length, timeout);
+}
 
-    if (response_len <= 3)
+esp_err_t sdi12_bus_get_preempt_stats(sdi12_bus_handle_t bus, sdi12_bus_preempt_stats_t *out_stats)
+{
+    ESP_RETURN_ON_FALSE(bus && out_stats, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    portENTER_CRITICAL(&bus->preempt_lock);
+    *out_stats = bus->preempt_stats;
+    portEXIT_CRITICAL(&bus->preempt_lock);
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_bus_get_health(sdi12_bus_handle_t bus, char address, sdi12_bus_health_t *out_health)
+{
+    ESP_RETURN_ON_FALSE(bus && out_health, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    esp_err_t ret = sdi12_bus_health_get(&bus->health, address, out_health);
+    ESP_RETURN_ON_FALSE(ret != ESP_ERR_INVALID_ARG, ret, TAG, "invalid address");
+
+    return ret;
+}
+
+esp_err_t sdi12_bus_reset_health(sdi12_bus_handle_t bus)
+{
+    ESP_RETURN_ON_FALSE(bus, ESP_ERR_INVALID_ARG, TAG, "bus is NULL");
+
+    sdi12_bus_health_reset(&bus->health);
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_bus_get_utilization(sdi12_bus_handle_t bus, sdi12_bus_utilization_t *out_utilization)
+{
+    ESP_RETURN_ON_FALSE(bus && out_utilization, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    sdi12_bus_health_get_utilization(&bus->health, out_utilization);
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Get measured health of address, falling back to whole bus if address has no responses yet
+ */
+static void estimate_health(sdi12_bus_t *bus, char address, sdi12_bus_health_t *out_health)
+{
+    if (sdi12_bus_health_get(&bus->health, address, out_health) != ESP_OK || out_health->response_latency_us.count == 0)
     {
-        return ESP_ERR_INVALID_ARG;
+        sdi12_bus_health_get(&bus->health, '\0', out_health);
     }
+}
+
+esp_err_t sdi12_bus_estimate_wire_time(sdi12_bus_handle_t bus, const sdi12_bus_wire_step_t *steps, size_t steps_length,
+    sdi12_bus_wire_time_t *out_wire_time)
+{
+    ESP_RETURN_ON_FALSE(bus && steps && steps_length > 0 && out_wire_time, ESP_ERR_INVALID_ARG, TAG, "invalid args");
 
-    uint16_t crc = 0;
-    char crc_str[4] = { 0 };
+    memset(out_wire_time, 0, sizeof(sdi12_bus_wire_time_t));
 
-    for (uint8_t i = 0; i < response_len - 3; ++i)
+    for (size_t i = 0; i < steps_length; i++)
     {
-        crc ^= (uint16_t)response[i];
+        const sdi12_bus_wire_step_t *step = &steps[i];
+        ESP_RETURN_ON_ERROR(check_cmd(step->cmd), TAG, "invalid command on step %u", (unsigned int)i);
+
+        sdi12_bus_health_t health;
+        estimate_health(bus, step->cmd[0], &health);
+
+        bool send_break = !(i > 0 && steps[i - 1].cmd[0] == step->cmd[0]);
+        uint32_t responses = health.response_latency_us.count;
+        sdi12_bus_timing_t timing = address_timing(bus, step->cmd[0]);
 
-        for (uint8_t j = 0; j < 8; ++j)
+        out_wire_time->break_us += (send_break ? timing.break_us : 0) + timing.post_break_marking_us;
+        out_wire_time->cmd_us += strlen(step->cmd) * SDI12_CHAR_US;
+        out_wire_time->turnaround_us += responses > 0 ? health.response_latency_us.sum / responses : SDI12_RESPONSE_START_MAX_US;
+        out_wire_time->response_us += (uint64_t)step->response_chars * SDI12_CHAR_US;
+        out_wire_time->idle_detect_us += responses > 0 ? health.wire_time.idle_detect_us / responses : bus->transport->rx_idle_us;
+
+        if (step->ttt_ms > 0)
         {
-            if (crc & 0x0001)
-            {
-                crc >>= 1;
-                crc ^= SDI12_CRC_POLY;
-            }
-            else
-            {
-                crc >>= 1;
-            }
+            // Sensors answering before ttt shorten the wait. Service request itself is 3 chars: 'a<CR><LF>'
+            uint32_t slack_ms = health.ttt_slack_ms.count > 0 ? health.ttt_slack_ms.sum / health.ttt_slack_ms.count : 0;
+            uint32_t wait_ms = step->ttt_ms > slack_ms ? step->ttt_ms - slack_ms : 0;
+            out_wire_time->ttt_wait_us += (uint64_t)wait_ms * 1000 + 3 * SDI12_CHAR_US + bus->transport->rx_idle_us;
         }
     }
 
-    crc_str[0] = (char)(0x0040 | (crc >> 12));
-    crc_str[1] = (char)(0x0040 | ((crc >> 6) & 0x003F));
-    crc_str[2] = (char)(0x0040 | (crc & 0x003F));
+    out_wire_time->busy_us = out_wire_time->break_us + out_wire_time->cmd_us + out_wire_time->turnaround_us + out_wire_time->response_us +
+        out_wire_time->idle_detect_us + out_wire_time->ttt_wait_us;
 
-    if (strncmp(crc_str, response + response_len - 3, 3) == 0)
+    return ESP_OK;
+}
+
+esp_err_t sdi12_bus_get_queue_stats(sdi12_bus_handle_t bus, sdi12_bus_queue_stats_t *out_stats)
+{
+    ESP_RETURN_ON_FALSE(bus && out_stats, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    sdi12_bus_queue_get_stats(&bus->queue, out_stats);
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Check step stop conditions on a successful response
+ *
+ * @param step      executed step
+ * @param response  step response, CRC already removed
+ * @return true if batch must stop
+ */
+static bool batch_stop_on_response(const sdi12_bus_batch_step_t *step, const char *response, size_t length)
+{
+    if ((step->stop_flags & SDI12_BUS_BATCH_STOP_ON_EMPTY) && length == 1)
     {
-        ESP_LOGD(TAG, "CRC: %s, Valid!", crc_str);
-        return ESP_OK;
+        // Only address is returned, i.e. aDx! without more values
+        return true;
     }
-    else
+
+    if ((step->stop_flags & SDI12_BUS_BATCH_STOP_ON_ZERO_VALUES) && length >= 5 && strtol(response + 4, NULL, 10) == 0)
     {
-        ESP_LOGD(TAG, "CRC: %s, Invalid!", crc_str);
-        return ESP_ERR_INVALID_CRC;
+        // 'atttn', 'atttnn' or 'atttnnn' with no values to collect
+        return true;
     }
+
+    return false;
 }
 
-esp_err_t sdi12_bus_send_cmd(sdi12_bus_handle_t bus, const char *cmd, bool crc, char *out_buffer, size_t out_buffer_length, uint32_t timeout)
+esp_err_t sdi12_bus_send_batch_prio(sdi12_bus_handle_t bus, const sdi12_bus_access_t *access, const sdi12_bus_batch_step_t *steps,
+    size_t steps_length, char *buffer, size_t buffer_length, sdi12_bus_batch_result_t *results, size_t *executed, uint32_t timeout)
 {
-    uint8_t cmd_len = strlen(cmd);
+    ESP_RETURN_ON_FALSE(bus && steps && steps_length > 0, ESP_ERR_INVALID_ARG, TAG, "invalid steps");
+    ESP_RETURN_ON_FALSE(buffer && buffer_length > 0, ESP_ERR_INVALID_ARG, TAG, "no out buffer");
+    ESP_RETURN_ON_FALSE(results, ESP_ERR_INVALID_ARG, TAG, "no results array");
 
-    ESP_RETURN_ON_FALSE(cmd, ESP_ERR_INVALID_ARG, TAG, "invalid command");
-    ESP_RETURN_ON_FALSE(out_buffer, ESP_ERR_INVALID_ARG, TAG, "no out buffer");
-    ESP_RETURN_ON_FALSE(out_buffer_length > 0, ESP_ERR_INVALID_ARG, TAG, "out buffer length error");
+    // Whole batch is checked before taking the bus, so a malformed step can't abort a half executed sequence.
+    for (size_t i = 0; i < steps_length; i++)
+    {
+        ESP_RETURN_ON_ERROR(check_cmd(steps[i].cmd), TAG, "invalid command on step %u", (unsigned int)i);
+        results[i].ret = ESP_ERR_INVALID_STATE;
+        results[i].response = NULL;
+        results[i].length = 0;
+        memset(&results[i].timestamps, 0, sizeof(sdi12_bus_timestamps_t));
+    }
 
-    ESP_RETURN_ON_FALSE(((cmd[0] >= '0' && cmd[0] <= '9') || (cmd[0] >= 'a' && cmd[0] <= 'z') || (cmd[0] >= 'A' && cmd[0] <= 'Z') || cmd[0] == '?'),
-        ESP_ERR_INVALID_ARG, TAG, "Invalidad sensor address");
+    esp_err_t ret = ESP_OK;
+    size_t offset = 0;
+    size_t step_index = 0;
 
-    ESP_RETURN_ON_FALSE(cmd[cmd_len - 1] == '!', ESP_ERR_INVALID_ARG, TAG, "Invalid CMD terminator");
-    ESP_LOGD(TAG, "TX: %s", cmd);
+    if (executed)
+    {
+        *executed = 0;
+    }
 
-    // each time RMT is installed/uninstalled INFO message is printed from GPIO component, so it is disabled during cmd time to clean up log messages
-    esp_log_level_set("gpio", ESP_LOG_WARN);
+    ESP_RETURN_ON_ERROR(SDI12_BUS_LOCK(bus, access), TAG, "bus access deadline expired");
 
-    SDI12_BUS_LOCK(bus);
+    for (; step_index < steps_length; step_index++)
+    {
+        const sdi12_bus_batch_step_t *step = &steps[step_index];
+        sdi12_bus_batch_result_t *result = &results[step_index];
 
-    esp_err_t ret = write_cmd(bus, cmd);
+        if (offset >= buffer_length)
+        {
+            result->ret = ESP_ERR_INVALID_SIZE;
+            ret = ESP_ERR_INVALID_SIZE;
+            ++step_index;
+            break;
+        }
 
-    if (ret == ESP_OK)
-    {
-        ret = read_response_line(bus, out_buffer, out_buffer_length, timeout);
-        // gpio_set_pull_mode(bus->gpio_num, GPIO_PULLDOWN_ONLY);
+        // Sensor is still awake if it was the last one talking and marking is short enough, so break can be skipped. Last one talking can be
+        // from a previous transaction, so back to back batches on same sensor (i.e. aR0! polling) skip it too.
+        bool send_break = !(bus->last_address == step->cmd[0] && bus->clock->now_us(bus->clock) - bus->last_activity_us < SDI12_BREAK_SKIP_US);
 
-        if (ret == ESP_OK)
+        sdi12_bus_result_t step_result;
+
+        result->response = buffer + offset;
+        result->ret = send_cmd_locked(bus, step->cmd, step->crc, send_break, result->response, buffer_length - offset, timeout, &step_result);
+        result->timestamps = step_result.timestamps;
+
+        if (result->ret == ESP_OK)
         {
-            if ((cmd[1] == 'D' || cmd[1] == 'R') && crc)
-            {
-                ret = sdi12_check_crc(out_buffer);
+            char address = step->address != '\0' ? step->address : step->cmd[0];
 
-                if (ret == ESP_OK)
-                {
-                    uint8_t response_len = strlen(out_buffer);
-                    out_buffer[response_len - 3] = '\0'; // Clear CRC string
-                }
+            if (address != '?' && result->response[0] != address)
+            {
+                result->ret = ESP_ERR_INVALID_RESPONSE;
             }
-            else if (cmd[1] == 'M' || cmd[1] == 'V' || cmd[1] == 'H')
+        }
+
+        if (result->ret != ESP_OK)
+        {
+            result->response = NULL; // Slice is reused by next step
+            ret = ret == ESP_OK ? result->ret : ret;
+
+            if (step->stop_flags & SDI12_BUS_BATCH_STOP_ON_ERROR)
             {
-                // Command aM..! and aV..! require service request
-                // Response should be "atttn", "atttnn" or "atttnnn"
-                uint16_t seconds = 0;
-                uint8_t factor = 100;
-
-                for (uint8_t i = 1; i < 4; i++)
-                {
-                    seconds += (out_buffer[i] - '0') * factor;
-                    factor /= 10;
-                }
-
-                // Only necessary if seconds is equal or greather than 1
-                if (seconds > 0)
-                {
-                    char temp_buf[4] = { 0 };
-
-                    ret = read_response_line(bus, temp_buf, sizeof(temp_buf), seconds * 1000);
-
-                    if (ret == ESP_OK && strlen(temp_buf) > 0)
-                    {
-                        ret = temp_buf[0] == cmd[0] ? ESP_OK : ESP_ERR_INVALID_RESPONSE;
-                    }
-                    else if (ret == ESP_ERR_TIMEOUT)
-                    {
-                        ret = ESP_ERR_NOT_FINISHED;
-                    }
-                }
+                ++step_index;
+                break;
             }
+
+            continue;
+        }
+
+        result->length = step_result.length;
+        offset += result->length + 1;
+
+        if (batch_stop_on_response(step, result->response, result->length))
+        {
+            ++step_index;
+            break;
         }
-    }
-    else
-    {
-        ESP_LOGE(TAG, "write error");
     }
 
-    // Bus is always master and must be in low state while no transmissions, so keep it as TX.
-    // config_rmt_as_tx(bus);
-    // ret = set_idle_bus(bus);
     SDI12_BUS_UNLOCK(bus);
 
-    esp_log_level_set("gpio", CONFIG_LOG_DEFAULT_LEVEL);
+    if (executed)
+    {
+        *executed = step_index;
+    }
 
     return ret;
 }
 
-esp_err_t sdi12_del_bus(sdi12_bus_handle_t bus)
+esp_err_t sdi12_bus_send_batch(sdi12_bus_handle_t bus, const sdi12_bus_batch_step_t *steps, size_t steps_length, char *buffer, size_t buffer_length,
+    sdi12_bus_batch_result_t *results, size_t *executed, uint32_t timeout)
 {
-    esp_err_t ret = ESP_FAIL;
+    return sdi12_bus_send_batch_prio(bus, NULL, steps, steps_length, buffer, buffer_length, results, executed, timeout);
+}
 
-    if (bus->rmt_tx_channel)
+esp_err_t sdi12_bus_set_address_timing(sdi12_bus_handle_t bus, char address, const sdi12_bus_timing_t *timing)
+{
+    ESP_RETURN_ON_FALSE(bus, ESP_ERR_INVALID_ARG, TAG, "bus is NULL");
+
+    int index = sdi12_bus_address_index(address);
+    ESP_RETURN_ON_FALSE(index >= 0, ESP_ERR_INVALID_ARG, TAG, "invalid address");
+
+    // Bus is locked, so a cmd never gets half updated timing
+    ESP_RETURN_ON_ERROR(sdi12_bus_queue_acquire(&bus->queue, 0, 0), TAG, "can't lock bus");
+
+    if (timing)
+    {
+        bus->address_timing[index] = *timing;
+    }
+    else
     {
-        rmt_del_channel(bus->rmt_tx_channel);
+        memset(&bus->address_timing[index], 0, sizeof(sdi12_bus_timing_t));
     }
 
-    if (bus->rmt_rx_channel)
+    SDI12_BUS_UNLOCK(bus);
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_bus_get_address_timing(sdi12_bus_handle_t bus, char address, sdi12_bus_timing_t *out_timing)
+{
+    ESP_RETURN_ON_FALSE(bus && out_timing, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+    ESP_RETURN_ON_FALSE(sdi12_bus_address_index(address) >= 0, ESP_ERR_INVALID_ARG, TAG, "invalid address");
+
+    *out_timing = address_timing(bus, address);
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_bus_set_measurement_callback(sdi12_bus_handle_t bus, sdi12_bus_measurement_cb_t cb, void *ctx)
+{
+    ESP_RETURN_ON_FALSE(bus, ESP_ERR_INVALID_ARG, TAG, "bus is NULL");
+
+    // Bus is locked, so callback isn't changed while a measurement is running
+    ESP_RETURN_ON_ERROR(sdi12_bus_queue_acquire(&bus->queue, 0, 0), TAG, "can't lock bus");
+    bus->on_measurement = cb;
+    bus->on_measurement_ctx = ctx;
+    SDI12_BUS_UNLOCK(bus);
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_bus_hold(sdi12_bus_handle_t bus, uint32_t duration_ms)
+{
+    ESP_RETURN_ON_FALSE(bus, ESP_ERR_INVALID_ARG, TAG, "bus is NULL");
+
+    ESP_RETURN_ON_ERROR(sdi12_bus_queue_acquire(&bus->queue, 0, 0), TAG, "can't lock bus");
+
+    int64_t until_us = bus->clock->now_us(bus->clock) + (int64_t)duration_ms * 1000;
+
+    while (bus->clock->now_us(bus->clock) < until_us)
     {
-        rmt_del_channel(bus->rmt_rx_channel);
+        bus->clock->sleep_until(bus->clock, until_us);
     }
 
-    if (bus->copy_encoder) { }
+    SDI12_BUS_UNLOCK(bus);
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Queue callback. A higher priority request is waiting, so pending service request wait is woken up to check its abort flag.
+ */
+static void bus_on_preempt(void *ctx)
+{
+    sdi12_bus_t *bus = (sdi12_bus_t *)ctx;
+
+    bus->transport->wake(bus->transport);
+}
+
+esp_err_t sdi12_del_bus(sdi12_bus_handle_t bus)
+{
+    esp_err_t ret = ESP_FAIL;
 
-    if (bus->mutex)
+    if (bus->transport)
     {
-        vSemaphoreDelete(bus->mutex);
+        ret = bus->transport->del(bus->transport);
     }
 
+    sdi12_bus_health_deinit(&bus->health);
     free(bus);
 
     return ret;
 }
 
+/**
+ * @brief Bus line identity: pin sensors answer on. Sim buses have no pin, their sim config address is used.
+ */
+static uint16_t bus_id(const sdi12_bus_config_t *config)
+{
+    if (config->transport == SDI12_BUS_TRANSPORT_SIM)
+    {
+        return 0x8000 | (uint16_t)(((uintptr_t)config->sim >> 2) & 0x7FFF);
+    }
+
+    // UART is dual pin only
+    return config->flags.dual_pin || config->transport == SDI12_BUS_TRANSPORT_UART ? config->dual_pin.rx_gpio_num : config->gpio_num;
+}
+
+uint16_t sdi12_bus_get_id(sdi12_bus_handle_t bus)
+{
+    return bus->id;
+}
+
 esp_err_t sdi12_new_bus(sdi12_bus_config_t *config, sdi12_bus_handle_t *sdi12_bus_out)
 {
 #if CONFIG_SDI12_ENABLE_DEBUG_LOG
@@ -618,37 +935,44 @@ esp_err_t sdi12_new_bus(sdi12_bus_config_t *config, sdi12_bus_handle_t *sdi12_bu
     esp_err_t ret = ESP_OK;
     ESP_RETURN_ON_FALSE(config, ESP_ERR_INVALID_ARG, TAG, "config is NULL");
 
-    // GPIO selected must be input and output capable.
-    // ESP_RETURN_ON_FALSE(GPIO_IS_VALID_DIGITAL_IO_PAD(config->gpio_num), ESP_ERR_INVALID_ARG, TAG, "Invalid GPIO pin");
-    ESP_RETURN_ON_FALSE(GPIO_IS_VALID_OUTPUT_GPIO(config->gpio_num), ESP_ERR_INVALID_ARG, TAG, "Invalid GPIO pin");
-
     sdi12_bus_t *bus = calloc(1, sizeof(sdi12_bus_t));
 
     ESP_RETURN_ON_FALSE(bus, ESP_ERR_NO_MEM, TAG, "can't allocate bus");
 
-    bus->gpio_num = config->gpio_num;
+    bus->id = bus_id(config);
+    bus->clock = config->clock ? config->clock : sdi12_clock_get_system();
     bus->timing.break_us = config->bus_timing.break_us != 0 ? config->bus_timing.break_us : SDI12_BREAK_US;
     bus->timing.post_break_marking_us = config->bus_timing.post_break_marking_us != 0 ? config->bus_timing.post_break_marking_us : SDI12_POST_BREAK_MARKING_US;
 
-    rmt_copy_encoder_config_t copy_encoder_config = {};
-    ESP_GOTO_ON_ERROR(rmt_new_copy_encoder(&copy_encoder_config, &bus->copy_encoder), err_encoder, TAG, "can't allocate copy encoder");
-    bus->mutex = xSemaphoreCreateMutex();
-
-    ESP_GOTO_ON_FALSE(bus->mutex, ESP_ERR_NO_MEM, err_mutex, TAG, "can't allocate bus mutex");
+    switch (config->transport)
+    {
+#if !CONFIG_IDF_TARGET_LINUX
+        case SDI12_BUS_TRANSPORT_RMT:
+            ret = sdi12_new_rmt_transport(config, &bus->transport);
+            break;
+        case SDI12_BUS_TRANSPORT_UART:
+            ret = sdi12_new_uart_transport(config, &bus->transport);
+            break;
+#endif
+        case SDI12_BUS_TRANSPORT_SIM:
+            ret = sdi12_new_sim_transport(config, bus->clock, &bus->transport);
+            break;
+        default:
+            ret = ESP_ERR_INVALID_ARG;
+            break;
+    }
 
-    bus->receive_queue = xQueueCreate(1, sizeof(rmt_rx_done_event_data_t));
-    ESP_GOTO_ON_FALSE(bus->receive_queue, ESP_ERR_NO_MEM, err_queue, TAG, "can't allocate receive queue");
+    ESP_GOTO_ON_ERROR(ret, err_transport, TAG, "can't create bus transport");
 
-    set_idle_bus(bus);
+    bus->preempt_measurements = config->flags.preempt_measurements;
+    portMUX_INITIALIZE(&bus->preempt_lock);
+    sdi12_bus_queue_init(&bus->queue, bus->clock, bus_on_preempt, bus);
+    sdi12_bus_health_init(&bus->health, bus->clock);
 
     *sdi12_bus_out = bus;
     return ret;
 
-err_queue:
-    vSemaphoreDelete(bus->mutex);
-err_mutex:
-    rmt_del_encoder(bus->copy_encoder);
-err_encoder:
+err_transport:
     free(bus);
     return ret;
 }
@@ -0,0 +1,335 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "sdi12_defs.h"
+#include "sdi12_bus_health.h"
+#include "sdi12_bus_priv.h"
+
+#define SDI12_HEALTH_SECOND_US (1000000LL)
+#define SDI12_HEALTH_MINUTE_US (60 * SDI12_HEALTH_SECOND_US)
+
+static void histogram_add(sdi12_bus_histogram_t *histogram, uint32_t value)
+{
+    // Bucket is bit length of value: 0 -> 0, 1 -> 1, 2..3 -> 2, 4..7 -> 3...
+    uint32_t bucket = value == 0 ? 0 : 32 - __builtin_clz(value);
+
+    if (bucket >= SDI12_BUS_HISTOGRAM_BUCKETS)
+    {
+        bucket = SDI12_BUS_HISTOGRAM_BUCKETS - 1;
+    }
+
+    ++histogram->buckets[bucket];
+    ++histogram->count;
+    histogram->sum += value;
+
+    if (value > histogram->max)
+    {
+        histogram->max = value;
+    }
+}
+
+static uint64_t span_us(int64_t from, int64_t to)
+{
+    return from != 0 && to > from ? (uint64_t)(to - from) : 0;
+}
+
+/**
+ * @brief Split transaction bus time by category. Categories come from last cmd attempt, anything else goes to other_us.
+ */
+static void txn_wire_time(const sdi12_bus_txn_t *txn, sdi12_bus_wire_time_t *out)
+{
+    const sdi12_bus_timestamps_t *ts = &txn->timestamps;
+
+    memset(out, 0, sizeof(sdi12_bus_wire_time_t));
+
+    uint64_t busy_us = span_us(txn->start_us, txn->end_us);
+    out->busy_us = busy_us > txn->yielded_us ? busy_us - txn->yielded_us : 0;
+
+    if (ts->cmd_end_us != 0)
+    {
+        out->cmd_us = (uint64_t)txn->cmd_chars * SDI12_CHAR_US;
+        uint64_t frame_us = span_us(ts->break_start_us, ts->cmd_end_us);
+        out->break_us = frame_us > out->cmd_us ? frame_us - out->cmd_us : 0;
+    }
+
+    if (ts->response_start_us != 0)
+    {
+        out->turnaround_us = span_us(ts->cmd_end_us, ts->response_start_us);
+        out->response_us = span_us(ts->response_start_us, ts->response_end_us);
+        out->idle_detect_us = span_us(ts->response_end_us, txn->line_done_us);
+    }
+    else
+    {
+        out->turnaround_us = span_us(ts->cmd_end_us, txn->line_done_us);
+    }
+
+    if (txn->ttt_ms > 0)
+    {
+        out->ttt_wait_us = span_us(txn->line_done_us, txn->end_us);
+    }
+
+    uint64_t categorized = out->break_us + out->cmd_us + out->turnaround_us + out->response_us + out->idle_detect_us + out->ttt_wait_us;
+    out->other_us = out->busy_us > categorized ? out->busy_us - categorized : 0;
+}
+
+static void wire_time_add(sdi12_bus_wire_time_t *total, const sdi12_bus_wire_time_t *wire_time)
+{
+    total->busy_us += wire_time->busy_us;
+    total->break_us += wire_time->break_us;
+    total->cmd_us += wire_time->cmd_us;
+    total->turnaround_us += wire_time->turnaround_us;
+    total->response_us += wire_time->response_us;
+    total->idle_detect_us += wire_time->idle_detect_us;
+    total->ttt_wait_us += wire_time->ttt_wait_us;
+    total->other_us += wire_time->other_us;
+}
+
+/**
+ * @brief Add busy interval to ring buckets. Must be called inside critical section.
+ */
+static void usage_add(sdi12_bus_usage_ring_t *ring, int64_t bucket_us, int64_t start_us, int64_t end_us)
+{
+    // Older part would be overwritten anyway
+    int64_t from = MAX(start_us, end_us - SDI12_HEALTH_USAGE_BUCKETS * bucket_us);
+
+    while (from < end_us)
+    {
+        int64_t index = from / bucket_us;
+        int64_t to = MIN(end_us, (index + 1) * bucket_us);
+        size_t slot = index % SDI12_HEALTH_USAGE_BUCKETS;
+
+        if (ring->index[slot] != index)
+        {
+            ring->index[slot] = index;
+            ring->busy_us[slot] = 0;
+        }
+
+        ring->busy_us[slot] += to - from;
+        from = to;
+    }
+}
+
+/**
+ * @brief Busy share of last buckets, current one included. Must be called inside critical section.
+ */
+static uint16_t usage_permille(const sdi12_bus_usage_ring_t *ring, int64_t bucket_us, size_t buckets, int64_t now_us, int64_t since_us)
+{
+    int64_t now_index = now_us / bucket_us;
+    uint64_t busy_us = 0;
+
+    for (size_t i = 0; i < buckets && now_index >= (int64_t)i; i++)
+    {
+        int64_t index = now_index - i;
+        size_t slot = index % SDI12_HEALTH_USAGE_BUCKETS;
+
+        if (ring->index[slot] == index)
+        {
+            busy_us += ring->busy_us[slot];
+        }
+    }
+
+    int64_t window_start = MAX((now_index - (int64_t)buckets + 1) * bucket_us, since_us);
+    uint64_t window_us = span_us(window_start, now_us);
+
+    if (window_us == 0)
+    {
+        return 0;
+    }
+
+    return (uint16_t)MIN(busy_us * 1000 / window_us, 1000);
+}
+
+/**
+ * @brief Account transaction on a record. Must be called inside critical section.
+ */
+static void health_add(sdi12_bus_health_t *health, const sdi12_bus_txn_t *txn, const sdi12_bus_wire_time_t *wire_time)
+{
+    wire_time_add(&health->wire_time, wire_time);
+
+    ++health->commands;
+    health->retries += txn->retries;
+    health->tx_bytes += txn->tx_bytes;
+    health->rx_bytes += txn->rx_bytes;
+
+    switch (txn->ret)
+    {
+        case ESP_OK:
+            ++health->successes;
+            break;
+        case ESP_ERR_TIMEOUT:
+            ++health->timeouts;
+            break;
+        case ESP_ERR_NOT_FINISHED:
+            ++health->no_service_requests;
+            break;
+        case ESP_ERR_INVALID_SIZE:
+            ++health->buffer_too_small;
+            break;
+        case ESP_ERR_INVALID_RESPONSE:
+            ++health->invalid_responses;
+            break;
+        case ESP_ERR_INVALID_CRC:
+            ++health->crc_errors;
+            break;
+        default:
+            if (txn->write_error)
+            {
+                ++health->write_errors;
+            }
+            else if (txn->rx_error == SDI12_TRANSPORT_RX_ERROR_PARITY)
+            {
+                ++health->parity_errors;
+            }
+            else if (txn->rx_error == SDI12_TRANSPORT_RX_ERROR_STOP_BIT)
+            {
+                ++health->stop_bit_errors;
+            }
+            else
+            {
+                ++health->other_errors;
+            }
+            break;
+    }
+
+    const sdi12_bus_timestamps_t *ts = &txn->timestamps;
+
+    if (ts->cmd_end_us != 0 && ts->response_start_us >= ts->cmd_end_us)
+    {
+        int64_t latency_us = ts->response_start_us - ts->cmd_end_us;
+        histogram_add(&health->response_latency_us, latency_us < UINT32_MAX ? (uint32_t)latency_us : UINT32_MAX);
+    }
+
+    if (ts->service_request_us != 0 && ts->response_end_us != 0)
+    {
+        // Early service request gives positive slack. A late one (within read margin) is accounted as 0.
+        int64_t delay_ms = (ts->service_request_us - ts->response_end_us) / 1000;
+        histogram_add(&health->ttt_slack_ms, delay_ms < txn->ttt_ms ? (uint32_t)(txn->ttt_ms - delay_ms) : 0);
+    }
+}
+
+void sdi12_bus_health_init(sdi12_bus_health_store_t *store, sdi12_clock_t *clock)
+{
+    memset(store, 0, sizeof(sdi12_bus_health_store_t));
+    portMUX_INITIALIZE(&store->lock);
+    store->clock = clock;
+    store->created_us = clock->now_us(clock);
+
+    for (size_t i = 0; i < SDI12_HEALTH_USAGE_BUCKETS; i++)
+    {
+        store->seconds.index[i] = -1;
+        store->minutes.index[i] = -1;
+    }
+}
+
+void sdi12_bus_health_deinit(sdi12_bus_health_store_t *store)
+{
+    for (size_t i = 0; i < SDI12_HEALTH_ADDRESSES; i++)
+    {
+        free(store->addresses[i]);
+        store->addresses[i] = NULL;
+    }
+}
+
+void sdi12_bus_health_account(sdi12_bus_health_store_t *store, char address, const sdi12_bus_txn_t *txn)
+{
+    int index = sdi12_bus_address_index(address);
+    sdi12_bus_health_t *record = NULL;
+
+    if (index >= 0)
+    {
+        record = store->addresses[index];
+
+        if (!record)
+        {
+            // Only bus owner adds records, so allocation can be done out of critical section. On no memory only bus total is accounted.
+            record = calloc(1, sizeof(sdi12_bus_health_t));
+        }
+    }
+
+    sdi12_bus_wire_time_t wire_time;
+    txn_wire_time(txn, &wire_time);
+
+    // Yielded time is accounted by preempting transactions, so busy interval is shortened to avoid counting it twice
+    int64_t busy_start_us = txn->end_us - (int64_t)wire_time.busy_us;
+
+    portENTER_CRITICAL(&store->lock);
+
+    health_add(&store->total, txn, &wire_time);
+
+    if (record)
+    {
+        store->addresses[index] = record;
+        health_add(record, txn, &wire_time);
+    }
+
+    if (wire_time.busy_us > 0)
+    {
+        usage_add(&store->seconds, SDI12_HEALTH_SECOND_US, busy_start_us, txn->end_us);
+        usage_add(&store->minutes, SDI12_HEALTH_MINUTE_US, busy_start_us, txn->end_us);
+    }
+
+    portEXIT_CRITICAL(&store->lock);
+}
+
+esp_err_t sdi12_bus_health_get(sdi12_bus_health_store_t *store, char address, sdi12_bus_health_t *out_health)
+{
+    if (address == '\0')
+    {
+        portENTER_CRITICAL(&store->lock);
+        *out_health = store->total;
+        portEXIT_CRITICAL(&store->lock);
+        return ESP_OK;
+    }
+
+    int index = sdi12_bus_address_index(address);
+
+    if (index < 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    portENTER_CRITICAL(&store->lock);
+
+    if (store->addresses[index])
+    {
+        *out_health = *store->addresses[index];
+        ret = ESP_OK;
+    }
+
+    portEXIT_CRITICAL(&store->lock);
+
+    return ret;
+}
+
+void sdi12_bus_health_reset(sdi12_bus_health_store_t *store)
+{
+    portENTER_CRITICAL(&store->lock);
+
+    memset(&store->total, 0, sizeof(sdi12_bus_health_t));
+
+    for (size_t i = 0; i < SDI12_HEALTH_ADDRESSES; i++)
+    {
+        if (store->addresses[i])
+        {
+            memset(store->addresses[i], 0, sizeof(sdi12_bus_health_t));
+        }
+    }
+
+    portEXIT_CRITICAL(&store->lock);
+}
+
+void sdi12_bus_health_get_utilization(sdi12_bus_health_store_t *store, sdi12_bus_utilization_t *out_utilization)
+{
+    int64_t now_us = store->clock->now_us(store->clock);
+
+    portENTER_CRITICAL(&store->lock);
+    out_utilization->last_10s_permille = usage_permille(&store->seconds, SDI12_HEALTH_SECOND_US, 10, now_us, store->created_us);
+    out_utilization->last_minute_permille = usage_permille(&store->seconds, SDI12_HEALTH_SECOND_US, 60, now_us, store->created_us);
+    out_utilization->last_hour_permille = usage_permille(&store->minutes, SDI12_HEALTH_MINUTE_US, 60, now_us, store->created_us);
+    portEXIT_CRITICAL(&store->lock);
+}
@@ -0,0 +1,415 @@
+#include <string.h>
+#include <sys/param.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "sdi12_bus_queue.h"
+
+void sdi12_bus_queue_init(sdi12_bus_queue_t *queue, sdi12_clock_t *clock, void (*on_preempt)(void *ctx), void *ctx)
+{
+    memset(queue, 0, sizeof(sdi12_bus_queue_t));
+    portMUX_INITIALIZE(&queue->spinlock);
+    queue->clock = clock;
+    queue->on_preempt = on_preempt;
+    queue->on_preempt_ctx = ctx;
+
+    // Static mutex, no heap involved. It can't fail with a valid buffer.
+    queue->boost_lock = xSemaphoreCreateMutexStatic(&queue->boost_lock_buffer);
+}
+
+/**
+ * @brief Check if owner must be preempted. Must be called inside critical section.
+ *
+ * @return true if preemption has just been requested, so on_preempt must be called.
+ */
+static bool check_preemption(sdi12_bus_queue_t *queue)
+{
+    if (queue->preemptible && !queue->preempt_requested && queue->waiters && queue->waiters->priority > queue->owner_priority)
+    {
+        queue->preempt_requested = true;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Account granted request wait time. Must be called inside critical section.
+ */
+static void account_grant(sdi12_bus_queue_t *queue, int64_t enqueue_us)
+{
+    uint32_t wait_us = (uint32_t)(queue->clock->now_us(queue->clock) - enqueue_us);
+
+    ++queue->stats.granted;
+    queue->stats.total_wait_us += wait_us;
+
+    if (wait_us > queue->stats.max_wait_us)
+    {
+        queue->stats.max_wait_us = wait_us;
+    }
+}
+
+static void insert_waiter(sdi12_bus_queue_t *queue, sdi12_bus_waiter_t *waiter)
+{
+    sdi12_bus_waiter_t **it = &queue->waiters;
+
+    // Same priority waiters are kept in arrival order
+    while (*it && (*it)->priority >= waiter->priority)
+    {
+        it = &(*it)->next;
+    }
+
+    waiter->next = *it;
+    *it = waiter;
+
+    ++queue->stats.depth;
+
+    if (queue->stats.depth > queue->stats.max_depth)
+    {
+        queue->stats.max_depth = queue->stats.depth;
+    }
+}
+
+static void insert_waiter_first(sdi12_bus_queue_t *queue, sdi12_bus_waiter_t *waiter)
+{
+    sdi12_bus_waiter_t **it = &queue->waiters;
+
+    // Ahead of any other waiter with same priority
+    while (*it && (*it)->priority > waiter->priority)
+    {
+        it = &(*it)->next;
+    }
+
+    waiter->next = *it;
+    *it = waiter;
+
+    ++queue->stats.depth;
+
+    if (queue->stats.depth > queue->stats.max_depth)
+    {
+        queue->stats.max_depth = queue->stats.depth;
+    }
+}
+
+static bool remove_waiter(sdi12_bus_queue_t *queue, sdi12_bus_waiter_t *waiter)
+{
+    for (sdi12_bus_waiter_t **it = &queue->waiters; *it; it = &(*it)->next)
+    {
+        if (*it == waiter)
+        {
+            *it = waiter->next;
+            --queue->stats.depth;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Take bus if it is free. Must be called inside critical section.
+ */
+static bool try_take(sdi12_bus_queue_t *queue, uint8_t priority, TaskHandle_t task, UBaseType_t task_priority)
+{
+    if (queue->busy)
+    {
+        return false;
+    }
+
+    // Waiters only exist while bus is busy, so free bus can be taken right away
+    queue->busy = true;
+    queue->owner_priority = priority;
+    queue->owner_task = task;
+    queue->owner_task_priority = task_priority;
+    queue->owner_boost = 0;
+    ++queue->stats.granted;
+
+    return true;
+}
+
+/**
+ * @brief Hand bus to next waiter. Must be called inside critical section.
+ */
+static void hand_over(sdi12_bus_queue_t *queue, sdi12_bus_waiter_t *next)
+{
+    // Bus isn't freed, ownership is handed directly to next waiter so no one can barge in.
+    queue->waiters = next->next;
+    --queue->stats.depth;
+    next->granted = true;
+    queue->owner_priority = next->priority;
+    queue->owner_task = next->task;
+    queue->owner_task_priority = next->task_priority;
+    queue->owner_boost = 0;
+    account_grant(queue, next->enqueue_us);
+}
+
+/**
+ * @brief Check if owner must be raised to highest waiter task priority. Must be called inside critical section.
+ *
+ * @param[out] out_priority     priority to set
+ * @return owner task to raise. NULL if none
+ */
+static TaskHandle_t boost_target(sdi12_bus_queue_t *queue, UBaseType_t *out_priority)
+{
+    UBaseType_t top = 0;
+
+    for (sdi12_bus_waiter_t *it = queue->waiters; it; it = it->next)
+    {
+        top = MAX(top, it->task_priority);
+    }
+
+    if (!queue->busy || top <= MAX(queue->owner_task_priority, queue->owner_boost))
+    {
+        return NULL;
+    }
+
+    queue->owner_boost = top;
+    *out_priority = top;
+
+    return queue->owner_task;
+}
+
+/**
+ * @brief Raise bus owner to waiters task priority, if higher. Called by a waiter right after it is queued.
+ */
+static void boost_owner(sdi12_bus_queue_t *queue)
+{
+    UBaseType_t priority = 0;
+
+    xSemaphoreTake(queue->boost_lock, portMAX_DELAY);
+
+    portENTER_CRITICAL(&queue->spinlock);
+    TaskHandle_t task = boost_target(queue, &priority);
+    portEXIT_CRITICAL(&queue->spinlock);
+
+    if (task)
+    {
+        vTaskPrioritySet(task, priority);
+    }
+
+    xSemaphoreGive(queue->boost_lock);
+}
+
+esp_err_t sdi12_bus_queue_acquire(sdi12_bus_queue_t *queue, uint8_t priority, uint32_t deadline_ms)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    UBaseType_t task_priority = uxTaskPriorityGet(NULL);
+
+    portENTER_CRITICAL(&queue->spinlock);
+    bool taken = try_take(queue, priority, task, task_priority);
+    portEXIT_CRITICAL(&queue->spinlock);
+
+    if (taken)
+    {
+        return ESP_OK;
+    }
+
+    sdi12_bus_waiter_t waiter = {
+        .priority = priority,
+        .task = task,
+        .task_priority = task_priority,
+        .granted = false,
+    };
+
+    // Static semaphore, no heap involved. It can't fail with a valid buffer. Created out of critical section, it is a FreeRTOS call.
+    waiter.granted_sem = xSemaphoreCreateBinaryStatic(&waiter.granted_sem_buffer);
+
+    portENTER_CRITICAL(&queue->spinlock);
+
+    if (try_take(queue, priority, task, task_priority))
+    {
+        // Bus was released meanwhile
+        portEXIT_CRITICAL(&queue->spinlock);
+        vSemaphoreDelete(waiter.granted_sem);
+        return ESP_OK;
+    }
+
+    waiter.seq = queue->next_seq++;
+    waiter.enqueue_us = queue->clock->now_us(queue->clock);
+    insert_waiter(queue, &waiter);
+    bool preempt = check_preemption(queue);
+
+    portEXIT_CRITICAL(&queue->spinlock);
+
+    if (preempt && queue->on_preempt)
+    {
+        queue->on_preempt(queue->on_preempt_ctx);
+    }
+
+    boost_owner(queue);
+
+    esp_err_t ret = ESP_OK;
+    TickType_t wait_ticks = deadline_ms != 0 ? pdMS_TO_TICKS(deadline_ms) : portMAX_DELAY;
+
+    if (xSemaphoreTake(waiter.granted_sem, wait_ticks) != pdTRUE)
+    {
+        portENTER_CRITICAL(&queue->spinlock);
+
+        bool granted = waiter.granted;
+
+        if (!granted)
+        {
+            remove_waiter(queue, &waiter);
+            ++queue->stats.expired;
+            ret = ESP_ERR_TIMEOUT;
+        }
+
+        portEXIT_CRITICAL(&queue->spinlock);
+
+        if (granted)
+        {
+            // Bus was granted between timeout and critical section, so request is served anyway.
+            // Wait for releaser to give the semaphore before it goes out of scope.
+            xSemaphoreTake(waiter.granted_sem, portMAX_DELAY);
+        }
+    }
+
+    vSemaphoreDelete(waiter.granted_sem);
+
+    return ret;
+}
+
+void sdi12_bus_queue_release(sdi12_bus_queue_t *queue)
+{
+    portENTER_CRITICAL(&queue->spinlock);
+
+    bool released = !queue->waiters && queue->owner_boost == 0;
+
+    if (released)
+    {
+        // A waiter is queued before it raises owner, so nobody can be raising it now
+        queue->busy = false;
+        queue->owner_task = NULL;
+    }
+
+    portEXIT_CRITICAL(&queue->spinlock);
+
+    if (released)
+    {
+        return;
+    }
+
+    UBaseType_t boost = 0;
+    TaskHandle_t boost_task = NULL;
+
+    xSemaphoreTake(queue->boost_lock, portMAX_DELAY);
+    portENTER_CRITICAL(&queue->spinlock);
+
+    UBaseType_t restore = queue->owner_boost != 0 ? queue->owner_task_priority : 0;
+    sdi12_bus_waiter_t *next = queue->waiters;
+
+    if (next)
+    {
+        hand_over(queue, next);
+        boost_task = boost_target(queue, &boost);
+    }
+    else
+    {
+        queue->busy = false;
+        queue->owner_task = NULL;
+    }
+
+    portEXIT_CRITICAL(&queue->spinlock);
+
+    if (boost_task)
+    {
+        vTaskPrioritySet(boost_task, boost);
+    }
+
+    xSemaphoreGive(queue->boost_lock);
+
+    if (next)
+    {
+        xSemaphoreGive(next->granted_sem);
+    }
+
+    // Raised priority is kept until bus is handed over, so a medium priority task can't get in between
+    if (restore != 0)
+    {
+        vTaskPrioritySet(NULL, restore);
+    }
+}
+
+void sdi12_bus_queue_set_preemptible(sdi12_bus_queue_t *queue, bool preemptible)
+{
+    portENTER_CRITICAL(&queue->spinlock);
+
+    queue->preemptible = preemptible;
+
+    if (preemptible)
+    {
+        queue->preempt_requested = false;
+        check_preemption(queue); // No need to wake owner, it is the caller
+    }
+
+    portEXIT_CRITICAL(&queue->spinlock);
+}
+
+bool sdi12_bus_queue_yield(sdi12_bus_queue_t *queue)
+{
+    sdi12_bus_waiter_t waiter = {
+        .task = xTaskGetCurrentTaskHandle(),
+        .granted = false,
+    };
+
+    waiter.granted_sem = xSemaphoreCreateBinaryStatic(&waiter.granted_sem_buffer);
+
+    UBaseType_t boost = 0;
+    TaskHandle_t boost_task = NULL;
+
+    xSemaphoreTake(queue->boost_lock, portMAX_DELAY);
+    portENTER_CRITICAL(&queue->spinlock);
+
+    sdi12_bus_waiter_t *next = queue->waiters;
+
+    if (!next || next->priority <= queue->owner_priority)
+    {
+        // Urgent request deadline could expire meanwhile
+        portEXIT_CRITICAL(&queue->spinlock);
+        xSemaphoreGive(queue->boost_lock);
+        vSemaphoreDelete(waiter.granted_sem);
+        return false;
+    }
+
+    UBaseType_t restore = queue->owner_boost != 0 ? queue->owner_task_priority : 0;
+
+    waiter.priority = queue->owner_priority;
+    waiter.task_priority = queue->owner_task_priority;
+    waiter.seq = queue->next_seq++;
+    waiter.enqueue_us = queue->clock->now_us(queue->clock);
+
+    // Hand over and queue up in same critical section, so yielding owner is first on its priority level.
+    hand_over(queue, next);
+    insert_waiter_first(queue, &waiter);
+    boost_task = boost_target(queue, &boost);
+
+    portEXIT_CRITICAL(&queue->spinlock);
+
+    if (boost_task)
+    {
+        vTaskPrioritySet(boost_task, boost);
+    }
+
+    xSemaphoreGive(queue->boost_lock);
+    xSemaphoreGive(next->granted_sem);
+
+    if (restore != 0)
+    {
+        vTaskPrioritySet(NULL, restore);
+    }
+
+    // No deadline, bus must be given back.
+    xSemaphoreTake(waiter.granted_sem, portMAX_DELAY);
+    vSemaphoreDelete(waiter.granted_sem);
+
+    return true;
+}
+
+void sdi12_bus_queue_get_stats(sdi12_bus_queue_t *queue, sdi12_bus_queue_stats_t *out_stats)
+{
+    portENTER_CRITICAL(&queue->spinlock);
+    *out_stats = queue->stats;
+    portEXIT_CRITICAL(&queue->spinlock);
+}
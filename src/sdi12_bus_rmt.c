@@ -0,0 +1,658 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+
+#include "driver/rmt_tx.h"
+#include "driver/rmt_rx.h"
+#include "driver/rmt_encoder.h"
+
+#include "driver/gpio.h"
+
+#include "esp_log.h"
+
+#include "sdi12_defs.h"
+#include "sdi12_transport.h"
+#include "sdi12_rmt_codec.h"
+#include "sdi12_trace_priv.h"
+#include "sdi12_capture_priv.h"
+
+#define SDI12_RX_SYMBOLS (128)
+#define SDI12_TX_CHARS   (16) // TX symbols buffer fits cmds up to this length. It is grown for longer ones
+
+/**
+ * @brief Reception done event plus time it was raised by RMT ISR
+ */
+typedef struct
+{
+    rmt_rx_done_event_data_t data;
+    int64_t done_us;
+} sdi12_rmt_rx_event_t;
+
+typedef struct
+{
+    sdi12_transport_t base;
+    uint8_t gpio_num;
+    uint8_t tx_gpio_num;
+    uint8_t rx_gpio_num;
+    int8_t dir_gpio_num;
+    bool dual_pin;
+    bool invert_tx;
+    bool invert_rx;
+    bool dir_tx_level;
+    volatile bool rx_armed;
+    volatile int64_t tx_done_us; // Set by TX done ISR
+    char tx_address;             // Traced by TX done ISR
+    const char *tx_cmd;          // Last sent cmd, for capture records. Valid until bus transaction ends
+    uint16_t tx_trace_arg;
+    rmt_channel_handle_t rmt_tx_channel;
+    rmt_channel_handle_t rmt_rx_channel;
+    rmt_encoder_t *copy_encoder;
+    rmt_symbol_word_t *rx_symbols; // RX channel can stay armed between read calls, so reception buffer must outlive them
+    rmt_symbol_word_t *tx_symbols; // Encoded cmd. Kept on heap, cmds have no length limit
+    size_t tx_symbols_length;
+    QueueHandle_t receive_queue;
+} sdi12_rmt_transport_t;
+
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+#define SDI12_RMT_CLK_SRC RMT_CLK_SRC_REF_TICK
+#else
+#define SDI12_RMT_CLK_SRC RMT_CLK_SRC_DEFAULT
+#endif
+
+static const char *TAG = "sdi12 rmt";
+
+static bool IRAM_ATTR sdi12_rmt_transmit_done_callback(rmt_channel_handle_t channel, const rmt_tx_done_event_data_t *data, void *user_data)
+{
+    sdi12_rmt_transport_t *rmt = (sdi12_rmt_transport_t *)user_data;
+    rmt->tx_done_us = esp_timer_get_time();
+    SDI12_TRACE(SDI12_TRACE_TX_FRAME, rmt->tx_address, rmt->tx_trace_arg);
+    return false;
+}
+
+/**
+ * @brief Configure RMT channel as transmisor
+ *
+ * @param rmt         rmt transport object
+ * @return esp_err_t
+ *      - ESP_FAIL RMT config install error
+ *      - ESP_OK  configuration and installation OK
+ */
+static esp_err_t config_rmt_as_tx(sdi12_rmt_transport_t *rmt)
+{
+    rmt_tx_channel_config_t tx_channel_config = {
+        .gpio_num = rmt->tx_gpio_num,     // GPIO number
+        .clk_src = SDI12_RMT_CLK_SRC,   // select source clock
+        .resolution_hz = 1 * 1000 * 1000, // 1MHz tick resolution, i.e. 1 tick = 1us
+        .mem_block_symbols = 64,          // memory block size, 64 * 4 = 256Bytes
+        .trans_queue_depth = 6,
+        .flags  = {
+            .io_loop_back = false,
+            .invert_out = rmt->invert_tx, // only external transceivers could need inverted signal
+            .with_dma = false,  // don't need DMA backend
+        }, 
+    };
+
+    ESP_RETURN_ON_ERROR(rmt_new_tx_channel(&tx_channel_config, &rmt->rmt_tx_channel), TAG, "create rmt tx channel error");
+
+    rmt_tx_event_callbacks_t cbs = {
+        .on_trans_done = sdi12_rmt_transmit_done_callback,
+    };
+
+    ESP_RETURN_ON_ERROR(rmt_tx_register_event_callbacks(rmt->rmt_tx_channel, &cbs, rmt), TAG, "error registering tx callback");
+    ESP_RETURN_ON_ERROR(rmt_enable(rmt->rmt_tx_channel), TAG, "rmt tx enable error");
+
+    return ESP_OK;
+}
+
+static bool IRAM_ATTR sdi12_rmt_receive_done_callback(rmt_channel_handle_t channel, const rmt_rx_done_event_data_t *data, void *user_data)
+{
+    BaseType_t high_task_wakeup = pdFALSE;
+    sdi12_rmt_transport_t *rmt = (sdi12_rmt_transport_t *)user_data;
+    sdi12_rmt_rx_event_t event = {
+        .data = *data,
+        .done_us = esp_timer_get_time(),
+    };
+
+    rmt->rx_armed = false;
+    xQueueSendFromISR(rmt->receive_queue, &event, &high_task_wakeup);
+    return high_task_wakeup == pdTRUE;
+}
+
+/**
+ * @brief Configure RMT channel as Receptor
+ *
+ * @param rmt         rmt transport object
+ * @return esp_err_t
+ *      - ESP_FAIL RMT config install error
+ *      - ESP_OK  configuration and installation OK
+ */
+static esp_err_t config_rmt_as_rx(sdi12_rmt_transport_t *rmt)
+{
+    rmt_rx_channel_config_t rx_channel_config = {
+        .gpio_num = rmt->rx_gpio_num,
+        .clk_src = SDI12_RMT_CLK_SRC,
+        .mem_block_symbols = 128,
+        .resolution_hz = 1 * 1000 * 1000, // 1MHz tick resolution, i.e. 1 tick = 1us
+        .flags = {
+            .io_loop_back = false,
+            .invert_in = rmt->invert_rx,
+            .with_dma = false,
+        },
+    };
+
+    if (rmt->dual_pin)
+    {
+        // RX pin is driven by transceiver, so no pull workaround is needed.
+        ESP_RETURN_ON_ERROR(rmt_new_rx_channel(&rx_channel_config, &rmt->rmt_rx_channel), TAG, "create rmt rx channel failed");
+    }
+    else
+    {
+        // Workaround to enable PULLDOWN on pin. rmt_new_rx_channel enable by default pull up
+        // and there is no way to change it.
+        gpio_hold_en(rmt->gpio_num);
+        ESP_RETURN_ON_ERROR(rmt_new_rx_channel(&rx_channel_config, &rmt->rmt_rx_channel), TAG, "create rmt rx channel failed");
+        gpio_hold_dis(rmt->gpio_num);
+        gpio_set_pull_mode(rmt->gpio_num, GPIO_PULLDOWN_ONLY);
+    }
+
+    rmt_rx_event_callbacks_t cbs = {
+        .on_recv_done = sdi12_rmt_receive_done_callback,
+    };
+
+    ESP_RETURN_ON_ERROR(rmt_rx_register_event_callbacks(rmt->rmt_rx_channel, &cbs, rmt), TAG, "error registering rx callback");
+    ESP_RETURN_ON_ERROR(rmt_enable(rmt->rmt_rx_channel), TAG, "error enabling rx channel");
+
+    return ESP_OK;
+}
+
+static esp_err_t set_idle_bus(sdi12_rmt_transport_t *rmt)
+{
+    if (rmt->dual_pin)
+    {
+        // Line driver is released, so transceiver keeps line on marking and forwards it to RX pin.
+        return rmt->dir_gpio_num >= 0 ? gpio_set_level(rmt->dir_gpio_num, !rmt->dir_tx_level) : ESP_OK;
+    }
+
+    gpio_config_t gpio_conf = {
+        .intr_type = GPIO_INTR_DISABLE,
+        // also enable the input path is `io_loop_back` is on, this is useful for debug
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_down_en = false,
+        .pull_up_en = false,
+        .pin_bit_mask = 1ULL << rmt->gpio_num,
+    };
+
+    gpio_hold_dis(rmt->gpio_num);
+
+    ESP_RETURN_ON_ERROR(gpio_config(&gpio_conf), TAG, "set idle bus error");
+
+    return gpio_set_level(rmt->gpio_num, 0);
+}
+
+/**
+ * @brief Install TX and RX channels (and direction pin) for whole bus life. Only used on dual pin mode.
+ *
+ * @param rmt         rmt transport object
+ * @return esp_err_t
+ */
+static esp_err_t config_dual_pin(sdi12_rmt_transport_t *rmt)
+{
+    if (rmt->dir_gpio_num >= 0)
+    {
+        gpio_config_t gpio_conf = {
+            .intr_type = GPIO_INTR_DISABLE,
+            .mode = GPIO_MODE_OUTPUT,
+            .pull_down_en = false,
+            .pull_up_en = false,
+            .pin_bit_mask = 1ULL << rmt->dir_gpio_num,
+        };
+
+        ESP_RETURN_ON_ERROR(gpio_config(&gpio_conf), TAG, "direction pin config error");
+    }
+
+    ESP_RETURN_ON_ERROR(config_rmt_as_tx(rmt), TAG, "error on tx config");
+    ESP_RETURN_ON_ERROR(config_rmt_as_rx(rmt), TAG, "error on rx config");
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Start a RMT reception. Reception ends when bus stays idle longer than a break.
+ *
+ * @param rmt           rmt transport object
+ * @param symbols       buffer where RMT driver stores received symbols
+ * @param symbols_len   buffer length, in symbols
+ * @return esp_err_t
+ */
+static esp_err_t arm_receiver(sdi12_rmt_transport_t *rmt, rmt_symbol_word_t *symbols, size_t symbols_len)
+{
+    rmt_receive_config_t receive_config = {
+
+    // Check @link https://github.com/espressif/esp-idf/issues/11262.
+    // Max range_min_ns value use rmt group resolution and must be a value allocatable in a 8-bit width reg.
+    // Group resolution is the same as RMT source clock
+// #if SDI12_RMT_CLK_SRC == RMT_CLK_SRC_REF_TICK
+//         // Group resolution = 1Mhz
+//         .signal_range_min_ns = 255 * 1000,
+// #else
+        // Group resolution = 80Mhz
+        .signal_range_min_ns = 3186,
+// #endif
+        .signal_range_max_ns = SDI12_RX_IDLE_US * 1000,
+    };
+
+    // Drop any stale reception (i.e. line noise between commands)
+    xQueueReset(rmt->receive_queue);
+    rmt->rx_armed = true;
+
+    esp_err_t ret = rmt_receive(rmt->rmt_rx_channel, symbols, symbols_len * sizeof(rmt_symbol_word_t), &receive_config);
+
+    if (ret != ESP_OK)
+    {
+        rmt->rx_armed = false;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Get response time on the wire from reception done ISR time.
+ *
+ * @details RMT raises reception done once line is idle for SDI12_RX_IDLE_US after last edge. Last edge is last stop bit start (inverse logic,
+ * stop bit and idle line are both marking) and first edge is received symbols duration before it.
+ */
+static void stamp_response(const sdi12_rmt_rx_event_t *event, sdi12_transport_stamp_t *out_stamp)
+{
+    int64_t last_edge_us = event->done_us - SDI12_RX_IDLE_US;
+
+    out_stamp->start_us = last_edge_us - sdi12_rmt_symbols_duration_us(event->data.received_symbols, event->data.num_symbols);
+    out_stamp->end_us = last_edge_us + SDI12_BIT_WIDTH_US;
+}
+
+/**
+ * @brief Stop any pending reception. On single pin mode RX channel is removed and line is given back to idle state.
+ *
+ * @param rmt         rmt transport object
+ */
+static void release_receiver(sdi12_rmt_transport_t *rmt)
+{
+    if (rmt->dual_pin)
+    {
+        if (rmt->rx_armed)
+        {
+            // Reception is still pending (timeout or unread line). Restart channel to abort it. It is cheap, no channel allocation is involved.
+            rmt_disable(rmt->rmt_rx_channel);
+            rmt_enable(rmt->rmt_rx_channel);
+            rmt->rx_armed = false;
+        }
+
+        return;
+    }
+
+    if (rmt->rmt_rx_channel)
+    {
+        // Skip gpio reset on disable rmt_disable()
+        gpio_hold_en(rmt->gpio_num);
+        rmt_disable(rmt->rmt_rx_channel);
+        rmt_del_channel(rmt->rmt_rx_channel);
+        rmt->rmt_rx_channel = NULL;
+        rmt->rx_armed = false;
+        set_idle_bus(rmt);
+    }
+}
+
+static esp_err_t read_response_line(sdi12_rmt_transport_t *rmt, char *out_buffer, size_t out_buffer_length, uint32_t timeout, const volatile bool *abort,
+    sdi12_transport_stamp_t *out_stamp)
+{
+    ESP_RETURN_ON_FALSE(rmt, ESP_ERR_INVALID_ARG, TAG, "transport is NULL");
+
+    esp_err_t ret = ESP_OK;
+    sdi12_rmt_rx_event_t rx_event;
+
+    rmt->base.rx_error = SDI12_TRANSPORT_RX_ERROR_NONE;
+    uint32_t aux_timeout = timeout != 0 ? timeout : SDI12_DEFAULT_RESPONSE_TIMEOUT;
+
+    // Dual pin RX channel lives for whole bus life. Single pin one is kept between lines of a response read with rx_keep.
+    if (!rmt->dual_pin && !rmt->rmt_rx_channel)
+    {
+        ret = config_rmt_as_rx(rmt);
+
+        if (ret != ESP_OK)
+        {
+            return ret;
+        }
+    }
+
+    // Only arm receiver if write_cmd() or previous line didn't do it yet.
+    if (!rmt->rx_armed)
+    {
+        ret = arm_receiver(rmt, rmt->rx_symbols, SDI12_RX_SYMBOLS);
+    }
+
+    if (ret == ESP_OK)
+    {
+        TickType_t start = xTaskGetTickCount();
+        TickType_t wait = pdMS_TO_TICKS(aux_timeout);
+
+        ret = ESP_ERR_TIMEOUT;
+
+        while (!(abort && *abort) && xQueueReceive(rmt->receive_queue, &rx_event, wait) == pdPASS)
+        {
+            rmt_rx_done_event_data_t *rx_data = &rx_event.data;
+
+            if (rx_data->num_symbols > 0)
+            {
+                // for (size_t i = 0; i < rx_data.num_symbols; i++)
+                // {
+                //     printf("Level: %d | Duration: %d \n", rx_data.received_symbols[i].level0, rx_data.received_symbols[i].duration0);
+                //     printf("Level: %d | Duration: %d \n", rx_data.received_symbols[i].level1, rx_data.received_symbols[i].duration1);
+                // }
+
+                ret = sdi12_rmt_decode_line(rx_data->received_symbols, rx_data->num_symbols, out_buffer, out_buffer_length, &rmt->base.rx_length,
+                    &rmt->base.rx_error);
+                SDI12_CAPTURE(rmt->tx_cmd, rx_data->received_symbols, rx_data->num_symbols, out_buffer_length, ret, rmt->base.rx_error, rx_event.done_us);
+
+                if (ret == ESP_OK && out_stamp)
+                {
+                    stamp_response(&rx_event, out_stamp);
+                }
+
+                if (ret == ESP_OK && rmt->base.rx_keep)
+                {
+                    // Symbols are already decoded, so buffer can be reused. If arming fails, next read arms it.
+                    arm_receiver(rmt, rmt->rx_symbols, SDI12_RX_SYMBOLS);
+                }
+
+                break;
+            }
+
+            // Empty event is a wake up from rmt_transport_wake(). Keep waiting unless read was aborted.
+            TickType_t elapsed = xTaskGetTickCount() - start;
+            wait = elapsed < pdMS_TO_TICKS(aux_timeout) ? pdMS_TO_TICKS(aux_timeout) - elapsed : 0;
+        }
+
+        if (ret == ESP_ERR_TIMEOUT && abort && *abort)
+        {
+            ret = ESP_ERR_INVALID_STATE;
+        }
+        else if (ret == ESP_ERR_TIMEOUT)
+        {
+            ESP_LOGD(TAG, "no rmt symbols received");
+        }
+    }
+
+    if (ret != ESP_OK || !rmt->base.rx_keep)
+    {
+        release_receiver(rmt);
+    }
+
+    return ret;
+}
+
+static esp_err_t write_cmd(sdi12_rmt_transport_t *rmt, const char *cmd, const sdi12_bus_timing_t *timing, sdi12_transport_stamp_t *out_stamp)
+{
+    // Receiver may be left armed by a multi-line read which stopped before response end
+    release_receiver(rmt);
+
+    if (rmt->dual_pin)
+    {
+        if (rmt->dir_gpio_num >= 0)
+        {
+            gpio_set_level(rmt->dir_gpio_num, rmt->dir_tx_level);
+        }
+    }
+    else
+    {
+        ESP_RETURN_ON_ERROR(config_rmt_as_tx(rmt), TAG, "error on tx config");
+    }
+
+    // Initial Break & marking + chars. Every char need 10 bits transfers so it needs 5 rmt_symbol_word
+    size_t cmd_len = strlen(cmd);
+    size_t rmt_symbols_len = SDI12_RMT_FRAME_SYMBOLS(cmd_len);
+
+    if (rmt_symbols_len > rmt->tx_symbols_length)
+    {
+        rmt_symbol_word_t *symbols = realloc(rmt->tx_symbols, rmt_symbols_len * sizeof(rmt_symbol_word_t));
+        ESP_RETURN_ON_FALSE(symbols, ESP_ERR_NO_MEM, TAG, "can't allocate tx symbols");
+        rmt->tx_symbols = symbols;
+        rmt->tx_symbols_length = rmt_symbols_len;
+    }
+
+    rmt_symbol_word_t *rmt_symbols = rmt->tx_symbols;
+    sdi12_rmt_encode_frame(cmd, cmd_len, timing->break_us, timing->post_break_marking_us, rmt_symbols);
+
+    rmt->tx_address = cmd[0];
+    rmt->tx_cmd = cmd;
+    rmt->tx_trace_arg = cmd_len | (timing->break_us > 0 ? 0x8000 : 0);
+
+    rmt_transmit_config_t tx_config = {
+        .loop_count = 0,
+        .flags.eot_level = 0,
+    };
+
+    esp_err_t ret = rmt_transmit(rmt->rmt_tx_channel, rmt->copy_encoder, rmt_symbols, sizeof(rmt_symbol_word_t) * rmt_symbols_len, &tx_config);
+
+    if (ret == ESP_OK)
+    {
+        ret = rmt_tx_wait_all_done(rmt->rmt_tx_channel, SDI12_TX_WAIT_MS(cmd_len, timing->break_us, timing->post_break_marking_us));
+
+        if (ret == ESP_OK && out_stamp)
+        {
+            // Frame length is exact, so break start is taken back from TX done ISR time.
+            out_stamp->end_us = rmt->tx_done_us;
+            out_stamp->start_us = rmt->tx_done_us - sdi12_rmt_symbols_duration_us(rmt_symbols, rmt_symbols_len);
+        }
+
+        if (rmt->dual_pin)
+        {
+            set_idle_bus(rmt);
+
+            // Arm receiver right after command end, so sensor response is never missed.
+            if (ret == ESP_OK)
+            {
+                ret = arm_receiver(rmt, rmt->rx_symbols, SDI12_RX_SYMBOLS);
+            }
+
+            return ret;
+        }
+
+        gpio_hold_en(rmt->gpio_num);
+        rmt_disable(rmt->rmt_tx_channel);
+        rmt_del_channel(rmt->rmt_tx_channel);
+        rmt->rmt_tx_channel = NULL;
+
+        set_idle_bus(rmt);
+
+        // gpio_set_level(rmt->gpio_num, 0);
+    }
+    else if (rmt->dual_pin)
+    {
+        set_idle_bus(rmt);
+    }
+
+    return ret;
+}
+
+
+static esp_err_t rmt_transport_write_cmd(sdi12_transport_t *transport, const char *cmd, const sdi12_bus_timing_t *timing,
+    sdi12_transport_stamp_t *out_stamp)
+{
+    sdi12_rmt_transport_t *rmt = __containerof(transport, sdi12_rmt_transport_t, base);
+
+    // each time RMT is installed/uninstalled INFO message is printed from GPIO component, so it is disabled during cmd time to clean up log messages.
+    // Dual pin mode doesn't reinstall channels.
+    if (!rmt->dual_pin)
+    {
+        esp_log_level_set("gpio", ESP_LOG_WARN);
+    }
+
+    esp_err_t ret = write_cmd(rmt, cmd, timing, out_stamp);
+
+    if (!rmt->dual_pin)
+    {
+        esp_log_level_set("gpio", CONFIG_LOG_DEFAULT_LEVEL);
+    }
+
+    return ret;
+}
+
+static esp_err_t rmt_transport_read_line(sdi12_transport_t *transport, char *out_buffer, size_t out_buffer_length, uint32_t timeout,
+    const volatile bool *abort, sdi12_transport_stamp_t *out_stamp)
+{
+    sdi12_rmt_transport_t *rmt = __containerof(transport, sdi12_rmt_transport_t, base);
+
+    if (!rmt->dual_pin)
+    {
+        esp_log_level_set("gpio", ESP_LOG_WARN);
+    }
+
+    esp_err_t ret = read_response_line(rmt, out_buffer, out_buffer_length, timeout, abort, out_stamp);
+
+    if (!rmt->dual_pin)
+    {
+        esp_log_level_set("gpio", CONFIG_LOG_DEFAULT_LEVEL);
+    }
+
+    return ret;
+}
+
+static void rmt_transport_wake(sdi12_transport_t *transport)
+{
+    sdi12_rmt_transport_t *rmt = __containerof(transport, sdi12_rmt_transport_t, base);
+    sdi12_rmt_rx_event_t wake_event = { 0 };
+
+    // If queue is full, a reception is already waking reader up
+    xQueueSend(rmt->receive_queue, &wake_event, 0);
+}
+
+static esp_err_t rmt_transport_del(sdi12_transport_t *transport)
+{
+    sdi12_rmt_transport_t *rmt = __containerof(transport, sdi12_rmt_transport_t, base);
+
+    if (rmt->rmt_tx_channel)
+    {
+        if (rmt->dual_pin)
+        {
+            rmt_disable(rmt->rmt_tx_channel);
+        }
+
+        rmt_del_channel(rmt->rmt_tx_channel);
+    }
+
+    if (rmt->rmt_rx_channel)
+    {
+        if (rmt->dual_pin)
+        {
+            rmt_disable(rmt->rmt_rx_channel);
+        }
+
+        rmt_del_channel(rmt->rmt_rx_channel);
+    }
+
+    if (rmt->copy_encoder)
+    {
+        rmt_del_encoder(rmt->copy_encoder);
+    }
+
+    if (rmt->receive_queue)
+    {
+        vQueueDelete(rmt->receive_queue);
+    }
+
+    if (rmt->rx_symbols)
+    {
+        free(rmt->rx_symbols);
+    }
+
+    if (rmt->tx_symbols)
+    {
+        free(rmt->tx_symbols);
+    }
+
+    free(rmt);
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_new_rmt_transport(const sdi12_bus_config_t *config, sdi12_transport_t **ret_transport)
+{
+    esp_err_t ret = ESP_OK;
+
+    if (config->flags.dual_pin)
+    {
+        ESP_RETURN_ON_FALSE(GPIO_IS_VALID_OUTPUT_GPIO(config->dual_pin.tx_gpio_num), ESP_ERR_INVALID_ARG, TAG, "Invalid TX GPIO pin");
+        ESP_RETURN_ON_FALSE(GPIO_IS_VALID_GPIO(config->dual_pin.rx_gpio_num), ESP_ERR_INVALID_ARG, TAG, "Invalid RX GPIO pin");
+        ESP_RETURN_ON_FALSE(config->dual_pin.tx_gpio_num != config->dual_pin.rx_gpio_num, ESP_ERR_INVALID_ARG, TAG, "TX and RX pins must be different");
+        ESP_RETURN_ON_FALSE(config->dual_pin.dir_gpio_num < 0 || GPIO_IS_VALID_OUTPUT_GPIO(config->dual_pin.dir_gpio_num), ESP_ERR_INVALID_ARG, TAG,
+            "Invalid DIR GPIO pin");
+    }
+    else
+    {
+        // GPIO selected must be input and output capable.
+        // ESP_RETURN_ON_FALSE(GPIO_IS_VALID_DIGITAL_IO_PAD(config->gpio_num), ESP_ERR_INVALID_ARG, TAG, "Invalid GPIO pin");
+        ESP_RETURN_ON_FALSE(GPIO_IS_VALID_OUTPUT_GPIO(config->gpio_num), ESP_ERR_INVALID_ARG, TAG, "Invalid GPIO pin");
+    }
+
+    sdi12_rmt_transport_t *rmt = calloc(1, sizeof(sdi12_rmt_transport_t));
+    ESP_RETURN_ON_FALSE(rmt, ESP_ERR_NO_MEM, TAG, "can't allocate rmt transport");
+
+    if (config->flags.dual_pin)
+    {
+        rmt->dual_pin = true;
+        rmt->tx_gpio_num = config->dual_pin.tx_gpio_num;
+        rmt->rx_gpio_num = config->dual_pin.rx_gpio_num;
+        rmt->dir_gpio_num = config->dual_pin.dir_gpio_num;
+        rmt->invert_tx = config->flags.invert_tx;
+        rmt->invert_rx = config->flags.invert_rx;
+        rmt->dir_tx_level = config->flags.dir_tx_level;
+    }
+    else
+    {
+        rmt->gpio_num = config->gpio_num;
+        rmt->tx_gpio_num = config->gpio_num;
+        rmt->rx_gpio_num = config->gpio_num;
+        rmt->dir_gpio_num = -1;
+    }
+
+    rmt->base.write_cmd = rmt_transport_write_cmd;
+    rmt->base.read_line = rmt_transport_read_line;
+    rmt->base.wake = rmt_transport_wake;
+    rmt->base.del = rmt_transport_del;
+    rmt->base.rx_idle_us = SDI12_RX_IDLE_US;
+
+    rmt_copy_encoder_config_t copy_encoder_config = {};
+    ESP_GOTO_ON_ERROR(rmt_new_copy_encoder(&copy_encoder_config, &rmt->copy_encoder), err, TAG, "can't allocate copy encoder");
+
+    // Room for a reception and a wake up event
+    rmt->receive_queue = xQueueCreate(2, sizeof(sdi12_rmt_rx_event_t));
+    ESP_GOTO_ON_FALSE(rmt->receive_queue, ESP_ERR_NO_MEM, err, TAG, "can't allocate receive queue");
+
+    rmt->rx_symbols = calloc(SDI12_RX_SYMBOLS, sizeof(rmt_symbol_word_t));
+    ESP_GOTO_ON_FALSE(rmt->rx_symbols, ESP_ERR_NO_MEM, err, TAG, "can't allocate rx symbols");
+
+    rmt->tx_symbols_length = SDI12_RMT_FRAME_SYMBOLS(SDI12_TX_CHARS);
+    rmt->tx_symbols = calloc(rmt->tx_symbols_length, sizeof(rmt_symbol_word_t));
+    ESP_GOTO_ON_FALSE(rmt->tx_symbols, ESP_ERR_NO_MEM, err, TAG, "can't allocate tx symbols");
+
+    if (rmt->dual_pin)
+    {
+        ESP_GOTO_ON_ERROR(config_dual_pin(rmt), err, TAG, "can't configure dual pin mode");
+    }
+
+    set_idle_bus(rmt);
+
+    *ret_transport = &rmt->base;
+    return ESP_OK;
+
+err:
+    rmt_transport_del(&rmt->base);
+    return ret;
+}
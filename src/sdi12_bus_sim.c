@@ -0,0 +1,181 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_check.h"
+#include "esp_log.h"
+
+#include "sdi12_defs.h"
+#include "sdi12_transport.h"
+#include "sdi12_sensor_proto.h"
+#include "sdi12_sim.h"
+
+typedef struct
+{
+    sdi12_transport_t base;
+    sdi12_clock_t *clock;
+    sdi12_sensor_proto_t proto;
+    uint16_t response_delay_us;
+    bool pending;             // A response to last cmd is on its way
+    int64_t pending_start_us; // Response first start bit
+    char response[SDI12_SENSOR_RESPONSE_LENGTH];
+    char service_request[2];
+} sdi12_sim_transport_t;
+
+static const char *TAG = "sdi12 sim";
+
+/**
+ * @brief Let bus clock reach wake_us. System clock can wake up early, so wait is repeated.
+ */
+static void advance_to(sdi12_sim_transport_t *sim, int64_t wake_us)
+{
+    while (sim->clock->now_us(sim->clock) < wake_us)
+    {
+        sim->clock->sleep_until(sim->clock, wake_us);
+    }
+}
+
+/**
+ * @brief Drop service requests which became due while bus wasn't listening. They collided with bus traffic, or nobody was reading.
+ */
+static void drop_service_requests(sdi12_sim_transport_t *sim, int64_t now_us)
+{
+    char address;
+
+    while ((address = sdi12_sensor_proto_pop_service_request(&sim->proto, now_us)) != '\0')
+    {
+        ESP_LOGD(TAG, "service request of '%c' lost", address);
+    }
+}
+
+static esp_err_t sim_transport_write_cmd(sdi12_transport_t *transport, const char *cmd, const sdi12_bus_timing_t *timing,
+    sdi12_transport_stamp_t *out_stamp)
+{
+    sdi12_sim_transport_t *sim = __containerof(transport, sdi12_sim_transport_t, base);
+    int64_t start_us = sim->clock->now_us(sim->clock);
+    int64_t end_us = start_us + timing->break_us + timing->post_break_marking_us + (int64_t)strlen(cmd) * SDI12_CHAR_US;
+
+    sim->pending = false;
+    drop_service_requests(sim, start_us);
+
+    if (timing->break_us > 0)
+    {
+        sdi12_sensor_proto_abort(&sim->proto);
+    }
+
+    advance_to(sim, end_us);
+
+    uint32_t aborted;
+
+    if (sdi12_sensor_proto_handle_cmd(&sim->proto, cmd, end_us, end_us, sim->response, sizeof(sim->response), &aborted) == ESP_OK)
+    {
+        sim->pending = true;
+        sim->pending_start_us = end_us + sim->response_delay_us;
+    }
+
+    if (out_stamp)
+    {
+        out_stamp->start_us = start_us;
+        out_stamp->end_us = end_us;
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t sim_transport_read_line(sdi12_transport_t *transport, char *out_buffer, size_t out_buffer_length, uint32_t timeout,
+    const volatile bool *abort, sdi12_transport_stamp_t *out_stamp)
+{
+    sdi12_sim_transport_t *sim = __containerof(transport, sdi12_sim_transport_t, base);
+
+    if (abort && *abort)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    int64_t now_us = sim->clock->now_us(sim->clock);
+    int64_t deadline_us = now_us + (int64_t)(timeout != 0 ? timeout : SDI12_DEFAULT_RESPONSE_TIMEOUT) * 1000;
+    const char *line;
+    int64_t start_us;
+
+    if (sim->pending && sim->pending_start_us <= deadline_us)
+    {
+        line = sim->response;
+        start_us = sim->pending_start_us;
+        sim->pending = false;
+    }
+    else
+    {
+        int64_t service_request_us = sdi12_sensor_proto_next_service_request(&sim->proto);
+
+        if (service_request_us > deadline_us)
+        {
+            advance_to(sim, deadline_us);
+            return ESP_ERR_TIMEOUT;
+        }
+
+        start_us = service_request_us > now_us ? service_request_us : now_us;
+        advance_to(sim, start_us);
+
+        sim->service_request[0] = sdi12_sensor_proto_pop_service_request(&sim->proto, start_us);
+        line = sim->service_request;
+    }
+
+    size_t length = strlen(line);
+    int64_t end_us = start_us + (int64_t)(length + 2) * SDI12_CHAR_US; // <CR><LF> included
+
+    advance_to(sim, end_us);
+
+    ESP_RETURN_ON_FALSE(length < out_buffer_length, ESP_ERR_INVALID_SIZE, TAG, "response buffer too small");
+
+    memcpy(out_buffer, line, length + 1);
+    sim->base.rx_length = length;
+
+    if (out_stamp)
+    {
+        out_stamp->start_us = start_us;
+        out_stamp->end_us = end_us;
+    }
+
+    return ESP_OK;
+}
+
+static void sim_transport_wake(sdi12_transport_t *transport)
+{
+    // Simulated waits are instant, abort flag is checked on next read_line()
+}
+
+static esp_err_t sim_transport_del(sdi12_transport_t *transport)
+{
+    sdi12_sim_transport_t *sim = __containerof(transport, sdi12_sim_transport_t, base);
+
+    sdi12_sensor_proto_deinit(&sim->proto);
+    free(sim);
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_new_sim_transport(const sdi12_bus_config_t *config, sdi12_clock_t *clock, sdi12_transport_t **ret_transport)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(config && config->sim && clock && ret_transport, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    sdi12_sim_transport_t *sim = calloc(1, sizeof(sdi12_sim_transport_t));
+    ESP_RETURN_ON_FALSE(sim, ESP_ERR_NO_MEM, TAG, "can't allocate sim transport");
+
+    ESP_GOTO_ON_ERROR(sdi12_sensor_proto_init(&sim->proto, config->sim->devices, config->sim->devices_count), err, TAG, "invalid devices");
+
+    sim->clock = clock;
+    sim->response_delay_us = config->sim->response_delay_us != 0 ? config->sim->response_delay_us : SDI12_POST_BREAK_MARKING_US;
+    sim->base.write_cmd = sim_transport_write_cmd;
+    sim->base.read_line = sim_transport_read_line;
+    sim->base.wake = sim_transport_wake;
+    sim->base.del = sim_transport_del;
+    sim->base.rx_idle_us = 0; // Line end is known exactly
+
+    *ret_transport = &sim->base;
+    return ESP_OK;
+
+err:
+    free(sim);
+    return ret;
+}
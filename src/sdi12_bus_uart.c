@@ -0,0 +1,307 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "esp_check.h"
+#include "esp_timer.h"
+
+#include "driver/uart.h"
+#include "driver/gpio.h"
+
+#include "esp_log.h"
+
+#include "sdi12_defs.h"
+#include "sdi12_transport.h"
+#include "sdi12_trace_priv.h"
+
+#define SDI12_UART_BAUD_RATE        (1200)
+#define SDI12_UART_RX_BUFFER_SIZE   (256) // Must be greater than UART HW FIFO
+#define SDI12_UART_EVENT_QUEUE_LEN  (16)
+#define SDI12_UART_BREAK_BITS       (9)   // NUL char in 7E1: start + 7 data + parity bits are all spacing
+#define SDI12_UART_RX_TOUT_SYMBOLS  (3)   // RX timeout interrupt after 3 idle chars
+#define SDI12_UART_PATTERN_GAP      (9)   // Max baud cycles between pattern chars. Unused with a single char pattern
+#define SDI12_UART_PATTERN_IDLE     (0)   // Idle baud cycles required after <LF> before pattern is reported
+#define SDI12_UART_EVENT_LATENCY_US (100) // Pattern ISR to read_line() task wake up, through driver event queue
+
+typedef struct
+{
+    sdi12_transport_t base;
+    uart_port_t port;
+    int8_t dir_gpio_num;
+    bool dir_tx_level;
+    QueueHandle_t event_queue;
+} sdi12_uart_transport_t;
+
+static const char *TAG = "sdi12 uart";
+
+static void set_line_driver(sdi12_uart_transport_t *uart, bool enable)
+{
+    if (uart->dir_gpio_num >= 0)
+    {
+        gpio_set_level(uart->dir_gpio_num, enable ? uart->dir_tx_level : !uart->dir_tx_level);
+    }
+}
+
+/**
+ * @brief Drop any received byte and pending event. Used to discard TX echo and line noise before a response.
+ *
+ * @param uart      uart transport object
+ */
+static void flush_rx(sdi12_uart_transport_t *uart)
+{
+    uart_flush_input(uart->port);
+    uart_pattern_queue_reset(uart->port, SDI12_UART_EVENT_QUEUE_LEN);
+    xQueueReset(uart->event_queue);
+}
+
+static esp_err_t uart_transport_write_cmd(sdi12_transport_t *transport, const char *cmd, const sdi12_bus_timing_t *timing,
+    sdi12_transport_stamp_t *out_stamp)
+{
+    sdi12_uart_transport_t *uart = __containerof(transport, sdi12_uart_transport_t, base);
+    esp_err_t ret;
+
+    // UART driver doesn't expose TX ISR events, so frame is stamped from task. TX FIFO is empty, so transmission starts right away.
+    int64_t start_us = esp_timer_get_time();
+    set_line_driver(uart, true);
+
+    // break_us 0 means break is suppressed, only marking is sent.
+    if (timing->break_us > 0)
+    {
+        // IDF UART driver only appends break after data, so break is generated as a NUL char at a baud rate which stretches its spacing bits to break
+        // length.
+        uint32_t break_baud_rate = (SDI12_UART_BREAK_BITS * 1000000UL) / timing->break_us;
+
+        ESP_GOTO_ON_ERROR(uart_set_baudrate(uart->port, break_baud_rate), err, TAG, "break baud rate error");
+        ESP_GOTO_ON_FALSE(uart_write_bytes(uart->port, "\0", 1) == 1, ESP_FAIL, err, TAG, "break write error");
+        ESP_GOTO_ON_ERROR(uart_wait_tx_done(uart->port, pdMS_TO_TICKS(100)), err, TAG, "break timeout");
+        ESP_GOTO_ON_ERROR(uart_set_baudrate(uart->port, SDI12_UART_BAUD_RATE), err, TAG, "baud rate error");
+    }
+
+    // Post break marking is timed by HW: idle bits inserted before next transmission.
+    ESP_GOTO_ON_ERROR(uart_set_tx_idle_num(uart->port, (timing->post_break_marking_us + SDI12_BIT_WIDTH_US - 1) / SDI12_BIT_WIDTH_US), err, TAG,
+        "marking error");
+
+    size_t cmd_len = strlen(cmd);
+    ESP_GOTO_ON_FALSE(uart_write_bytes(uart->port, cmd, cmd_len) == (int)cmd_len, ESP_FAIL, err, TAG, "cmd write error");
+    ret = uart_wait_tx_done(uart->port, pdMS_TO_TICKS(SDI12_TX_WAIT_MS(cmd_len, 0, timing->post_break_marking_us)));
+
+    if (ret == ESP_OK)
+    {
+        SDI12_TRACE(SDI12_TRACE_TX_FRAME, cmd[0], cmd_len | (timing->break_us > 0 ? 0x8000 : 0));
+    }
+
+    if (ret == ESP_OK && out_stamp)
+    {
+        out_stamp->start_us = start_us;
+        out_stamp->end_us = esp_timer_get_time();
+    }
+
+err:
+    set_line_driver(uart, false);
+    flush_rx(uart);
+
+    return ret;
+}
+
+static esp_err_t uart_transport_read_line(sdi12_transport_t *transport, char *out_buffer, size_t out_buffer_length, uint32_t timeout,
+    const volatile bool *abort, sdi12_transport_stamp_t *out_stamp)
+{
+    sdi12_uart_transport_t *uart = __containerof(transport, sdi12_uart_transport_t, base);
+    uint32_t aux_timeout = timeout != 0 ? timeout : SDI12_DEFAULT_RESPONSE_TIMEOUT;
+    TickType_t start = xTaskGetTickCount();
+    TickType_t wait = pdMS_TO_TICKS(aux_timeout);
+    uart_event_t event;
+
+    uart->base.rx_error = SDI12_TRANSPORT_RX_ERROR_NONE;
+
+    while (!(abort && *abort) && xQueueReceive(uart->event_queue, &event, wait) == pdPASS)
+    {
+        switch (event.type)
+        {
+            case UART_PATTERN_DET:
+            {
+                // Pattern is detected right after <LF> stop bit. Line start is taken back from line length.
+                int64_t end_us = esp_timer_get_time();
+                int pos = uart_pattern_pop_pos(uart->port);
+
+                if (pos < 0)
+                {
+                    // Pattern queue overflowed, position is lost.
+                    flush_rx(uart);
+                    return ESP_FAIL;
+                }
+
+                size_t line_len = pos + 1; // Include <LF>
+
+                if (line_len > out_buffer_length)
+                {
+                    uart_read_bytes(uart->port, out_buffer, out_buffer_length - 1, 0);
+                    out_buffer[out_buffer_length - 1] = '\0';
+                    flush_rx(uart);
+                    ESP_LOGE(TAG, "Out buffer too small");
+                    return ESP_ERR_INVALID_SIZE;
+                }
+
+                uart_read_bytes(uart->port, out_buffer, line_len, 0);
+
+                if (line_len < 2 || out_buffer[line_len - 2] != '\r')
+                {
+                    // <LF> without <CR>. Not a SDI-12 line end, keep waiting.
+                    break;
+                }
+
+                out_buffer[line_len - 2] = '\0'; // Delete \r\n from response buffer
+                uart->base.rx_length = line_len - 2;
+                ESP_LOGD(TAG, "RX: %s", out_buffer);
+                SDI12_TRACE(SDI12_TRACE_RX_FRAME, out_buffer[0], line_len - 2);
+
+                if (out_stamp)
+                {
+                    out_stamp->end_us = end_us;
+                    out_stamp->start_us = end_us - (int64_t)line_len * SDI12_CHAR_US;
+                }
+
+                return ESP_OK;
+            }
+
+            case UART_PARITY_ERR:
+                SDI12_TRACE(SDI12_TRACE_PARITY_ERROR, '\0', 0);
+                uart->base.rx_error = SDI12_TRANSPORT_RX_ERROR_PARITY;
+                ESP_LOGE(TAG, "Reception parity error");
+                flush_rx(uart);
+                return ESP_FAIL;
+
+            case UART_FRAME_ERR:
+                SDI12_TRACE(SDI12_TRACE_STOP_ERROR, '\0', 0);
+                uart->base.rx_error = SDI12_TRANSPORT_RX_ERROR_STOP_BIT;
+                ESP_LOGE(TAG, "Reception Stop bit error");
+                flush_rx(uart);
+                return ESP_FAIL;
+
+            case UART_FIFO_OVF:
+            case UART_BUFFER_FULL:
+                ESP_LOGE(TAG, "Reception overflow");
+                flush_rx(uart);
+                return ESP_ERR_INVALID_SIZE;
+
+            default:
+                // UART_DATA: RX timeout or FIFO threshold. Line end isn't found yet, so keep waiting.
+                // UART_EVENT_MAX: wake up from uart_transport_wake(). Loop condition checks abort.
+                break;
+        }
+
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        wait = elapsed < pdMS_TO_TICKS(aux_timeout) ? pdMS_TO_TICKS(aux_timeout) - elapsed : 0;
+    }
+
+    if (abort && *abort)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    ESP_LOGD(TAG, "no uart line received");
+
+    return ESP_ERR_TIMEOUT;
+}
+
+static void uart_transport_wake(sdi12_transport_t *transport)
+{
+    sdi12_uart_transport_t *uart = __containerof(transport, sdi12_uart_transport_t, base);
+    uart_event_t wake_event = { .type = UART_EVENT_MAX };
+
+    xQueueSend(uart->event_queue, &wake_event, 0);
+}
+
+static esp_err_t uart_transport_del(sdi12_transport_t *transport)
+{
+    sdi12_uart_transport_t *uart = __containerof(transport, sdi12_uart_transport_t, base);
+
+    esp_err_t ret = uart_driver_delete(uart->port);
+
+    free(uart);
+
+    return ret;
+}
+
+esp_err_t sdi12_new_uart_transport(const sdi12_bus_config_t *config, sdi12_transport_t **ret_transport)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(config->flags.dual_pin, ESP_ERR_NOT_SUPPORTED, TAG, "uart transport needs dual pin mode");
+    ESP_RETURN_ON_FALSE(config->uart_port < UART_NUM_MAX, ESP_ERR_INVALID_ARG, TAG, "Invalid UART port");
+    ESP_RETURN_ON_FALSE(GPIO_IS_VALID_OUTPUT_GPIO(config->dual_pin.tx_gpio_num), ESP_ERR_INVALID_ARG, TAG, "Invalid TX GPIO pin");
+    ESP_RETURN_ON_FALSE(GPIO_IS_VALID_GPIO(config->dual_pin.rx_gpio_num), ESP_ERR_INVALID_ARG, TAG, "Invalid RX GPIO pin");
+    ESP_RETURN_ON_FALSE(config->dual_pin.dir_gpio_num < 0 || GPIO_IS_VALID_OUTPUT_GPIO(config->dual_pin.dir_gpio_num), ESP_ERR_INVALID_ARG, TAG,
+        "Invalid DIR GPIO pin");
+
+    sdi12_uart_transport_t *uart = calloc(1, sizeof(sdi12_uart_transport_t));
+    ESP_RETURN_ON_FALSE(uart, ESP_ERR_NO_MEM, TAG, "can't allocate uart transport");
+
+    uart->port = config->uart_port;
+    uart->dir_gpio_num = config->dual_pin.dir_gpio_num;
+    uart->dir_tx_level = config->flags.dir_tx_level;
+
+    uart->base.write_cmd = uart_transport_write_cmd;
+    uart->base.read_line = uart_transport_read_line;
+    uart->base.wake = uart_transport_wake;
+    uart->base.del = uart_transport_del;
+    uart->base.rx_idle_us = SDI12_UART_PATTERN_IDLE * SDI12_BIT_WIDTH_US + SDI12_UART_EVENT_LATENCY_US; // Line end is found by <LF> pattern
+
+    uart_config_t uart_config = {
+        .baud_rate = SDI12_UART_BAUD_RATE,
+        .data_bits = UART_DATA_7_BITS,
+        .parity = UART_PARITY_EVEN,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+
+    // SDI-12 uses inverse logic: marking (UART idle '1') is low level. Pin flags work as on RMT transport, so UART signals are inverted by default.
+    uint32_t inverse_mask = UART_SIGNAL_INV_DISABLE;
+
+    if (!config->flags.invert_tx)
+    {
+        inverse_mask |= UART_SIGNAL_TXD_INV;
+    }
+
+    if (!config->flags.invert_rx)
+    {
+        inverse_mask |= UART_SIGNAL_RXD_INV;
+    }
+
+    ESP_GOTO_ON_ERROR(uart_driver_install(uart->port, SDI12_UART_RX_BUFFER_SIZE, 0, SDI12_UART_EVENT_QUEUE_LEN, &uart->event_queue, 0), err_driver, TAG,
+        "uart driver install error");
+    ESP_GOTO_ON_ERROR(uart_param_config(uart->port, &uart_config), err, TAG, "uart config error");
+    ESP_GOTO_ON_ERROR(uart_set_pin(uart->port, config->dual_pin.tx_gpio_num, config->dual_pin.rx_gpio_num, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE), err,
+        TAG, "uart pin error");
+    ESP_GOTO_ON_ERROR(uart_set_line_inverse(uart->port, inverse_mask), err, TAG, "uart inverse error");
+    ESP_GOTO_ON_ERROR(uart_set_rx_timeout(uart->port, SDI12_UART_RX_TOUT_SYMBOLS), err, TAG, "uart rx timeout error");
+    ESP_GOTO_ON_ERROR(uart_enable_pattern_det_baud_intr(uart->port, '\n', 1, SDI12_UART_PATTERN_GAP, SDI12_UART_PATTERN_IDLE, 0), err, TAG, "uart pattern error");
+    ESP_GOTO_ON_ERROR(uart_pattern_queue_reset(uart->port, SDI12_UART_EVENT_QUEUE_LEN), err, TAG, "uart pattern queue error");
+
+    if (uart->dir_gpio_num >= 0)
+    {
+        gpio_config_t gpio_conf = {
+            .intr_type = GPIO_INTR_DISABLE,
+            .mode = GPIO_MODE_OUTPUT,
+            .pull_down_en = false,
+            .pull_up_en = false,
+            .pin_bit_mask = 1ULL << uart->dir_gpio_num,
+        };
+
+        ESP_GOTO_ON_ERROR(gpio_config(&gpio_conf), err, TAG, "direction pin config error");
+    }
+
+    set_line_driver(uart, false);
+
+    *ret_transport = &uart->base;
+    return ESP_OK;
+
+err:
+    uart_driver_delete(uart->port);
+err_driver:
+    free(uart);
+    return ret;
+}
@@ -0,0 +1,424 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "esp_check.h"
+#include "esp_log.h"
+
+#include "sdi12_cache.h"
+#include "sdi12_values.h"
+
+#define SDI12_CACHE_DEFAULT_VALUES_SIZE (256)
+#define SDI12_CACHE_LINE_CHARS          (85)
+#define SDI12_CACHE_MAX_D_INDEX         (9)
+
+/**
+ * @brief Request waiting for a running measurement. Lives on requester stack, leader fills it and gives done.
+ */
+typedef struct sdi12_cache_waiter
+{
+    struct sdi12_cache_waiter *next;
+    char *values; // NULL if request only waits for sensor to be free
+    size_t values_length;
+    esp_err_t ret;
+    uint16_t n_values;
+    int64_t measured_us;
+    SemaphoreHandle_t done;
+    StaticSemaphore_t done_buffer;
+} sdi12_cache_waiter_t;
+
+typedef struct
+{
+    sdi12_dev_handle_t dev; // NULL on free entries. Device, not address, so same address on two buses are two sensors
+    char cmd[SDI12_CACHE_CMD_CHARS];
+    bool in_flight;
+    bool valid; // values hold results of last measurement
+    uint16_t n_values;
+    int64_t measured_us;
+    int64_t used_us;
+    char *values;
+    sdi12_cache_waiter_t *waiters;
+} sdi12_cache_entry_t;
+
+typedef struct sdi12_cache
+{
+    sdi12_clock_t *clock;
+    int64_t ttl_us;
+    size_t values_size;
+    size_t entries_length;
+    sdi12_cache_entry_t *entries;
+    SemaphoreHandle_t mutex; // Protects entries and stats
+    sdi12_cache_stats_t stats;
+} sdi12_cache_t;
+
+static const char *TAG = "sdi12 cache";
+
+static esp_err_t copy_values(char *out_values, size_t out_values_length, const char *values)
+{
+    size_t length = strlen(values);
+
+    if (length >= out_values_length)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    memcpy(out_values, values, length + 1);
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Send measurement cmd and read its values. Called without mutex.
+ */
+static esp_err_t run_measurement(sdi12_cache_t *cache, sdi12_dev_handle_t dev, const char *cmd, char *values, size_t values_size,
+    uint16_t *out_n_values, int64_t *out_measured_us, uint32_t timeout)
+{
+    char line[SDI12_CACHE_LINE_CHARS];
+    bool crc = (cmd[0] == 'M' || cmd[0] == 'C') && cmd[1] == 'C';
+
+    // aM!, aV! and aH.! return after service request
+    ESP_RETURN_ON_ERROR(sdi12_dev_extended_cmd(dev, cmd, false, line, sizeof(line), timeout), TAG, "%s error", cmd);
+
+    char ttt[4] = { 0 };
+    strncpy(ttt, line + 1, 3);
+    uint16_t n_values = (uint16_t)strtol(line + 4, NULL, 10);
+
+    if (cmd[0] == 'C')
+    {
+        int64_t ready_us = cache->clock->now_us(cache->clock) + strtol(ttt, NULL, 10) * 1000000LL;
+
+        while (cache->clock->now_us(cache->clock) < ready_us)
+        {
+            cache->clock->sleep_until(cache->clock, ready_us);
+        }
+    }
+
+    *out_measured_us = cache->clock->now_us(cache->clock);
+
+    size_t length = 0;
+    uint16_t collected = 0;
+
+    values[0] = '\0';
+
+    for (uint8_t d_index = 0; d_index <= SDI12_CACHE_MAX_D_INDEX && collected < n_values; d_index++)
+    {
+        char d_cmd[3] = { 'D', d_index + '0', '\0' };
+
+        ESP_RETURN_ON_ERROR(sdi12_dev_extended_cmd(dev, d_cmd, crc, line, sizeof(line), timeout), TAG, "%s error", d_cmd);
+
+        size_t line_length = strlen(line + 1); // Skip address
+
+        if (line_length == 0)
+        {
+            // Measurement has fewer values than announced, i.e. aborted
+            break;
+        }
+
+        ESP_RETURN_ON_FALSE(length + line_length < values_size, ESP_ERR_INVALID_SIZE, TAG, "values don't fit");
+
+        memcpy(values + length, line + 1, line_length + 1);
+        length += line_length;
+        collected += sdi12_values_count(line + 1);
+    }
+
+    *out_n_values = collected;
+
+    return ESP_OK;
+}
+
+static sdi12_cache_entry_t *find_entry(sdi12_cache_t *cache, sdi12_dev_handle_t dev, const char *cmd)
+{
+    for (size_t i = 0; i < cache->entries_length; i++)
+    {
+        sdi12_cache_entry_t *entry = &cache->entries[i];
+
+        if (entry->dev == dev && (!cmd || strcmp(entry->cmd, cmd) == 0))
+        {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static sdi12_cache_entry_t *find_in_flight(sdi12_cache_t *cache, sdi12_dev_handle_t dev)
+{
+    for (size_t i = 0; i < cache->entries_length; i++)
+    {
+        if (cache->entries[i].dev == dev && cache->entries[i].in_flight)
+        {
+            return &cache->entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Get a free entry, or least recently used idle one. NULL if every entry is in flight.
+ */
+static sdi12_cache_entry_t *take_entry(sdi12_cache_t *cache)
+{
+    sdi12_cache_entry_t *lru = NULL;
+
+    for (size_t i = 0; i < cache->entries_length; i++)
+    {
+        sdi12_cache_entry_t *entry = &cache->entries[i];
+
+        if (!entry->dev)
+        {
+            return entry;
+        }
+
+        if (!entry->in_flight && (!lru || entry->used_us < lru->used_us))
+        {
+            lru = entry;
+        }
+    }
+
+    if (lru)
+    {
+        ++cache->stats.evictions;
+    }
+
+    return lru;
+}
+
+static void fill_info(sdi12_cache_info_t *out_info, uint16_t n_values, int64_t measured_us, sdi12_cache_source_t source)
+{
+    if (out_info)
+    {
+        out_info->n_values = n_values;
+        out_info->measured_us = measured_us;
+        out_info->source = source;
+    }
+}
+
+/**
+ * @brief Join running measurement of sensor. Called with mutex, which is released while waiting.
+ */
+static void wait_flight(sdi12_cache_t *cache, sdi12_cache_entry_t *entry, sdi12_cache_waiter_t *waiter)
+{
+    waiter->done = xSemaphoreCreateBinaryStatic(&waiter->done_buffer);
+    waiter->next = entry->waiters;
+    entry->waiters = waiter;
+
+    xSemaphoreGive(cache->mutex);
+    xSemaphoreTake(waiter->done, portMAX_DELAY);
+    xSemaphoreTake(cache->mutex, portMAX_DELAY);
+
+    vSemaphoreDelete(waiter->done);
+}
+
+/**
+ * @brief Store flight results and wake up its waiters. Called with mutex.
+ */
+static void land_flight(sdi12_cache_t *cache, sdi12_cache_entry_t *entry, esp_err_t ret)
+{
+    entry->in_flight = false;
+    entry->valid = ret == ESP_OK;
+
+    ++cache->stats.measured;
+    cache->stats.errors += ret != ESP_OK;
+
+    for (sdi12_cache_waiter_t *waiter = entry->waiters; waiter; waiter = waiter->next)
+    {
+        waiter->ret = ret;
+        waiter->n_values = entry->n_values;
+        waiter->measured_us = entry->measured_us;
+
+        if (waiter->values && ret == ESP_OK)
+        {
+            waiter->ret = copy_values(waiter->values, waiter->values_length, entry->values);
+        }
+
+        // Waiter runs once mutex is released
+        xSemaphoreGive(waiter->done);
+    }
+
+    entry->waiters = NULL;
+
+    if (!entry->valid)
+    {
+        entry->dev = NULL;
+    }
+}
+
+esp_err_t sdi12_cache_measure(sdi12_cache_handle_t cache, sdi12_dev_handle_t dev, const char *cmd, char *out_values, size_t out_values_length,
+    sdi12_cache_info_t *out_info, uint32_t timeout)
+{
+    ESP_RETURN_ON_FALSE(cache && dev && cmd && out_values && out_values_length > 0, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+    ESP_RETURN_ON_FALSE(strlen(cmd) < SDI12_CACHE_CMD_CHARS && (cmd[0] == 'M' || cmd[0] == 'C' || cmd[0] == 'V' || cmd[0] == 'H'),
+        ESP_ERR_INVALID_ARG, TAG, "invalid measurement cmd");
+
+    esp_err_t ret;
+    sdi12_cache_entry_t *entry;
+
+    xSemaphoreTake(cache->mutex, portMAX_DELAY);
+
+    while (true)
+    {
+        int64_t now_us = cache->clock->now_us(cache->clock);
+        entry = find_entry(cache, dev, cmd);
+
+        if (entry && entry->valid && !entry->in_flight && now_us - entry->measured_us < cache->ttl_us)
+        {
+            entry->used_us = now_us;
+            ret = copy_values(out_values, out_values_length, entry->values);
+            fill_info(out_info, entry->n_values, entry->measured_us, SDI12_CACHE_HIT);
+            ++cache->stats.hits;
+            xSemaphoreGive(cache->mutex);
+
+            return ret;
+        }
+
+        // Only one measurement per sensor, so aDx! gets values of its own measurement
+        sdi12_cache_entry_t *flight = find_in_flight(cache, dev);
+        sdi12_cache_waiter_t waiter = { 0 };
+
+        if (flight && flight == entry)
+        {
+            waiter.values = out_values;
+            waiter.values_length = out_values_length;
+            ++cache->stats.shared;
+            wait_flight(cache, flight, &waiter);
+            xSemaphoreGive(cache->mutex);
+
+            fill_info(out_info, waiter.n_values, waiter.measured_us, SDI12_CACHE_SHARED);
+            return waiter.ret;
+        }
+
+        if (flight)
+        {
+            wait_flight(cache, flight, &waiter);
+            continue;
+        }
+
+        entry = entry ? entry : take_entry(cache);
+
+        if (entry)
+        {
+            break;
+        }
+
+        // Every entry is in flight, on other sensors. A measurement run without entry couldn't be seen by find_in_flight(), so request
+        // waits for one to land.
+        ++cache->stats.full_waits;
+        wait_flight(cache, &cache->entries[0], &waiter);
+    }
+
+    entry->dev = dev;
+    strcpy(entry->cmd, cmd);
+    entry->in_flight = true;
+    entry->valid = false;
+    entry->used_us = cache->clock->now_us(cache->clock);
+    xSemaphoreGive(cache->mutex);
+
+    // Entry values aren't read by anyone while in flight
+    ret = run_measurement(cache, dev, cmd, entry->values, cache->values_size, &entry->n_values, &entry->measured_us, timeout);
+
+    xSemaphoreTake(cache->mutex, portMAX_DELAY);
+    fill_info(out_info, entry->n_values, entry->measured_us, SDI12_CACHE_MEASURED);
+
+    if (ret == ESP_OK)
+    {
+        ret = copy_values(out_values, out_values_length, entry->values);
+    }
+
+    land_flight(cache, entry, ret);
+    xSemaphoreGive(cache->mutex);
+
+    return ret;
+}
+
+esp_err_t sdi12_cache_invalidate(sdi12_cache_handle_t cache, sdi12_dev_handle_t dev, const char *cmd)
+{
+    ESP_RETURN_ON_FALSE(cache && dev, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    xSemaphoreTake(cache->mutex, portMAX_DELAY);
+
+    for (size_t i = 0; i < cache->entries_length; i++)
+    {
+        sdi12_cache_entry_t *entry = &cache->entries[i];
+
+        if (entry->dev == dev && !entry->in_flight && (!cmd || strcmp(entry->cmd, cmd) == 0))
+        {
+            entry->dev = NULL;
+            entry->valid = false;
+        }
+    }
+
+    xSemaphoreGive(cache->mutex);
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_cache_get_stats(sdi12_cache_handle_t cache, sdi12_cache_stats_t *out_stats)
+{
+    ESP_RETURN_ON_FALSE(cache && out_stats, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    xSemaphoreTake(cache->mutex, portMAX_DELAY);
+    *out_stats = cache->stats;
+    xSemaphoreGive(cache->mutex);
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_del_cache(sdi12_cache_handle_t cache)
+{
+    ESP_RETURN_ON_FALSE(cache, ESP_ERR_INVALID_ARG, TAG, "cache is NULL");
+
+    if (cache->entries)
+    {
+        for (size_t i = 0; i < cache->entries_length; i++)
+        {
+            free(cache->entries[i].values);
+        }
+
+        free(cache->entries);
+    }
+
+    if (cache->mutex)
+    {
+        vSemaphoreDelete(cache->mutex);
+    }
+
+    free(cache);
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_new_cache(const sdi12_cache_config_t *config, sdi12_cache_handle_t *ret_cache)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(config && ret_cache && config->entries > 0, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    sdi12_cache_t *cache = calloc(1, sizeof(sdi12_cache_t));
+    ESP_RETURN_ON_FALSE(cache, ESP_ERR_NO_MEM, TAG, "can't allocate cache");
+
+    cache->clock = config->clock ? config->clock : sdi12_clock_get_system();
+    cache->ttl_us = (int64_t)config->ttl_ms * 1000;
+    cache->values_size = config->values_size != 0 ? config->values_size : SDI12_CACHE_DEFAULT_VALUES_SIZE;
+    cache->entries_length = config->entries;
+    cache->entries = calloc(config->entries, sizeof(sdi12_cache_entry_t));
+    ESP_GOTO_ON_FALSE(cache->entries, ESP_ERR_NO_MEM, err, TAG, "can't allocate entries");
+
+    for (size_t i = 0; i < config->entries; i++)
+    {
+        cache->entries[i].values = malloc(cache->values_size);
+        ESP_GOTO_ON_FALSE(cache->entries[i].values, ESP_ERR_NO_MEM, err, TAG, "can't allocate values");
+    }
+
+    cache->mutex = xSemaphoreCreateMutex();
+    ESP_GOTO_ON_FALSE(cache->mutex, ESP_ERR_NO_MEM, err, TAG, "can't create mutex");
+
+    *ret_cache = cache;
+    return ESP_OK;
+
+err:
+    sdi12_del_cache(cache);
+    return ret;
+}
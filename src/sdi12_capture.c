@@ -0,0 +1,173 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "esp_check.h"
+#include "esp_log.h"
+
+#include "sdi12_defs.h"
+#include "sdi12_capture_priv.h"
+
+static const char *TAG = "sdi12 capture";
+
+#if CONFIG_SDI12_CAPTURE
+
+typedef struct __attribute__((packed))
+{
+    char magic[4];
+    uint8_t version;
+    uint8_t reserved;
+    uint16_t bit_width_us;
+} sdi12_capture_file_header_t;
+
+typedef struct __attribute__((packed))
+{
+    uint16_t num_symbols;
+    int16_t ret;
+    uint32_t done_us;
+    uint16_t buffer_length;
+    uint8_t cmd_length;
+    uint8_t rx_error;
+} sdi12_capture_record_header_t;
+
+static StaticSemaphore_t s_lock_buffer;
+static SemaphoreHandle_t s_lock = NULL;
+static sdi12_capture_write_t s_write = NULL; // Capture is running while set
+static void *s_ctx = NULL;
+static size_t s_records = 0;
+static bool s_failed = false;
+
+void sdi12_capture_reception(const char *cmd, const rmt_symbol_word_t *symbols, size_t num_symbols, size_t buffer_length, esp_err_t ret,
+    uint8_t rx_error, int64_t done_us)
+{
+    // Unlocked check keeps disabled capture cheap. Sink is checked again with lock held.
+    if (!s_write)
+    {
+        return;
+    }
+
+    size_t cmd_length = cmd ? strnlen(cmd, UINT8_MAX) : 0;
+    sdi12_capture_record_header_t header = {
+        .num_symbols = num_symbols,
+        .ret = (int16_t)ret,
+        .done_us = (uint32_t)done_us,
+        .buffer_length = buffer_length < UINT16_MAX ? buffer_length : UINT16_MAX,
+        .cmd_length = cmd_length,
+        .rx_error = rx_error,
+    };
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    if (s_write)
+    {
+        // rmt_symbol_word_t is a 32 bit word, so symbols are written as they are on little endian chips
+        esp_err_t err = s_write(&header, sizeof(header), s_ctx);
+        err = err == ESP_OK && cmd_length > 0 ? s_write(cmd, cmd_length, s_ctx) : err;
+        err = err == ESP_OK && num_symbols > 0 ? s_write(symbols, num_symbols * sizeof(rmt_symbol_word_t), s_ctx) : err;
+
+        if (err == ESP_OK)
+        {
+            ++s_records;
+        }
+        else
+        {
+            ESP_LOGE(TAG, "sink error %s, capture stopped", esp_err_to_name(err));
+            s_write = NULL;
+            s_failed = true;
+        }
+    }
+
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t sdi12_capture_start(sdi12_capture_write_t write, void *ctx)
+{
+    ESP_RETURN_ON_FALSE(write, ESP_ERR_INVALID_ARG, TAG, "no capture sink");
+
+    if (!s_lock)
+    {
+        s_lock = xSemaphoreCreateMutexStatic(&s_lock_buffer);
+    }
+
+    sdi12_capture_file_header_t header = {
+        .magic = { 'S', '1', '2', 'C' },
+        .version = SDI12_CAPTURE_VERSION,
+        .bit_width_us = SDI12_BIT_WIDTH_US,
+    };
+
+    esp_err_t ret = ESP_OK;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    if (s_write)
+    {
+        ret = ESP_ERR_INVALID_STATE;
+    }
+    else
+    {
+        ret = write(&header, sizeof(header), ctx);
+
+        if (ret == ESP_OK)
+        {
+            s_records = 0;
+            s_failed = false;
+            s_ctx = ctx;
+            s_write = write;
+        }
+    }
+
+    xSemaphoreGive(s_lock);
+
+    return ret;
+}
+
+esp_err_t sdi12_capture_stop(size_t *out_records)
+{
+    ESP_RETURN_ON_FALSE(s_lock, ESP_ERR_INVALID_STATE, TAG, "capture never started");
+
+    esp_err_t ret = ESP_OK;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    if (s_failed)
+    {
+        ret = ESP_FAIL;
+    }
+    else if (!s_write)
+    {
+        ret = ESP_ERR_INVALID_STATE;
+    }
+
+    s_write = NULL;
+    s_failed = false;
+
+    if (out_records)
+    {
+        *out_records = s_records;
+    }
+
+    xSemaphoreGive(s_lock);
+
+    return ret;
+}
+
+#else
+
+void sdi12_capture_reception(const char *cmd, const rmt_symbol_word_t *symbols, size_t num_symbols, size_t buffer_length, esp_err_t ret,
+    uint8_t rx_error, int64_t done_us)
+{
+}
+
+esp_err_t sdi12_capture_start(sdi12_capture_write_t write, void *ctx)
+{
+    ESP_LOGW(TAG, "CONFIG_SDI12_CAPTURE is disabled");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t sdi12_capture_stop(size_t *out_records)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
@@ -0,0 +1,331 @@
+#include <stdlib.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_check.h"
+
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#else
+#include "esp_timer.h"
+#endif
+
+#include "sdi12_clock.h"
+
+typedef struct
+{
+    sdi12_clock_t base;
+    portMUX_TYPE lock;
+    int64_t now_us;
+} sdi12_sim_clock_t;
+
+/**
+ * @brief Task sleeping on system clock. Lives on its stack while it sleeps.
+ */
+typedef struct sdi12_clock_sleeper
+{
+    int64_t wake_us;
+    TaskHandle_t task;
+    SemaphoreHandle_t sem; // Own semaphore, so task notifications of caller are left alone
+    StaticSemaphore_t sem_buffer;
+    struct sdi12_clock_sleeper *next;
+} sdi12_clock_sleeper_t;
+
+static const char *TAG = "sdi12 clock";
+
+static portMUX_TYPE s_sleepers_lock = portMUX_INITIALIZER_UNLOCKED;
+static sdi12_clock_sleeper_t *s_sleepers = NULL; // Sorted by wake time. A sleeper is removed before its semaphore is given
+
+#if CONFIG_IDF_TARGET_LINUX
+
+static int64_t system_clock_now_us(sdi12_clock_t *clock)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static bool ensure_timer(void)
+{
+    // No esp_timer, waits are tick based
+    return false;
+}
+
+static void arm_timer(int64_t now_us)
+{
+}
+
+#else
+
+static esp_timer_handle_t s_timer = NULL; // Single timer for every sleeper, armed for the first one
+
+static int64_t system_clock_now_us(sdi12_clock_t *clock)
+{
+    return esp_timer_get_time();
+}
+
+/**
+ * @brief Arm timer for first sleeper. Must be called inside critical section.
+ */
+static void arm_timer(int64_t now_us)
+{
+    esp_timer_stop(s_timer);
+
+    if (s_sleepers)
+    {
+        esp_timer_start_once(s_timer, s_sleepers->wake_us > now_us ? s_sleepers->wake_us - now_us : 0);
+    }
+}
+
+static void wake_sleepers_cb(void *arg)
+{
+    int64_t now_us = esp_timer_get_time();
+    sdi12_clock_sleeper_t *due = NULL;
+
+    portENTER_CRITICAL(&s_sleepers_lock);
+
+    // Due sleepers are at list head
+    if (s_sleepers && s_sleepers->wake_us <= now_us)
+    {
+        sdi12_clock_sleeper_t *last = s_sleepers;
+
+        while (last->next && last->next->wake_us <= now_us)
+        {
+            last = last->next;
+        }
+
+        due = s_sleepers;
+        s_sleepers = last->next;
+        last->next = NULL;
+    }
+
+    arm_timer(now_us);
+
+    portEXIT_CRITICAL(&s_sleepers_lock);
+
+    while (due)
+    {
+        // Sleeper leaves once given, so next is read before
+        sdi12_clock_sleeper_t *next = due->next;
+        xSemaphoreGive(due->sem);
+        due = next;
+    }
+}
+
+/**
+ * @brief Create timer on first sleep. It is never deleted, as system clock can't be.
+ */
+static bool ensure_timer(void)
+{
+    if (s_timer)
+    {
+        return true;
+    }
+
+    esp_timer_handle_t timer;
+    esp_timer_create_args_t timer_args = {
+        .callback = wake_sleepers_cb,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "sdi12_clock",
+    };
+
+    if (esp_timer_create(&timer_args, &timer) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "no timer, tick based wait");
+        return false;
+    }
+
+    portENTER_CRITICAL(&s_sleepers_lock);
+    bool created = s_timer == NULL;
+
+    if (created)
+    {
+        s_timer = timer;
+    }
+
+    portEXIT_CRITICAL(&s_sleepers_lock);
+
+    if (!created)
+    {
+        // Another task got there first
+        esp_timer_delete(timer);
+    }
+
+    return true;
+}
+
+#endif
+
+/**
+ * @brief Must be called inside critical section.
+ */
+static void insert_sleeper(sdi12_clock_sleeper_t *sleeper)
+{
+    sdi12_clock_sleeper_t **it = &s_sleepers;
+
+    while (*it && (*it)->wake_us <= sleeper->wake_us)
+    {
+        it = &(*it)->next;
+    }
+
+    sleeper->next = *it;
+    *it = sleeper;
+}
+
+/**
+ * @brief Must be called inside critical section.
+ *
+ * @return false if sleeper was already removed, so it is being woken up
+ */
+static bool remove_sleeper(sdi12_clock_sleeper_t *sleeper)
+{
+    for (sdi12_clock_sleeper_t **it = &s_sleepers; *it; it = &(*it)->next)
+    {
+        if (*it == sleeper)
+        {
+            *it = sleeper->next;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void system_clock_sleep_until(sdi12_clock_t *clock, int64_t wake_us)
+{
+    int64_t now_us = system_clock_now_us(clock);
+
+    if (wake_us <= now_us)
+    {
+        return;
+    }
+
+    bool timed = ensure_timer();
+    sdi12_clock_sleeper_t sleeper = {
+        .wake_us = wake_us,
+        .task = xTaskGetCurrentTaskHandle(),
+    };
+
+    // Static semaphore, no heap involved. It can't fail with a valid buffer.
+    sleeper.sem = xSemaphoreCreateBinaryStatic(&sleeper.sem_buffer);
+
+    portENTER_CRITICAL(&s_sleepers_lock);
+    insert_sleeper(&sleeper);
+
+    if (timed && s_sleepers == &sleeper)
+    {
+        arm_timer(now_us);
+    }
+
+    portEXIT_CRITICAL(&s_sleepers_lock);
+
+    // esp_timer wakes task with us resolution, tick based delays would add up to a tick of jitter. Without it, one more tick is waited,
+    // as pdMS_TO_TICKS() rounds down.
+    TickType_t wait_ticks = timed ? portMAX_DELAY : pdMS_TO_TICKS((wake_us - now_us + 999) / 1000) + 1;
+
+    if (xSemaphoreTake(sleeper.sem, wait_ticks) != pdTRUE)
+    {
+        portENTER_CRITICAL(&s_sleepers_lock);
+        bool queued = remove_sleeper(&sleeper);
+        portEXIT_CRITICAL(&s_sleepers_lock);
+
+        if (!queued)
+        {
+            // Woken up between timeout and critical section. Wait for the give before semaphore goes out of scope.
+            xSemaphoreTake(sleeper.sem, portMAX_DELAY);
+        }
+    }
+
+    vSemaphoreDelete(sleeper.sem);
+}
+
+static void system_clock_wake(sdi12_clock_t *clock, void *task)
+{
+    sdi12_clock_sleeper_t *found = NULL;
+
+    portENTER_CRITICAL(&s_sleepers_lock);
+
+    for (sdi12_clock_sleeper_t *it = s_sleepers; it; it = it->next)
+    {
+        if (it->task == (TaskHandle_t)task)
+        {
+            found = it;
+            break;
+        }
+    }
+
+    if (found)
+    {
+        // If it was first, timer fires for nothing and is armed again for next sleeper
+        remove_sleeper(found);
+    }
+
+    portEXIT_CRITICAL(&s_sleepers_lock);
+
+    if (found)
+    {
+        xSemaphoreGive(found->sem);
+    }
+}
+
+static sdi12_clock_t system_clock = {
+    .now_us = system_clock_now_us,
+    .sleep_until = system_clock_sleep_until,
+    .wake = system_clock_wake,
+};
+
+sdi12_clock_t *sdi12_clock_get_system(void)
+{
+    return &system_clock;
+}
+
+static int64_t sim_clock_now_us(sdi12_clock_t *clock)
+{
+    sdi12_sim_clock_t *sim = __containerof(clock, sdi12_sim_clock_t, base);
+
+    portENTER_CRITICAL(&sim->lock);
+    int64_t now_us = sim->now_us;
+    portEXIT_CRITICAL(&sim->lock);
+
+    return now_us;
+}
+
+static void sim_clock_sleep_until(sdi12_clock_t *clock, int64_t wake_us)
+{
+    sdi12_sim_clock_t *sim = __containerof(clock, sdi12_sim_clock_t, base);
+
+    // Nothing can happen meanwhile, so idle time is skipped
+    portENTER_CRITICAL(&sim->lock);
+    sim->now_us = wake_us > sim->now_us ? wake_us : sim->now_us;
+    portEXIT_CRITICAL(&sim->lock);
+
+    // Other tasks get the CPU, as they would on a real wait
+    taskYIELD();
+}
+
+esp_err_t sdi12_del_sim_clock(sdi12_clock_t *clock)
+{
+    ESP_RETURN_ON_FALSE(clock && clock != &system_clock, ESP_ERR_INVALID_ARG, TAG, "not a sim clock");
+
+    free(__containerof(clock, sdi12_sim_clock_t, base));
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_new_sim_clock(int64_t start_us, sdi12_clock_t **ret_clock)
+{
+    ESP_RETURN_ON_FALSE(ret_clock && start_us >= 0, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    sdi12_sim_clock_t *sim = calloc(1, sizeof(sdi12_sim_clock_t));
+    ESP_RETURN_ON_FALSE(sim, ESP_ERR_NO_MEM, TAG, "can't allocate clock");
+
+    portMUX_INITIALIZE(&sim->lock);
+    sim->now_us = start_us;
+    sim->base.now_us = sim_clock_now_us;
+    sim->base.sleep_until = sim_clock_sleep_until;
+
+    *ret_clock = &sim->base;
+    return ESP_OK;
+}
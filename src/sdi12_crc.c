@@ -0,0 +1,58 @@
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "sdi12_defs.h"
+#include "sdi12_crc.h"
+
+static const char *TAG = "sdi12 crc";
+
+void sdi12_crc_ascii(const char *data, size_t length, char out_crc[3])
+{
+    uint16_t crc = 0;
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        crc ^= (uint16_t)data[i];
+
+        for (uint8_t j = 0; j < 8; ++j)
+        {
+            if (crc & 0x0001)
+            {
+                crc >>= 1;
+                crc ^= SDI12_CRC_POLY;
+            }
+            else
+            {
+                crc >>= 1;
+            }
+        }
+    }
+
+    out_crc[0] = (char)(0x0040 | (crc >> 12));
+    out_crc[1] = (char)(0x0040 | ((crc >> 6) & 0x003F));
+    out_crc[2] = (char)(0x0040 | (crc & 0x003F));
+}
+
+esp_err_t sdi12_crc_check(const char *response, size_t length)
+{
+    if (length <= 3)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    char crc_str[4] = { 0 };
+
+    sdi12_crc_ascii(response, length - 3, crc_str);
+
+    if (memcmp(crc_str, response + length - 3, 3) == 0)
+    {
+        ESP_LOGD(TAG, "CRC: %s, Valid!", crc_str);
+        return ESP_OK;
+    }
+    else
+    {
+        ESP_LOGD(TAG, "CRC: %s, Invalid!", crc_str);
+        return ESP_ERR_INVALID_CRC;
+    }
+}
@@ -1,31 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "freertos/FreeRTOS.h"
+
 #include "esp_check.h"
 #include "esp_log.h"
 
 #include "sdi12_defs.h"
 #include "sdi12_dev.h"
+#include "sdi12_bus_priv.h"
+#include "sdi12_crc.h"
+#include "sdi12_dev_journal.h"
 
 #if CONFIG_SDI12_ENABLE_DEBUG_LOG
 #define LOG_LOCAL_LEVEL ESP_LOG_DEBUG
 #endif
 
+#define SDI12_DEV_TUNE_SLEEP_MS       (150) // Between probes: sensor falls asleep after 100 ms of marking, so every probe needs a break
+#define SDI12_DEV_TUNE_TIMEOUT_MS     (50)
+#define SDI12_DEV_TUNE_MIN_US         (1000)
+#define SDI12_DEV_TUNE_RESOLUTION_US  (250)
+#define SDI12_DEV_TUNE_ATTEMPTS       (5)
+#define SDI12_DEV_TUNE_MARGIN_PERCENT (25)
+#define SDI12_DEV_META_CMD_CHARS      (4)  // Longest measurement cmd without address nor '!' ("MC9" or "HA") plus '\0'
+#define SDI12_DEV_META_LINE_CHARS     (85) // Metadata response: address, fields, ';', CRC and '\0'
+#define SDI12_DEV_META_MAX_PARAMS     (999)
+
+/**
+ * @brief Metadata of a measurement cmd. Descriptors are fetched one by one on first use and kept as "name\0units\0description\0".
+ */
+typedef struct sdi12_dev_meta
+{
+    struct sdi12_dev_meta *next;
+    char cmd[SDI12_DEV_META_CMD_CHARS];
+    uint16_t n_params; // 0 until aI<cmd>! is sent
+    uint16_t length;   // params slots
+    char **params;     // NULL items aren't fetched yet
+} sdi12_dev_meta_t;
+
 typedef struct sdi12_dev
 {
     char address;
     sdi12_dev_info_t info;
     sdi12_bus_handle_t bus;
+    sdi12_bus_timestamps_t last_timestamps;
+    char *identity;         // Last aI! response. Metadata belongs to it
+    sdi12_dev_meta_t *meta; // Metadata catalog
 } sdi12_dev_t;
 
 static const char *TAG = "sdi12-dev";
 
+/**
+ * @brief Resume measurement started with cmd before last reset. Response is built from journal, as sensor would send it.
+ */
+static bool resume_measurement(sdi12_dev_handle_t dev, const char *cmd, char *out_buffer, size_t out_buffer_length)
+{
+    uint32_t remaining_ms;
+    uint16_t n_values;
+
+    if (!sdi12_dev_journal_resume(dev->bus, cmd, &remaining_ms, &n_values))
+    {
+        return false;
+    }
+
+    // n takes 1 digit on aM! and aV!, 2 on aC! and 3 on aH.!
+    int n_width = cmd[1] == 'C' ? 2 : (cmd[1] == 'H' ? 3 : 1);
+    uint32_t ttt = (remaining_ms + 999) / 1000;
+
+    if (cmd[1] != 'C' && remaining_ms > 0)
+    {
+        // Bus would be held until service request
+        sdi12_bus_hold(dev->bus, remaining_ms);
+        ttt = 0;
+    }
+
+    snprintf(out_buffer, out_buffer_length, "%c%03u%0*u", cmd[0], (unsigned int)ttt, n_width, (unsigned int)n_values);
+    memset(&dev->last_timestamps, 0, sizeof(dev->last_timestamps));
+
+    return true;
+}
+
+/**
+ * @brief Send cmd keeping its timestamps as last device transaction
+ */
+static esp_err_t dev_transact(sdi12_dev_handle_t dev, const char *cmd, bool crc, char *out_buffer, size_t out_buffer_length, uint32_t timeout,
+    sdi12_bus_result_t *out_result)
+{
+    if ((cmd[1] == 'M' || cmd[1] == 'C' || cmd[1] == 'V' || cmd[1] == 'H') && resume_measurement(dev, cmd, out_buffer, out_buffer_length))
+    {
+        memset(out_result, 0, sizeof(sdi12_bus_result_t));
+        out_result->response = out_buffer;
+        out_result->length = strlen(out_buffer);
+        out_result->address = out_buffer[0];
+        return ESP_OK;
+    }
+
+    esp_err_t ret = sdi12_bus_transact(dev->bus, NULL, cmd, crc, out_buffer, out_buffer_length, timeout, out_result);
+    dev->last_timestamps = out_result->timestamps;
+
+    if (ret == ESP_OK && cmd[1] == 'D' && out_result->address == cmd[0])
+    {
+        sdi12_dev_journal_data(dev->bus, out_buffer);
+    }
+
+    return ret;
+}
+
+static esp_err_t dev_send_cmd(sdi12_dev_handle_t dev, const char *cmd, bool crc, char *out_buffer, size_t out_buffer_length, uint32_t timeout)
+{
+    sdi12_bus_result_t result;
+
+    return dev_transact(dev, cmd, crc, out_buffer, out_buffer_length, timeout, &result);
+}
+
 static esp_err_t check_address(sdi12_dev_handle_t dev, char *buffer)
 {
     return dev->address == buffer[0] ? ESP_OK : ESP_ERR_INVALID_RESPONSE;
 }
 
+static void free_meta(sdi12_dev_handle_t dev)
+{
+    while (dev->meta)
+    {
+        sdi12_dev_meta_t *meta = dev->meta;
+        dev->meta = meta->next;
+
+        for (uint16_t i = 0; i < meta->length; i++)
+        {
+            free(meta->params[i]);
+        }
+
+        free(meta->params);
+        free(meta);
+    }
+}
+
 static esp_err_t parse_info(sdi12_dev_handle_t dev, char *info_buffer)
 {
+    // Same sensor, same firmware, same metadata. Anything else may have other parameters
+    if (!dev->identity || strcmp(dev->identity, info_buffer) != 0)
+    {
+        free_meta(dev);
+        free(dev->identity);
+        dev->identity = strdup(info_buffer);
+    }
+
     if (dev->info.vendor_id)
     {
         free(dev->info.vendor_id);
@@ -85,6 +205,146 @@ esp_err_t sdi12_dev_get_address(sdi12_dev_handle_t dev, char *out_address)
     return ESP_OK;
 }
 
+esp_err_t sdi12_dev_get_last_timestamps(sdi12_dev_handle_t dev, sdi12_bus_timestamps_t *out_timestamps)
+{
+    ESP_RETURN_ON_FALSE(dev && out_timestamps, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    *out_timestamps = dev->last_timestamps;
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_dev_set_timing(sdi12_dev_handle_t dev, const sdi12_bus_timing_t *timing)
+{
+    ESP_RETURN_ON_FALSE(dev, ESP_ERR_INVALID_ARG, TAG, "device is null");
+
+    return sdi12_bus_set_address_timing(dev->bus, dev->address, timing);
+}
+
+esp_err_t sdi12_dev_get_timing(sdi12_dev_handle_t dev, sdi12_bus_timing_t *out_timing)
+{
+    ESP_RETURN_ON_FALSE(dev && out_timing, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    return sdi12_bus_get_address_timing(dev->bus, dev->address, out_timing);
+}
+
+/**
+ * @brief Check sensor answers every acknowledge sent with timing
+ */
+static bool probe_timing(sdi12_dev_handle_t dev, const sdi12_bus_timing_t *timing, uint8_t attempts)
+{
+    if (sdi12_bus_set_address_timing(dev->bus, dev->address, timing) != ESP_OK)
+    {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < attempts; i++)
+    {
+        // Waited on bus clock, so simulated sensors see the idle time too
+        if (sdi12_bus_hold(dev->bus, SDI12_DEV_TUNE_SLEEP_MS) != ESP_OK)
+        {
+            return false;
+        }
+
+        if (sdi12_dev_acknowledge_active(dev, SDI12_DEV_TUNE_TIMEOUT_MS) != ESP_OK)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Binary search of shortest break (or marking) sensor accepts. high must be accepted.
+ */
+static uint16_t find_shortest(sdi12_dev_handle_t dev, sdi12_bus_timing_t timing, bool tune_break, uint16_t low, uint16_t high,
+    const sdi12_dev_tune_config_t *config)
+{
+    uint16_t *value = tune_break ? &timing.break_us : &timing.post_break_marking_us;
+
+    if (low >= high)
+    {
+        return high;
+    }
+
+    *value = low;
+
+    if (probe_timing(dev, &timing, config->attempts))
+    {
+        return low;
+    }
+
+    while (high - low > config->resolution_us)
+    {
+        uint16_t mid = low + (high - low) / 2;
+        *value = mid;
+
+        if (probe_timing(dev, &timing, config->attempts))
+        {
+            high = mid;
+        }
+        else
+        {
+            low = mid;
+        }
+    }
+
+    return high;
+}
+
+static uint16_t add_margin(uint16_t value, uint8_t margin_percent, uint16_t max)
+{
+    uint32_t with_margin = value + (uint32_t)value * margin_percent / 100;
+
+    return with_margin < max ? with_margin : max;
+}
+
+esp_err_t sdi12_dev_tune_timing(sdi12_dev_handle_t dev, const sdi12_dev_tune_config_t *config, sdi12_bus_timing_t *out_timing)
+{
+    ESP_RETURN_ON_FALSE(dev && dev->address != '?', ESP_ERR_INVALID_ARG, TAG, "invalid device");
+
+    sdi12_dev_tune_config_t tune = config ? *config : (sdi12_dev_tune_config_t){ 0 };
+    tune.min_break_us = tune.min_break_us != 0 ? tune.min_break_us : SDI12_DEV_TUNE_MIN_US;
+    tune.min_marking_us = tune.min_marking_us != 0 ? tune.min_marking_us : SDI12_DEV_TUNE_MIN_US;
+    tune.resolution_us = tune.resolution_us != 0 ? tune.resolution_us : SDI12_DEV_TUNE_RESOLUTION_US;
+    tune.attempts = tune.attempts != 0 ? tune.attempts : SDI12_DEV_TUNE_ATTEMPTS;
+    tune.margin_percent = tune.margin_percent != 0 ? tune.margin_percent : SDI12_DEV_TUNE_MARGIN_PERCENT;
+
+    esp_err_t ret = ESP_OK;
+    sdi12_bus_timing_t previous;
+    sdi12_bus_timing_t reference;
+
+    ESP_RETURN_ON_ERROR(sdi12_dev_get_timing(dev, &previous), TAG, "can't get timing");
+    ESP_RETURN_ON_ERROR(sdi12_dev_set_timing(dev, NULL), TAG, "can't reset timing");
+    ESP_RETURN_ON_ERROR(sdi12_dev_get_timing(dev, &reference), TAG, "can't get bus timing");
+
+    // Bus timing is the upper bound, so it must work
+    ESP_GOTO_ON_FALSE(probe_timing(dev, &reference, tune.attempts), ESP_ERR_NOT_FOUND, err, TAG, "addr: %c, no answer with bus timing", dev->address);
+
+    sdi12_bus_timing_t tuned = reference;
+    tuned.break_us = find_shortest(dev, tuned, true, tune.min_break_us, reference.break_us, &tune);
+    tuned.post_break_marking_us = find_shortest(dev, tuned, false, tune.min_marking_us, reference.post_break_marking_us, &tune);
+    tuned.break_us = add_margin(tuned.break_us, tune.margin_percent, reference.break_us);
+    tuned.post_break_marking_us = add_margin(tuned.post_break_marking_us, tune.margin_percent, reference.post_break_marking_us);
+
+    ESP_GOTO_ON_FALSE(probe_timing(dev, &tuned, tune.attempts), ESP_ERR_INVALID_RESPONSE, err, TAG, "addr: %c, tuned timing isn't reliable",
+        dev->address);
+
+    ESP_LOGD(TAG, "addr: %c, break %u us, marking %u us", dev->address, tuned.break_us, tuned.post_break_marking_us);
+
+    if (out_timing)
+    {
+        *out_timing = tuned;
+    }
+
+    return ESP_OK;
+
+err:
+    sdi12_dev_set_timing(dev, &previous);
+    return ret;
+}
+
 esp_err_t sdi12_dev_get_sdi_version(sdi12_dev_handle_t dev, sdi12_version_t *out_version)
 {
     ESP_RETURN_ON_FALSE(dev && out_version, ESP_ERR_INVALID_ARG, TAG, "invalid args");
@@ -125,6 +385,22 @@ esp_err_t sdi12_dev_get_optional_info(sdi12_dev_handle_t dev, char **out_optiona
     return ESP_OK;
 }
 
+esp_err_t sdi12_dev_get_journal(sdi12_dev_handle_t dev, sdi12_dev_journal_entry_t *out_entry)
+{
+    ESP_RETURN_ON_FALSE(dev && out_entry, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    return sdi12_dev_journal_get(dev->bus, dev->address, out_entry);
+}
+
+esp_err_t sdi12_dev_clear_journal(sdi12_dev_handle_t dev)
+{
+    ESP_RETURN_ON_FALSE(dev, ESP_ERR_INVALID_ARG, TAG, "device is null");
+
+    sdi12_dev_journal_clear(dev->bus, dev->address);
+
+    return ESP_OK;
+}
+
 esp_err_t sdi12_dev_acknowledge_active(sdi12_dev_handle_t dev, uint32_t timeout)
 {
     ESP_RETURN_ON_FALSE(dev, ESP_ERR_INVALID_ARG, TAG, "device is null");
@@ -133,7 +409,7 @@ esp_err_t sdi12_dev_acknowledge_active(sdi12_dev_handle_t dev, uint32_t timeout)
     cmd[0] = dev->address;
 
     char out_buffer[3]; // Response should be a<CR><LF>
-    esp_err_t ret = sdi12_bus_send_cmd(dev->bus, cmd, false, out_buffer, sizeof(out_buffer), timeout);
+    esp_err_t ret = dev_send_cmd(dev, cmd, false, out_buffer, sizeof(out_buffer), timeout);
 
     if (ret == ESP_OK)
     {
@@ -155,12 +431,20 @@ esp_err_t sdi12_dev_change_address(sdi12_dev_handle_t dev, char new_address, uin
     cmd[2] = new_address;
 
     char out_buffer[3]; // Response should be 'new address'<CR><LF>
-    esp_err_t ret = sdi12_bus_send_cmd(dev->bus, cmd, false, out_buffer, sizeof(out_buffer), timeout);
+    esp_err_t ret = dev_send_cmd(dev, cmd, false, out_buffer, sizeof(out_buffer), timeout);
 
     if (ret == ESP_OK)
     {
         if (out_buffer[0] == new_address)
         {
+            sdi12_bus_timing_t timing;
+
+            // Timing belongs to sensor, not to address
+            sdi12_dev_get_timing(dev, &timing);
+            sdi12_bus_set_address_timing(dev->bus, new_address, &timing);
+            sdi12_bus_set_address_timing(dev->bus, dev->address, NULL);
+
+            sdi12_dev_journal_clear(dev->bus, dev->address);
             dev->address = new_address;
         }
         else
@@ -183,7 +467,7 @@ esp_err_t sdi12_dev_read_identification(sdi12_dev_handle_t dev, char *out_buffer
     // Response should be 'info'<CR><LF>. Info maximum length is 34
     if (out_buffer)
     {
-        ret = sdi12_bus_send_cmd(dev->bus, cmd, false, out_buffer, out_buffer_length, timeout);
+        ret = dev_send_cmd(dev, cmd, false, out_buffer, out_buffer_length, timeout);
 
         if (ret == ESP_OK)
         {
@@ -198,7 +482,7 @@ esp_err_t sdi12_dev_read_identification(sdi12_dev_handle_t dev, char *out_buffer
     else
     {
         char temp_buf[38];
-        ret = sdi12_bus_send_cmd(dev->bus, cmd, false, temp_buf, sizeof(temp_buf), timeout);
+        ret = dev_send_cmd(dev, cmd, false, temp_buf, sizeof(temp_buf), timeout);
 
         if (ret == ESP_OK)
         {
@@ -222,7 +506,7 @@ esp_err_t sdi12_dev_address_query(sdi12_dev_handle_t dev, char *address, uint32_
     char cmd[] = "?!";
 
     char out_buffer[3]; // Response should be 'address'<CR><LF>
-    esp_err_t ret = sdi12_bus_send_cmd(dev->bus, cmd, false, out_buffer, sizeof(out_buffer), timeout);
+    esp_err_t ret = dev_send_cmd(dev, cmd, false, out_buffer, sizeof(out_buffer), timeout);
 
     if (ret == ESP_OK)
     {
@@ -257,7 +541,7 @@ esp_err_t sdi12_dev_start_measurement(sdi12_dev_handle_t dev, uint8_t m_index, b
     cmd[index] = '\0';
 
     char out_buffer[8]; // Response should be 'atttn'<CR><LF>
-    esp_err_t ret = sdi12_bus_send_cmd(dev->bus, cmd, crc, out_buffer, sizeof(out_buffer), timeout);
+    esp_err_t ret = dev_send_cmd(dev, cmd, crc, out_buffer, sizeof(out_buffer), timeout);
 
     if (ret == ESP_OK)
     {
@@ -286,7 +570,7 @@ esp_err_t sdi12_dev_read_data(sdi12_dev_handle_t dev, uint8_t d_index, bool crc,
     cmd[index++] = '!';
     cmd[index] = '\0';
 
-    esp_err_t ret = sdi12_bus_send_cmd(dev->bus, cmd, crc, out_buffer, out_buffer_length, timeout);
+    esp_err_t ret = dev_send_cmd(dev, cmd, crc, out_buffer, out_buffer_length, timeout);
 
     if (ret == ESP_OK)
     {
@@ -304,7 +588,7 @@ esp_err_t sdi12_dev_start_verification(sdi12_dev_handle_t dev, uint8_t *n_params
     cmd[0] = dev->address;
 
     char out_buffer[8]; // Response should be 'atttn'<CR><LF>
-    esp_err_t ret = sdi12_bus_send_cmd(dev->bus, cmd, false, out_buffer, sizeof(out_buffer), timeout);
+    esp_err_t ret = dev_send_cmd(dev, cmd, false, out_buffer, sizeof(out_buffer), timeout);
 
     if (ret == ESP_OK)
     {
@@ -344,7 +628,7 @@ esp_err_t sdi12_dev_start_concurrent_measurement(sdi12_dev_handle_t dev, const u
     cmd[index] = '\0';
 
     char out_buffer[8]; // Response should be 'atttnn'<CR><LF>
-    esp_err_t ret = sdi12_bus_send_cmd(dev->bus, cmd, crc, out_buffer, sizeof(out_buffer), timeout);
+    esp_err_t ret = dev_send_cmd(dev, cmd, crc, out_buffer, sizeof(out_buffer), timeout);
 
     if (ret == ESP_OK)
     {
@@ -352,7 +636,7 @@ esp_err_t sdi12_dev_start_concurrent_measurement(sdi12_dev_handle_t dev, const u
 
         if (ret == ESP_OK && n_params)
         {
-            *n_params = (uint8_t)strtol(out_buffer + 5, NULL, 0);
+            *n_params = (uint8_t)strtol(out_buffer + 4, NULL, 10);
         }
     }
 
@@ -365,16 +649,22 @@ esp_err_t sdi12_dev_read_continuos_measurement(sdi12_dev_handle_t dev, const uin
     ESP_RETURN_ON_FALSE(dev, ESP_ERR_INVALID_ARG, TAG, "device is null");
     ESP_RETURN_ON_FALSE(r_index <= 9, ESP_ERR_INVALID_ARG, TAG, "addr: %c, invalid R index", dev->address);
 
-    char cmd[5] = "";
+    char cmd[6] = "";
     uint8_t index = 0;
 
     cmd[index++] = dev->address;
     cmd[index++] = 'R';
+
+    if (crc)
+    {
+        cmd[index++] = 'C';
+    }
+
     cmd[index++] = r_index + '0';
     cmd[index++] = '!';
     cmd[index] = '\0';
 
-    esp_err_t ret = sdi12_bus_send_cmd(dev->bus, cmd, crc, out_buffer, out_buffer_length, timeout);
+    esp_err_t ret = dev_send_cmd(dev, cmd, crc, out_buffer, out_buffer_length, timeout);
 
     if (ret == ESP_OK)
     {
@@ -384,17 +674,72 @@ esp_err_t sdi12_dev_read_continuos_measurement(sdi12_dev_handle_t dev, const uin
     return ret;
 }
 
+/**
+ * @brief Build extended cmd on heap: address, cmd and '!'. Cmds have no length limit, so they aren't built on caller stack.
+ *
+ * @return cmd to free, NULL if out of memory
+ */
+static char *build_extended_cmd(sdi12_dev_handle_t dev, const char *cmd)
+{
+    size_t length = strlen(cmd) + 3; // Address, '!' and '\0'
+    char *full_cmd = malloc(length);
+
+    if (full_cmd)
+    {
+        snprintf(full_cmd, length, "%c%s!", dev->address, cmd);
+    }
+
+    return full_cmd;
+}
+
 esp_err_t sdi12_dev_extended_cmd(sdi12_dev_handle_t dev, const char *cmd, bool crc, char *out_buffer, size_t out_buffer_length, uint32_t timeout)
 {
     ESP_RETURN_ON_FALSE(dev, ESP_ERR_INVALID_ARG, TAG, "device is null");
     ESP_RETURN_ON_FALSE(cmd, ESP_ERR_INVALID_ARG, TAG, "invalid cmd");
 
-    uint8_t len = strlen(cmd);
+    char *full_cmd = build_extended_cmd(dev, cmd);
+    ESP_RETURN_ON_FALSE(full_cmd, ESP_ERR_NO_MEM, TAG, "addr: %c, can't allocate cmd", dev->address);
 
-    char full_cmd[10];
-    snprintf(full_cmd, len + 3, "%c%s!", dev->address, cmd);
+    esp_err_t ret = dev_send_cmd(dev, full_cmd, crc, out_buffer, out_buffer_length, timeout);
+    free(full_cmd);
 
-    esp_err_t ret = sdi12_bus_send_cmd(dev->bus, full_cmd, crc, out_buffer, out_buffer_length, timeout);
+    if (ret == ESP_OK)
+    {
+        ret = check_address(dev, out_buffer);
+    }
+
+    return ret;
+}
+
+esp_err_t sdi12_dev_transact(sdi12_dev_handle_t dev, const char *cmd, bool crc, char *buffer, size_t buffer_length, uint32_t timeout,
+    sdi12_bus_result_t *out_result)
+{
+    ESP_RETURN_ON_FALSE(dev && out_result, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+    ESP_RETURN_ON_FALSE(cmd && cmd[0] == dev->address, ESP_ERR_INVALID_ARG, TAG, "addr: %c, cmd isn't for device", dev->address);
+    ESP_RETURN_ON_FALSE(buffer && buffer_length > 0, ESP_ERR_INVALID_ARG, TAG, "addr: %c, no out buffer", dev->address);
+
+    esp_err_t ret = dev_transact(dev, cmd, crc, buffer, buffer_length, timeout, out_result);
+
+    if (ret == ESP_OK && out_result->address != dev->address)
+    {
+        ret = ESP_ERR_INVALID_RESPONSE;
+    }
+
+    return ret;
+}
+
+esp_err_t sdi12_dev_extended_cmd_lines(sdi12_dev_handle_t dev, const char *cmd, const sdi12_bus_lines_config_t *config, char *out_buffer,
+    size_t out_buffer_length, uint8_t *out_lines, uint32_t timeout)
+{
+    ESP_RETURN_ON_FALSE(dev, ESP_ERR_INVALID_ARG, TAG, "device is null");
+    ESP_RETURN_ON_FALSE(cmd, ESP_ERR_INVALID_ARG, TAG, "invalid cmd");
+
+    char *full_cmd = build_extended_cmd(dev, cmd);
+    ESP_RETURN_ON_FALSE(full_cmd, ESP_ERR_NO_MEM, TAG, "addr: %c, can't allocate cmd", dev->address);
+
+    esp_err_t ret = sdi12_bus_send_cmd_lines(dev->bus, NULL, full_cmd, config, out_buffer, out_buffer_length, timeout, out_lines,
+        &dev->last_timestamps);
+    free(full_cmd);
 
     if (ret == ESP_OK)
     {
@@ -417,7 +762,7 @@ esp_err_t sdi12_dev_read_identify_cmd(sdi12_dev_handle_t dev, const char *cmd, u
 
     char out_buffer[10]; // Response should be 'atttn', 'atttnn' or 'atttnnn' plus <CR><LF>
 
-    esp_err_t ret = sdi12_bus_send_cmd(dev->bus, full_cmd, false, out_buffer, sizeof(out_buffer), timeout);
+    esp_err_t ret = dev_send_cmd(dev, full_cmd, false, out_buffer, sizeof(out_buffer), timeout);
 
     if (ret == ESP_OK)
     {
@@ -425,13 +770,188 @@ esp_err_t sdi12_dev_read_identify_cmd(sdi12_dev_handle_t dev, const char *cmd, u
 
         if (ret == ESP_OK && n_params)
         {
-            *n_params = (uint8_t)strtol(out_buffer + 5, NULL, 10);
+            *n_params = (uint8_t)strtol(out_buffer + 4, NULL, 10);
         }
     }
 
     return ret;
 }
 
+static bool is_meta_cmd(const char *cmd)
+{
+    return cmd && strlen(cmd) > 0 && strlen(cmd) < SDI12_DEV_META_CMD_CHARS && strchr("MCVHR", cmd[0]) != NULL;
+}
+
+/**
+ * @brief Get catalog entry of cmd, reading identification first if it's unknown, so catalog is bound to an identity.
+ */
+static esp_err_t get_meta(sdi12_dev_handle_t dev, const char *cmd, sdi12_dev_meta_t **out_meta, uint32_t timeout)
+{
+    if (!dev->identity)
+    {
+        ESP_RETURN_ON_ERROR(sdi12_dev_read_identification(dev, NULL, 0, timeout), TAG, "addr: %c, can't read identification", dev->address);
+    }
+
+    sdi12_dev_meta_t *meta = dev->meta;
+
+    while (meta && strcmp(meta->cmd, cmd) != 0)
+    {
+        meta = meta->next;
+    }
+
+    if (!meta)
+    {
+        meta = calloc(1, sizeof(sdi12_dev_meta_t));
+        ESP_RETURN_ON_FALSE(meta, ESP_ERR_NO_MEM, TAG, "can't allocate metadata");
+
+        strcpy(meta->cmd, cmd);
+        meta->next = dev->meta;
+        dev->meta = meta;
+    }
+
+    *out_meta = meta;
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_dev_get_param_count(sdi12_dev_handle_t dev, const char *cmd, uint16_t *out_n_params, uint32_t timeout)
+{
+    ESP_RETURN_ON_FALSE(dev && out_n_params, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+    ESP_RETURN_ON_FALSE(is_meta_cmd(cmd) && cmd[0] != 'R', ESP_ERR_INVALID_ARG, TAG, "addr: %c, invalid cmd", dev->address);
+
+    sdi12_dev_meta_t *meta;
+    ESP_RETURN_ON_ERROR(get_meta(dev, cmd, &meta, timeout), TAG, "addr: %c, can't get metadata", dev->address);
+
+    if (meta->n_params == 0)
+    {
+        char full_cmd[8];
+        char line[10]; // Response should be 'atttn', 'atttnn' or 'atttnnn'
+
+        snprintf(full_cmd, sizeof(full_cmd), "%cI%s!", dev->address, cmd);
+        ESP_RETURN_ON_ERROR(dev_send_cmd(dev, full_cmd, false, line, sizeof(line), timeout), TAG, "addr: %c, can't read %s", dev->address, full_cmd);
+        ESP_RETURN_ON_ERROR(check_address(dev, line), TAG, "addr: %c, invalid address on %s", dev->address, full_cmd);
+
+        // n has up to 3 digits (aIHA!), so aI..! response isn't parsed with sdi12_dev_read_identify_cmd()
+        meta->n_params = (uint16_t)strtol(line + 4, NULL, 10);
+    }
+
+    *out_n_params = meta->n_params;
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Send aI<cmd>_nnn! and keep its fields
+ */
+static esp_err_t fetch_param(sdi12_dev_handle_t dev, sdi12_dev_meta_t *meta, uint16_t param, uint32_t timeout)
+{
+    if (param > meta->length)
+    {
+        char **params = realloc(meta->params, param * sizeof(char *));
+        ESP_RETURN_ON_FALSE(params, ESP_ERR_NO_MEM, TAG, "can't allocate metadata");
+
+        memset(params + meta->length, 0, (param - meta->length) * sizeof(char *));
+        meta->params = params;
+        meta->length = param;
+    }
+
+    char cmd[12];
+    char line[SDI12_DEV_META_LINE_CHARS];
+
+    snprintf(cmd, sizeof(cmd), "%cI%s_%03u!", dev->address, meta->cmd, param);
+    ESP_RETURN_ON_ERROR(dev_send_cmd(dev, cmd, false, line, sizeof(line), timeout), TAG, "addr: %c, can't read %s", dev->address, cmd);
+    ESP_RETURN_ON_ERROR(check_address(dev, line), TAG, "addr: %c, invalid address on %s", dev->address, cmd);
+
+    // CRC variants (aIMC_nnn!, aICC1_nnn!, aIRC0_nnn!...) add CRC after ';'. 'C' right after measurement letter asks for it on every type
+    if (strchr("MCR", meta->cmd[0]) != NULL && meta->cmd[1] == 'C')
+    {
+        ESP_RETURN_ON_ERROR(sdi12_crc_check(line, strlen(line)), TAG, "addr: %c, CRC error on %s", dev->address, cmd);
+    }
+
+    // Response is "a,name,units,description;"
+    char *end = strchr(line, ';');
+    ESP_RETURN_ON_FALSE(line[1] == ',' && end, ESP_ERR_INVALID_RESPONSE, TAG, "addr: %c, malformed metadata: %s", dev->address, line);
+    *end = '\0';
+
+    char *descriptor = malloc(end - line + 1); // name, units, description and their '\0'
+    ESP_RETURN_ON_FALSE(descriptor, ESP_ERR_NO_MEM, TAG, "can't allocate metadata");
+
+    char *out = descriptor;
+    uint8_t fields = 0;
+
+    // Name and units are split at first two commas. Any further field is kept as description
+    for (const char *in = line + 2; *in != '\0'; in++)
+    {
+        if (*in == ',' && fields < 2)
+        {
+            *out++ = '\0';
+            ++fields;
+        }
+        else
+        {
+            *out++ = *in;
+        }
+    }
+
+    for (; fields < 3; fields++)
+    {
+        *out++ = '\0';
+    }
+
+    meta->params[param - 1] = descriptor;
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_dev_get_param_meta(sdi12_dev_handle_t dev, const char *cmd, uint16_t param, sdi12_dev_param_meta_t *out_meta, uint32_t timeout)
+{
+    ESP_RETURN_ON_FALSE(dev && out_meta, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+    ESP_RETURN_ON_FALSE(is_meta_cmd(cmd), ESP_ERR_INVALID_ARG, TAG, "addr: %c, invalid cmd", dev->address);
+    ESP_RETURN_ON_FALSE(param >= 1 && param <= SDI12_DEV_META_MAX_PARAMS, ESP_ERR_INVALID_ARG, TAG, "addr: %c, invalid param", dev->address);
+
+    sdi12_dev_meta_t *meta;
+    ESP_RETURN_ON_ERROR(get_meta(dev, cmd, &meta, timeout), TAG, "addr: %c, can't get metadata", dev->address);
+    ESP_RETURN_ON_FALSE(meta->n_params == 0 || param <= meta->n_params, ESP_ERR_NOT_FOUND, TAG, "addr: %c, %s has %u params", dev->address, cmd,
+        meta->n_params);
+
+    if (param > meta->length || !meta->params[param - 1])
+    {
+        ESP_RETURN_ON_ERROR(fetch_param(dev, meta, param, timeout), TAG, "addr: %c, can't fetch param %u", dev->address, param);
+    }
+
+    const char *descriptor = meta->params[param - 1];
+
+    out_meta->name = descriptor;
+    out_meta->units = out_meta->name + strlen(out_meta->name) + 1;
+    out_meta->description = out_meta->units + strlen(out_meta->units) + 1;
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_dev_fetch_meta(sdi12_dev_handle_t dev, const char *cmd, uint32_t timeout)
+{
+    uint16_t n_params;
+    sdi12_dev_param_meta_t param_meta;
+
+    ESP_RETURN_ON_ERROR(sdi12_dev_get_param_count(dev, cmd, &n_params, timeout), TAG, "can't get param count");
+
+    for (uint16_t param = 1; param <= n_params; param++)
+    {
+        ESP_RETURN_ON_ERROR(sdi12_dev_get_param_meta(dev, cmd, param, &param_meta, timeout), TAG, "can't get param meta");
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_dev_clear_meta(sdi12_dev_handle_t dev)
+{
+    ESP_RETURN_ON_FALSE(dev, ESP_ERR_INVALID_ARG, TAG, "device is null");
+
+    free_meta(dev);
+
+    return ESP_OK;
+}
+
 void sdi12_del_dev(sdi12_dev_handle_t dev)
 {
     if (!dev)
@@ -439,6 +959,9 @@ void sdi12_del_dev(sdi12_dev_handle_t dev)
         return;
     }
 
+    free_meta(dev);
+    free(dev->identity);
+
     if (dev->info.vendor_id)
     {
         free(dev->info.vendor_id);
@@ -472,6 +995,7 @@ esp_err_t sdi12_new_dev(sdi12_bus_handle_t bus, char address, sdi12_dev_handle_t
     ESP_RETURN_ON_FALSE(dev, ESP_ERR_NO_MEM, TAG, "can't allocate SDI12 device");
 
     dev->bus = bus;
+    sdi12_dev_journal_attach(bus);
 
     if (address == '?')
     {
@@ -485,7 +1009,8 @@ esp_err_t sdi12_new_dev(sdi12_bus_handle_t bus, char address, sdi12_dev_handle_t
     {
         dev->address = address;
 
-        if (sdi12_dev_acknowledge_active(dev, 500) != ESP_OK)
+        // Acknowledge would abort a measurement running since before last reset
+        if (!sdi12_dev_journal_running(bus, address) && sdi12_dev_acknowledge_active(dev, 500) != ESP_OK)
         {
             ESP_LOGD(TAG, "can't find sensor with address '%c'", address);
             goto err_cmd;
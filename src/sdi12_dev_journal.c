@@ -0,0 +1,357 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "esp_attr.h"
+#include "esp_check.h"
+#include "esp_log.h"
+
+#include "sdi12_bus_priv.h"
+#include "sdi12_dev_journal.h"
+
+static const char *TAG = "sdi12 journal";
+
+#if CONFIG_SDI12_JOURNAL
+
+#include "sdi12_crc.h"
+#include "sdi12_values.h"
+
+#define SDI12_JOURNAL_SLOTS      (CONFIG_SDI12_JOURNAL_SLOTS)
+#define SDI12_JOURNAL_MAX_AGE_US ((int64_t)CONFIG_SDI12_JOURNAL_MAX_AGE_S * 1000000)
+#define SDI12_JOURNAL_MAGIC      (0x53444a32) // "SDJ2"
+
+/**
+ * @brief Journal slot. crc covers every other field, so slots left half written by a reset, or RTC garbage after power on, are dropped.
+ */
+typedef struct
+{
+    uint32_t boot;     // Boot which started or resumed measurement. 0 on free slots
+    int64_t ready_us;  // Wall time when results are ready
+    uint16_t ttt_s;    // ttt on response
+    uint16_t n_values; // n on response
+    uint16_t n_read;   // Values read with aDx! since boot
+    uint16_t bus_id;   // sdi12_bus_get_id() of bus sensor is on
+    char cmd[SDI12_DEV_JOURNAL_CMD_CHARS];
+    char crc[3];
+} sdi12_journal_slot_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t boot; // Incremented once per boot
+    sdi12_journal_slot_t slots[SDI12_JOURNAL_SLOTS];
+} sdi12_journal_t;
+
+static RTC_NOINIT_ATTR sdi12_journal_t s_journal;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool s_loaded = false;
+
+static int64_t wall_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void seal_slot(sdi12_journal_slot_t *slot)
+{
+    sdi12_crc_ascii((const char *)slot, offsetof(sdi12_journal_slot_t, crc), slot->crc);
+}
+
+static bool slot_is_valid(sdi12_journal_slot_t *slot)
+{
+    char crc[3];
+    sdi12_crc_ascii((const char *)slot, offsetof(sdi12_journal_slot_t, crc), crc);
+
+    return memcmp(crc, slot->crc, sizeof(crc)) == 0;
+}
+
+static void free_slot(sdi12_journal_slot_t *slot)
+{
+    memset(slot, 0, sizeof(sdi12_journal_slot_t));
+    seal_slot(slot);
+}
+
+/**
+ * @brief Check journal left by previous boot, on first use of each boot. Call with lock taken.
+ */
+static void load_journal(int64_t now_us)
+{
+    if (s_loaded)
+    {
+        return;
+    }
+
+    s_loaded = true;
+
+    if (s_journal.magic != SDI12_JOURNAL_MAGIC)
+    {
+        // Power on: RTC memory holds garbage
+        s_journal.magic = SDI12_JOURNAL_MAGIC;
+        s_journal.boot = 0;
+
+        for (size_t i = 0; i < SDI12_JOURNAL_SLOTS; i++)
+        {
+            free_slot(&s_journal.slots[i]);
+        }
+    }
+
+    // 0 marks free slots
+    if (++s_journal.boot == 0)
+    {
+        s_journal.boot = 1;
+    }
+
+    for (size_t i = 0; i < SDI12_JOURNAL_SLOTS; i++)
+    {
+        sdi12_journal_slot_t *slot = &s_journal.slots[i];
+
+        if (!slot_is_valid(slot) || (slot->boot != 0 && now_us - slot->ready_us > SDI12_JOURNAL_MAX_AGE_US))
+        {
+            free_slot(slot);
+        }
+    }
+}
+
+static sdi12_journal_slot_t *find_slot(uint16_t bus_id, char address)
+{
+    for (size_t i = 0; i < SDI12_JOURNAL_SLOTS; i++)
+    {
+        if (s_journal.slots[i].boot != 0 && s_journal.slots[i].bus_id == bus_id && s_journal.slots[i].cmd[0] == address)
+        {
+            return &s_journal.slots[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Time until results are ready. Wall clock can be set after reset (i.e. by SNTP), so it's never above ttt.
+ */
+static uint32_t remaining_ms(const sdi12_journal_slot_t *slot, int64_t now_us)
+{
+    int64_t remaining_us = slot->ready_us - now_us;
+
+    if (remaining_us <= 0)
+    {
+        return 0;
+    }
+
+    if (remaining_us > (int64_t)slot->ttt_s * 1000000)
+    {
+        remaining_us = (int64_t)slot->ttt_s * 1000000;
+    }
+
+    return (remaining_us + 999) / 1000;
+}
+
+/**
+ * @brief Bus measurement callback
+ */
+static void on_measurement(const char *cmd, const char *response, void *ctx)
+{
+    if (strlen(cmd) >= SDI12_DEV_JOURNAL_CMD_CHARS)
+    {
+        return;
+    }
+
+    char ttt[4] = {response[1], response[2], response[3], '\0'};
+    uint16_t n_values = (uint16_t)strtol(response + 4, NULL, 10);
+    uint16_t bus_id = sdi12_bus_get_id((sdi12_bus_handle_t)ctx);
+    int64_t now_us = wall_us();
+
+    portENTER_CRITICAL(&s_lock);
+    load_journal(now_us);
+
+    // Sensor drops previous results on every measurement, so only last one of each address is kept
+    sdi12_journal_slot_t *slot = find_slot(bus_id, cmd[0]);
+
+    for (size_t i = 0; i < SDI12_JOURNAL_SLOTS && !slot; i++)
+    {
+        if (s_journal.slots[i].boot == 0)
+        {
+            slot = &s_journal.slots[i];
+        }
+    }
+
+    if (slot)
+    {
+        if (n_values == 0)
+        {
+            free_slot(slot);
+        }
+        else
+        {
+            slot->boot = s_journal.boot;
+            slot->ttt_s = (uint16_t)strtol(ttt, NULL, 10);
+            slot->ready_us = now_us + (int64_t)slot->ttt_s * 1000000;
+            slot->n_values = n_values;
+            slot->n_read = 0;
+            slot->bus_id = bus_id;
+            strcpy(slot->cmd, cmd);
+            seal_slot(slot);
+        }
+    }
+
+    portEXIT_CRITICAL(&s_lock);
+
+    if (!slot && n_values != 0)
+    {
+        ESP_LOGW(TAG, "journal full, %s not recorded", cmd);
+    }
+}
+
+void sdi12_dev_journal_attach(sdi12_bus_handle_t bus)
+{
+    sdi12_bus_set_measurement_callback(bus, on_measurement, bus);
+}
+
+bool sdi12_dev_journal_resume(sdi12_bus_handle_t bus, const char *cmd, uint32_t *out_remaining_ms, uint16_t *out_n_values)
+{
+    int64_t now_us = wall_us();
+    bool resumed = false;
+
+    portENTER_CRITICAL(&s_lock);
+    load_journal(now_us);
+
+    sdi12_journal_slot_t *slot = find_slot(sdi12_bus_get_id(bus), cmd[0]);
+
+    // Same cmd on same boot is a new measurement
+    if (slot && slot->boot != s_journal.boot && strcmp(slot->cmd, cmd) == 0)
+    {
+        *out_remaining_ms = remaining_ms(slot, now_us);
+        *out_n_values = slot->n_values;
+        slot->boot = s_journal.boot;
+        slot->n_read = 0;
+        seal_slot(slot);
+        resumed = true;
+    }
+
+    portEXIT_CRITICAL(&s_lock);
+
+    if (resumed)
+    {
+        ESP_LOGD(TAG, "%s resumed, results ready in %" PRIu32 " ms", cmd, *out_remaining_ms);
+    }
+
+    return resumed;
+}
+
+bool sdi12_dev_journal_running(sdi12_bus_handle_t bus, char address)
+{
+    int64_t now_us = wall_us();
+    bool running = false;
+
+    portENTER_CRITICAL(&s_lock);
+    load_journal(now_us);
+
+    sdi12_journal_slot_t *slot = find_slot(sdi12_bus_get_id(bus), address);
+    running = slot && slot->boot != s_journal.boot && remaining_ms(slot, now_us) > 0;
+
+    portEXIT_CRITICAL(&s_lock);
+
+    return running;
+}
+
+void sdi12_dev_journal_data(sdi12_bus_handle_t bus, const char *response)
+{
+    uint16_t n = sdi12_values_count(response + 1);
+
+    portENTER_CRITICAL(&s_lock);
+    load_journal(wall_us());
+
+    sdi12_journal_slot_t *slot = find_slot(sdi12_bus_get_id(bus), response[0]);
+
+    if (slot)
+    {
+        slot->n_read += n;
+
+        if (n == 0 || slot->n_read >= slot->n_values)
+        {
+            free_slot(slot);
+        }
+        else
+        {
+            seal_slot(slot);
+        }
+    }
+
+    portEXIT_CRITICAL(&s_lock);
+}
+
+esp_err_t sdi12_dev_journal_get(sdi12_bus_handle_t bus, char address, sdi12_dev_journal_entry_t *out_entry)
+{
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    portENTER_CRITICAL(&s_lock);
+    load_journal(wall_us());
+
+    sdi12_journal_slot_t *slot = find_slot(sdi12_bus_get_id(bus), address);
+
+    if (slot)
+    {
+        strcpy(out_entry->cmd, slot->cmd);
+        out_entry->n_values = slot->n_values;
+        out_entry->n_read = slot->n_read;
+        out_entry->ready_us = slot->ready_us;
+        out_entry->previous_boot = slot->boot != s_journal.boot;
+        ret = ESP_OK;
+    }
+
+    portEXIT_CRITICAL(&s_lock);
+
+    return ret;
+}
+
+void sdi12_dev_journal_clear(sdi12_bus_handle_t bus, char address)
+{
+    portENTER_CRITICAL(&s_lock);
+    load_journal(wall_us());
+
+    sdi12_journal_slot_t *slot = find_slot(sdi12_bus_get_id(bus), address);
+
+    if (slot)
+    {
+        free_slot(slot);
+    }
+
+    portEXIT_CRITICAL(&s_lock);
+}
+
+#else
+
+void sdi12_dev_journal_attach(sdi12_bus_handle_t bus)
+{
+}
+
+bool sdi12_dev_journal_resume(sdi12_bus_handle_t bus, const char *cmd, uint32_t *out_remaining_ms, uint16_t *out_n_values)
+{
+    return false;
+}
+
+bool sdi12_dev_journal_running(sdi12_bus_handle_t bus, char address)
+{
+    return false;
+}
+
+void sdi12_dev_journal_data(sdi12_bus_handle_t bus, const char *response)
+{
+}
+
+esp_err_t sdi12_dev_journal_get(sdi12_bus_handle_t bus, char address, sdi12_dev_journal_entry_t *out_entry)
+{
+    ESP_LOGW(TAG, "CONFIG_SDI12_JOURNAL is disabled");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void sdi12_dev_journal_clear(sdi12_bus_handle_t bus, char address)
+{
+}
+
+#endif
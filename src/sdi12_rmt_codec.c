@@ -0,0 +1,456 @@
+#include <string.h>
+#include <sys/param.h>
+
+#include "esp_log.h"
+
+#include "sdi12_defs.h"
+#include "sdi12_rmt_codec.h"
+#include "sdi12_trace_priv.h"
+
+#define SDI12_RMT_FRAME_GAP_BITS (6) // Marking after a char longer than this ends a frame. Cmd chars are 1.66 ms apart at most
+
+static const char *TAG = "sdi12 rmt";
+
+/**
+ * @brief Cmd decoder state, fed by streaming decoder
+ */
+typedef struct
+{
+    char *out_buffer;
+    size_t out_buffer_length;
+    size_t length;
+    bool overflow;
+    bool brk;
+    sdi12_transport_rx_error_t rx_error;
+} sdi12_rmt_cmd_decoder_t;
+
+esp_err_t sdi12_rmt_decode_line(const rmt_symbol_word_t *raw_symbols, size_t symbols_length, char *out_buffer, size_t out_buffer_length,
+    size_t *out_length, sdi12_transport_rx_error_t *out_rx_error)
+{
+    size_t char_index = 0;
+    size_t symbol_index = 0;
+    bool level0 = 0; // False if level0, duration0 needed. True when level1, duration1
+    uint8_t bit_counter = 0;
+    uint8_t level;
+    uint8_t number_of_bits;
+    char c = 0;
+    bool parity = false;
+
+    while (symbol_index < symbols_length)
+    {
+        if (!level0)
+        {
+            level = raw_symbols[symbol_index].level0;
+            // (raw_symbols[index].duration0 + SDI12_BIT_WIDTH_US / 2) / SDI12_BIT_WIDTH_US -> Solve integer division round.
+            number_of_bits = (raw_symbols[symbol_index].duration0 + SDI12_BIT_WIDTH_US / 2) / SDI12_BIT_WIDTH_US;
+        }
+        else
+        {
+            level = raw_symbols[symbol_index].level1;
+            number_of_bits = (raw_symbols[symbol_index].duration1 + SDI12_BIT_WIDTH_US / 2) / SDI12_BIT_WIDTH_US;
+            ++symbol_index;
+        }
+
+        level0 = !level0;
+
+        while (number_of_bits > 0 && number_of_bits < 10)
+        {
+            switch (bit_counter)
+            {
+                // start bit
+                case 0:
+                    // We need to found start bit.
+                    if (level == 1)
+                    {
+                        ++bit_counter;
+                        parity = false;
+                        c = 0;
+                    }
+
+                    break;
+
+                // parity bit
+                case 8:
+                    if (parity != level)
+                    {
+                        SDI12_TRACE(SDI12_TRACE_PARITY_ERROR, char_index > 0 ? out_buffer[0] : '\0', char_index);
+                        out_buffer[MIN(char_index, out_buffer_length - 1)] = '\0';
+                        *out_rx_error = SDI12_TRANSPORT_RX_ERROR_PARITY;
+                        ESP_LOGE(TAG, "Reception parity error");
+                        return ESP_FAIL;
+                    }
+
+                    if (char_index < out_buffer_length)
+                    {
+                        out_buffer[char_index] = c;
+
+                        if (char_index > 0 && out_buffer[char_index] == '\n' && out_buffer[char_index - 1] == '\r')
+                        {
+                            out_buffer[char_index - 1] = '\0'; // Delete \r\n from response buffer
+                            SDI12_TRACE(SDI12_TRACE_RX_FRAME, out_buffer[0], char_index - 1);
+                            ESP_LOGD(TAG, "RX: %s", out_buffer);
+
+                            if (out_length)
+                            {
+                                *out_length = char_index - 1;
+                            }
+
+                            return ESP_OK;
+                        }
+
+                        ++char_index;
+                    }
+                    else
+                    {
+                        out_buffer[out_buffer_length - 1] = '\0';
+                        ESP_LOGE(TAG, "Out buffer too small");
+                        return ESP_ERR_INVALID_SIZE;
+                    }
+
+                    ++bit_counter;
+                    break;
+
+                // stop bit
+                case 9:
+                    if (level != 0)
+                    {
+                        SDI12_TRACE(SDI12_TRACE_STOP_ERROR, char_index > 0 ? out_buffer[0] : '\0', char_index);
+                        out_buffer[MIN(char_index, out_buffer_length - 1)] = '\0';
+                        *out_rx_error = SDI12_TRANSPORT_RX_ERROR_STOP_BIT;
+                        ESP_LOGE(TAG, "Reception Stop bit error");
+                        return ESP_FAIL;
+                    }
+
+                    bit_counter = 0;
+                    break;
+
+                // data bits. Remember inverse logic
+                default:
+                    if (level == 0)
+                    {
+                        c |= (1 << (bit_counter - 1));
+                    }
+                    else
+                    {
+                        parity = !parity;
+                    }
+
+                    ++bit_counter;
+                    break;
+            }
+
+            --number_of_bits;
+        }
+    }
+
+    // Partial line is kept for capture records and logs
+    out_buffer[MIN(char_index, out_buffer_length - 1)] = '\0';
+
+    return ESP_ERR_NOT_FOUND;
+}
+
+void sdi12_rmt_stream_init(sdi12_rmt_stream_t *stream, uint8_t gap_bits, sdi12_rmt_stream_char_cb_t on_char, sdi12_rmt_stream_frame_end_cb_t on_frame_end,
+    void *ctx)
+{
+    memset(stream, 0, sizeof(sdi12_rmt_stream_t));
+    stream->gap_bits = gap_bits;
+    stream->on_char = on_char;
+    stream->on_frame_end = on_frame_end;
+    stream->ctx = ctx;
+}
+
+void sdi12_rmt_stream_reset(sdi12_rmt_stream_t *stream)
+{
+    stream->bit_counter = 0;
+    stream->idle_bits = 0;
+    stream->in_frame = false;
+}
+
+static void stream_char_done(sdi12_rmt_stream_t *stream)
+{
+    stream->bit_counter = 0;
+    stream->idle_bits = 0;
+    stream->in_frame = true;
+    stream->on_char(stream->ctx, stream->c, stream->error, stream->char_start_us);
+}
+
+/**
+ * @brief Decode one bit. Inverse logic: level 1 is spacing (0), level 0 is marking (1).
+ */
+static void stream_decode_bit(sdi12_rmt_stream_t *stream, uint8_t level, int64_t bit_us)
+{
+    switch (stream->bit_counter)
+    {
+        // start bit or idle line
+        case 0:
+            if (level == 1)
+            {
+                stream->bit_counter = 1;
+                stream->c = 0;
+                stream->parity = false;
+                stream->error = SDI12_TRANSPORT_RX_ERROR_NONE;
+                stream->char_start_us = bit_us;
+            }
+            else if (stream->in_frame && ++stream->idle_bits > stream->gap_bits)
+            {
+                stream->in_frame = false;
+                stream->on_frame_end(stream->ctx, false);
+            }
+
+            break;
+
+        // parity bit
+        case 8:
+            if (stream->parity != level)
+            {
+                stream->error = SDI12_TRANSPORT_RX_ERROR_PARITY;
+            }
+
+            ++stream->bit_counter;
+            break;
+
+        // stop bit
+        case 9:
+            if (level != 0)
+            {
+                // Framing is lost. Char is reported with error and this bit is taken as next start bit candidate
+                if (stream->error == SDI12_TRANSPORT_RX_ERROR_NONE)
+                {
+                    stream->error = SDI12_TRANSPORT_RX_ERROR_STOP_BIT;
+                }
+
+                stream_char_done(stream);
+                stream_decode_bit(stream, level, bit_us);
+                break;
+            }
+
+            stream_char_done(stream);
+            break;
+
+        // data bits
+        default:
+            if (level == 0)
+            {
+                stream->c |= (1 << (stream->bit_counter - 1));
+            }
+            else
+            {
+                stream->parity = !stream->parity;
+            }
+
+            ++stream->bit_counter;
+            break;
+    }
+}
+
+void sdi12_rmt_stream_level(sdi12_rmt_stream_t *stream, uint8_t level, uint32_t duration_us, int64_t start_us)
+{
+    if (level == 1 && duration_us >= SDI12_CHAR_US)
+    {
+        // Spacing longer than any char (start + 7 data + parity bits) is a break
+        stream->bit_counter = 0;
+        stream->idle_bits = 0;
+        stream->in_frame = false;
+        stream->on_frame_end(stream->ctx, true);
+        return;
+    }
+
+    // Longer marking runs are only idle line
+    uint32_t bits = MIN((duration_us + SDI12_BIT_WIDTH_US / 2) / SDI12_BIT_WIDTH_US, 10U + stream->gap_bits);
+
+    for (uint32_t i = 0; i < bits; i++)
+    {
+        stream_decode_bit(stream, level, start_us + (int64_t)i * SDI12_BIT_WIDTH_US);
+    }
+}
+
+void sdi12_rmt_stream_flush(sdi12_rmt_stream_t *stream)
+{
+    if (stream->bit_counter == 9)
+    {
+        stream_char_done(stream);
+    }
+}
+
+static void cmd_frame_reset(sdi12_rmt_cmd_decoder_t *decoder, bool brk)
+{
+    decoder->length = 0;
+    decoder->overflow = false;
+    decoder->brk = brk;
+    decoder->rx_error = SDI12_TRANSPORT_RX_ERROR_NONE;
+}
+
+static void cmd_on_char(void *ctx, char c, sdi12_transport_rx_error_t error, int64_t start_us)
+{
+    sdi12_rmt_cmd_decoder_t *decoder = (sdi12_rmt_cmd_decoder_t *)ctx;
+
+    if (decoder->rx_error == SDI12_TRANSPORT_RX_ERROR_NONE)
+    {
+        decoder->rx_error = error;
+    }
+
+    if (decoder->length + 1 < decoder->out_buffer_length)
+    {
+        decoder->out_buffer[decoder->length++] = c;
+    }
+    else
+    {
+        decoder->overflow = true;
+    }
+}
+
+static void cmd_on_frame_end(void *ctx, bool brk)
+{
+    // Frame is over, a later one may be the cmd
+    cmd_frame_reset((sdi12_rmt_cmd_decoder_t *)ctx, brk);
+}
+
+esp_err_t sdi12_rmt_decode_cmd(const rmt_symbol_word_t *raw_symbols, size_t symbols_length, char *out_buffer, size_t out_buffer_length,
+    bool *out_break, sdi12_transport_rx_error_t *out_rx_error)
+{
+    sdi12_rmt_cmd_decoder_t decoder = {
+        .out_buffer = out_buffer,
+        .out_buffer_length = out_buffer_length,
+    };
+    sdi12_rmt_stream_t stream;
+
+    cmd_frame_reset(&decoder, false);
+    sdi12_rmt_stream_init(&stream, SDI12_RMT_FRAME_GAP_BITS, cmd_on_char, cmd_on_frame_end, &decoder);
+
+    for (size_t i = 0; i < symbols_length; i++)
+    {
+        // Zero duration is end marker
+        if (raw_symbols[i].duration0 == 0)
+        {
+            break;
+        }
+
+        sdi12_rmt_stream_level(&stream, raw_symbols[i].level0, raw_symbols[i].duration0, 0);
+
+        if (raw_symbols[i].duration1 == 0)
+        {
+            break;
+        }
+
+        sdi12_rmt_stream_level(&stream, raw_symbols[i].level1, raw_symbols[i].duration1, 0);
+    }
+
+    sdi12_rmt_stream_flush(&stream);
+
+    out_buffer[decoder.length < out_buffer_length ? decoder.length : out_buffer_length - 1] = '\0';
+
+    if (out_break)
+    {
+        *out_break = decoder.brk;
+    }
+
+    if (decoder.overflow)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if (decoder.rx_error != SDI12_TRANSPORT_RX_ERROR_NONE)
+    {
+        *out_rx_error = decoder.rx_error;
+        return ESP_FAIL;
+    }
+
+    return decoder.length > 0 && out_buffer[decoder.length - 1] == '!' ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+void sdi12_rmt_encode_frame(const char *data, size_t length, uint16_t break_us, uint32_t marking_us, rmt_symbol_word_t *out_symbols)
+{
+    size_t rmt_symbol_index = 0;
+
+    if (break_us > 0)
+    {
+        // Break + marking
+        out_symbols[rmt_symbol_index].level0 = SDI12_SPACING;
+        out_symbols[rmt_symbol_index].duration0 = break_us;
+        out_symbols[rmt_symbol_index].level1 = SDI12_MARKING;
+        out_symbols[rmt_symbol_index].duration1 = marking_us;
+    }
+    else
+    {
+        // Break suppressed, only marking. Zero duration is RMT end marker, so marking is split in two halves.
+        out_symbols[rmt_symbol_index].level0 = SDI12_MARKING;
+        out_symbols[rmt_symbol_index].duration0 = marking_us / 2;
+        out_symbols[rmt_symbol_index].level1 = SDI12_MARKING;
+        out_symbols[rmt_symbol_index].duration1 = marking_us - marking_us / 2;
+    }
+
+    ++rmt_symbol_index;
+
+    for (size_t char_index = 0; char_index < length; char_index++)
+    {
+        char cur_byte = data[char_index];
+        uint8_t level_to_write;
+        bool parity_bit = false;
+
+        for (uint8_t bit_index = 0; bit_index < 10; bit_index++)
+        {
+            switch (bit_index)
+            {
+                case 0: // start bit
+                    out_symbols[rmt_symbol_index].level0 = SDI12_SPACING;
+                    out_symbols[rmt_symbol_index].duration0 = SDI12_BIT_WIDTH_US;
+                    break;
+
+                case 8: // parity bit
+                    out_symbols[rmt_symbol_index].level0 = parity_bit;
+                    out_symbols[rmt_symbol_index].duration0 = SDI12_BIT_WIDTH_US;
+
+                    break;
+
+                case 9: // stop bit
+                    out_symbols[rmt_symbol_index].level1 = SDI12_MARKING;
+                    out_symbols[rmt_symbol_index].duration1 = SDI12_BIT_WIDTH_US;
+                    break;
+
+                default:                 // case 1 to 7, char bits
+
+                    if (cur_byte & 0x01) // bit == 1; Inverse -> 0 to write
+                    {
+                        level_to_write = SDI12_MARKING;
+                    }
+                    else // bit == 1; Inverse -> 1 to write
+                    {
+                        level_to_write = SDI12_SPACING;
+                        parity_bit = !parity_bit;
+                    }
+
+                    if (bit_index % 2 == 0)
+                    {
+                        out_symbols[rmt_symbol_index].level0 = level_to_write;
+                        out_symbols[rmt_symbol_index].duration0 = SDI12_BIT_WIDTH_US;
+                    }
+                    else
+                    {
+                        out_symbols[rmt_symbol_index].level1 = level_to_write;
+                        out_symbols[rmt_symbol_index].duration1 = SDI12_BIT_WIDTH_US;
+                    }
+
+                    cur_byte >>= 1;
+
+                    break;
+            }
+
+            if (bit_index % 2 == 1)
+            {
+                ++rmt_symbol_index;
+            }
+        }
+    }
+}
+
+int64_t sdi12_rmt_symbols_duration_us(const rmt_symbol_word_t *symbols, size_t symbols_length)
+{
+    int64_t duration = 0;
+
+    for (size_t i = 0; i < symbols_length; i++)
+    {
+        duration += symbols[i].duration0 + symbols[i].duration1;
+    }
+
+    return duration;
+}
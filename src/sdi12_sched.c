@@ -0,0 +1,676 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/param.h>
+#include <sys/time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_check.h"
+#include "esp_log.h"
+
+#include "sdi12_sched.h"
+#include "sdi12_values.h"
+
+#define SDI12_SCHED_EXCHANGE_MS            (400) // Estimated bus time of one cmd/response exchange: break, marking, cmd and a long data line
+#define SDI12_SCHED_DEFAULT_MAX_JITTER_MS  (10)
+#define SDI12_SCHED_DEFAULT_STACK_SIZE     (4096)
+#define SDI12_SCHED_DEFAULT_PRIORITY       (5)
+#define SDI12_SCHED_MAX_WAIT_US            (1000000) // Wait is split, so wall clock changes (i.e. SNTP sync) are noticed
+#define SDI12_SCHED_VALUES_CHARS           (512)
+#define SDI12_SCHED_LINE_CHARS             (85)
+#define SDI12_SCHED_MAX_D_INDEX            (999)
+#define SDI12_SCHED_UNPLACED               (UINT32_MAX)
+
+typedef struct
+{
+    sdi12_sched_plan_t plan;
+    uint32_t slot_ms;
+    uint32_t shift_ms;
+    int64_t next_us; // Next planned start
+    // Pending aDx! reads of a concurrent measurement. collect_us is 0 if there is none.
+    int64_t collect_us;
+    int64_t collect_scheduled_us;
+    int64_t collect_started_us;
+    uint16_t collect_n_values;
+    sdi12_bus_timestamps_t collect_timestamps;
+    sdi12_sched_plan_stats_t stats;
+} sdi12_sched_entry_t;
+
+typedef struct sdi12_sched
+{
+    sdi12_sched_entry_t *entries;
+    size_t entries_length;
+    sdi12_sched_timeline_t timeline;
+    uint32_t max_jitter_us;
+    bool wall_clock;
+    int64_t epoch_us; // Scheduler time origin if wall clock isn't used
+    sdi12_clock_t *clock;
+    TaskHandle_t task;
+    SemaphoreHandle_t done_sem;
+    volatile bool stop;
+    portMUX_TYPE lock; // Protects stats
+    char values[SDI12_SCHED_VALUES_CHARS];
+    char line[SDI12_SCHED_LINE_CHARS];
+} sdi12_sched_t;
+
+static const char *TAG = "sdi12 sched";
+
+static uint32_t gcd32(uint32_t a, uint32_t b)
+{
+    while (b != 0)
+    {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+static uint32_t plan_slot_ms(const sdi12_sched_plan_t *plan)
+{
+    if (plan->slot_ms != 0)
+    {
+        return plan->slot_ms;
+    }
+
+    // Only C start and R read can be estimated, their bus time doesn't depend on sensor measurement time.
+    return SDI12_SCHED_EXCHANGE_MS;
+}
+
+static esp_err_t check_plan(const sdi12_sched_plan_t *plan)
+{
+    ESP_RETURN_ON_FALSE(plan->dev, ESP_ERR_INVALID_ARG, TAG, "plan without device");
+    ESP_RETURN_ON_FALSE(plan->type <= SDI12_SCHED_MEASUREMENT_H, ESP_ERR_INVALID_ARG, TAG, "invalid measurement type");
+    ESP_RETURN_ON_FALSE(plan->index <= 9, ESP_ERR_INVALID_ARG, TAG, "invalid measurement index");
+    ESP_RETURN_ON_FALSE(plan->period_ms > 0 && plan->phase_ms < plan->period_ms, ESP_ERR_INVALID_ARG, TAG, "invalid period or phase");
+    ESP_RETURN_ON_FALSE(plan->slot_ms != 0 || plan->type == SDI12_SCHED_MEASUREMENT_C || plan->type == SDI12_SCHED_MEASUREMENT_R, ESP_ERR_INVALID_ARG,
+        TAG, "M and H plans need slot_ms");
+    ESP_RETURN_ON_FALSE(plan_slot_ms(plan) <= plan->period_ms, ESP_ERR_INVALID_ARG, TAG, "slot longer than period");
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Find smallest shift which places plan x without overlapping any placed plan.
+ *
+ * @details Two periodic slots, starting at cx + i*Px and cj + k*Pj, can only be apart by (cx - cj) plus multiples of gcd(Px, Pj). So they never
+ * overlap if d = (cx - cj) mod gcd is at least slot j and at most gcd - slot x. No need to go through hyperperiod.
+ *
+ * @return true if plan got a phase
+ */
+static bool place_plan(const sdi12_sched_plan_t *plans, const uint32_t *slots, const uint32_t *shifts, const size_t *placed, size_t placed_length,
+    size_t x, uint32_t *out_shift)
+{
+    // Shifting a whole period or more gives back same slot instants, so search ends there whatever max_shift_ms is
+    int64_t max_shift = MIN(plans[x].max_shift_ms, plans[x].period_ms - 1);
+    int64_t shift = 0;
+    bool moved = true;
+
+    while (moved)
+    {
+        moved = false;
+
+        for (size_t i = 0; i < placed_length; i++)
+        {
+            size_t j = placed[i];
+            int64_t g = gcd32(plans[x].period_ms, plans[j].period_ms);
+
+            if (slots[x] + slots[j] > g)
+            {
+                // Overlaps whatever the phase
+                return false;
+            }
+
+            int64_t cx = (int64_t)plans[x].phase_ms + shift;
+            int64_t cj = (int64_t)plans[j].phase_ms + shifts[j];
+            int64_t d = ((cx - cj) % g + g) % g;
+
+            if (d < slots[j] || d > g - slots[x])
+            {
+                shift += d < slots[j] ? slots[j] - d : g - d + slots[j];
+                moved = true;
+
+                if (shift > max_shift)
+                {
+                    return false;
+                }
+            }
+        }
+    }
+
+    *out_shift = (uint32_t)shift;
+
+    return true;
+}
+
+static esp_err_t compute_timeline(const sdi12_sched_plan_t *plans, size_t plans_length, sdi12_sched_timeline_t *out_timeline, uint32_t *out_shifts_ms)
+{
+    esp_err_t ret = ESP_OK;
+    uint32_t *slots = calloc(plans_length, sizeof(uint32_t));
+    size_t *placed = calloc(plans_length, sizeof(size_t));
+    size_t *order = calloc(plans_length, sizeof(size_t));
+
+    ESP_GOTO_ON_FALSE(slots && placed && order, ESP_ERR_NO_MEM, err, TAG, "can't allocate timeline");
+
+    uint32_t utilization = 0;
+
+    for (size_t i = 0; i < plans_length; i++)
+    {
+        ESP_GOTO_ON_ERROR(check_plan(&plans[i]), err, TAG, "invalid plan %u", (unsigned int)i);
+        slots[i] = plan_slot_ms(&plans[i]);
+        utilization += (uint32_t)(((uint64_t)slots[i] * 1000 + plans[i].period_ms - 1) / plans[i].period_ms);
+        out_shifts_ms[i] = SDI12_SCHED_UNPLACED;
+
+        // Shortest period first: frequent plans have least room to move
+        size_t k = i;
+
+        while (k > 0 && plans[order[k - 1]].period_ms > plans[i].period_ms)
+        {
+            order[k] = order[k - 1];
+            --k;
+        }
+
+        order[k] = i;
+    }
+
+    size_t placed_length = 0;
+
+    for (size_t i = 0; i < plans_length; i++)
+    {
+        size_t x = order[i];
+
+        if (place_plan(plans, slots, out_shifts_ms, placed, placed_length, x, &out_shifts_ms[x]))
+        {
+            placed[placed_length++] = x;
+        }
+        else
+        {
+            ESP_LOGW(TAG, "plan %u doesn't fit the bus", (unsigned int)x);
+        }
+    }
+
+    out_timeline->utilization_permille = utilization > UINT16_MAX ? UINT16_MAX : utilization;
+    out_timeline->unplaced = plans_length - placed_length;
+    out_timeline->fits = out_timeline->unplaced == 0;
+
+err:
+    free(slots);
+    free(placed);
+    free(order);
+
+    return ret;
+}
+
+esp_err_t sdi12_sched_check_plans(const sdi12_sched_plan_t *plans, size_t plans_length, sdi12_sched_timeline_t *out_timeline, uint32_t *out_shifts_ms)
+{
+    ESP_RETURN_ON_FALSE(plans && plans_length > 0 && out_timeline, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    uint32_t *shifts = out_shifts_ms ? out_shifts_ms : calloc(plans_length, sizeof(uint32_t));
+    ESP_RETURN_ON_FALSE(shifts, ESP_ERR_NO_MEM, TAG, "can't allocate shifts");
+
+    esp_err_t ret = compute_timeline(plans, plans_length, out_timeline, shifts);
+
+    if (!out_shifts_ms)
+    {
+        free(shifts);
+    }
+
+    return ret;
+}
+
+static int64_t sched_now_us(sdi12_sched_t *sched)
+{
+    if (sched->wall_clock)
+    {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+    }
+
+    return sched->clock->now_us(sched->clock) - sched->epoch_us;
+}
+
+/**
+ * @brief Set next start to first period boundary (plus phase and shift) not before now
+ */
+static void align_next(sdi12_sched_entry_t *entry, int64_t now_us)
+{
+    int64_t period_us = (int64_t)entry->plan.period_ms * 1000;
+    int64_t offset_us = ((int64_t)entry->plan.phase_ms + entry->shift_ms) * 1000;
+    int64_t next_us = ((now_us - offset_us) / period_us) * period_us + offset_us;
+
+    while (next_us < now_us)
+    {
+        next_us += period_us;
+    }
+
+    entry->next_us = next_us;
+}
+
+/**
+ * @brief Send aDx! cmds until n_values are collected or sensor has no more values. Values are stored on sched values buffer.
+ *
+ * @return ESP_ERR_INVALID_RESPONSE if fewer than n_values were collected. Collected ones are kept
+ */
+static esp_err_t read_values(sdi12_sched_t *sched, sdi12_sched_entry_t *entry, uint16_t n_values, uint16_t *out_n_values)
+{
+    size_t length = 0;
+    uint16_t collected = 0;
+    char cmd[5];
+
+    sched->values[0] = '\0';
+
+    for (uint16_t d_index = 0; d_index <= SDI12_SCHED_MAX_D_INDEX && collected < n_values; d_index++)
+    {
+        snprintf(cmd, sizeof(cmd), "D%u", d_index);
+        esp_err_t ret = sdi12_dev_extended_cmd(entry->plan.dev, cmd, entry->plan.crc, sched->line, sizeof(sched->line), 0);
+
+        if (ret != ESP_OK)
+        {
+            *out_n_values = collected;
+            return ret;
+        }
+
+        const char *values = sched->line + 1; // Skip address
+        size_t values_length = strlen(values);
+
+        if (values_length == 0)
+        {
+            // Measurement has fewer values than announced, i.e. aborted
+            break;
+        }
+
+        if (length + values_length >= sizeof(sched->values))
+        {
+            *out_n_values = collected;
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        memcpy(sched->values + length, values, values_length + 1);
+        length += values_length;
+        collected += sdi12_values_count(values);
+    }
+
+    *out_n_values = collected;
+
+    // i.e. aborted measurement or values not ready yet: sample isn't complete
+    return collected < n_values ? ESP_ERR_INVALID_RESPONSE : ESP_OK;
+}
+
+static void deliver_sample(sdi12_sched_t *sched, size_t entry_index, int64_t scheduled_us, int64_t started_us, esp_err_t ret, uint16_t n_values,
+    const sdi12_bus_timestamps_t *timestamps)
+{
+    sdi12_sched_entry_t *entry = &sched->entries[entry_index];
+
+    if (ret != ESP_OK)
+    {
+        ESP_LOGD(TAG, "plan %u sample error: %s", (unsigned int)entry_index, esp_err_to_name(ret));
+
+        portENTER_CRITICAL(&sched->lock);
+        ++entry->stats.errors;
+        portEXIT_CRITICAL(&sched->lock);
+    }
+
+    if (entry->plan.on_data)
+    {
+        sdi12_sched_sample_t sample = {
+            .scheduled_us = scheduled_us,
+            .started_us = started_us,
+            .ret = ret,
+            .values = ret == ESP_OK ? sched->values : "",
+            .n_values = ret == ESP_OK ? n_values : 0,
+            .timestamps = *timestamps,
+        };
+
+        entry->plan.on_data(entry_index, &sample, entry->plan.ctx);
+    }
+}
+
+/**
+ * @brief Parse 'atttn', 'atttnn' or 'atttnnn' response
+ */
+static void parse_measurement_response(const char *response, uint16_t *out_seconds, uint16_t *out_n_values)
+{
+    char ttt[4] = { 0 };
+
+    strncpy(ttt, response + 1, 3);
+    *out_seconds = (uint16_t)strtol(ttt, NULL, 10);
+    *out_n_values = (uint16_t)strtol(response + 4, NULL, 10);
+}
+
+/**
+ * @brief Build measurement cmd without address nor '!'. i.e. "M", "MC3" or "C1"
+ */
+static void build_measurement_cmd(char *cmd, char letter, bool crc, uint8_t index)
+{
+    uint8_t i = 0;
+
+    cmd[i++] = letter;
+
+    if (crc)
+    {
+        cmd[i++] = 'C';
+    }
+
+    if (index != 0)
+    {
+        cmd[i++] = index + '0';
+    }
+
+    cmd[i] = '\0';
+}
+
+static void run_start(sdi12_sched_t *sched, size_t entry_index)
+{
+    sdi12_sched_entry_t *entry = &sched->entries[entry_index];
+    const sdi12_sched_plan_t *plan = &entry->plan;
+    int64_t scheduled_us = entry->next_us;
+    int64_t started_us = sched_now_us(sched);
+    int64_t bus_start_us = sched->clock->now_us(sched->clock);
+    uint16_t seconds = 0;
+    uint16_t n_values = 0;
+    char cmd[5];
+    esp_err_t ret;
+    sdi12_bus_timestamps_t timestamps;
+
+    switch (plan->type)
+    {
+        case SDI12_SCHED_MEASUREMENT_M:
+        case SDI12_SCHED_MEASUREMENT_H:
+            // Bus waits for service request inside cmd
+            if (plan->type == SDI12_SCHED_MEASUREMENT_M)
+            {
+                build_measurement_cmd(cmd, 'M', plan->crc, plan->index);
+            }
+            else
+            {
+                strcpy(cmd, "HA");
+            }
+
+            ret = sdi12_dev_extended_cmd(plan->dev, cmd, false, sched->line, sizeof(sched->line), 0);
+            sdi12_dev_get_last_timestamps(plan->dev, &timestamps);
+
+            if (ret == ESP_OK)
+            {
+                parse_measurement_response(sched->line, &seconds, &n_values);
+                ret = read_values(sched, entry, n_values, &n_values);
+            }
+
+            deliver_sample(sched, entry_index, scheduled_us, started_us, ret, n_values, &timestamps);
+            break;
+
+        case SDI12_SCHED_MEASUREMENT_C:
+            build_measurement_cmd(cmd, 'C', plan->crc, plan->index);
+            ret = sdi12_dev_extended_cmd(plan->dev, cmd, false, sched->line, sizeof(sched->line), 0);
+            sdi12_dev_get_last_timestamps(plan->dev, &timestamps);
+
+            if (ret == ESP_OK)
+            {
+                // Bus is free meanwhile. Values are read on a later gap.
+                parse_measurement_response(sched->line, &seconds, &n_values);
+                entry->collect_scheduled_us = scheduled_us;
+                entry->collect_started_us = started_us;
+                entry->collect_n_values = n_values;
+                entry->collect_timestamps = timestamps;
+                // ttt counts from response end, not from cmd start. Scheduler time can be wall clock, so it is taken back from bus clock.
+                int64_t response_end_us = sched_now_us(sched) - (sched->clock->now_us(sched->clock) - timestamps.response_end_us);
+                entry->collect_us = response_end_us + (int64_t)seconds * 1000000;
+            }
+            else
+            {
+                deliver_sample(sched, entry_index, scheduled_us, started_us, ret, 0, &timestamps);
+            }
+            break;
+
+        case SDI12_SCHED_MEASUREMENT_R:
+        default:
+            ret = sdi12_dev_read_continuos_measurement(plan->dev, plan->index, plan->crc, sched->line, sizeof(sched->line), 0);
+            sdi12_dev_get_last_timestamps(plan->dev, &timestamps);
+
+            if (ret == ESP_OK)
+            {
+                snprintf(sched->values, sizeof(sched->values), "%s", sched->line + 1);
+                n_values = sdi12_values_count(sched->values);
+            }
+
+            deliver_sample(sched, entry_index, scheduled_us, started_us, ret, n_values, &timestamps);
+            break;
+    }
+
+    uint32_t jitter_us = started_us > scheduled_us ? (uint32_t)(started_us - scheduled_us) : 0;
+    uint32_t bus_us = (uint32_t)(sched->clock->now_us(sched->clock) - bus_start_us);
+
+    portENTER_CRITICAL(&sched->lock);
+    ++entry->stats.runs;
+    entry->stats.total_jitter_us += jitter_us;
+    entry->stats.max_jitter_us = jitter_us > entry->stats.max_jitter_us ? jitter_us : entry->stats.max_jitter_us;
+    entry->stats.max_bus_us = bus_us > entry->stats.max_bus_us ? bus_us : entry->stats.max_bus_us;
+
+    if (jitter_us > sched->max_jitter_us)
+    {
+        ++entry->stats.late;
+    }
+
+    if (bus_us > entry->slot_ms * 1000)
+    {
+        ++entry->stats.overruns;
+    }
+
+    portEXIT_CRITICAL(&sched->lock);
+}
+
+static void run_collect(sdi12_sched_t *sched, size_t entry_index)
+{
+    sdi12_sched_entry_t *entry = &sched->entries[entry_index];
+    uint16_t n_values = 0;
+
+    entry->collect_us = 0;
+    esp_err_t ret = read_values(sched, entry, entry->collect_n_values, &n_values);
+    deliver_sample(sched, entry_index, entry->collect_scheduled_us, entry->collect_started_us, ret, n_values, &entry->collect_timestamps);
+}
+
+static void wait_until(sdi12_sched_t *sched, int64_t now_us, int64_t wake_us)
+{
+    int64_t delay_us = wake_us - now_us;
+
+    if (delay_us > SDI12_SCHED_MAX_WAIT_US)
+    {
+        delay_us = SDI12_SCHED_MAX_WAIT_US;
+    }
+
+    // Delay is taken on clock timebase, as scheduler time can be wall clock. System clock is woken up early on del.
+    sched->clock->sleep_until(sched->clock, sched->clock->now_us(sched->clock) + delay_us);
+}
+
+static void sched_task(void *arg)
+{
+    sdi12_sched_t *sched = (sdi12_sched_t *)arg;
+    int64_t now_us = sched_now_us(sched);
+
+    for (size_t i = 0; i < sched->entries_length; i++)
+    {
+        align_next(&sched->entries[i], now_us);
+    }
+
+    while (!sched->stop)
+    {
+        now_us = sched_now_us(sched);
+
+        size_t next = 0;
+        int64_t wake_us = INT64_MAX;
+        size_t collect = SIZE_MAX;
+
+        for (size_t i = 0; i < sched->entries_length; i++)
+        {
+            sdi12_sched_entry_t *entry = &sched->entries[i];
+
+            if (entry->next_us - now_us > ((int64_t)entry->plan.period_ms + entry->shift_ms) * 1000)
+            {
+                // Wall clock went backwards
+                align_next(entry, now_us);
+            }
+
+            if (entry->next_us < sched->entries[next].next_us)
+            {
+                next = i;
+            }
+
+            if (entry->collect_us != 0)
+            {
+                if (entry->collect_us <= now_us && (collect == SIZE_MAX || entry->collect_us < sched->entries[collect].collect_us))
+                {
+                    collect = i;
+                }
+                else if (entry->collect_us < wake_us)
+                {
+                    wake_us = entry->collect_us;
+                }
+            }
+        }
+
+        sdi12_sched_entry_t *entry = &sched->entries[next];
+
+        // Concurrent reads aren't part of timeline, they use any gap long enough before next planned start.
+        if (collect != SIZE_MAX && entry->next_us - now_us >= (int64_t)SDI12_SCHED_EXCHANGE_MS * 1000)
+        {
+            run_collect(sched, collect);
+            continue;
+        }
+
+        if (entry->next_us > now_us)
+        {
+            wait_until(sched, now_us, wake_us < entry->next_us ? wake_us : entry->next_us);
+            continue;
+        }
+
+        int64_t period_us = (int64_t)entry->plan.period_ms * 1000;
+
+        if (now_us - entry->next_us >= period_us)
+        {
+            // Whole periods lost (i.e. long overrun or wall clock step), sample on next boundary instead of bursting
+            uint32_t missed = (now_us - entry->next_us) / period_us;
+
+            portENTER_CRITICAL(&sched->lock);
+            entry->stats.missed += missed;
+            portEXIT_CRITICAL(&sched->lock);
+
+            align_next(entry, now_us);
+            continue;
+        }
+
+        run_start(sched, next);
+        entry->next_us += period_us;
+    }
+
+    xSemaphoreGive(sched->done_sem);
+    vTaskDelete(NULL);
+}
+
+esp_err_t sdi12_sched_get_timeline(sdi12_sched_handle_t sched, sdi12_sched_timeline_t *out_timeline)
+{
+    ESP_RETURN_ON_FALSE(sched && out_timeline, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    *out_timeline = sched->timeline;
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_sched_get_plan_stats(sdi12_sched_handle_t sched, size_t plan_index, sdi12_sched_plan_stats_t *out_stats)
+{
+    ESP_RETURN_ON_FALSE(sched && out_stats, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+    ESP_RETURN_ON_FALSE(plan_index < sched->entries_length, ESP_ERR_INVALID_ARG, TAG, "invalid plan index");
+
+    portENTER_CRITICAL(&sched->lock);
+    *out_stats = sched->entries[plan_index].stats;
+    portEXIT_CRITICAL(&sched->lock);
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_del_sched(sdi12_sched_handle_t sched)
+{
+    ESP_RETURN_ON_FALSE(sched, ESP_ERR_INVALID_ARG, TAG, "sched is NULL");
+
+    if (sched->task)
+    {
+        sched->stop = true;
+
+        // Task can be about to sleep when woken up, so wake is repeated until it is done
+        do
+        {
+            if (sched->clock->wake)
+            {
+                sched->clock->wake(sched->clock, sched->task);
+            }
+        } while (xSemaphoreTake(sched->done_sem, sched->clock->wake ? pdMS_TO_TICKS(10) : portMAX_DELAY) != pdTRUE);
+    }
+
+    if (sched->done_sem)
+    {
+        vSemaphoreDelete(sched->done_sem);
+    }
+
+    free(sched->entries);
+    free(sched);
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_new_sched(const sdi12_sched_config_t *config, sdi12_sched_handle_t *ret_sched)
+{
+    esp_err_t ret = ESP_OK;
+    uint32_t *shifts = NULL;
+
+    ESP_RETURN_ON_FALSE(config && ret_sched, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+    ESP_RETURN_ON_FALSE(config->plans && config->plans_length > 0, ESP_ERR_INVALID_ARG, TAG, "no plans");
+
+    sdi12_sched_t *sched = calloc(1, sizeof(sdi12_sched_t));
+    ESP_RETURN_ON_FALSE(sched, ESP_ERR_NO_MEM, TAG, "can't allocate scheduler");
+
+    portMUX_INITIALIZE(&sched->lock);
+    sched->wall_clock = config->flags.wall_clock;
+    sched->clock = config->clock ? config->clock : sdi12_clock_get_system();
+    sched->max_jitter_us = (config->max_jitter_ms != 0 ? config->max_jitter_ms : SDI12_SCHED_DEFAULT_MAX_JITTER_MS) * 1000;
+    sched->entries_length = config->plans_length;
+    sched->entries = calloc(config->plans_length, sizeof(sdi12_sched_entry_t));
+    shifts = calloc(config->plans_length, sizeof(uint32_t));
+    ESP_GOTO_ON_FALSE(sched->entries && shifts, ESP_ERR_NO_MEM, err, TAG, "can't allocate plans");
+
+    ESP_GOTO_ON_ERROR(compute_timeline(config->plans, config->plans_length, &sched->timeline, shifts), err, TAG, "invalid plans");
+    ESP_GOTO_ON_FALSE(sched->timeline.fits, ESP_ERR_INVALID_SIZE, err, TAG, "%u plans don't fit the bus", (unsigned int)sched->timeline.unplaced);
+
+    for (size_t i = 0; i < config->plans_length; i++)
+    {
+        sdi12_sched_entry_t *entry = &sched->entries[i];
+
+        entry->plan = config->plans[i];
+        entry->slot_ms = plan_slot_ms(&entry->plan);
+        entry->shift_ms = shifts[i];
+        entry->stats.slot_ms = entry->slot_ms;
+        entry->stats.shift_ms = entry->shift_ms;
+    }
+
+    sched->done_sem = xSemaphoreCreateBinary();
+    ESP_GOTO_ON_FALSE(sched->done_sem, ESP_ERR_NO_MEM, err, TAG, "can't create semaphore");
+
+    sched->epoch_us = sched->clock->now_us(sched->clock);
+
+    ESP_GOTO_ON_FALSE(xTaskCreate(sched_task, "sdi12_sched", config->task_stack_size != 0 ? config->task_stack_size : SDI12_SCHED_DEFAULT_STACK_SIZE,
+                          sched, config->task_priority != 0 ? config->task_priority : SDI12_SCHED_DEFAULT_PRIORITY, &sched->task) == pdPASS,
+        ESP_ERR_NO_MEM, err, TAG, "can't create task");
+
+    ESP_LOGD(TAG, "timeline: %u plans, utilization %u per mille", (unsigned int)config->plans_length, sched->timeline.utilization_permille);
+
+    free(shifts);
+    *ret_sched = sched;
+    return ESP_OK;
+
+err:
+    free(shifts);
+    sdi12_del_sched(sched);
+    return ret;
+}
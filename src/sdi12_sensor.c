@@ -0,0 +1,597 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+
+#include "driver/rmt_tx.h"
+#include "driver/rmt_rx.h"
+#include "driver/rmt_encoder.h"
+#include "driver/gpio.h"
+
+#include "sdi12_defs.h"
+#include "sdi12_sensor.h"
+#include "sdi12_sensor_proto.h"
+#include "sdi12_rmt_codec.h"
+
+#define SDI12_SENSOR_DEFAULT_STACK_SIZE     (4096)
+#define SDI12_SENSOR_DEFAULT_PRIORITY       (20)
+#define SDI12_SENSOR_RX_SYMBOLS             (512) // Cmd plus other sensor responses sent less than SDI12_SENSOR_RX_IDLE_US before it
+#define SDI12_SENSOR_CMD_LENGTH             (32)
+#define SDI12_SENSOR_RX_IDLE_US             (10 * SDI12_BIT_WIDTH_US) // Longest edge free run inside a cmd is 9 bits, 1.66 ms char gaps included
+#define SDI12_SENSOR_MIN_LEAD_US            (2 * SDI12_BIT_WIDTH_US) // Marking sent before a response start bit, at least
+#define SDI12_SENSOR_TX_SETUP_US            (700) // Reception end to TX start: task wake up, single pin channel swap and encoding
+
+_Static_assert(SDI12_SENSOR_MIN_RESPONSE_DELAY_US >= SDI12_SENSOR_RX_IDLE_US - SDI12_BIT_WIDTH_US + SDI12_SENSOR_TX_SETUP_US + SDI12_SENSOR_MIN_LEAD_US,
+    "SDI12_SENSOR_MIN_RESPONSE_DELAY_US can't be reached");
+
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+#define SDI12_RMT_CLK_SRC RMT_CLK_SRC_REF_TICK
+#else
+#define SDI12_RMT_CLK_SRC RMT_CLK_SRC_DEFAULT
+#endif
+
+typedef struct
+{
+    rmt_rx_done_event_data_t data;
+    int64_t done_us;
+} sdi12_sensor_rx_event_t;
+
+typedef struct sdi12_sensor
+{
+    uint8_t gpio_num;
+    uint8_t tx_gpio_num;
+    uint8_t rx_gpio_num;
+    int8_t dir_gpio_num;
+    bool dual_pin;
+    bool invert_tx;
+    bool invert_rx;
+    bool dir_tx_level;
+    uint16_t response_delay_us;
+
+    sdi12_sensor_proto_t proto; // Only used by sensor task
+
+    rmt_channel_handle_t tx_channel;
+    rmt_channel_handle_t rx_channel;
+    rmt_encoder_t *copy_encoder;
+    rmt_symbol_word_t *tx_symbols;
+    rmt_symbol_word_t *rx_symbols[2]; // One is armed while the other is decoded
+    uint8_t armed_index;
+    volatile int64_t tx_done_us; // Set by TX done ISR
+    QueueHandle_t rx_queue;
+    TaskHandle_t task;
+    SemaphoreHandle_t done_sem;
+    volatile bool stop;
+
+    portMUX_TYPE lock; // Protects stats
+    sdi12_sensor_stats_t stats;
+} sdi12_sensor_t;
+
+static const char *TAG = "sdi12 sensor";
+
+static bool IRAM_ATTR sensor_transmit_done_callback(rmt_channel_handle_t channel, const rmt_tx_done_event_data_t *data, void *user_data)
+{
+    sdi12_sensor_t *sensor = (sdi12_sensor_t *)user_data;
+    sensor->tx_done_us = esp_timer_get_time();
+    return false;
+}
+
+static bool IRAM_ATTR sensor_receive_done_callback(rmt_channel_handle_t channel, const rmt_rx_done_event_data_t *data, void *user_data)
+{
+    BaseType_t high_task_wakeup = pdFALSE;
+    sdi12_sensor_t *sensor = (sdi12_sensor_t *)user_data;
+    sdi12_sensor_rx_event_t event = {
+        .data = *data,
+        .done_us = esp_timer_get_time(),
+    };
+
+    xQueueSendFromISR(sensor->rx_queue, &event, &high_task_wakeup);
+    return high_task_wakeup == pdTRUE;
+}
+
+static esp_err_t config_rmt_as_tx(sdi12_sensor_t *sensor)
+{
+    rmt_tx_channel_config_t tx_channel_config = {
+        .gpio_num = sensor->tx_gpio_num,
+        .clk_src = SDI12_RMT_CLK_SRC,
+        .resolution_hz = 1 * 1000 * 1000, // 1MHz tick resolution, i.e. 1 tick = 1us
+        .mem_block_symbols = 64,
+        .trans_queue_depth = 2,
+        .flags = {
+            .io_loop_back = false,
+            .invert_out = sensor->invert_tx,
+            .with_dma = false,
+        },
+    };
+
+    ESP_RETURN_ON_ERROR(rmt_new_tx_channel(&tx_channel_config, &sensor->tx_channel), TAG, "create rmt tx channel error");
+
+    rmt_tx_event_callbacks_t cbs = {
+        .on_trans_done = sensor_transmit_done_callback,
+    };
+
+    ESP_RETURN_ON_ERROR(rmt_tx_register_event_callbacks(sensor->tx_channel, &cbs, sensor), TAG, "error registering tx callback");
+    ESP_RETURN_ON_ERROR(rmt_enable(sensor->tx_channel), TAG, "rmt tx enable error");
+
+    return ESP_OK;
+}
+
+static esp_err_t config_rmt_as_rx(sdi12_sensor_t *sensor)
+{
+    rmt_rx_channel_config_t rx_channel_config = {
+        .gpio_num = sensor->rx_gpio_num,
+        .clk_src = SDI12_RMT_CLK_SRC,
+        .mem_block_symbols = 128,
+        .resolution_hz = 1 * 1000 * 1000, // 1MHz tick resolution, i.e. 1 tick = 1us
+        .flags = {
+            .io_loop_back = false,
+            .invert_in = sensor->invert_rx,
+            .with_dma = false,
+        },
+    };
+
+    if (sensor->dual_pin)
+    {
+        ESP_RETURN_ON_ERROR(rmt_new_rx_channel(&rx_channel_config, &sensor->rx_channel), TAG, "create rmt rx channel failed");
+    }
+    else
+    {
+        // Same pull down workaround as bus: rmt_new_rx_channel enables pull up, which would look like a break.
+        gpio_hold_en(sensor->gpio_num);
+        ESP_RETURN_ON_ERROR(rmt_new_rx_channel(&rx_channel_config, &sensor->rx_channel), TAG, "create rmt rx channel failed");
+        gpio_hold_dis(sensor->gpio_num);
+        gpio_set_pull_mode(sensor->gpio_num, GPIO_PULLDOWN_ONLY);
+    }
+
+    rmt_rx_event_callbacks_t cbs = {
+        .on_recv_done = sensor_receive_done_callback,
+    };
+
+    ESP_RETURN_ON_ERROR(rmt_rx_register_event_callbacks(sensor->rx_channel, &cbs, sensor), TAG, "error registering rx callback");
+    ESP_RETURN_ON_ERROR(rmt_enable(sensor->rx_channel), TAG, "error enabling rx channel");
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Release line. Unlike a data recorder, a sensor never drives an idle line.
+ */
+static esp_err_t set_idle_line(sdi12_sensor_t *sensor)
+{
+    if (sensor->dual_pin)
+    {
+        return sensor->dir_gpio_num >= 0 ? gpio_set_level(sensor->dir_gpio_num, !sensor->dir_tx_level) : ESP_OK;
+    }
+
+    gpio_hold_dis(sensor->gpio_num);
+    ESP_RETURN_ON_ERROR(gpio_set_direction(sensor->gpio_num, GPIO_MODE_INPUT), TAG, "set idle line error");
+
+    return gpio_set_pull_mode(sensor->gpio_num, GPIO_PULLDOWN_ONLY);
+}
+
+/**
+ * @brief Start a reception. It ends when line has no edges for SDI12_SENSOR_RX_IDLE_US, that is right after a cmd, well before response window
+ * closes. Breaks are longer, so a break also ends a reception and next one starts on its spacing to marking edge.
+ */
+static esp_err_t arm_receiver(sdi12_sensor_t *sensor)
+{
+    rmt_receive_config_t receive_config = {
+        .signal_range_min_ns = 3186, // Same glitch filter as bus reception
+        .signal_range_max_ns = SDI12_SENSOR_RX_IDLE_US * 1000,
+    };
+
+    return rmt_receive(sensor->rx_channel, sensor->rx_symbols[sensor->armed_index], SDI12_SENSOR_RX_SYMBOLS * sizeof(rmt_symbol_word_t),
+        &receive_config);
+}
+
+/**
+ * @brief Send a line, <CR><LF> is added. Receiver is stopped meanwhile, so own frame isn't taken as traffic.
+ *
+ * @param sensor        sensor object
+ * @param line          null terminated line
+ * @param start_us      esp_timer time of first start bit. Sent as soon as possible if it has already passed
+ * @param out_start_us  Optional. Actual first start bit time
+ * @return esp_err_t
+ */
+static esp_err_t send_line(sdi12_sensor_t *sensor, const char *line, int64_t start_us, int64_t *out_start_us)
+{
+    esp_err_t ret = ESP_OK;
+    char frame[SDI12_SENSOR_RESPONSE_LENGTH + 2];
+    size_t length = snprintf(frame, sizeof(frame), "%s\r\n", line);
+
+    length = MIN(length, sizeof(frame) - 1);
+
+    if (sensor->dual_pin)
+    {
+        rmt_disable(sensor->rx_channel);
+
+        if (sensor->dir_gpio_num >= 0)
+        {
+            gpio_set_level(sensor->dir_gpio_num, sensor->dir_tx_level);
+        }
+    }
+    else
+    {
+        // Single pin: channels are swapped, like bus does on every transaction
+        esp_log_level_set("gpio", ESP_LOG_WARN);
+
+        gpio_hold_en(sensor->gpio_num);
+        rmt_disable(sensor->rx_channel);
+        rmt_del_channel(sensor->rx_channel);
+        sensor->rx_channel = NULL;
+        gpio_hold_dis(sensor->gpio_num);
+
+        ESP_GOTO_ON_ERROR(config_rmt_as_tx(sensor), restore, TAG, "error on tx config");
+    }
+
+    // Lead marking places start bit on time. It is taken as late as possible, so channel setup time is already paid.
+    int64_t lead_us = MAX(start_us - esp_timer_get_time(), SDI12_SENSOR_MIN_LEAD_US);
+    size_t symbols_length = SDI12_RMT_FRAME_SYMBOLS(length);
+
+    sdi12_rmt_encode_frame(frame, length, 0, (uint32_t)lead_us, sensor->tx_symbols);
+
+    rmt_transmit_config_t tx_config = {
+        .loop_count = 0,
+        .flags.eot_level = SDI12_MARKING,
+    };
+
+    ESP_GOTO_ON_ERROR(rmt_transmit(sensor->tx_channel, sensor->copy_encoder, sensor->tx_symbols, symbols_length * sizeof(rmt_symbol_word_t), &tx_config),
+        restore, TAG, "transmit error");
+    ESP_GOTO_ON_ERROR(rmt_tx_wait_all_done(sensor->tx_channel, SDI12_TX_WAIT_MS(length, 0, lead_us)), restore, TAG, "transmit timeout");
+
+    if (out_start_us)
+    {
+        // Frame length is exact, so start bit is taken back from TX done ISR time
+        *out_start_us = sensor->tx_done_us - (int64_t)length * SDI12_CHAR_US;
+    }
+
+restore:
+    if (!sensor->dual_pin && sensor->tx_channel)
+    {
+        gpio_hold_en(sensor->gpio_num);
+        rmt_disable(sensor->tx_channel);
+        rmt_del_channel(sensor->tx_channel);
+        sensor->tx_channel = NULL;
+    }
+
+    set_idle_line(sensor);
+
+    if (sensor->dual_pin)
+    {
+        rmt_enable(sensor->rx_channel);
+    }
+    else
+    {
+        if (config_rmt_as_rx(sensor) != ESP_OK)
+        {
+            ESP_LOGE(TAG, "can't restore receiver");
+        }
+
+        esp_log_level_set("gpio", CONFIG_LOG_DEFAULT_LEVEL);
+    }
+
+    if (sensor->rx_channel && arm_receiver(sensor) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "can't restart reception");
+    }
+
+    return ret;
+}
+
+static void send_response(sdi12_sensor_t *sensor, const char *response, int64_t cmd_end_us)
+{
+    int64_t start_us = 0;
+    // 0 has already passed, so send_line() answers as soon as possible
+    if (send_line(sensor, response, cmd_end_us + sensor->response_delay_us, &start_us) != ESP_OK)
+    {
+        return;
+    }
+
+    uint32_t response_delay_us = start_us > cmd_end_us ? (uint32_t)(start_us - cmd_end_us) : 0;
+
+    portENTER_CRITICAL(&sensor->lock);
+
+    ++sensor->stats.responses;
+    sensor->stats.max_response_delay_us = MAX(sensor->stats.max_response_delay_us, response_delay_us);
+
+    if (response_delay_us > SDI12_RESPONSE_START_MAX_US)
+    {
+        ++sensor->stats.late_responses;
+    }
+
+    portEXIT_CRITICAL(&sensor->lock);
+}
+
+static void handle_cmd(sdi12_sensor_t *sensor, const char *cmd, int64_t cmd_end_us)
+{
+    char response[SDI12_SENSOR_RESPONSE_LENGTH];
+    uint32_t aborted = 0;
+    esp_err_t ret = sdi12_sensor_proto_handle_cmd(&sensor->proto, cmd, cmd_end_us, esp_timer_get_time(), response, sizeof(response), &aborted);
+
+    if (ret == ESP_ERR_NOT_FOUND)
+    {
+        return;
+    }
+
+    portENTER_CRITICAL(&sensor->lock);
+    ++sensor->stats.cmds;
+    sensor->stats.aborted += aborted;
+    portEXIT_CRITICAL(&sensor->lock);
+
+    if (ret == ESP_OK)
+    {
+        send_response(sensor, response, cmd_end_us);
+    }
+}
+
+static void handle_reception(sdi12_sensor_t *sensor, const sdi12_sensor_rx_event_t *event)
+{
+    const rmt_symbol_word_t *symbols = event->data.received_symbols;
+
+    // Other buffer is armed before decoding, so traffic right after this reception isn't missed
+    sensor->armed_index ^= 1;
+
+    if (arm_receiver(sensor) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "can't restart reception");
+    }
+
+    if (event->data.num_symbols == 0)
+    {
+        return;
+    }
+
+    char cmd[SDI12_SENSOR_CMD_LENGTH];
+    bool brk = false;
+    sdi12_transport_rx_error_t rx_error = SDI12_TRANSPORT_RX_ERROR_NONE;
+    esp_err_t ret = sdi12_rmt_decode_cmd(symbols, event->data.num_symbols, cmd, sizeof(cmd), &brk, &rx_error);
+
+    // Reception starting on a spacing to marking edge means line was spacing when last one ended: a break
+    if (brk || symbols[0].level0 == SDI12_MARKING)
+    {
+        uint32_t aborted = sdi12_sensor_proto_abort(&sensor->proto);
+
+        portENTER_CRITICAL(&sensor->lock);
+        sensor->stats.aborted += aborted;
+        portEXIT_CRITICAL(&sensor->lock);
+    }
+
+    if (ret == ESP_FAIL)
+    {
+        portENTER_CRITICAL(&sensor->lock);
+        ++sensor->stats.rx_errors;
+        portEXIT_CRITICAL(&sensor->lock);
+    }
+
+    if (ret != ESP_OK)
+    {
+        return;
+    }
+
+    // '!' parity bit is spacing, so last edge is its stop bit start
+    int64_t cmd_end_us = event->done_us - SDI12_SENSOR_RX_IDLE_US + SDI12_BIT_WIDTH_US;
+
+    ESP_LOGD(TAG, "CMD: %s", cmd);
+    handle_cmd(sensor, cmd, cmd_end_us);
+}
+
+static TickType_t service_request_wait(sdi12_sensor_t *sensor)
+{
+    int64_t next_us = sdi12_sensor_proto_next_service_request(&sensor->proto);
+
+    if (next_us == INT64_MAX)
+    {
+        return portMAX_DELAY;
+    }
+
+    int64_t wait_us = next_us - esp_timer_get_time();
+
+    // One more tick, as pdMS_TO_TICKS() rounds down
+    return wait_us > 0 ? pdMS_TO_TICKS((wait_us + 999) / 1000) + 1 : 0;
+}
+
+static void send_service_requests(sdi12_sensor_t *sensor)
+{
+    char service_request[2] = { 0 };
+
+    while ((service_request[0] = sdi12_sensor_proto_pop_service_request(&sensor->proto, esp_timer_get_time())) != '\0')
+    {
+        if (send_line(sensor, service_request, 0, NULL) == ESP_OK)
+        {
+            portENTER_CRITICAL(&sensor->lock);
+            ++sensor->stats.service_requests;
+            portEXIT_CRITICAL(&sensor->lock);
+        }
+    }
+}
+
+static void sensor_task(void *arg)
+{
+    sdi12_sensor_t *sensor = (sdi12_sensor_t *)arg;
+    sdi12_sensor_rx_event_t event;
+
+    while (!sensor->stop)
+    {
+        if (xQueueReceive(sensor->rx_queue, &event, service_request_wait(sensor)) == pdPASS)
+        {
+            if (sensor->stop)
+            {
+                break;
+            }
+
+            if (event.data.received_symbols)
+            {
+                handle_reception(sensor, &event);
+            }
+        }
+
+        send_service_requests(sensor);
+    }
+
+    xSemaphoreGive(sensor->done_sem);
+    vTaskDelete(NULL);
+}
+
+esp_err_t sdi12_sensor_get_stats(sdi12_sensor_handle_t sensor, sdi12_sensor_stats_t *out_stats)
+{
+    ESP_RETURN_ON_FALSE(sensor && out_stats, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    portENTER_CRITICAL(&sensor->lock);
+    *out_stats = sensor->stats;
+    portEXIT_CRITICAL(&sensor->lock);
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_del_sensor(sdi12_sensor_handle_t sensor)
+{
+    ESP_RETURN_ON_FALSE(sensor, ESP_ERR_INVALID_ARG, TAG, "sensor is NULL");
+
+    if (sensor->task)
+    {
+        sdi12_sensor_rx_event_t wake = { 0 };
+
+        sensor->stop = true;
+        xQueueSend(sensor->rx_queue, &wake, portMAX_DELAY);
+        xSemaphoreTake(sensor->done_sem, portMAX_DELAY);
+    }
+
+    if (sensor->rx_channel)
+    {
+        rmt_disable(sensor->rx_channel);
+        rmt_del_channel(sensor->rx_channel);
+    }
+
+    if (sensor->tx_channel)
+    {
+        rmt_disable(sensor->tx_channel);
+        rmt_del_channel(sensor->tx_channel);
+    }
+
+    if (sensor->copy_encoder)
+    {
+        rmt_del_encoder(sensor->copy_encoder);
+    }
+
+    if (sensor->rx_queue)
+    {
+        vQueueDelete(sensor->rx_queue);
+    }
+
+    if (sensor->done_sem)
+    {
+        vSemaphoreDelete(sensor->done_sem);
+    }
+
+    free(sensor->rx_symbols[0]);
+    free(sensor->rx_symbols[1]);
+    free(sensor->tx_symbols);
+    sdi12_sensor_proto_deinit(&sensor->proto);
+    free(sensor);
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_new_sensor(const sdi12_sensor_config_t *config, sdi12_sensor_handle_t *ret_sensor)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(config && ret_sensor, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+    ESP_RETURN_ON_FALSE(config->response_delay_us == 0
+            || (config->response_delay_us >= SDI12_SENSOR_MIN_RESPONSE_DELAY_US && config->response_delay_us <= SDI12_RESPONSE_START_MAX_US),
+        ESP_ERR_INVALID_ARG, TAG, "response delay out of reachable window");
+
+    if (config->flags.dual_pin)
+    {
+        ESP_RETURN_ON_FALSE(GPIO_IS_VALID_OUTPUT_GPIO(config->dual_pin.tx_gpio_num), ESP_ERR_INVALID_ARG, TAG, "Invalid TX GPIO pin");
+        ESP_RETURN_ON_FALSE(GPIO_IS_VALID_GPIO(config->dual_pin.rx_gpio_num), ESP_ERR_INVALID_ARG, TAG, "Invalid RX GPIO pin");
+        ESP_RETURN_ON_FALSE(config->dual_pin.tx_gpio_num != config->dual_pin.rx_gpio_num, ESP_ERR_INVALID_ARG, TAG, "TX and RX pins must be different");
+        ESP_RETURN_ON_FALSE(config->dual_pin.dir_gpio_num < 0 || GPIO_IS_VALID_OUTPUT_GPIO(config->dual_pin.dir_gpio_num), ESP_ERR_INVALID_ARG, TAG,
+            "Invalid DIR GPIO pin");
+    }
+    else
+    {
+        ESP_RETURN_ON_FALSE(GPIO_IS_VALID_OUTPUT_GPIO(config->gpio_num), ESP_ERR_INVALID_ARG, TAG, "Invalid GPIO pin");
+    }
+
+    sdi12_sensor_t *sensor = calloc(1, sizeof(sdi12_sensor_t));
+    ESP_RETURN_ON_FALSE(sensor, ESP_ERR_NO_MEM, TAG, "can't allocate sensor");
+
+    portMUX_INITIALIZE(&sensor->lock);
+    sensor->response_delay_us = config->response_delay_us;
+
+    if (config->flags.dual_pin)
+    {
+        sensor->dual_pin = true;
+        sensor->tx_gpio_num = config->dual_pin.tx_gpio_num;
+        sensor->rx_gpio_num = config->dual_pin.rx_gpio_num;
+        sensor->dir_gpio_num = config->dual_pin.dir_gpio_num;
+        sensor->invert_tx = config->flags.invert_tx;
+        sensor->invert_rx = config->flags.invert_rx;
+        sensor->dir_tx_level = config->flags.dir_tx_level;
+    }
+    else
+    {
+        sensor->gpio_num = config->gpio_num;
+        sensor->tx_gpio_num = config->gpio_num;
+        sensor->rx_gpio_num = config->gpio_num;
+        sensor->dir_gpio_num = -1;
+    }
+
+    ESP_GOTO_ON_ERROR(sdi12_sensor_proto_init(&sensor->proto, config->devices, config->devices_count), err, TAG, "invalid devices");
+
+    sensor->tx_symbols = calloc(SDI12_RMT_FRAME_SYMBOLS(SDI12_SENSOR_RESPONSE_LENGTH + 2), sizeof(rmt_symbol_word_t));
+    sensor->rx_symbols[0] = calloc(SDI12_SENSOR_RX_SYMBOLS, sizeof(rmt_symbol_word_t));
+    sensor->rx_symbols[1] = calloc(SDI12_SENSOR_RX_SYMBOLS, sizeof(rmt_symbol_word_t));
+    ESP_GOTO_ON_FALSE(sensor->tx_symbols && sensor->rx_symbols[0] && sensor->rx_symbols[1], ESP_ERR_NO_MEM, err, TAG, "can't allocate symbols");
+
+    sensor->rx_queue = xQueueCreate(2, sizeof(sdi12_sensor_rx_event_t));
+    sensor->done_sem = xSemaphoreCreateBinary();
+    ESP_GOTO_ON_FALSE(sensor->rx_queue && sensor->done_sem, ESP_ERR_NO_MEM, err, TAG, "can't create queue");
+
+    rmt_copy_encoder_config_t copy_encoder_config = {};
+    ESP_GOTO_ON_ERROR(rmt_new_copy_encoder(&copy_encoder_config, &sensor->copy_encoder), err, TAG, "can't allocate copy encoder");
+
+    if (sensor->dual_pin)
+    {
+        if (sensor->dir_gpio_num >= 0)
+        {
+            gpio_config_t gpio_conf = {
+                .intr_type = GPIO_INTR_DISABLE,
+                .mode = GPIO_MODE_OUTPUT,
+                .pull_down_en = false,
+                .pull_up_en = false,
+                .pin_bit_mask = 1ULL << sensor->dir_gpio_num,
+            };
+
+            ESP_GOTO_ON_ERROR(gpio_config(&gpio_conf), err, TAG, "direction pin config error");
+        }
+
+        // TX channel lives for whole sensor life, transceiver keeps line released while direction pin says so
+        ESP_GOTO_ON_ERROR(config_rmt_as_tx(sensor), err, TAG, "error on tx config");
+    }
+
+    ESP_GOTO_ON_ERROR(set_idle_line(sensor), err, TAG, "can't release line");
+    ESP_GOTO_ON_ERROR(config_rmt_as_rx(sensor), err, TAG, "error on rx config");
+    ESP_GOTO_ON_ERROR(arm_receiver(sensor), err, TAG, "error starting reception");
+
+    ESP_GOTO_ON_FALSE(xTaskCreate(sensor_task, "sdi12_sensor", config->task_stack_size != 0 ? config->task_stack_size : SDI12_SENSOR_DEFAULT_STACK_SIZE,
+                          sensor, config->task_priority != 0 ? config->task_priority : SDI12_SENSOR_DEFAULT_PRIORITY, &sensor->task) == pdPASS,
+        ESP_ERR_NO_MEM, err, TAG, "can't create sensor task");
+
+    *ret_sensor = sensor;
+    return ESP_OK;
+
+err:
+    sdi12_del_sensor(sensor);
+    return ret;
+}
@@ -0,0 +1,434 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/param.h>
+
+#include "esp_check.h"
+
+#include "sdi12_sensor_proto.h"
+#include "sdi12_crc.h"
+#include "sdi12_values.h"
+
+#define SDI12_SENSOR_DEFAULT_IDENTIFICATION "14ESP-IDF SDI12E100"
+#define SDI12_SENSOR_M_PAGE_CHARS           (35) // Values chars per aDn! response after aM!/aV!
+#define SDI12_SENSOR_C_PAGE_CHARS           (75) // Values chars per aDn! response after aC! and per aRn! response
+
+static const char *TAG = "sdi12 sensor";
+
+static bool valid_address(char address)
+{
+    return (address >= '0' && address <= '9') || (address >= 'a' && address <= 'z') || (address >= 'A' && address <= 'Z');
+}
+
+static sdi12_sensor_proto_device_t *find_device(sdi12_sensor_proto_t *proto, char address)
+{
+    for (size_t i = 0; i < proto->devices_count; i++)
+    {
+        if (proto->devices[i].address == address)
+        {
+            return &proto->devices[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Abort pending aM!/aV! measurements. NULL device aborts them on every device (break).
+ *
+ * @return number of aborted measurements
+ */
+static uint32_t abort_measurements(sdi12_sensor_proto_t *proto, sdi12_sensor_proto_device_t *device)
+{
+    uint32_t aborted = 0;
+
+    for (size_t i = 0; i < proto->devices_count; i++)
+    {
+        sdi12_sensor_proto_device_t *current = &proto->devices[i];
+
+        if ((device == NULL || device == current) && current->service_request)
+        {
+            current->service_request = false;
+            current->values[0] = '\0';
+            ++aborted;
+        }
+    }
+
+    return aborted;
+}
+
+/**
+ * @brief Find a aDn! page. Values are never split between pages, a value longer than a page is sent alone.
+ *
+ * @return page length
+ */
+static size_t values_page(const char *values, uint8_t page_chars, uint8_t page, const char **out_start)
+{
+    const char *start = values;
+
+    while (true)
+    {
+        const char *end = start;
+
+        while (*end != '\0')
+        {
+            const char *value_end = end + 1;
+
+            while (*value_end != '\0' && *value_end != '+' && *value_end != '-')
+            {
+                ++value_end;
+            }
+
+            if (value_end - start > page_chars && end > start)
+            {
+                break;
+            }
+
+            end = value_end;
+        }
+
+        if (page == 0 || end == start)
+        {
+            *out_start = start;
+            return page == 0 ? end - start : 0;
+        }
+
+        start = end;
+        --page;
+    }
+}
+
+static void append_crc(char *response, size_t response_length)
+{
+    size_t length = strlen(response);
+
+    if (length + 3 < response_length)
+    {
+        sdi12_crc_ascii(response, length, response + length);
+        response[length + 3] = '\0';
+    }
+}
+
+/**
+ * @brief Check measurement cmd syntax: M, MC, Mn, MCn (C alike, n 1-9), V, Rn and RCn (n 0-9)
+ */
+static bool parse_measure_cmd(const char *body, size_t length, bool *out_crc)
+{
+    size_t i = 1;
+
+    *out_crc = false;
+
+    if (body[0] == 'V')
+    {
+        return length == 1;
+    }
+
+    if (i < length && body[i] == 'C')
+    {
+        *out_crc = true;
+        ++i;
+    }
+
+    if (i < length)
+    {
+        if (!isdigit((unsigned char)body[i]) || (body[0] != 'R' && body[i] == '0'))
+        {
+            return false;
+        }
+
+        ++i;
+    }
+    else if (body[0] == 'R')
+    {
+        return false;
+    }
+
+    return i == length;
+}
+
+static esp_err_t measure(sdi12_sensor_proto_device_t *device, const char *body, size_t length, char *values, size_t values_length, uint16_t *out_ttt_s,
+    uint32_t *out_ready_ms)
+{
+    char measure_cmd[8] = { 0 };
+    sdi12_sensor_measurement_t measurement = {
+        .values = values,
+        .values_length = values_length,
+    };
+
+    memcpy(measure_cmd, body, MIN(length, sizeof(measure_cmd) - 1));
+    values[0] = '\0';
+
+    if (device->config.on_measure)
+    {
+        esp_err_t ret = device->config.on_measure(device->address, measure_cmd, &measurement, device->config.user_ctx);
+
+        if (ret != ESP_OK)
+        {
+            return ret;
+        }
+    }
+
+    values[values_length - 1] = '\0';
+    *out_ttt_s = MIN(measurement.ttt_s, 999);
+    *out_ready_ms = measurement.ready_ms != 0 ? measurement.ready_ms : measurement.ttt_s * 1000;
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Built-in cmd handling
+ *
+ * @return esp_err_t
+ *      - ESP_OK response is ready
+ *      - ESP_ERR_NOT_SUPPORTED unknown cmd, it isn't answered
+ */
+static esp_err_t build_response(sdi12_sensor_proto_t *proto, sdi12_sensor_proto_device_t *device, const char *cmd, int64_t cmd_end_us, int64_t now_us,
+    char *out_response, size_t out_response_length)
+{
+    const char *body = cmd + 1;
+    size_t length = strlen(body) - 1; // '!' excluded
+    bool crc = false;
+    uint16_t ttt_s = 0;
+    uint32_t ready_ms = 0;
+
+    if (length == 0)
+    {
+        snprintf(out_response, out_response_length, "%c", device->address);
+        return ESP_OK;
+    }
+
+    switch (body[0])
+    {
+        case 'I':
+            if (length != 1)
+            {
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+
+            snprintf(out_response, out_response_length, "%c%s", device->address, device->config.identification);
+            return ESP_OK;
+
+        case 'A':
+            if (length != 2)
+            {
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+
+            // Invalid or busy new address keeps old one, and sensor answers with it
+            if (valid_address(body[1]) && !find_device(proto, body[1]))
+            {
+                device->address = body[1];
+            }
+
+            snprintf(out_response, out_response_length, "%c", device->address);
+            return ESP_OK;
+
+        case 'D':
+        {
+            if (length != 2 || !isdigit((unsigned char)body[1]))
+            {
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+
+            const char *page = device->values;
+            size_t page_length = 0;
+
+            if (now_us >= device->ready_us)
+            {
+                page_length = values_page(device->values, device->page_chars, body[1] - '0', &page);
+            }
+
+            snprintf(out_response, out_response_length, "%c%.*s", device->address, (int)page_length, page);
+
+            if (device->crc)
+            {
+                append_crc(out_response, out_response_length);
+            }
+
+            return ESP_OK;
+        }
+
+        case 'R':
+        {
+            if (!parse_measure_cmd(body, length, &crc))
+            {
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+
+            // Continuous measurement values are sent right away and don't replace aDn! values
+            char values[SDI12_SENSOR_C_PAGE_CHARS + 1];
+
+            if (measure(device, body, length, values, sizeof(values), &ttt_s, &ready_ms) != ESP_OK)
+            {
+                return ESP_FAIL;
+            }
+
+            snprintf(out_response, out_response_length, "%c%s", device->address, values);
+
+            if (crc)
+            {
+                append_crc(out_response, out_response_length);
+            }
+
+            return ESP_OK;
+        }
+
+        case 'M':
+        case 'C':
+        case 'V':
+        {
+            if (!parse_measure_cmd(body, length, &crc))
+            {
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+
+            if (measure(device, body, length, device->values, sizeof(device->values), &ttt_s, &ready_ms) != ESP_OK)
+            {
+                return ESP_FAIL;
+            }
+
+            bool concurrent = body[0] == 'C';
+            size_t count = sdi12_values_count(device->values);
+
+            device->crc = crc;
+            device->page_chars = concurrent ? SDI12_SENSOR_C_PAGE_CHARS : SDI12_SENSOR_M_PAGE_CHARS;
+            device->ready_us = cmd_end_us + (int64_t)ready_ms * 1000;
+            device->service_request = !concurrent && ttt_s > 0;
+
+            if (concurrent)
+            {
+                snprintf(out_response, out_response_length, "%c%03u%02u", device->address, (unsigned)ttt_s, (unsigned)MIN(count, 99));
+            }
+            else
+            {
+                snprintf(out_response, out_response_length, "%c%03u%u", device->address, (unsigned)ttt_s, (unsigned)MIN(count, 9));
+            }
+
+            return ESP_OK;
+        }
+
+        default:
+            return ESP_ERR_NOT_SUPPORTED;
+    }
+}
+
+esp_err_t sdi12_sensor_proto_handle_cmd(sdi12_sensor_proto_t *proto, const char *cmd, int64_t cmd_end_us, int64_t now_us, char *out_response,
+    size_t out_response_length, uint32_t *out_aborted)
+{
+    sdi12_sensor_proto_device_t *device;
+
+    *out_aborted = 0;
+
+    if (strcmp(cmd, "?!") == 0)
+    {
+        // Address query only works with a single sensor on the bus, any other one would answer at once
+        device = proto->devices_count == 1 ? &proto->devices[0] : NULL;
+    }
+    else
+    {
+        device = find_device(proto, cmd[0]);
+    }
+
+    if (!device)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Recorder didn't wait for service request
+    *out_aborted = abort_measurements(proto, device);
+
+    esp_err_t ret = ESP_ERR_NOT_SUPPORTED;
+
+    if (device->config.on_cmd)
+    {
+        ret = device->config.on_cmd(device->address, cmd, out_response, out_response_length, device->config.user_ctx);
+    }
+
+    if (ret == ESP_ERR_NOT_SUPPORTED)
+    {
+        ret = build_response(proto, device, cmd, cmd_end_us, now_us, out_response, out_response_length);
+    }
+
+    out_response[out_response_length - 1] = '\0';
+
+    return ret;
+}
+
+uint32_t sdi12_sensor_proto_abort(sdi12_sensor_proto_t *proto)
+{
+    return abort_measurements(proto, NULL);
+}
+
+int64_t sdi12_sensor_proto_next_service_request(const sdi12_sensor_proto_t *proto)
+{
+    int64_t next_us = INT64_MAX;
+
+    for (size_t i = 0; i < proto->devices_count; i++)
+    {
+        if (proto->devices[i].service_request)
+        {
+            next_us = MIN(next_us, proto->devices[i].ready_us);
+        }
+    }
+
+    return next_us;
+}
+
+char sdi12_sensor_proto_pop_service_request(sdi12_sensor_proto_t *proto, int64_t now_us)
+{
+    for (size_t i = 0; i < proto->devices_count; i++)
+    {
+        sdi12_sensor_proto_device_t *device = &proto->devices[i];
+
+        if (device->service_request && now_us >= device->ready_us)
+        {
+            device->service_request = false;
+            return device->address;
+        }
+    }
+
+    return '\0';
+}
+
+void sdi12_sensor_proto_deinit(sdi12_sensor_proto_t *proto)
+{
+    free(proto->devices);
+    proto->devices = NULL;
+    proto->devices_count = 0;
+}
+
+esp_err_t sdi12_sensor_proto_init(sdi12_sensor_proto_t *proto, const sdi12_sensor_device_config_t *devices, size_t devices_count)
+{
+    ESP_RETURN_ON_FALSE(devices && devices_count > 0 && devices_count <= SDI12_SENSOR_PROTO_MAX_DEVICES, ESP_ERR_INVALID_ARG, TAG, "invalid devices");
+
+    for (size_t i = 0; i < devices_count; i++)
+    {
+        ESP_RETURN_ON_FALSE(valid_address(devices[i].address), ESP_ERR_INVALID_ARG, TAG, "invalid address");
+
+        for (size_t j = 0; j < i; j++)
+        {
+            ESP_RETURN_ON_FALSE(devices[i].address != devices[j].address, ESP_ERR_INVALID_ARG, TAG, "duplicated address");
+        }
+    }
+
+    proto->devices = calloc(devices_count, sizeof(sdi12_sensor_proto_device_t));
+    ESP_RETURN_ON_FALSE(proto->devices, ESP_ERR_NO_MEM, TAG, "can't allocate devices");
+    proto->devices_count = devices_count;
+
+    for (size_t i = 0; i < devices_count; i++)
+    {
+        sdi12_sensor_proto_device_t *device = &proto->devices[i];
+
+        device->config = devices[i];
+        device->address = devices[i].address;
+        device->page_chars = SDI12_SENSOR_M_PAGE_CHARS;
+
+        if (!device->config.identification)
+        {
+            device->config.identification = SDI12_SENSOR_DEFAULT_IDENTIFICATION;
+        }
+    }
+
+    return ESP_OK;
+}
@@ -0,0 +1,536 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sys/param.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+
+#include "driver/rmt_rx.h"
+#include "driver/gpio.h"
+
+#include "sdi12_defs.h"
+#include "sdi12_sniffer.h"
+#include "sdi12_rmt_codec.h"
+
+#define SDI12_SNIFFER_DEFAULT_MAX_FRAME_CHARS (128)
+#define SDI12_SNIFFER_DEFAULT_RX_SYMBOLS      (1024)
+#define SDI12_SNIFFER_DEFAULT_STACK_SIZE      (3072)
+#define SDI12_SNIFFER_DEFAULT_PRIORITY        (10)
+#define SDI12_SNIFFER_GAP_BITS                (6) // Marking after a char longer than this ends frame. Chars are 1.66 ms apart at most, frames 8.33 ms at least
+#define SDI12_SNIFFER_WRAP                    (0xFFFF) // Record length marking ring wrap. Next record is at ring start
+#define SDI12_SNIFFER_ALIGN(x)                (((x) + 7) & ~(size_t)7)
+
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+#define SDI12_RMT_CLK_SRC RMT_CLK_SRC_REF_TICK
+#else
+#define SDI12_RMT_CLK_SRC RMT_CLK_SRC_DEFAULT
+#endif
+
+/**
+ * @brief Frame header stored in capture ring, followed by frame chars
+ */
+typedef struct
+{
+    int64_t timestamp_us;
+    uint16_t flags;
+    uint16_t length;
+} sdi12_sniffer_record_t;
+
+typedef struct
+{
+    rmt_rx_done_event_data_t data;
+    int64_t done_us;
+} sdi12_sniffer_rx_event_t;
+
+typedef struct sdi12_sniffer
+{
+    // Capture ring. Single producer (sniffer task), single consumer (reader). Offsets are relative to ring base.
+    uint8_t *ring;
+    size_t ring_size;
+    _Atomic size_t head;
+    _Atomic size_t tail;
+    SemaphoreHandle_t frame_sem;
+
+    // Frame being decoded
+    bool frame_open;
+    bool frame_dropped;
+    bool frame_wrap; // Frame was placed at ring start, so a wrap record must be left at head on commit
+    size_t frame_offset;
+    sdi12_sniffer_record_t frame;
+    bool pending_break;
+    uint16_t max_frame_chars;
+
+    sdi12_rmt_stream_t stream; // Char being decoded
+
+    rmt_channel_handle_t rx_channel;
+    rmt_symbol_word_t *symbols[2]; // One is armed while the other is decoded
+    size_t rx_symbols;
+    uint8_t armed_index;
+    QueueHandle_t rx_queue;
+    TaskHandle_t task;
+    SemaphoreHandle_t done_sem;
+    volatile bool stop;
+
+    portMUX_TYPE lock; // Protects stats
+    sdi12_sniffer_stats_t stats;
+} sdi12_sniffer_t;
+
+static const char *TAG = "sdi12 sniffer";
+
+static sdi12_sniffer_record_t *ring_record(sdi12_sniffer_t *sniffer, size_t offset)
+{
+    return (sdi12_sniffer_record_t *)(sniffer->ring + offset);
+}
+
+/**
+ * @brief Reserve ring space for a record of up to need bytes. Producer only.
+ *
+ * @return true if space was found. frame_offset and frame_wrap are set
+ */
+static bool ring_reserve(sdi12_sniffer_t *sniffer, size_t need)
+{
+    size_t head = atomic_load_explicit(&sniffer->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&sniffer->tail, memory_order_acquire);
+
+    // head == tail means empty ring, so a commit can never make them equal
+    if (head >= tail)
+    {
+        if (head + need < sniffer->ring_size || (head + need == sniffer->ring_size && tail != 0))
+        {
+            sniffer->frame_offset = head;
+            sniffer->frame_wrap = false;
+            return true;
+        }
+
+        if (need < tail)
+        {
+            sniffer->frame_offset = 0;
+            sniffer->frame_wrap = true;
+            return true;
+        }
+
+        return false;
+    }
+
+    if (head + need < tail)
+    {
+        sniffer->frame_offset = head;
+        sniffer->frame_wrap = false;
+        return true;
+    }
+
+    return false;
+}
+
+static void ring_commit(sdi12_sniffer_t *sniffer)
+{
+    size_t head = atomic_load_explicit(&sniffer->head, memory_order_relaxed);
+
+    *ring_record(sniffer, sniffer->frame_offset) = sniffer->frame;
+
+    if (sniffer->frame_wrap && sniffer->ring_size - head >= sizeof(sdi12_sniffer_record_t))
+    {
+        // Otherwise reader wraps by itself, a record header doesn't fit there
+        ring_record(sniffer, head)->length = SDI12_SNIFFER_WRAP;
+    }
+
+    head = sniffer->frame_offset + SDI12_SNIFFER_ALIGN(sizeof(sdi12_sniffer_record_t) + sniffer->frame.length);
+    atomic_store_explicit(&sniffer->head, head < sniffer->ring_size ? head : 0, memory_order_release);
+
+    xSemaphoreGive(sniffer->frame_sem);
+}
+
+static void frame_open(sdi12_sniffer_t *sniffer, int64_t timestamp_us)
+{
+    sniffer->frame_open = true;
+    sniffer->frame.timestamp_us = timestamp_us;
+    sniffer->frame.flags = sniffer->pending_break ? SDI12_SNIFFER_FRAME_BREAK : 0;
+    sniffer->frame.length = 0;
+    sniffer->pending_break = false;
+
+    // Longest frame is reserved, so chars are decoded straight into the ring
+    sniffer->frame_dropped = !ring_reserve(sniffer, SDI12_SNIFFER_ALIGN(sizeof(sdi12_sniffer_record_t) + sniffer->max_frame_chars));
+}
+
+static void frame_push(sdi12_sniffer_t *sniffer, char c)
+{
+    if (sniffer->frame.length >= sniffer->max_frame_chars)
+    {
+        sniffer->frame.flags |= SDI12_SNIFFER_FRAME_TRUNCATED;
+        return;
+    }
+
+    if (!sniffer->frame_dropped)
+    {
+        char *data = (char *)(ring_record(sniffer, sniffer->frame_offset) + 1);
+        data[sniffer->frame.length] = c;
+    }
+
+    ++sniffer->frame.length;
+}
+
+static void frame_close(sdi12_sniffer_t *sniffer)
+{
+    if (!sniffer->frame_open)
+    {
+        return;
+    }
+
+    sniffer->frame_open = false;
+
+    if (!sniffer->frame_dropped && sniffer->frame.length > 0)
+    {
+        const char *data = (const char *)(ring_record(sniffer, sniffer->frame_offset) + 1);
+        uint16_t length = sniffer->frame.length;
+
+        if (length >= 2 && data[length - 2] == '\r' && data[length - 1] == '\n')
+        {
+            sniffer->frame.length -= 2;
+        }
+        else if (data[length - 1] == '!')
+        {
+            sniffer->frame.flags |= SDI12_SNIFFER_FRAME_CMD;
+        }
+
+        ring_commit(sniffer);
+    }
+
+    portENTER_CRITICAL(&sniffer->lock);
+
+    if (sniffer->frame_dropped)
+    {
+        ++sniffer->stats.dropped;
+    }
+    else
+    {
+        ++sniffer->stats.frames;
+    }
+
+    if (sniffer->frame.flags & SDI12_SNIFFER_FRAME_ERROR)
+    {
+        ++sniffer->stats.errors;
+    }
+
+    portEXIT_CRITICAL(&sniffer->lock);
+}
+
+static void sniffer_on_char(void *ctx, char c, sdi12_transport_rx_error_t error, int64_t start_us)
+{
+    sdi12_sniffer_t *sniffer = (sdi12_sniffer_t *)ctx;
+
+    if (!sniffer->frame_open)
+    {
+        frame_open(sniffer, start_us);
+    }
+
+    if (error != SDI12_TRANSPORT_RX_ERROR_NONE)
+    {
+        sniffer->frame.flags |= SDI12_SNIFFER_FRAME_ERROR;
+    }
+
+    frame_push(sniffer, c);
+}
+
+static void sniffer_on_frame_end(void *ctx, bool brk)
+{
+    sdi12_sniffer_t *sniffer = (sdi12_sniffer_t *)ctx;
+
+    frame_close(sniffer);
+
+    if (brk)
+    {
+        sniffer->pending_break = true;
+    }
+}
+
+/**
+ * @brief Split a reception into frames and decode them into capture ring
+ *
+ * @details Reception ends after SDI12_RX_IDLE_US of idle line, so its start is that plus symbols duration before done ISR time.
+ */
+static void decode_reception(sdi12_sniffer_t *sniffer, const rmt_symbol_word_t *symbols, size_t symbols_length, int64_t done_us)
+{
+    int64_t t = done_us - SDI12_RX_IDLE_US - sdi12_rmt_symbols_duration_us(symbols, symbols_length);
+
+    sdi12_rmt_stream_reset(&sniffer->stream);
+
+    // Breaks longer than SDI12_RX_IDLE_US end previous reception before their spacing ends, so they never reach decoder. Reception starting
+    // on a spacing to marking edge means line was spacing when last one ended: a break, as on sensor side.
+    sniffer->pending_break = symbols_length > 0 && symbols[0].level0 == SDI12_MARKING;
+
+    for (size_t i = 0; i < symbols_length; i++)
+    {
+        // Zero duration is end marker
+        if (symbols[i].duration0 == 0)
+        {
+            break;
+        }
+
+        sdi12_rmt_stream_level(&sniffer->stream, symbols[i].level0, symbols[i].duration0, t);
+        t += symbols[i].duration0;
+
+        if (symbols[i].duration1 == 0)
+        {
+            break;
+        }
+
+        sdi12_rmt_stream_level(&sniffer->stream, symbols[i].level1, symbols[i].duration1, t);
+        t += symbols[i].duration1;
+    }
+
+    sdi12_rmt_stream_flush(&sniffer->stream);
+
+    if (symbols_length >= sniffer->rx_symbols)
+    {
+        sniffer->frame.flags |= SDI12_SNIFFER_FRAME_TRUNCATED;
+
+        portENTER_CRITICAL(&sniffer->lock);
+        ++sniffer->stats.overflows;
+        portEXIT_CRITICAL(&sniffer->lock);
+    }
+
+    frame_close(sniffer);
+}
+
+static bool IRAM_ATTR sniffer_receive_done_callback(rmt_channel_handle_t channel, const rmt_rx_done_event_data_t *data, void *user_data)
+{
+    BaseType_t high_task_wakeup = pdFALSE;
+    sdi12_sniffer_t *sniffer = (sdi12_sniffer_t *)user_data;
+    sdi12_sniffer_rx_event_t event = {
+        .data = *data,
+        .done_us = esp_timer_get_time(),
+    };
+
+    xQueueSendFromISR(sniffer->rx_queue, &event, &high_task_wakeup);
+    return high_task_wakeup == pdTRUE;
+}
+
+static esp_err_t arm_receiver(sdi12_sniffer_t *sniffer)
+{
+    rmt_receive_config_t receive_config = {
+        .signal_range_min_ns = 3186, // Same glitch filter as bus reception
+        .signal_range_max_ns = SDI12_RX_IDLE_US * 1000,
+    };
+
+    return rmt_receive(sniffer->rx_channel, sniffer->symbols[sniffer->armed_index], sniffer->rx_symbols * sizeof(rmt_symbol_word_t),
+        &receive_config);
+}
+
+static void sniffer_task(void *arg)
+{
+    sdi12_sniffer_t *sniffer = (sdi12_sniffer_t *)arg;
+    sdi12_sniffer_rx_event_t event;
+
+    while (!sniffer->stop)
+    {
+        if (xQueueReceive(sniffer->rx_queue, &event, portMAX_DELAY) != pdPASS || sniffer->stop || !event.data.received_symbols)
+        {
+            continue;
+        }
+
+        // Other buffer is armed before decoding, so traffic isn't missed meanwhile. Line has just been idle for longer than a break.
+        sniffer->armed_index ^= 1;
+
+        if (arm_receiver(sniffer) != ESP_OK)
+        {
+            ESP_LOGE(TAG, "can't restart reception");
+        }
+
+        decode_reception(sniffer, event.data.received_symbols, event.data.num_symbols, event.done_us);
+    }
+
+    xSemaphoreGive(sniffer->done_sem);
+    vTaskDelete(NULL);
+}
+
+esp_err_t sdi12_sniffer_read(sdi12_sniffer_handle_t sniffer, sdi12_sniffer_frame_t *out_frame, uint32_t timeout_ms)
+{
+    ESP_RETURN_ON_FALSE(sniffer && out_frame, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout = pdMS_TO_TICKS(timeout_ms);
+
+    while (true)
+    {
+        size_t tail = atomic_load_explicit(&sniffer->tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&sniffer->head, memory_order_acquire);
+
+        if (tail != head)
+        {
+            if (sniffer->ring_size - tail < sizeof(sdi12_sniffer_record_t) || ring_record(sniffer, tail)->length == SDI12_SNIFFER_WRAP)
+            {
+                atomic_store_explicit(&sniffer->tail, 0, memory_order_release);
+                continue;
+            }
+
+            const sdi12_sniffer_record_t *record = ring_record(sniffer, tail);
+
+            out_frame->timestamp_us = record->timestamp_us;
+            out_frame->flags = record->flags;
+            out_frame->length = record->length;
+            out_frame->data = (const char *)(record + 1);
+
+            return ESP_OK;
+        }
+
+        TickType_t elapsed = xTaskGetTickCount() - start;
+
+        if (elapsed >= timeout || xSemaphoreTake(sniffer->frame_sem, timeout - elapsed) != pdTRUE)
+        {
+            return ESP_ERR_TIMEOUT;
+        }
+    }
+}
+
+esp_err_t sdi12_sniffer_release(sdi12_sniffer_handle_t sniffer)
+{
+    ESP_RETURN_ON_FALSE(sniffer, ESP_ERR_INVALID_ARG, TAG, "sniffer is NULL");
+
+    size_t tail = atomic_load_explicit(&sniffer->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&sniffer->head, memory_order_acquire);
+
+    ESP_RETURN_ON_FALSE(tail != head, ESP_ERR_INVALID_STATE, TAG, "no frame to release");
+
+    if (sniffer->ring_size - tail < sizeof(sdi12_sniffer_record_t) || ring_record(sniffer, tail)->length == SDI12_SNIFFER_WRAP)
+    {
+        // Frame wasn't read yet. Skip wrap, released frame is at ring start
+        tail = 0;
+    }
+
+    tail += SDI12_SNIFFER_ALIGN(sizeof(sdi12_sniffer_record_t) + ring_record(sniffer, tail)->length);
+    atomic_store_explicit(&sniffer->tail, tail < sniffer->ring_size ? tail : 0, memory_order_release);
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_sniffer_get_stats(sdi12_sniffer_handle_t sniffer, sdi12_sniffer_stats_t *out_stats)
+{
+    ESP_RETURN_ON_FALSE(sniffer && out_stats, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    portENTER_CRITICAL(&sniffer->lock);
+    *out_stats = sniffer->stats;
+    portEXIT_CRITICAL(&sniffer->lock);
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_del_sniffer(sdi12_sniffer_handle_t sniffer)
+{
+    ESP_RETURN_ON_FALSE(sniffer, ESP_ERR_INVALID_ARG, TAG, "sniffer is NULL");
+
+    if (sniffer->task)
+    {
+        sdi12_sniffer_rx_event_t wake = { 0 };
+
+        sniffer->stop = true;
+        xQueueSend(sniffer->rx_queue, &wake, portMAX_DELAY);
+        xSemaphoreTake(sniffer->done_sem, portMAX_DELAY);
+    }
+
+    if (sniffer->rx_channel)
+    {
+        rmt_disable(sniffer->rx_channel);
+        rmt_del_channel(sniffer->rx_channel);
+    }
+
+    if (sniffer->rx_queue)
+    {
+        vQueueDelete(sniffer->rx_queue);
+    }
+
+    if (sniffer->frame_sem)
+    {
+        vSemaphoreDelete(sniffer->frame_sem);
+    }
+
+    if (sniffer->done_sem)
+    {
+        vSemaphoreDelete(sniffer->done_sem);
+    }
+
+    free(sniffer->symbols[0]);
+    free(sniffer->symbols[1]);
+    free(sniffer);
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_new_sniffer(const sdi12_sniffer_config_t *config, sdi12_sniffer_handle_t *ret_sniffer)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(config && ret_sniffer, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+    ESP_RETURN_ON_FALSE(GPIO_IS_VALID_GPIO(config->gpio_num), ESP_ERR_INVALID_ARG, TAG, "invalid gpio");
+    ESP_RETURN_ON_FALSE(config->ring, ESP_ERR_INVALID_ARG, TAG, "no capture ring");
+
+    sdi12_sniffer_t *sniffer = calloc(1, sizeof(sdi12_sniffer_t));
+    ESP_RETURN_ON_FALSE(sniffer, ESP_ERR_NO_MEM, TAG, "can't allocate sniffer");
+
+    portMUX_INITIALIZE(&sniffer->lock);
+    sniffer->max_frame_chars = config->max_frame_chars != 0 ? config->max_frame_chars : SDI12_SNIFFER_DEFAULT_MAX_FRAME_CHARS;
+    sniffer->rx_symbols = config->rx_symbols != 0 ? config->rx_symbols : SDI12_SNIFFER_DEFAULT_RX_SYMBOLS;
+    sdi12_rmt_stream_init(&sniffer->stream, SDI12_SNIFFER_GAP_BITS, sniffer_on_char, sniffer_on_frame_end, sniffer);
+
+    // Records hold an int64_t, so ring base is aligned to 8 bytes
+    uintptr_t base = SDI12_SNIFFER_ALIGN((uintptr_t)config->ring);
+    size_t skipped = base - (uintptr_t)config->ring;
+    sniffer->ring = (uint8_t *)base;
+    sniffer->ring_size = config->ring_size > skipped ? (config->ring_size - skipped) & ~(size_t)7 : 0;
+
+    ESP_GOTO_ON_FALSE(sniffer->ring_size > SDI12_SNIFFER_ALIGN(sizeof(sdi12_sniffer_record_t) + sniffer->max_frame_chars), ESP_ERR_INVALID_ARG, err,
+        TAG, "capture ring can't hold a max length frame");
+
+    sniffer->symbols[0] = calloc(sniffer->rx_symbols, sizeof(rmt_symbol_word_t));
+    sniffer->symbols[1] = calloc(sniffer->rx_symbols, sizeof(rmt_symbol_word_t));
+    ESP_GOTO_ON_FALSE(sniffer->symbols[0] && sniffer->symbols[1], ESP_ERR_NO_MEM, err, TAG, "can't allocate rx symbols");
+
+    sniffer->rx_queue = xQueueCreate(2, sizeof(sdi12_sniffer_rx_event_t));
+    sniffer->frame_sem = xSemaphoreCreateBinary();
+    sniffer->done_sem = xSemaphoreCreateBinary();
+    ESP_GOTO_ON_FALSE(sniffer->rx_queue && sniffer->frame_sem && sniffer->done_sem, ESP_ERR_NO_MEM, err, TAG, "can't create queue");
+
+    rmt_rx_channel_config_t rx_channel_config = {
+        .gpio_num = config->gpio_num,
+        .clk_src = SDI12_RMT_CLK_SRC,
+        .mem_block_symbols = 128,
+        .resolution_hz = 1 * 1000 * 1000, // 1MHz tick resolution, i.e. 1 tick = 1us
+        .flags = {
+            .io_loop_back = false,
+            .invert_in = config->flags.invert_rx,
+            .with_dma = false,
+        },
+    };
+
+    // RX channel only, pin is never an output
+    ESP_GOTO_ON_ERROR(rmt_new_rx_channel(&rx_channel_config, &sniffer->rx_channel), err, TAG, "create rmt rx channel failed");
+
+    // Same pull as bus single pin mode: RMT enables pull up, which would look like a break on an undriven line
+    gpio_set_pull_mode(config->gpio_num, GPIO_PULLDOWN_ONLY);
+
+    rmt_rx_event_callbacks_t cbs = {
+        .on_recv_done = sniffer_receive_done_callback,
+    };
+
+    ESP_GOTO_ON_ERROR(rmt_rx_register_event_callbacks(sniffer->rx_channel, &cbs, sniffer), err, TAG, "error registering rx callback");
+    ESP_GOTO_ON_ERROR(rmt_enable(sniffer->rx_channel), err, TAG, "error enabling rx channel");
+    ESP_GOTO_ON_ERROR(arm_receiver(sniffer), err, TAG, "error starting reception");
+
+    ESP_GOTO_ON_FALSE(xTaskCreate(sniffer_task, "sdi12_sniffer", config->task_stack_size != 0 ? config->task_stack_size : SDI12_SNIFFER_DEFAULT_STACK_SIZE,
+                          sniffer, config->task_priority != 0 ? config->task_priority : SDI12_SNIFFER_DEFAULT_PRIORITY, &sniffer->task) == pdPASS,
+        ESP_ERR_NO_MEM, err, TAG, "can't create sniffer task");
+
+    *ret_sniffer = sniffer;
+    return ESP_OK;
+
+err:
+    sdi12_del_sniffer(sniffer);
+    return ret;
+}
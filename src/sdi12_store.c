@@ -0,0 +1,518 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "esp_check.h"
+#include "esp_log.h"
+
+#include "sdi12_store.h"
+#include "sdi12_values.h"
+
+#define SDI12_STORE_DEFAULT_BLOCK_SIZE (256)
+#define SDI12_STORE_DEFAULT_DECIMALS   (3)
+#define SDI12_STORE_DEFAULT_RESOLUTION (1000)
+#define SDI12_STORE_MAX_DECIMALS       SDI12_VALUES_MAX_DECIMALS
+#define SDI12_STORE_VARINT_MAX         (10) // Bytes of a 64 bits varint
+#define SDI12_STORE_EXPORT_CHUNK       (1024) // Longer than a line of SDI12_STORE_MAX_CHANNELS values
+#define SDI12_STORE_ALIGN(x)           (((x) + 7) & ~(size_t)7)
+
+/**
+ * @brief Block header, followed by encoded readings. First reading has absolute values, next ones timestamp delta of delta and value deltas.
+ */
+typedef struct
+{
+    int64_t first_ts; // In time resolution units
+    int64_t last_ts;
+    uint16_t count;  // Readings in block
+    uint16_t length; // Encoded bytes after header
+} sdi12_store_block_t;
+
+typedef struct sdi12_store
+{
+    // Blocks ring. Oldest block is at tail, newest (being written) is used_blocks - 1 after it.
+    uint8_t *arena;
+    size_t block_size;
+    size_t blocks_length;
+    size_t tail;
+    size_t used_blocks;
+
+    uint8_t channels;
+    uint8_t decimals[SDI12_STORE_MAX_CHANNELS];
+    uint32_t resolution_us;
+
+    // Last reading, base of next deltas
+    int64_t last_ts;
+    int64_t last_delta;
+    int64_t last_values[SDI12_STORE_MAX_CHANNELS];
+
+    uint32_t readings;
+    uint32_t appended;
+    uint32_t evicted;
+    SemaphoreHandle_t mutex;
+} sdi12_store_t;
+
+/**
+ * @brief Block decoding state
+ */
+typedef struct
+{
+    const uint8_t *data;
+    const uint8_t *end;
+    uint16_t index;
+    int64_t ts;
+    int64_t delta;
+    int64_t values[SDI12_STORE_MAX_CHANNELS];
+} sdi12_store_cursor_t;
+
+static const char *TAG = "sdi12 store";
+
+static sdi12_store_block_t *block_at(sdi12_store_t *store, size_t index)
+{
+    return (sdi12_store_block_t *)(store->arena + ((store->tail + index) % store->blocks_length) * store->block_size);
+}
+
+static size_t payload_size(const sdi12_store_t *store)
+{
+    return store->block_size - sizeof(sdi12_store_block_t);
+}
+
+static uint64_t zigzag(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static size_t put_varint(uint8_t *out, int64_t value)
+{
+    uint64_t v = zigzag(value);
+    size_t length = 0;
+
+    while (v >= 0x80)
+    {
+        out[length++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+
+    out[length++] = (uint8_t)v;
+
+    return length;
+}
+
+static int64_t get_varint(const uint8_t **data)
+{
+    uint64_t v = 0;
+    uint8_t shift = 0;
+    uint8_t byte;
+
+    do
+    {
+        byte = *(*data)++;
+        v |= (uint64_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    return unzigzag(v);
+}
+
+/**
+ * @brief Timestamp to resolution units, rounded down also for negative timestamps
+ */
+static int64_t to_units(const sdi12_store_t *store, int64_t timestamp_us)
+{
+    int64_t units = timestamp_us / store->resolution_us;
+
+    return (timestamp_us % store->resolution_us < 0) ? units - 1 : units;
+}
+
+static void open_block(sdi12_store_t *store, int64_t ts)
+{
+    if (store->used_blocks == store->blocks_length)
+    {
+        // Arena full, oldest block makes room
+        store->evicted += block_at(store, 0)->count;
+        store->readings -= block_at(store, 0)->count;
+        store->tail = (store->tail + 1) % store->blocks_length;
+        --store->used_blocks;
+    }
+
+    sdi12_store_block_t *block = block_at(store, store->used_blocks++);
+
+    block->first_ts = ts;
+    block->last_ts = ts;
+    block->count = 0;
+    block->length = 0;
+}
+
+static esp_err_t append_locked(sdi12_store_t *store, int64_t timestamp_us, const int64_t *values)
+{
+    int64_t ts = to_units(store, timestamp_us);
+    uint8_t record[SDI12_STORE_VARINT_MAX * (SDI12_STORE_MAX_CHANNELS + 1)];
+    size_t length = 0;
+
+    ESP_RETURN_ON_FALSE(store->used_blocks == 0 || ts >= store->last_ts, ESP_ERR_INVALID_ARG, TAG, "reading older than last one");
+
+    sdi12_store_block_t *block = store->used_blocks > 0 ? block_at(store, store->used_blocks - 1) : NULL;
+
+    if (block)
+    {
+        int64_t delta = ts - store->last_ts;
+
+        length += put_varint(record, delta - store->last_delta);
+
+        for (uint8_t i = 0; i < store->channels; i++)
+        {
+            length += put_varint(record + length, values[i] - store->last_values[i]);
+        }
+    }
+
+    if (!block || block->length + length > payload_size(store) || block->count == UINT16_MAX)
+    {
+        // First reading of a block is kept whole, so blocks can be decoded alone
+        open_block(store, ts);
+        block = block_at(store, store->used_blocks - 1);
+        length = 0;
+        store->last_delta = 0;
+
+        for (uint8_t i = 0; i < store->channels; i++)
+        {
+            length += put_varint(record + length, values[i]);
+        }
+    }
+    else
+    {
+        store->last_delta = ts - store->last_ts;
+    }
+
+    memcpy((uint8_t *)(block + 1) + block->length, record, length);
+    block->length += length;
+    block->last_ts = ts;
+    ++block->count;
+
+    store->last_ts = ts;
+    memcpy(store->last_values, values, store->channels * sizeof(int64_t));
+    ++store->readings;
+    ++store->appended;
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_store_append_scaled(sdi12_store_handle_t store, int64_t timestamp_us, const int64_t *values)
+{
+    ESP_RETURN_ON_FALSE(store && values, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    xSemaphoreTake(store->mutex, portMAX_DELAY);
+    esp_err_t ret = append_locked(store, timestamp_us, values);
+    xSemaphoreGive(store->mutex);
+
+    return ret;
+}
+
+esp_err_t sdi12_store_append(sdi12_store_handle_t store, int64_t timestamp_us, const char *values)
+{
+    ESP_RETURN_ON_FALSE(store && values, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    int64_t scaled[SDI12_STORE_MAX_CHANNELS];
+    uint8_t count = 0;
+
+    while (*values != '\0')
+    {
+        ESP_RETURN_ON_FALSE(count < store->channels, ESP_ERR_INVALID_SIZE, TAG, "more values than channels");
+
+        values = sdi12_values_parse(values, store->decimals[count], &scaled[count]);
+        ESP_RETURN_ON_FALSE(values, ESP_ERR_INVALID_ARG, TAG, "malformed value %u", count);
+        ++count;
+    }
+
+    ESP_RETURN_ON_FALSE(count == store->channels, ESP_ERR_INVALID_SIZE, TAG, "%u values, %u channels", count, store->channels);
+
+    return sdi12_store_append_scaled(store, timestamp_us, scaled);
+}
+
+static void cursor_init(const sdi12_store_t *store, const sdi12_store_block_t *block, sdi12_store_cursor_t *cursor)
+{
+    cursor->data = (const uint8_t *)(block + 1);
+    cursor->end = cursor->data + block->length;
+    cursor->index = 0;
+    cursor->ts = block->first_ts;
+    cursor->delta = 0;
+}
+
+static bool cursor_next(const sdi12_store_t *store, sdi12_store_cursor_t *cursor)
+{
+    if (cursor->data >= cursor->end)
+    {
+        return false;
+    }
+
+    bool first = cursor->index++ == 0;
+
+    if (!first)
+    {
+        cursor->delta += get_varint(&cursor->data);
+        cursor->ts += cursor->delta;
+    }
+
+    for (uint8_t i = 0; i < store->channels; i++)
+    {
+        int64_t value = get_varint(&cursor->data);
+        cursor->values[i] = first ? value : cursor->values[i] + value;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Index of first block with readings not older than ts. Blocks are in time order, so binary search is used.
+ */
+static size_t find_block(sdi12_store_t *store, int64_t ts)
+{
+    size_t low = 0;
+    size_t high = store->used_blocks;
+
+    while (low < high)
+    {
+        size_t mid = (low + high) / 2;
+
+        if (block_at(store, mid)->last_ts < ts)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+static void query_locked(sdi12_store_t *store, int64_t from_us, int64_t to_us, sdi12_store_reading_cb_t on_reading, void *ctx)
+{
+    int64_t from = to_units(store, from_us);
+    int64_t to = to_units(store, to_us);
+    sdi12_store_cursor_t cursor;
+    sdi12_store_reading_t reading = {
+        .values = cursor.values,
+        .decimals = store->decimals,
+        .channels = store->channels,
+    };
+
+    for (size_t i = find_block(store, from); i < store->used_blocks && block_at(store, i)->first_ts <= to; i++)
+    {
+        cursor_init(store, block_at(store, i), &cursor);
+
+        while (cursor_next(store, &cursor) && cursor.ts <= to)
+        {
+            if (cursor.ts < from)
+            {
+                continue;
+            }
+
+            reading.timestamp_us = cursor.ts * store->resolution_us;
+
+            if (!on_reading(&reading, ctx))
+            {
+                return;
+            }
+        }
+    }
+}
+
+esp_err_t sdi12_store_query(sdi12_store_handle_t store, int64_t from_us, int64_t to_us, sdi12_store_reading_cb_t on_reading, void *ctx)
+{
+    ESP_RETURN_ON_FALSE(store && on_reading && from_us <= to_us, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    xSemaphoreTake(store->mutex, portMAX_DELAY);
+    query_locked(store, from_us, to_us, on_reading, ctx);
+    xSemaphoreGive(store->mutex);
+
+    return ESP_OK;
+}
+
+typedef struct
+{
+    sdi12_store_write_cb_t write;
+    void *ctx;
+    esp_err_t ret;
+    size_t length;
+    char chunk[SDI12_STORE_EXPORT_CHUNK];
+} sdi12_store_export_t;
+
+static bool export_flush(sdi12_store_export_t *export)
+{
+    if (export->length > 0 && export->ret == ESP_OK)
+    {
+        export->ret = export->write(export->chunk, export->length, export->ctx);
+    }
+
+    export->length = 0;
+
+    return export->ret == ESP_OK;
+}
+
+static bool export_reading(const sdi12_store_reading_t *reading, void *ctx)
+{
+    sdi12_store_export_t *export = (sdi12_store_export_t *)ctx;
+    char line[24 + SDI12_STORE_MAX_CHANNELS * 22];
+    int length = snprintf(line, sizeof(line), "%" PRId64, reading->timestamp_us);
+
+    for (uint8_t i = 0; i < reading->channels; i++)
+    {
+        int64_t value = reading->values[i];
+        uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+        int64_t scale = sdi12_values_pow10[reading->decimals[i]];
+
+        if (reading->decimals[i] == 0)
+        {
+            length += snprintf(line + length, sizeof(line) - length, ",%" PRId64, value);
+        }
+        else
+        {
+            length += snprintf(line + length, sizeof(line) - length, ",%s%" PRIu64 ".%0*" PRIu64, value < 0 ? "-" : "", magnitude / scale,
+                reading->decimals[i], magnitude % scale);
+        }
+    }
+
+    line[length++] = '\n';
+
+    if (export->length + length > sizeof(export->chunk) && !export_flush(export))
+    {
+        return false;
+    }
+
+    memcpy(export->chunk + export->length, line, length);
+    export->length += length;
+
+    return true;
+}
+
+esp_err_t sdi12_store_export_csv(sdi12_store_handle_t store, int64_t from_us, int64_t to_us, sdi12_store_write_cb_t write, void *ctx)
+{
+    ESP_RETURN_ON_FALSE(store && write && from_us <= to_us, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    sdi12_store_export_t *export = calloc(1, sizeof(sdi12_store_export_t));
+    ESP_RETURN_ON_FALSE(export, ESP_ERR_NO_MEM, TAG, "can't allocate export chunk");
+
+    export->write = write;
+    export->ctx = ctx;
+
+    xSemaphoreTake(store->mutex, portMAX_DELAY);
+    query_locked(store, from_us, to_us, export_reading, export);
+    xSemaphoreGive(store->mutex);
+
+    export_flush(export);
+    esp_err_t ret = export->ret;
+    free(export);
+
+    return ret;
+}
+
+esp_err_t sdi12_store_get_stats(sdi12_store_handle_t store, sdi12_store_stats_t *out_stats)
+{
+    ESP_RETURN_ON_FALSE(store && out_stats, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    xSemaphoreTake(store->mutex, portMAX_DELAY);
+
+    memset(out_stats, 0, sizeof(sdi12_store_stats_t));
+    out_stats->readings = store->readings;
+    out_stats->appended = store->appended;
+    out_stats->evicted = store->evicted;
+    out_stats->blocks_used = store->used_blocks;
+    out_stats->blocks_total = store->blocks_length;
+
+    for (size_t i = 0; i < store->used_blocks; i++)
+    {
+        out_stats->bytes_used += sizeof(sdi12_store_block_t) + block_at(store, i)->length;
+    }
+
+    if (store->used_blocks > 0)
+    {
+        out_stats->first_us = block_at(store, 0)->first_ts * store->resolution_us;
+        out_stats->last_us = store->last_ts * store->resolution_us;
+    }
+
+    xSemaphoreGive(store->mutex);
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_store_clear(sdi12_store_handle_t store)
+{
+    ESP_RETURN_ON_FALSE(store, ESP_ERR_INVALID_ARG, TAG, "store is NULL");
+
+    xSemaphoreTake(store->mutex, portMAX_DELAY);
+    store->tail = 0;
+    store->used_blocks = 0;
+    store->readings = 0;
+    xSemaphoreGive(store->mutex);
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_del_store(sdi12_store_handle_t store)
+{
+    ESP_RETURN_ON_FALSE(store, ESP_ERR_INVALID_ARG, TAG, "store is NULL");
+
+    if (store->mutex)
+    {
+        vSemaphoreDelete(store->mutex);
+    }
+
+    free(store);
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_new_store(const sdi12_store_config_t *config, sdi12_store_handle_t *ret_store)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(config && ret_store && config->arena, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+    ESP_RETURN_ON_FALSE(config->channels > 0 && config->channels <= SDI12_STORE_MAX_CHANNELS, ESP_ERR_INVALID_ARG, TAG, "invalid channels");
+
+    size_t block_size = SDI12_STORE_ALIGN(config->block_size != 0 ? config->block_size : SDI12_STORE_DEFAULT_BLOCK_SIZE);
+    size_t max_record = SDI12_STORE_VARINT_MAX * (config->channels + 1);
+
+    ESP_RETURN_ON_FALSE(block_size <= sizeof(sdi12_store_block_t) + UINT16_MAX && block_size >= sizeof(sdi12_store_block_t) + max_record,
+        ESP_ERR_INVALID_ARG, TAG, "block size must hold a reading of %u values", config->channels);
+
+    // Block headers hold int64_t, so arena base is aligned to 8 bytes
+    uintptr_t base = SDI12_STORE_ALIGN((uintptr_t)config->arena);
+    size_t skipped = base - (uintptr_t)config->arena;
+    size_t blocks_length = config->arena_size > skipped ? (config->arena_size - skipped) / block_size : 0;
+
+    ESP_RETURN_ON_FALSE(blocks_length >= 2, ESP_ERR_INVALID_ARG, TAG, "arena can't hold 2 blocks");
+
+    sdi12_store_t *store = calloc(1, sizeof(sdi12_store_t));
+    ESP_RETURN_ON_FALSE(store, ESP_ERR_NO_MEM, TAG, "can't allocate store");
+
+    store->arena = (uint8_t *)base;
+    store->block_size = block_size;
+    store->blocks_length = blocks_length;
+    store->channels = config->channels;
+    store->resolution_us = config->time_resolution_us != 0 ? config->time_resolution_us : SDI12_STORE_DEFAULT_RESOLUTION;
+
+    for (uint8_t i = 0; i < config->channels; i++)
+    {
+        store->decimals[i] = config->decimals ? config->decimals[i] : SDI12_STORE_DEFAULT_DECIMALS;
+        ESP_GOTO_ON_FALSE(store->decimals[i] <= SDI12_STORE_MAX_DECIMALS, ESP_ERR_INVALID_ARG, err, TAG, "channel %u: too many decimals", i);
+    }
+
+    store->mutex = xSemaphoreCreateMutex();
+    ESP_GOTO_ON_FALSE(store->mutex, ESP_ERR_NO_MEM, err, TAG, "can't create mutex");
+
+    *ret_store = store;
+    return ESP_OK;
+
+err:
+    sdi12_del_store(store);
+    return ret;
+}
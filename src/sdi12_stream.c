@@ -0,0 +1,302 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_check.h"
+#include "esp_log.h"
+
+#include "sdi12_stream.h"
+#include "sdi12_values.h"
+
+#define SDI12_STREAM_DEFAULT_STACK_SIZE (3072)
+#define SDI12_STREAM_DEFAULT_PRIORITY   (5)
+#define SDI12_STREAM_LINE_CHARS         (82) // Address, 75 values chars, CRC, <CR><LF> and '\0'
+#define SDI12_STREAM_CMD_CHARS          (6)  // "aRCx!" and '\0'
+
+typedef struct sdi12_stream
+{
+    sdi12_bus_handle_t bus;
+    sdi12_bus_access_t access;
+    sdi12_clock_t *clock;
+    uint32_t period_us;
+    uint32_t response_timeout_ms;
+
+    // Cycle batch, built once
+    size_t sources_length;
+    sdi12_bus_batch_step_t *steps;
+    sdi12_bus_batch_result_t *results;
+    char (*cmds)[SDI12_STREAM_CMD_CHARS];
+    char *lines;
+
+    // Output ring. Single producer (stream task), single consumer (reader). head and tail count samples, so full and empty differ.
+    sdi12_stream_sample_t *samples;
+    size_t samples_length;
+    _Atomic uint32_t head;
+    _Atomic uint32_t tail;
+    SemaphoreHandle_t sample_sem;
+    uint32_t seq;
+
+    TaskHandle_t task;
+    SemaphoreHandle_t done_sem;
+    volatile bool stop;
+
+    portMUX_TYPE lock; // Protects stats
+    sdi12_stream_stats_t stats;
+} sdi12_stream_t;
+
+static const char *TAG = "sdi12 stream";
+
+/**
+ * @brief Store result of a cycle step on output ring. Producer only, it never waits for reader.
+ */
+static void push_sample(sdi12_stream_t *stream, size_t source, const sdi12_bus_batch_result_t *result)
+{
+    uint32_t head = atomic_load_explicit(&stream->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&stream->tail, memory_order_acquire);
+    uint32_t seq = stream->seq++;
+
+    if (head - tail >= stream->samples_length)
+    {
+        portENTER_CRITICAL(&stream->lock);
+        ++stream->stats.dropped;
+        portEXIT_CRITICAL(&stream->lock);
+        return;
+    }
+
+    sdi12_stream_sample_t *sample = &stream->samples[head % stream->samples_length];
+    const char *values = result->ret == ESP_OK ? result->response + 1 : ""; // Skip address
+
+    sample->seq = seq;
+    sample->source = source;
+    sample->ret = result->ret;
+    sample->timestamps = result->timestamps;
+
+    if (sample->ret == ESP_OK && strlen(values) >= sizeof(sample->values))
+    {
+        sample->ret = ESP_ERR_INVALID_SIZE;
+        values = "";
+    }
+
+    strcpy(sample->values, values);
+    sample->n_values = sdi12_values_count(sample->values);
+
+    atomic_store_explicit(&stream->head, head + 1, memory_order_release);
+    xSemaphoreGive(stream->sample_sem);
+
+    portENTER_CRITICAL(&stream->lock);
+    ++stream->stats.samples;
+    stream->stats.errors += sample->ret != ESP_OK;
+    portEXIT_CRITICAL(&stream->lock);
+}
+
+static void stream_task(void *arg)
+{
+    sdi12_stream_t *stream = (sdi12_stream_t *)arg;
+    int64_t next_us = stream->clock->now_us(stream->clock);
+
+    while (!stream->stop)
+    {
+        // Steps don't stop on error, so a silent sensor doesn't starve the others
+        size_t executed = 0;
+        esp_err_t ret = sdi12_bus_send_batch_prio(stream->bus, &stream->access, stream->steps, stream->sources_length, stream->lines,
+            stream->sources_length * SDI12_STREAM_LINE_CHARS, stream->results, &executed, stream->response_timeout_ms);
+
+        if (ret == ESP_ERR_TIMEOUT && executed == 0)
+        {
+            ESP_LOGD(TAG, "bus access deadline expired, cycle skipped");
+        }
+        else
+        {
+            for (size_t i = 0; i < executed; i++)
+            {
+                push_sample(stream, i, &stream->results[i]);
+            }
+        }
+
+        int64_t now_us = stream->clock->now_us(stream->clock);
+        bool overrun = stream->period_us != 0 && now_us - next_us > stream->period_us;
+
+        portENTER_CRITICAL(&stream->lock);
+        ++stream->stats.cycles;
+        stream->stats.overruns += overrun;
+        portEXIT_CRITICAL(&stream->lock);
+
+        // Late cycles aren't caught up with bursts, next one starts right away
+        next_us = overrun ? now_us : next_us + stream->period_us;
+
+        // System clock is woken up early on del
+        while (!stream->stop && stream->clock->now_us(stream->clock) < next_us)
+        {
+            stream->clock->sleep_until(stream->clock, next_us);
+        }
+    }
+
+    xSemaphoreGive(stream->done_sem);
+    vTaskDelete(NULL);
+}
+
+esp_err_t sdi12_stream_read(sdi12_stream_handle_t stream, const sdi12_stream_sample_t **out_sample, uint32_t timeout_ms)
+{
+    ESP_RETURN_ON_FALSE(stream && out_sample, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout = pdMS_TO_TICKS(timeout_ms);
+
+    while (true)
+    {
+        uint32_t tail = atomic_load_explicit(&stream->tail, memory_order_relaxed);
+        uint32_t head = atomic_load_explicit(&stream->head, memory_order_acquire);
+
+        if (tail != head)
+        {
+            *out_sample = &stream->samples[tail % stream->samples_length];
+            return ESP_OK;
+        }
+
+        TickType_t elapsed = xTaskGetTickCount() - start;
+
+        if (elapsed >= timeout || xSemaphoreTake(stream->sample_sem, timeout - elapsed) != pdTRUE)
+        {
+            return ESP_ERR_TIMEOUT;
+        }
+    }
+}
+
+esp_err_t sdi12_stream_release(sdi12_stream_handle_t stream)
+{
+    ESP_RETURN_ON_FALSE(stream, ESP_ERR_INVALID_ARG, TAG, "stream is NULL");
+
+    uint32_t tail = atomic_load_explicit(&stream->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&stream->head, memory_order_acquire);
+
+    ESP_RETURN_ON_FALSE(tail != head, ESP_ERR_INVALID_STATE, TAG, "no sample to release");
+
+    atomic_store_explicit(&stream->tail, tail + 1, memory_order_release);
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_stream_get_stats(sdi12_stream_handle_t stream, sdi12_stream_stats_t *out_stats)
+{
+    ESP_RETURN_ON_FALSE(stream && out_stats, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+
+    portENTER_CRITICAL(&stream->lock);
+    *out_stats = stream->stats;
+    portEXIT_CRITICAL(&stream->lock);
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_del_stream(sdi12_stream_handle_t stream)
+{
+    ESP_RETURN_ON_FALSE(stream, ESP_ERR_INVALID_ARG, TAG, "stream is NULL");
+
+    if (stream->task)
+    {
+        stream->stop = true;
+
+        // Task can be about to sleep when woken up, so wake is repeated until it is done
+        do
+        {
+            if (stream->clock->wake)
+            {
+                stream->clock->wake(stream->clock, stream->task);
+            }
+        } while (xSemaphoreTake(stream->done_sem, stream->clock->wake ? pdMS_TO_TICKS(10) : portMAX_DELAY) != pdTRUE);
+    }
+
+    if (stream->sample_sem)
+    {
+        vSemaphoreDelete(stream->sample_sem);
+    }
+
+    if (stream->done_sem)
+    {
+        vSemaphoreDelete(stream->done_sem);
+    }
+
+    free(stream->steps);
+    free(stream->results);
+    free(stream->cmds);
+    free(stream->lines);
+    free(stream);
+
+    return ESP_OK;
+}
+
+esp_err_t sdi12_new_stream(const sdi12_stream_config_t *config, sdi12_stream_handle_t *ret_stream)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(config && ret_stream && config->bus, ESP_ERR_INVALID_ARG, TAG, "invalid args");
+    ESP_RETURN_ON_FALSE(config->sources && config->sources_length > 0 && config->sources_length <= UINT16_MAX, ESP_ERR_INVALID_ARG, TAG, "no sources");
+    ESP_RETURN_ON_FALSE(config->samples && config->samples_length > 0, ESP_ERR_INVALID_ARG, TAG, "no output ring");
+
+    for (size_t i = 0; i < config->sources_length; i++)
+    {
+        char address = config->sources[i].address;
+
+        ESP_RETURN_ON_FALSE((address >= '0' && address <= '9') || (address >= 'a' && address <= 'z') || (address >= 'A' && address <= 'Z'),
+            ESP_ERR_INVALID_ARG, TAG, "source %u: invalid address", (unsigned int)i);
+        ESP_RETURN_ON_FALSE(config->sources[i].index <= 9, ESP_ERR_INVALID_ARG, TAG, "source %u: invalid R index", (unsigned int)i);
+    }
+
+    sdi12_stream_t *stream = calloc(1, sizeof(sdi12_stream_t));
+    ESP_RETURN_ON_FALSE(stream, ESP_ERR_NO_MEM, TAG, "can't allocate stream");
+
+    portMUX_INITIALIZE(&stream->lock);
+    stream->bus = config->bus;
+    stream->access = config->access;
+    stream->clock = config->clock ? config->clock : sdi12_clock_get_system();
+    stream->period_us = config->period_us;
+    stream->response_timeout_ms = config->response_timeout_ms;
+    stream->samples = config->samples;
+    stream->samples_length = config->samples_length;
+    stream->sources_length = config->sources_length;
+    stream->steps = calloc(config->sources_length, sizeof(sdi12_bus_batch_step_t));
+    stream->results = calloc(config->sources_length, sizeof(sdi12_bus_batch_result_t));
+    stream->cmds = calloc(config->sources_length, SDI12_STREAM_CMD_CHARS);
+    stream->lines = calloc(config->sources_length, SDI12_STREAM_LINE_CHARS);
+    ESP_GOTO_ON_FALSE(stream->steps && stream->results && stream->cmds && stream->lines, ESP_ERR_NO_MEM, err, TAG, "can't allocate cycle");
+
+    for (size_t i = 0; i < config->sources_length; i++)
+    {
+        const sdi12_stream_source_t *source = &config->sources[i];
+        char *cmd = stream->cmds[i];
+        uint8_t index = 0;
+
+        cmd[index++] = source->address;
+        cmd[index++] = 'R';
+
+        if (source->crc)
+        {
+            cmd[index++] = 'C';
+        }
+
+        cmd[index++] = source->index + '0';
+        cmd[index++] = '!';
+        cmd[index] = '\0';
+
+        stream->steps[i].cmd = cmd;
+        stream->steps[i].crc = source->crc;
+    }
+
+    stream->sample_sem = xSemaphoreCreateBinary();
+    stream->done_sem = xSemaphoreCreateBinary();
+    ESP_GOTO_ON_FALSE(stream->sample_sem && stream->done_sem, ESP_ERR_NO_MEM, err, TAG, "can't create semaphore");
+
+    ESP_GOTO_ON_FALSE(xTaskCreate(stream_task, "sdi12_stream", config->task_stack_size != 0 ? config->task_stack_size : SDI12_STREAM_DEFAULT_STACK_SIZE,
+                          stream, config->task_priority != 0 ? config->task_priority : SDI12_STREAM_DEFAULT_PRIORITY, &stream->task) == pdPASS,
+        ESP_ERR_NO_MEM, err, TAG, "can't create task");
+
+    *ret_stream = stream;
+    return ESP_OK;
+
+err:
+    sdi12_del_stream(stream);
+    return ret;
+}
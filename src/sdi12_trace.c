@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_check.h"
+#include "esp_log.h"
+
+#include "sdi12_trace_priv.h"
+
+static const char *TAG = "sdi12 trace";
+
+#if CONFIG_SDI12_TRACE
+
+#define SDI12_TRACE_EVENTS (CONFIG_SDI12_TRACE_EVENTS)
+#define SDI12_TRACE_MASK   (SDI12_TRACE_EVENTS - 1)
+
+_Static_assert((SDI12_TRACE_EVENTS & SDI12_TRACE_MASK) == 0, "CONFIG_SDI12_TRACE_EVENTS must be a power of 2");
+
+/**
+ * @brief Ring buffer slot. seq works as a sequence lock: it is 0 while slot is being written and record number + 1 once it is complete.
+ */
+typedef struct
+{
+    _Atomic uint32_t seq;
+    uint32_t timestamp_us;
+    uint8_t type;
+    char address;
+    uint16_t arg;
+} sdi12_trace_slot_t;
+
+static sdi12_trace_slot_t s_slots[SDI12_TRACE_EVENTS];
+static _Atomic uint32_t s_write_index = 0;
+
+void IRAM_ATTR sdi12_trace_record(sdi12_trace_event_t type, char address, uint16_t arg)
+{
+    // Time is taken before slot is claimed: an ISR preempting a task writer between both would otherwise get an earlier slot with a later
+    // time. Preemption right after reading time still swaps two records, but only by the few us the ISR ran.
+    uint32_t timestamp_us = (uint32_t)esp_timer_get_time();
+
+    // Every writer (task or ISR, any core) gets its own slot, so no lock is needed. Oldest record is overwritten.
+    uint32_t index = atomic_fetch_add_explicit(&s_write_index, 1, memory_order_relaxed);
+    sdi12_trace_slot_t *slot = &s_slots[index & SDI12_TRACE_MASK];
+
+    atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot->timestamp_us = timestamp_us;
+    slot->type = (uint8_t)type;
+    slot->address = address;
+    slot->arg = arg;
+
+    atomic_store_explicit(&slot->seq, index + 1, memory_order_release);
+}
+
+size_t sdi12_trace_dump(sdi12_trace_record_t *out_records, size_t max_records)
+{
+    if (!out_records || max_records == 0)
+    {
+        return 0;
+    }
+
+    uint32_t end = atomic_load_explicit(&s_write_index, memory_order_acquire);
+    uint32_t available = end < SDI12_TRACE_EVENTS ? end : SDI12_TRACE_EVENTS;
+
+    if (available > max_records)
+    {
+        available = max_records;
+    }
+
+    size_t copied = 0;
+
+    for (uint32_t index = end - available; index != end; index++)
+    {
+        sdi12_trace_slot_t *slot = &s_slots[index & SDI12_TRACE_MASK];
+        uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+
+        if (seq != index + 1)
+        {
+            // Being written or already overwritten by a newer record
+            continue;
+        }
+
+        sdi12_trace_record_t record = {
+            .seq = index,
+            .timestamp_us = slot->timestamp_us,
+            .type = slot->type,
+            .address = slot->address,
+            .arg = slot->arg,
+        };
+
+        atomic_thread_fence(memory_order_acquire);
+
+        if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != seq)
+        {
+            continue;
+        }
+
+        out_records[copied++] = record;
+    }
+
+    return copied;
+}
+
+esp_err_t sdi12_trace_print(void)
+{
+    sdi12_trace_record_t *records = calloc(SDI12_TRACE_EVENTS, sizeof(sdi12_trace_record_t));
+    ESP_RETURN_ON_FALSE(records, ESP_ERR_NO_MEM, TAG, "can't allocate dump buffer");
+
+    size_t length = sdi12_trace_dump(records, SDI12_TRACE_EVENTS);
+
+    // Plain printf, so dump isn't filtered by log level. Format is parsed by tools/sdi12_trace_decode.py
+    for (size_t i = 0; i < length; i++)
+    {
+        printf("SDI12T %08" PRIx32 " %08" PRIx32 " %02x %02x %04x\n", records[i].seq, records[i].timestamp_us, records[i].type,
+            (uint8_t)records[i].address, records[i].arg);
+    }
+
+    free(records);
+
+    return ESP_OK;
+}
+
+void sdi12_trace_clear(void)
+{
+    for (size_t i = 0; i < SDI12_TRACE_EVENTS; i++)
+    {
+        atomic_store_explicit(&s_slots[i].seq, 0, memory_order_relaxed);
+    }
+}
+
+#else
+
+void sdi12_trace_record(sdi12_trace_event_t type, char address, uint16_t arg)
+{
+}
+
+size_t sdi12_trace_dump(sdi12_trace_record_t *out_records, size_t max_records)
+{
+    return 0;
+}
+
+esp_err_t sdi12_trace_print(void)
+{
+    ESP_LOGW(TAG, "CONFIG_SDI12_TRACE is disabled");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void sdi12_trace_clear(void)
+{
+}
+
+#endif
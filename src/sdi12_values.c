@@ -0,0 +1,70 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "sdi12_values.h"
+
+const int64_t sdi12_values_pow10[SDI12_VALUES_MAX_DECIMALS + 1] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+
+uint16_t sdi12_values_count(const char *values)
+{
+    uint16_t n = 0;
+
+    for (; *values != '\0'; values++)
+    {
+        if (*values == '+' || *values == '-')
+        {
+            ++n;
+        }
+    }
+
+    return n;
+}
+
+const char *sdi12_values_parse(const char *values, uint8_t decimals, int64_t *out_value)
+{
+    bool negative = *values == '-';
+    int64_t value = 0;
+    uint8_t digits = 0;
+    uint8_t fraction = 0;
+    bool point = false;
+    bool round_up = false;
+
+    if (*values != '+' && *values != '-')
+    {
+        return NULL;
+    }
+
+    for (values++; (*values >= '0' && *values <= '9') || (*values == '.' && !point); values++)
+    {
+        if (*values == '.')
+        {
+            point = true;
+            continue;
+        }
+
+        if (++digits > 18)
+        {
+            return NULL;
+        }
+
+        if (!point || fraction < decimals)
+        {
+            value = value * 10 + (*values - '0');
+            fraction += point;
+        }
+        else if (fraction++ == decimals)
+        {
+            round_up = *values >= '5'; // First dropped digit
+        }
+    }
+
+    if (digits == 0)
+    {
+        return NULL;
+    }
+
+    value = value * sdi12_values_pow10[decimals - (fraction < decimals ? fraction : decimals)] + round_up;
+    *out_value = negative ? -value : value;
+
+    return values;
+}
@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""Compare throughput benchmark results against a baseline and flag regressions.
+
+Usage:
+    ./build/throughput-benchmark.elf | tee bench.log
+    python tools/sdi12_bench_compare.py examples/throughput-benchmark/baseline.csv bench.log
+
+A run regresses when its readings per minute drop, or its p99 latency rises, by more than tolerance. Exit code is 1 on any regression or
+missing run, so it can gate CI. Use --update to rewrite baseline from current log.
+"""
+
+import argparse
+import csv
+import re
+import sys
+
+BENCH_LINE = re.compile(r'BENCH,([^,]+),([^,]+),([0-9.]+),(\d+),(\d+),(\d+),(\d+),(\d+)')
+
+FIELDS = ('fleet', 'strategy', 'readings_per_min', 'failed', 'bus_permille', 'p50_ms', 'p95_ms', 'p99_ms')
+
+
+def parse_log(lines):
+    runs = {}
+
+    for line in lines:
+        match = BENCH_LINE.search(line)
+
+        if match:
+            row = dict(zip(FIELDS, match.groups()))
+            runs[(row['fleet'], row['strategy'])] = row
+
+    return runs
+
+
+def parse_baseline(lines):
+    return {(row['fleet'], row['strategy']): row for row in csv.DictReader(lines)}
+
+
+def change(baseline, current):
+    if baseline == 0:
+        return 0.0 if current == 0 else float('inf')
+    return (current - baseline) * 100 / baseline
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('baseline', help='baseline CSV')
+    parser.add_argument('log', nargs='?', type=argparse.FileType('r'), default=sys.stdin, help='benchmark output')
+    parser.add_argument('-t', '--tolerance', type=float, default=5.0, help='allowed change, in %% (default 5)')
+    parser.add_argument('--update', action='store_true', help='write current results to baseline')
+    args = parser.parse_args()
+
+    current = parse_log(args.log)
+
+    if not current:
+        print('No BENCH lines found', file=sys.stderr)
+        return 1
+
+    if args.update:
+        with open(args.baseline, 'w', newline='') as baseline_file:
+            writer = csv.DictWriter(baseline_file, fieldnames=FIELDS, lineterminator='\n')
+            writer.writeheader()
+            writer.writerows(current.values())
+        print('Baseline updated with {} runs'.format(len(current)))
+        return 0
+
+    with open(args.baseline, newline='') as baseline_file:
+        baseline = parse_baseline(baseline_file)
+
+    print('{:12}  {:4}  {:>22}  {:>8}  {:>22}  {:>8}  {}'.format('fleet', 'run', 'readings/min', 'change', 'p99 (ms)', 'change', 'result'))
+
+    regressions = 0
+
+    for key, base in baseline.items():
+        run = current.get(key)
+
+        if run is None:
+            print('{:12}  {:4}  missing'.format(*key))
+            regressions += 1
+            continue
+
+        readings = (float(base['readings_per_min']), float(run['readings_per_min']))
+        p99 = (int(base['p99_ms']), int(run['p99_ms']))
+        readings_change = change(*readings)
+        p99_change = change(*p99)
+        regressed = readings_change < -args.tolerance or p99_change > args.tolerance
+        regressions += regressed
+
+        print('{:12}  {:4}  {:>10.1f} -> {:>8.1f}  {:>+7.1f}%  {:>10} -> {:>8}  {:>+7.1f}%  {}'.format(key[0], key[1], readings[0], readings[1],
+                                                                                                   readings_change, p99[0], p99[1], p99_change,
+                                                                                                   'REGRESSION' if regressed else 'ok'))
+
+    for key in current.keys() - baseline.keys():
+        print('{:12}  {:4}  not in baseline'.format(*key))
+
+    return 1 if regressions else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,16 @@
+#pragma once
+
+// Host build shim: same layout as ESP-IDF rmt_symbol_word_t.
+#include <stdint.h>
+
+typedef union
+{
+    struct
+    {
+        uint16_t duration0 : 15;
+        uint16_t level0 : 1;
+        uint16_t duration1 : 15;
+        uint16_t level1 : 1;
+    };
+    uint32_t val;
+} rmt_symbol_word_t;
@@ -0,0 +1,7 @@
+#pragma once
+
+// Host build shim: device logs are dropped, replay prints its own report.
+#define ESP_LOGE(tag, format, ...) ((void)(tag))
+#define ESP_LOGW(tag, format, ...) ((void)(tag))
+#define ESP_LOGI(tag, format, ...) ((void)(tag))
+#define ESP_LOGD(tag, format, ...) ((void)(tag))
@@ -0,0 +1,3 @@
+#pragma once
+
+// Host build shim: tracing and capture are device only.
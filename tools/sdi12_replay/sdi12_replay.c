@@ -0,0 +1,263 @@
+/**
+ * Replay RMT captures (see include/sdi12_capture.h) through component decoder and CRC code.
+ *
+ * Every record is decoded again with the buffer length it had on device and its result is compared with the captured one, so a capture corpus
+ * works as a decoder regression test. Records are then decoded in a loop to measure decoder throughput on real waveforms.
+ *
+ * Usage: sdi12_replay [-v] [-n iterations] capture.bin...
+ * Exit code is 1 if any record decodes differently than on device.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sdi12_capture.h"
+#include "sdi12_rmt_codec.h"
+#include "sdi12_crc.h"
+
+#define REPLAY_MAX_LINE (1024)
+
+typedef struct
+{
+    uint16_t num_symbols;
+    int16_t ret;
+    uint32_t done_us;
+    uint16_t buffer_length;
+    uint8_t cmd_length;
+    uint8_t rx_error;
+    char cmd[UINT8_MAX + 1];
+    rmt_symbol_word_t *symbols;
+} replay_record_t;
+
+typedef struct
+{
+    size_t records;
+    size_t symbols;
+    size_t mismatches;
+    size_t crc_ok;
+    size_t crc_bad;
+    replay_record_t *items;
+    size_t capacity;
+} replay_corpus_t;
+
+static uint16_t read_u16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t read_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static const char *ret_name(int ret)
+{
+    switch (ret)
+    {
+        case ESP_OK:
+            return "OK";
+        case ESP_FAIL:
+            return "FAIL";
+        case ESP_ERR_INVALID_SIZE:
+            return "INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:
+            return "NOT_FOUND";
+        default:
+            return "?";
+    }
+}
+
+static int load_capture(const char *path, replay_corpus_t *corpus)
+{
+    FILE *file = fopen(path, "rb");
+
+    if (!file)
+    {
+        perror(path);
+        return -1;
+    }
+
+    uint8_t header[8];
+
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) || memcmp(header, "S12C", 4) != 0 || header[4] != SDI12_CAPTURE_VERSION)
+    {
+        fprintf(stderr, "%s: not a version %d capture\n", path, SDI12_CAPTURE_VERSION);
+        fclose(file);
+        return -1;
+    }
+
+    uint8_t raw[12];
+
+    while (fread(raw, 1, sizeof(raw), file) == sizeof(raw))
+    {
+        if (corpus->records == corpus->capacity)
+        {
+            corpus->capacity = corpus->capacity ? corpus->capacity * 2 : 256;
+            corpus->items = realloc(corpus->items, corpus->capacity * sizeof(replay_record_t));
+        }
+
+        replay_record_t *record = &corpus->items[corpus->records];
+
+        record->num_symbols = read_u16(raw);
+        record->ret = (int16_t)read_u16(raw + 2);
+        record->done_us = read_u32(raw + 4);
+        record->buffer_length = read_u16(raw + 8);
+        record->cmd_length = raw[10];
+        record->rx_error = raw[11];
+
+        if (fread(record->cmd, 1, record->cmd_length, file) != record->cmd_length)
+        {
+            break;
+        }
+
+        record->cmd[record->cmd_length] = '\0';
+
+        // Allocated once cmd is read, so a truncated cmd leaks nothing
+        record->symbols = calloc(record->num_symbols + 1, sizeof(rmt_symbol_word_t));
+
+        uint8_t word[4];
+        size_t i = 0;
+
+        for (; i < record->num_symbols && fread(word, 1, sizeof(word), file) == sizeof(word); i++)
+        {
+            record->symbols[i].val = read_u32(word);
+        }
+
+        if (i != record->num_symbols)
+        {
+            fprintf(stderr, "%s: truncated record %zu\n", path, corpus->records);
+            free(record->symbols);
+            break;
+        }
+
+        corpus->symbols += record->num_symbols;
+        ++corpus->records;
+    }
+
+    fclose(file);
+    return 0;
+}
+
+static void verify(replay_corpus_t *corpus, int verbose)
+{
+    char line[REPLAY_MAX_LINE];
+
+    for (size_t i = 0; i < corpus->records; i++)
+    {
+        replay_record_t *record = &corpus->items[i];
+        size_t length = record->buffer_length < sizeof(line) ? record->buffer_length : sizeof(line);
+        sdi12_transport_rx_error_t rx_error = SDI12_TRANSPORT_RX_ERROR_NONE;
+
+        size_t line_length = 0;
+        esp_err_t ret = sdi12_rmt_decode_line(record->symbols, record->num_symbols, line, length, &line_length, &rx_error);
+        const char *crc = "";
+
+        if (ret == ESP_OK && record->cmd_length >= 2 && (record->cmd[1] == 'D' || record->cmd[1] == 'R') && line_length > 3)
+        {
+            // Captures don't know if CRC was requested, so it is only reported
+            bool crc_ok = sdi12_crc_check(line, line_length) == ESP_OK;
+            crc = crc_ok ? " crc ok" : " crc bad";
+            crc_ok ? ++corpus->crc_ok : ++corpus->crc_bad;
+        }
+
+        bool mismatch = ret != record->ret || (ret == ESP_FAIL && rx_error != record->rx_error);
+
+        if (mismatch)
+        {
+            ++corpus->mismatches;
+        }
+
+        if (verbose || mismatch)
+        {
+            printf("%6zu %10u %-8s %4u sym %-12s%s %s\n", i, record->done_us, record->cmd, record->num_symbols, ret_name(ret), crc,
+                ret == ESP_OK ? line : "");
+
+            if (mismatch)
+            {
+                printf("       MISMATCH: device got %s\n", ret_name(record->ret));
+            }
+        }
+    }
+}
+
+static double benchmark(const replay_corpus_t *corpus, unsigned iterations)
+{
+    char line[REPLAY_MAX_LINE];
+    struct timespec start, end;
+    volatile size_t sink = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (unsigned n = 0; n < iterations; n++)
+    {
+        for (size_t i = 0; i < corpus->records; i++)
+        {
+            const replay_record_t *record = &corpus->items[i];
+            sdi12_transport_rx_error_t rx_error;
+            size_t length = record->buffer_length < sizeof(line) ? record->buffer_length : sizeof(line);
+
+            sink += sdi12_rmt_decode_line(record->symbols, record->num_symbols, line, length, NULL, &rx_error);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    int verbose = 0;
+    unsigned iterations = 1000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "vn:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'v':
+                verbose = 1;
+                break;
+            case 'n':
+                iterations = (unsigned)strtoul(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-v] [-n iterations] capture.bin...\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if (optind >= argc)
+    {
+        fprintf(stderr, "usage: %s [-v] [-n iterations] capture.bin...\n", argv[0]);
+        return 2;
+    }
+
+    replay_corpus_t corpus = { 0 };
+
+    for (int i = optind; i < argc; i++)
+    {
+        if (load_capture(argv[i], &corpus) != 0)
+        {
+            return 2;
+        }
+    }
+
+    verify(&corpus, verbose);
+
+    printf("records: %zu  symbols: %zu  mismatches: %zu  crc ok/bad: %zu/%zu\n", corpus.records, corpus.symbols, corpus.mismatches, corpus.crc_ok,
+        corpus.crc_bad);
+
+    if (iterations > 0 && corpus.records > 0)
+    {
+        double seconds = benchmark(&corpus, iterations);
+        double lines = (double)corpus.records * iterations;
+
+        printf("decoder: %.0f lines/s, %.1f Msymbols/s, %.3f us/line (%u iterations)\n", lines / seconds, corpus.symbols * (double)iterations / seconds / 1e6,
+            seconds / lines * 1e6, iterations);
+    }
+
+    return corpus.mismatches > 0 ? 1 : 0;
+}
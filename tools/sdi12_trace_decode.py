@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""Decode SDI-12 bus trace dumped by sdi12_trace_print() into a readable timeline.
+
+Usage:
+    idf.py monitor | tee monitor.log
+    python tools/sdi12_trace_decode.py monitor.log
+
+Non trace lines are ignored, so a raw serial log can be used. Reads stdin if no file is given.
+"""
+
+import argparse
+import re
+import sys
+
+TRACE_LINE = re.compile(r'SDI12T ([0-9a-f]{8}) ([0-9a-f]{8}) ([0-9a-f]{2}) ([0-9a-f]{2}) ([0-9a-f]{4})')
+
+# Must match sdi12_trace_event_t
+EVENTS = {
+    1: 'TX_FRAME',
+    2: 'RX_FRAME',
+    3: 'PARITY_ERROR',
+    4: 'STOP_ERROR',
+    5: 'CRC_ERROR',
+    6: 'TIMEOUT',
+    7: 'RETRY',
+    8: 'USER',
+}
+
+TX_BREAK_FLAG = 0x8000
+
+
+def describe(event, arg):
+    if event == 'TX_FRAME':
+        return 'len={} {}'.format(arg & ~TX_BREAK_FLAG, 'break' if arg & TX_BREAK_FLAG else 'no break')
+    if event == 'RX_FRAME':
+        return 'len={}'.format(arg)
+    if event in ('PARITY_ERROR', 'STOP_ERROR'):
+        return 'after {} chars'.format(arg)
+    if event == 'CRC_ERROR':
+        return 'response len={}'.format(arg)
+    if event == 'TIMEOUT':
+        return 'waited {} ms'.format(arg)
+    if event == 'RETRY':
+        return 'attempt {}'.format(arg)
+    return 'arg=0x{:04x}'.format(arg)
+
+
+def parse(lines):
+    records = {}
+
+    for line in lines:
+        match = TRACE_LINE.search(line)
+
+        if match:
+            seq, timestamp, event, address, arg = (int(field, 16) for field in match.groups())
+            records[seq] = (timestamp, event, address, arg)
+
+    return [(seq,) + records[seq] for seq in sorted(records)]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('log', nargs='?', type=argparse.FileType('r'), default=sys.stdin, help='serial log with trace dump')
+    args = parser.parse_args()
+
+    records = parse(args.log)
+
+    if not records:
+        print('No trace records found', file=sys.stderr)
+        return 1
+
+    print('{:>10}  {:>12}  {:>10}  {:4}  {:14}  {}'.format('seq', 'time (ms)', 'delta (ms)', 'addr', 'event', 'details'))
+
+    # Timestamps are esp_timer low 32 bits, unwrap them. Records written from ISRs can be a few us out of order, so only a drop larger
+    # than half the range is a wrap: step from previous record is taken as a signed 32 bits difference.
+    base = None
+    previous = None
+    last_raw = None
+    last_seq = None
+
+    for seq, timestamp, event, address, arg in records:
+        if last_raw is None:
+            absolute = timestamp
+        else:
+            step = (timestamp - last_raw) & 0xFFFFFFFF
+            absolute = previous + (step - (1 << 32) if step >= (1 << 31) else step)
+
+        base = absolute if base is None else base
+        delta = '' if previous is None else '{:.3f}'.format((absolute - previous) / 1000)
+
+        if last_seq is not None and seq != last_seq + 1:
+            print('{:>10}  {} records lost'.format('...', seq - last_seq - 1))
+
+        name = EVENTS.get(event, 'UNKNOWN({})'.format(event))
+        addr = chr(address) if address else '-'
+
+        print('{:>10}  {:>12.3f}  {:>10}  {:4}  {:14}  {}'.format(seq, (absolute - base) / 1000, delta, addr, name, describe(name, arg)))
+
+        previous = absolute
+        last_raw = timestamp
+        last_seq = seq
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())